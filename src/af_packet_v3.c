@@ -34,9 +34,9 @@
 #include "af_packet_v3.h"
 #include "signal_handling.h"
 #include "libmerc/utils.h"
-#include "rnd_pkt_drop.h"
 #include "output.h"
 #include "pkt_processing.h"
+#include "libmerc/socket_filter.h"
 
 /*
  * The thread_storage, stats_tracking, and ring_limits structs are
@@ -70,10 +70,14 @@ struct stats_tracking {
   uint64_t socket_packets;
   uint64_t socket_drops;
   uint64_t socket_freezes;
+  uint64_t output_drops;
+  bool load_shedding;         /* The packet processors shed load adaptively */
+  struct thread_queues *qs;   /* The lockless output queues */
   int *t_start_p;             /* The clean start predicate */
   pthread_cond_t *t_start_c;  /* The clean start condition */
   pthread_mutex_t *t_start_m; /* The clean start mutex */
   int verbosity;
+  mercury_context mc;         /* Its resources are reloaded on SIGHUP */
 };
 
 /*
@@ -96,6 +100,7 @@ struct thread_storage {
   int *t_start_p;             /* The clean start predicate */
   pthread_cond_t *t_start_c;  /* The clean start condition */
   pthread_mutex_t *t_start_m; /* The clean start mutex */
+  class socket_filter *filter; /* The filter to attach to the socket, or NULL */
 };
 
 
@@ -153,7 +158,9 @@ void process_all_packets_in_block(struct tpacket_block_desc *block_hdr,
   unsigned long byte_count = 0;
   struct tpacket3_hdr *pkt_hdr;
   //struct timespec ts;
-  struct packet_info pi;
+  struct packet_info pi[PROCESS_BATCH_SIZE];
+  uint8_t *eth[PROCESS_BATCH_SIZE];
+  size_t n = 0;
 
   pkt_hdr = (struct tpacket3_hdr *) ((uint8_t *) block_hdr + block_hdr->hdr.bh1.offset_to_first_pkt);
   for (i = 0; i < num_pkts; ++i) {
@@ -166,17 +173,23 @@ void process_all_packets_in_block(struct tpacket_block_desc *block_hdr,
       byte_count += pkt_hdr->tp_snaplen;
 
     /* Grab the times */
-    pi.ts.tv_sec = pkt_hdr->tp_sec;
-    pi.ts.tv_nsec = pkt_hdr->tp_nsec;
+    pi[n].ts.tv_sec = pkt_hdr->tp_sec;
+    pi[n].ts.tv_nsec = pkt_hdr->tp_nsec;
 
-    pi.caplen = pkt_hdr->tp_snaplen;
-    pi.len = pkt_hdr->tp_snaplen;
+    pi[n].caplen = pkt_hdr->tp_snaplen;
+    pi[n].len = pkt_hdr->tp_snaplen;
 
-    uint8_t *eth = (uint8_t *)pkt_hdr + pkt_hdr->tp_mac;
-    pkt_processor->apply(&pi, eth);
+    eth[n] = (uint8_t *)pkt_hdr + pkt_hdr->tp_mac;
+    if (++n == PROCESS_BATCH_SIZE) {
+        pkt_processor->apply_batch(pi, eth, n);
+        n = 0;
+    }
 
     pkt_hdr = (struct tpacket3_hdr *) ((uint8_t *)pkt_hdr + pkt_hdr->tp_next_offset);
   }
+  if (n > 0) {
+      pkt_processor->apply_batch(pi, eth, n);
+  }
 
   /* Atomic operations
    * https://gcc.gnu.org/onlinedocs/gcc-4.1.0/gcc/Atomic-Builtins.html
@@ -185,32 +198,9 @@ void process_all_packets_in_block(struct tpacket_block_desc *block_hdr,
   __sync_add_and_fetch(&(statst->received_bytes), byte_count);
 }
 
-void check_socket_drops(int duration, uint64_t sdps, uint64_t sfps, int *socket_drops, int *zero_drops) {
-    int current_percent;
-
-    if (sdps == 0 && sfps == 0) {
-       (*zero_drops)++;
-       (*socket_drops) = 0;
-       if (*zero_drops >= 60) {
-          *zero_drops = 0;
-          current_percent = increment_percent_accept(5);
-          fprintf(stderr, "  Duration: %6d, Current percent acceptance Increased to %d\n", duration, current_percent);
-       }
-    } else {
-       (*zero_drops) = 0;
-       (*socket_drops)++;
-       if (*socket_drops > 1) {
-           *socket_drops = -58;
-           current_percent = increment_percent_accept(-10);
-           fprintf(stderr, "  Duration: %6d,    Current percent acceptance Decreased to %d\n", duration, current_percent);
-       }
-    }
-}
-
 void *stats_thread_func(void *statst_arg) {
 
     struct stats_tracking *statst = (struct stats_tracking *)statst_arg;
-    int duration = 0, socket_drops = 0, zero_drops = 0;
 
   /* The stats thread is one of the first to get started and it has to wait
    * for the other threads otherwise we'll be tracking bogus stats
@@ -239,12 +229,31 @@ void *stats_thread_func(void *statst_arg) {
   struct timespec ts;
   double time_d; /* time delta */
   memset(&ts, 0, sizeof(ts));
+
+  /* Snapshots of the output queue counters at the start and end of each interval */
+  struct output_queue_stats *oq_prev = (struct output_queue_stats *)calloc(statst->qs->qnum, sizeof(struct output_queue_stats));
+  struct output_queue_stats *oq_curr = (struct output_queue_stats *)calloc(statst->qs->qnum, sizeof(struct output_queue_stats));
+  if (oq_prev == NULL || oq_curr == NULL) {
+    fprintf(stderr, "error: could not allocate memory for output queue stats\n");
+    exit(255);
+  }
+  output_queue_stats_snapshot(statst->qs, oq_prev, false);
+
+  /* Snapshots of the load shedding counters of each thread, likewise */
+  struct load_shed_stats *ls_prev = (struct load_shed_stats *)calloc(statst->num_threads, sizeof(struct load_shed_stats));
+  struct load_shed_stats *ls_curr = (struct load_shed_stats *)calloc(statst->num_threads, sizeof(struct load_shed_stats));
+  if (ls_prev == NULL || ls_curr == NULL) {
+    fprintf(stderr, "error: could not allocate memory for load shedding stats\n");
+    exit(255);
+  }
   /**
    * Enable all signals so that this thread shuts down first
    */
   enable_all_signals();
 
   while (sig_close_flag == 0) {
+    reload_resources_if_requested(statst->mc);
+
     uint64_t packets_before = statst->received_packets;
     uint64_t bytes_before = statst->received_bytes;
     uint64_t socket_packets_before = statst->socket_packets;
@@ -270,8 +279,17 @@ void *stats_thread_func(void *statst_arg) {
     double worst_rusage = 0; /* Worst average rbuffer usage */
     double worst_i_rusage = 0; /* Worst instantaneous rbuffer usage */
     for (int thread = 0; thread < statst->num_threads; thread++) {
+      uint64_t thread_drops_before = statst->socket_drops;
       af_packet_stats(statst->tstor[thread].sockfd, statst);
 
+      /* Each thread sheds load according to the drops on its own socket */
+      struct load_shedder *shedder = &(statst->tstor[thread].pkt_processor->shedder);
+      if (shedder->adjust(statst->socket_drops - thread_drops_before)) {
+        fprintf(stderr, "thread %d: load shedding now accepts %d%% of packets that are not flow-initial\n",
+                thread, shedder->percent_accept.load());
+      }
+      shedder->snapshot(&ls_curr[thread]);
+
       int thread_block_count = statst->tstor[thread].ring_params.tp_block_nr;
       double *bstreak_hist = statst->tstor[thread].block_streak_hist;
 
@@ -332,6 +350,20 @@ void *stats_thread_func(void *statst_arg) {
     uint64_t sdps = statst->socket_drops - socket_drops_before;
     uint64_t sfps = statst->socket_freezes - socket_freezes_before;
 
+    /* The output queue stats, which are not scaled either */
+    output_queue_stats_snapshot(statst->qs, oq_curr, false);
+    uint64_t odps = 0;               /* output drops */
+    uint64_t oblocked = 0;           /* time producers spent blocked on output (nanoseconds) */
+    uint64_t worst_in_use = 0;       /* worst output queue usage (bytes) */
+    for (int q = 0; q < statst->qs->qnum; q++) {
+      odps += oq_curr[q].drops - oq_prev[q].drops;
+      oblocked += oq_curr[q].blocked_nsec - oq_prev[q].blocked_nsec;
+      if (oq_curr[q].in_use > worst_in_use) {
+        worst_in_use = oq_curr[q].in_use;
+      }
+    }
+    statst->output_drops += odps;
+
     /* Compute the estimated Ethernet rate which accounts for the
      * "extra" per-packet data including the:
      * interpacket gap (12 bytes)
@@ -377,22 +409,34 @@ void *stats_thread_func(void *statst_arg) {
                 "%7.03f%s Packets/s; Data Rate %7.03f%s bytes/s; "
                 "Ethernet Rate (est.) %7.03f%s bits/s; "
                 "Socket Packets %7.03f%s; Socket Drops %" PRIu64 " (packets); Socket Freezes %" PRIu64 "; "
-                "All threads avg. rbuf %4.1f%%; Worst thread avg. rbuf %4.1f%%; Worst instantaneous rbuf %4.1f%%\n",
+                "All threads avg. rbuf %4.1f%%; Worst thread avg. rbuf %4.1f%%; Worst instantaneous rbuf %4.1f%%; "
+                "Output Drops %" PRIu64 "; Output Blocked %.1f ms; Worst output queue %4.1f%%\n",
                 (ts.tv_sec + (ts.tv_nsec / 1000000000.0)),
                 r_pps, r_pps_s, r_byps, r_byps_s,
                 r_ebips, r_ebips_s,
                 r_spps, r_spps_s, sdps, sfps,
                 (tot_rusage / (statst->num_threads)) * 100.0, worst_rusage * 100.0,
-                worst_i_rusage * 100.0);
+                worst_i_rusage * 100.0,
+                odps, oblocked / 1000000.0, (worst_in_use * 100.0) / LLQ_BUF_SIZE);
+        if (statst->load_shedding) {
+            load_shed_stats_write_json(stderr, statst->num_threads, ls_curr, ls_prev);
+        }
     }
 
-    duration++;
-    if (get_percent_accept() > 0) {
-        /* check socket drops and update accept percentage only when percent accept > 0 */
-        check_socket_drops(duration, sdps, sfps, &socket_drops, &zero_drops);
-    }
+    struct output_queue_stats *oq_tmp = oq_prev;
+    oq_prev = oq_curr;
+    oq_curr = oq_tmp;
+
+    struct load_shed_stats *ls_tmp = ls_prev;
+    ls_prev = ls_curr;
+    ls_curr = ls_tmp;
   }
 
+  free(oq_prev);
+  free(oq_curr);
+  free(ls_prev);
+  free(ls_curr);
+
   return NULL;
 }
 
@@ -416,6 +460,19 @@ int create_dedicated_socket(struct thread_storage *thread_stor, int fanout_arg)
   /* Now store this socket file descriptor in the thread storage */
   thread_stor->sockfd = sockfd;
 
+  /*
+   * attach the socket filter before anything else, so that no
+   * unfiltered packets are queued on the socket
+   */
+  if (thread_stor->filter) {
+    struct sock_fprog fprog = thread_stor->filter->program();
+    err = setsockopt(sockfd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+    if (err) {
+      fprintf(stderr, "%s: could not attach socket filter for thread %d\n", strerror(errno), thread_stor->tnum);
+      return -1;
+    }
+  }
+
   /*
    * set AF_PACKET version to V3, which is more performant, as it
    * reads in blocks of packets, not single packets
@@ -802,6 +859,8 @@ enum status bind_and_dispatch(struct mercury_config *cfg,
   statst.t_start_c = &t_start_c;
   statst.t_start_m = &t_start_m;
   statst.verbosity = cfg->verbosity;
+  statst.mc = mc;
+  statst.load_shedding = cfg->adaptive;
 
   struct thread_storage *tstor;  // Holds the array of struct thread_storage, one for each thread
   tstor = (struct thread_storage *)malloc(num_threads * sizeof(struct thread_storage));
@@ -809,6 +868,7 @@ enum status bind_and_dispatch(struct mercury_config *cfg,
     perror("could not allocate memory for strocut thread_storage array\n");
   }
   statst.tstor = tstor; // The stats thread needs to know how to access the socket for each packet worker
+  statst.qs = &out_ctx->qs; // and the output queue for each packet worker
 
   /* Now that we know how many threads we will have, we need
    * to figure out what our ring parameters will be */
@@ -855,6 +915,31 @@ enum status bind_and_dispatch(struct mercury_config *cfg,
   thread_ring_req.tp_retire_blk_tov = rl.af_blocktimeout;
   thread_ring_req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
   
+  /*
+   * compile the protocol selection into a socket filter; the kernel
+   * keeps its own copy of the program, so the filter is only needed
+   * while the sockets are created
+   */
+  class socket_filter *filter = NULL;
+  if (cfg->socket_filter) {
+    try {
+      filter = new socket_filter{mc->selector, mc->global_vars};
+    }
+    catch (std::exception &e) {
+      fprintf(stderr, "error: could not compile socket filter (%s)\n", e.what());
+      return status_err;
+    }
+    if (cfg->verbosity) {
+      fprintf(stderr, "compiled protocol selection into a socket filter of %zu instructions\n", filter->size());
+    }
+    if (filter->passes_all_tcp_data()) {
+      fprintf(stderr, "note: with tcp reassembly or nonselected-tcp-data, the socket filter passes all tcp data\n");
+    }
+    if (filter->passes_all_udp_data()) {
+      fprintf(stderr, "note: with nonselected-udp-data, the socket filter passes all udp data\n");
+    }
+  }
+
   /* Get all the thread storage ready and allocate the sockets */
   for (int thread = 0; thread < num_threads; thread++) {
     /* Init the thread storage for this thread */
@@ -894,6 +979,7 @@ enum status bind_and_dispatch(struct mercury_config *cfg,
     tstor[thread].t_start_p = &t_start_p;
     tstor[thread].t_start_c = &t_start_c;
     tstor[thread].t_start_m = &t_start_m;
+    tstor[thread].filter = filter;
 
     tstor[thread].block_streak_hist = (double *)calloc(thread_ring_blockcount + 1, sizeof(double));
     if (!(tstor[thread].block_streak_hist)) {
@@ -908,7 +994,9 @@ enum status bind_and_dispatch(struct mercury_config *cfg,
       fprintf(stderr, "error creating dedicated socket for thread %d\n", thread);
       exit(255);
     }
+    tstor[thread].filter = NULL;
   }
+  delete filter;
 
   /* drop privileges from root to normal user */
   if (drop_root_privileges(cfg->user, cfg->working_dir) != status_ok) {
@@ -983,6 +1071,18 @@ enum status bind_and_dispatch(struct mercury_config *cfg,
     pthread_join(tstor[thread].tid, NULL);
   }
 
+  /* total up the packets shed by each thread, by class */
+  uint64_t shed[shed_class_max] = { 0 };
+  uint64_t shed_total = 0;
+  for (int thread = 0; thread < num_threads; thread++) {
+    struct load_shed_stats ls;
+    tstor[thread].pkt_processor->shedder.snapshot(&ls);
+    for (int c = 0; c < shed_class_max; c++) {
+      shed[c] += ls.shed[c];
+      shed_total += ls.shed[c];
+    }
+  }
+
   /* free up resources */
   for (int thread = 0; thread < num_threads; thread++) {
     free(tstor[thread].block_header);
@@ -998,8 +1098,17 @@ enum status bind_and_dispatch(struct mercury_config *cfg,
 	  "%" PRIu64 " bytes captured\n"
 	  "%" PRIu64 " packets seen by socket\n"
 	  "%" PRIu64 " packets dropped\n"
-	  "%" PRIu64 " socket queue freezes\n",
-	  statst.received_packets, statst.received_bytes, statst.socket_packets, statst.socket_drops, statst.socket_freezes);
+	  "%" PRIu64 " socket queue freezes\n"
+	  "%" PRIu64 " records dropped by output queues\n",
+	  statst.received_packets, statst.received_bytes, statst.socket_packets, statst.socket_drops, statst.socket_freezes,
+	  statst.output_drops);
+  if (cfg->adaptive) {
+    fprintf(stderr, "%" PRIu64 " packets shed (", shed_total);
+    for (int c = shed_class_tcp_data; c < shed_class_max; c++) {
+      fprintf(stderr, "%s%s: %" PRIu64, c == shed_class_tcp_data ? "" : ", ", shed_class_get_name((enum shed_class)c), shed[c]);
+    }
+    fprintf(stderr, ")\n");
+  }
 
   return status_ok;
 }
@@ -0,0 +1,1032 @@
+/*
+ * af_xdp.c
+ *
+ * interface to AF_XDP sockets, with a UMEM for each thread and a
+ * built-in XDP program that steers packets to them
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.
+ * License at https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <poll.h>
+#include <time.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+
+#include <vector>
+
+#include "af_xdp.h"
+#include "signal_handling.h"
+#include "libmerc/utils.h"
+#include "output.h"
+#include "pkt_processing.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+/*
+ * Each packet is received into its own frame of the UMEM, so
+ * XSK_FRAME_SIZE limits the size of the packets that can be captured
+ */
+#define XSK_FRAME_SIZE      4096
+#define XSK_MIN_FRAMES      4096       /* The smallest UMEM that we use, in frames */
+#define XSK_MAX_FRAMES      (1 << 18)  /* The largest UMEM that we use, in frames */
+#define XSK_COMP_RING_SIZE  64         /* Nothing is transmitted, but the kernel requires a completion ring */
+
+/*
+ * The XDP program built by --xdp-filter passes the first
+ * XDP_FILTER_FLOW_SEGMENTS TCP data segments in each direction of a
+ * flow, and drops the rest; it tracks up to XDP_FILTER_FLOWS flows,
+ * and forgets the least recently used ones first.
+ */
+#define XDP_FILTER_FLOW_SEGMENTS 16
+#define XDP_FILTER_FLOWS         (1 << 18)
+
+/*
+ * The xsk_stats_tracking, xsk_thread_storage, and xsk_ring structs
+ * are local to this file.
+ */
+
+/* A ring that is shared with the kernel through mmap() */
+struct xsk_ring {
+    uint32_t *producer;
+    uint32_t *consumer;
+    uint32_t *flags;
+    void *desc;
+    uint32_t size;          /* The number of descriptors, which is a power of two */
+    void *map;
+    size_t map_len;
+};
+
+struct xsk_stats_tracking {
+    struct xsk_thread_storage *tstor;
+    int num_threads;
+    uint64_t received_packets;
+    uint64_t received_bytes;
+    uint64_t socket_drops;      /* Packets that the kernel could not put in an RX ring */
+    uint64_t fill_ring_empty;   /* Times that the kernel found no free frame in a fill ring */
+    uint64_t output_drops;
+    struct thread_queues *qs;   /* The lockless output queues */
+    int *t_start_p;             /* The clean start predicate */
+    pthread_cond_t *t_start_c;  /* The clean start condition */
+    pthread_mutex_t *t_start_m; /* The clean start mutex */
+    int verbosity;
+    mercury_context mc;         /* Its resources are reloaded on SIGHUP */
+};
+
+struct xsk_thread_storage {
+    struct pkt_proc *pkt_processor;
+    int tnum;                   /* Thread Number, which is also the receive queue number */
+    pthread_t tid;              /* Thread ID */
+    int sockfd;                 /* AF_XDP socket owned by this thread */
+    bool zero_copy;             /* The socket is bound in zero-copy mode */
+    uint8_t *umem;              /* The frames into which packets are received */
+    uint32_t num_frames;
+    struct xsk_ring rx;
+    struct xsk_ring fill;
+    struct xsk_ring comp;
+    struct xdp_statistics last_stats;  /* The socket counters at the previous stats interval */
+    struct xsk_stats_tracking *statst;
+    int *t_start_p;             /* The clean start predicate */
+    pthread_cond_t *t_start_c;  /* The clean start condition */
+    pthread_mutex_t *t_start_m; /* The clean start mutex */
+};
+
+/*
+ * As in af_packet_v3.c, the stats thread watches sig_close_flag, and
+ * the worker threads watch sig_close_workers, so that the stats
+ * thread ends first.
+ */
+extern int sig_close_flag; /* defined in signal_handling.c */
+static int sig_close_workers = 0;
+
+
+/*
+ * == The XDP program ==
+ *
+ * The program that steers packets to the AF_XDP sockets is assembled
+ * at run time and loaded with the bpf() system call, so that mercury
+ * does not need libbpf or a BPF compiler.
+ */
+
+static int sys_bpf(enum bpf_cmd cmd, union bpf_attr *attr) {
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+static int bpf_map_create(enum bpf_map_type type, uint32_t key_size, uint32_t value_size, uint32_t max_entries, const char *name) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = type;
+    attr.key_size = key_size;
+    attr.value_size = value_size;
+    attr.max_entries = max_entries;
+    strncpy(attr.map_name, name, sizeof(attr.map_name) - 1);
+    return sys_bpf(BPF_MAP_CREATE, &attr);
+}
+
+static int bpf_map_update(int map_fd, const void *key, const void *value) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = map_fd;
+    attr.key = (uint64_t)(uintptr_t)key;
+    attr.value = (uint64_t)(uintptr_t)value;
+    attr.flags = BPF_ANY;
+    return sys_bpf(BPF_MAP_UPDATE_ELEM, &attr);
+}
+
+/*
+ * class bpf_assembler builds an eBPF program one instruction at a
+ * time; jumps refer to labels, which are resolved by program()
+ */
+class bpf_assembler {
+    std::vector<struct bpf_insn> insns;
+    std::vector<size_t> labels;
+    std::vector<std::pair<size_t, int>> fixups;  /* (jump instruction, label) */
+
+    void emit(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+        struct bpf_insn insn;
+        memset(&insn, 0, sizeof(insn));
+        insn.code = code;
+        insn.dst_reg = dst;
+        insn.src_reg = src;
+        insn.off = off;
+        insn.imm = imm;
+        insns.push_back(insn);
+    }
+
+public:
+    int new_label() {
+        labels.push_back(0);
+        return labels.size() - 1;
+    }
+
+    void bind(int label) { labels[label] = insns.size(); }
+
+    void alu(uint8_t op, uint8_t dst, int32_t imm) { emit(BPF_ALU64 | op | BPF_K, dst, 0, 0, imm); }
+
+    void alu_reg(uint8_t op, uint8_t dst, uint8_t src) { emit(BPF_ALU64 | op | BPF_X, dst, src, 0, 0); }
+
+    void be16_to_host(uint8_t dst) { emit(BPF_ALU | BPF_END | BPF_TO_BE, dst, 0, 0, 16); }
+
+    void load(uint8_t size, uint8_t dst, uint8_t src, int16_t off) { emit(BPF_LDX | BPF_MEM | size, dst, src, off, 0); }
+
+    void store(uint8_t size, uint8_t dst, int16_t off, uint8_t src) { emit(BPF_STX | BPF_MEM | size, dst, src, off, 0); }
+
+    void load_map(uint8_t dst, int map_fd) {
+        emit(BPF_LD | BPF_DW | BPF_IMM, dst, BPF_PSEUDO_MAP_FD, 0, map_fd);
+        emit(0, 0, 0, 0, 0);
+    }
+
+    void call(int32_t helper) { emit(BPF_JMP | BPF_CALL, 0, 0, 0, helper); }
+
+    void ret() { emit(BPF_JMP | BPF_EXIT, 0, 0, 0, 0); }
+
+    void jump(int label) { jump_if(BPF_JA, 0, 0, label); }
+
+    void jump_if(uint8_t op, uint8_t dst, int32_t imm, int label) {
+        fixups.push_back({insns.size(), label});
+        emit(BPF_JMP | op | BPF_K, dst, 0, 0, imm);
+    }
+
+    void jump_if_reg(uint8_t op, uint8_t dst, uint8_t src, int label) {
+        fixups.push_back({insns.size(), label});
+        emit(BPF_JMP | op | BPF_X, dst, src, 0, 0);
+    }
+
+    const std::vector<struct bpf_insn> &program() {
+        for (const auto &f : fixups) {
+            insns[f.first].off = labels[f.second] - f.first - 1;
+        }
+        return insns;
+    }
+};
+
+/*
+ * xdp_program_assemble() writes the XDP program into a.  It redirects
+ * each packet to the AF_XDP socket for the queue on which it arrived,
+ * or passes it to the network stack if there is no such socket.
+ *
+ * If flows_map_fd is not -1, then the program first drops TCP packets
+ * that mercury would not parse: pure acknowledgements, and data
+ * segments after the first XDP_FILTER_FLOW_SEGMENTS in each direction
+ * of a flow, which are counted in the LRU hash flows_map_fd.  SYN,
+ * FIN, and RST segments, fragments, and anything that is not TCP over
+ * untagged IPv4 or IPv6 are always passed.  An IPv6 address is folded
+ * into 32 bits for the flow key, which can only cause a flow to be
+ * passed for longer than it should be.
+ */
+static void xdp_program_assemble(bpf_assembler &a, int xsks_map_fd, int flows_map_fd) {
+    const int key = -16;     /* stack offset of the flow key: saddr, daddr, sport, dport */
+    const int value = -20;   /* stack offset of the segment count for a new flow */
+
+    int redirect = a.new_label();
+
+    a.alu_reg(BPF_MOV, BPF_REG_6, BPF_REG_1);                        /* r6 = ctx */
+
+    if (flows_map_fd != -1) {
+        int ipv4 = a.new_label();
+        int tcp = a.new_label();
+        int syn = a.new_label();
+        int new_flow = a.new_label();
+        int update = a.new_label();
+        int drop = a.new_label();
+
+        a.load(BPF_W, BPF_REG_7, BPF_REG_6, offsetof(struct xdp_md, data));
+        a.load(BPF_W, BPF_REG_8, BPF_REG_6, offsetof(struct xdp_md, data_end));
+
+        /* ethernet */
+        a.alu_reg(BPF_MOV, BPF_REG_2, BPF_REG_7);
+        a.alu(BPF_ADD, BPF_REG_2, ETH_HLEN);
+        a.jump_if_reg(BPF_JGT, BPF_REG_2, BPF_REG_8, redirect);
+        a.load(BPF_H, BPF_REG_3, BPF_REG_7, 12);
+        a.jump_if(BPF_JEQ, BPF_REG_3, htons(ETH_P_IP), ipv4);
+        a.jump_if(BPF_JNE, BPF_REG_3, htons(ETH_P_IPV6), redirect);
+
+        /* ipv6, with the TCP header immediately after the fixed header */
+        a.alu_reg(BPF_MOV, BPF_REG_2, BPF_REG_7);
+        a.alu(BPF_ADD, BPF_REG_2, ETH_HLEN + 40 + 20);
+        a.jump_if_reg(BPF_JGT, BPF_REG_2, BPF_REG_8, redirect);
+        a.load(BPF_B, BPF_REG_3, BPF_REG_7, ETH_HLEN + 6);
+        a.jump_if(BPF_JNE, BPF_REG_3, IPPROTO_TCP, redirect);
+        a.load(BPF_H, BPF_REG_9, BPF_REG_7, ETH_HLEN + 4);           /* r9 = payload length */
+        a.be16_to_host(BPF_REG_9);
+        for (int addr = 0; addr < 2; addr++) {
+            int16_t off = ETH_HLEN + 8 + addr * 16;
+            a.load(BPF_W, BPF_REG_2, BPF_REG_7, off);
+            for (int i = 1; i < 4; i++) {
+                a.load(BPF_W, BPF_REG_3, BPF_REG_7, off + i * 4);
+                a.alu_reg(BPF_XOR, BPF_REG_2, BPF_REG_3);
+            }
+            a.store(BPF_W, BPF_REG_10, key + addr * 4, BPF_REG_2);
+        }
+        a.alu(BPF_ADD, BPF_REG_7, ETH_HLEN + 40);                    /* r7 = tcp header */
+        a.jump(tcp);
+
+        /* ipv4 */
+        a.bind(ipv4);
+        a.alu_reg(BPF_MOV, BPF_REG_2, BPF_REG_7);
+        a.alu(BPF_ADD, BPF_REG_2, ETH_HLEN + 20);
+        a.jump_if_reg(BPF_JGT, BPF_REG_2, BPF_REG_8, redirect);
+        a.load(BPF_B, BPF_REG_3, BPF_REG_7, ETH_HLEN + 9);
+        a.jump_if(BPF_JNE, BPF_REG_3, IPPROTO_TCP, redirect);
+        a.load(BPF_H, BPF_REG_3, BPF_REG_7, ETH_HLEN + 6);
+        a.alu(BPF_AND, BPF_REG_3, htons(0x3fff));                    /* more fragments, or fragment offset */
+        a.jump_if(BPF_JNE, BPF_REG_3, 0, redirect);
+        a.load(BPF_W, BPF_REG_2, BPF_REG_7, ETH_HLEN + 12);
+        a.store(BPF_W, BPF_REG_10, key, BPF_REG_2);
+        a.load(BPF_W, BPF_REG_2, BPF_REG_7, ETH_HLEN + 16);
+        a.store(BPF_W, BPF_REG_10, key + 4, BPF_REG_2);
+        a.load(BPF_H, BPF_REG_9, BPF_REG_7, ETH_HLEN + 2);           /* r9 = total length */
+        a.be16_to_host(BPF_REG_9);
+        a.load(BPF_B, BPF_REG_3, BPF_REG_7, ETH_HLEN);
+        a.alu(BPF_AND, BPF_REG_3, 0x0f);
+        a.alu(BPF_LSH, BPF_REG_3, 2);                                /* r3 = header length */
+        a.jump_if(BPF_JLT, BPF_REG_3, 20, redirect);
+        a.alu_reg(BPF_SUB, BPF_REG_9, BPF_REG_3);                    /* r9 = payload length */
+        a.alu(BPF_ADD, BPF_REG_7, ETH_HLEN);
+        a.alu_reg(BPF_ADD, BPF_REG_7, BPF_REG_3);                    /* r7 = tcp header */
+        a.alu_reg(BPF_MOV, BPF_REG_2, BPF_REG_7);
+        a.alu(BPF_ADD, BPF_REG_2, 20);
+        a.jump_if_reg(BPF_JGT, BPF_REG_2, BPF_REG_8, redirect);
+
+        /* tcp */
+        a.bind(tcp);
+        a.load(BPF_H, BPF_REG_2, BPF_REG_7, 0);
+        a.store(BPF_H, BPF_REG_10, key + 8, BPF_REG_2);
+        a.load(BPF_H, BPF_REG_2, BPF_REG_7, 2);
+        a.store(BPF_H, BPF_REG_10, key + 10, BPF_REG_2);
+        a.load(BPF_B, BPF_REG_3, BPF_REG_7, 12);
+        a.alu(BPF_RSH, BPF_REG_3, 4);
+        a.alu(BPF_LSH, BPF_REG_3, 2);
+        a.alu_reg(BPF_SUB, BPF_REG_9, BPF_REG_3);                    /* r9 = tcp data length */
+        a.load(BPF_B, BPF_REG_3, BPF_REG_7, 13);                     /* r3 = tcp flags */
+        a.alu_reg(BPF_MOV, BPF_REG_2, BPF_REG_3);
+        a.alu(BPF_AND, BPF_REG_2, 0x02);
+        a.jump_if(BPF_JNE, BPF_REG_2, 0, syn);
+        a.alu_reg(BPF_MOV, BPF_REG_2, BPF_REG_3);
+        a.alu(BPF_AND, BPF_REG_2, 0x05);                             /* FIN or RST */
+        a.jump_if(BPF_JNE, BPF_REG_2, 0, redirect);
+        a.jump_if(BPF_JSLE, BPF_REG_9, 0, drop);
+
+        a.load_map(BPF_REG_1, flows_map_fd);
+        a.alu_reg(BPF_MOV, BPF_REG_2, BPF_REG_10);
+        a.alu(BPF_ADD, BPF_REG_2, key);
+        a.call(BPF_FUNC_map_lookup_elem);
+        a.jump_if(BPF_JEQ, BPF_REG_0, 0, new_flow);
+        a.load(BPF_W, BPF_REG_1, BPF_REG_0, 0);
+        a.jump_if(BPF_JGE, BPF_REG_1, XDP_FILTER_FLOW_SEGMENTS, drop);
+        a.alu(BPF_ADD, BPF_REG_1, 1);
+        a.store(BPF_W, BPF_REG_0, 0, BPF_REG_1);
+        a.jump(redirect);
+
+        /* a SYN starts the count for its direction over again */
+        a.bind(syn);
+        a.alu(BPF_MOV, BPF_REG_1, 0);
+        a.jump(update);
+        a.bind(new_flow);
+        a.alu(BPF_MOV, BPF_REG_1, 1);
+        a.bind(update);
+        a.store(BPF_W, BPF_REG_10, value, BPF_REG_1);
+        a.load_map(BPF_REG_1, flows_map_fd);
+        a.alu_reg(BPF_MOV, BPF_REG_2, BPF_REG_10);
+        a.alu(BPF_ADD, BPF_REG_2, key);
+        a.alu_reg(BPF_MOV, BPF_REG_3, BPF_REG_10);
+        a.alu(BPF_ADD, BPF_REG_3, value);
+        a.alu(BPF_MOV, BPF_REG_4, BPF_ANY);
+        a.call(BPF_FUNC_map_update_elem);
+        a.jump(redirect);
+
+        a.bind(drop);
+        a.alu(BPF_MOV, BPF_REG_0, XDP_DROP);
+        a.ret();
+    }
+
+    /* return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS) */
+    a.bind(redirect);
+    a.load(BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, rx_queue_index));
+    a.load_map(BPF_REG_1, xsks_map_fd);
+    a.alu(BPF_MOV, BPF_REG_3, XDP_PASS);
+    a.call(BPF_FUNC_redirect_map);
+    a.ret();
+}
+
+static int xdp_program_load(int xsks_map_fd, int flows_map_fd) {
+    bpf_assembler a;
+    xdp_program_assemble(a, xsks_map_fd, flows_map_fd);
+    const std::vector<struct bpf_insn> &insns = a.program();
+    static const char license[] = "Dual BSD/GPL";
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.expected_attach_type = BPF_XDP;
+    attr.insns = (uint64_t)(uintptr_t)insns.data();
+    attr.insn_cnt = insns.size();
+    attr.license = (uint64_t)(uintptr_t)license;
+    strncpy(attr.prog_name, "mercury_xsk", sizeof(attr.prog_name) - 1);
+    int prog_fd = sys_bpf(BPF_PROG_LOAD, &attr);
+    if (prog_fd < 0) {
+        int err = errno;
+
+        /* load it again, to get the verifier log */
+        std::vector<char> log(1 << 16);
+        attr.log_buf = (uint64_t)(uintptr_t)log.data();
+        attr.log_size = log.size();
+        attr.log_level = 1;
+        if (sys_bpf(BPF_PROG_LOAD, &attr) < 0) {
+            fprintf(stderr, "%s", log.data());
+        }
+        fprintf(stderr, "%s: could not load XDP program\n", strerror(err));
+        return -1;
+    }
+    return prog_fd;
+}
+
+/*
+ * xdp_program_attach() attaches the program to the interface through
+ * a BPF link, so that it is detached when mercury exits, however that
+ * happens.  The driver's native XDP hook is used if it has one.
+ */
+static int xdp_program_attach(int prog_fd, int ifindex, const char *if_name, int verbosity) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = prog_fd;
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = XDP_FLAGS_DRV_MODE;
+    int link_fd = sys_bpf(BPF_LINK_CREATE, &attr);
+    if (link_fd >= 0) {
+        if (verbosity) {
+            fprintf(stderr, "attached XDP program to %s in native mode\n", if_name);
+        }
+        return link_fd;
+    }
+    attr.link_create.flags = XDP_FLAGS_SKB_MODE;
+    link_fd = sys_bpf(BPF_LINK_CREATE, &attr);
+    if (link_fd >= 0) {
+        fprintf(stderr, "notice: %s does not support native XDP; using generic XDP, which is slower\n", if_name);
+        return link_fd;
+    }
+    fprintf(stderr, "%s: could not attach XDP program to interface %s\n", strerror(errno), if_name);
+    return -1;
+}
+
+
+/*
+ * == AF_XDP sockets ==
+ */
+
+static int xsk_ring_map(struct xsk_ring *r, int sockfd, const struct xdp_ring_offset *off,
+                        uint32_t size, size_t desc_size, off_t pgoff) {
+    r->map_len = off->desc + size * desc_size;
+    r->map = mmap(NULL, r->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, sockfd, pgoff);
+    if (r->map == MAP_FAILED) {
+        r->map = NULL;
+        return -1;
+    }
+    r->producer = (uint32_t *)((uint8_t *)r->map + off->producer);
+    r->consumer = (uint32_t *)((uint8_t *)r->map + off->consumer);
+    r->flags = (uint32_t *)((uint8_t *)r->map + off->flags);
+    r->desc = (uint8_t *)r->map + off->desc;
+    r->size = size;
+    return 0;
+}
+
+static void xsk_ring_unmap(struct xsk_ring *r) {
+    if (r->map) {
+        munmap(r->map, r->map_len);
+        r->map = NULL;
+    }
+}
+
+/*
+ * xsk_socket_create() creates the AF_XDP socket for a thread, with
+ * its UMEM and rings, puts every frame of the UMEM on the fill ring,
+ * and binds the socket to receive queue tnum of the interface,
+ * in zero-copy mode if the driver supports it
+ */
+static int xsk_socket_create(struct xsk_thread_storage *t, int ifindex, const char *if_name) {
+    t->sockfd = socket(AF_XDP, SOCK_RAW, 0);
+    if (t->sockfd == -1) {
+        fprintf(stderr, "%s: could not create AF_XDP socket for thread %d\n", strerror(errno), t->tnum);
+        return -1;
+    }
+
+    size_t umem_len = (size_t)t->num_frames * XSK_FRAME_SIZE;
+    fprintf(stderr, "Requesting UMEM with %zu bytes (%u frames of size %d) for thread %d\n",
+            umem_len, t->num_frames, XSK_FRAME_SIZE, t->tnum);
+    t->umem = (uint8_t *)mmap(NULL, umem_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (t->umem == MAP_FAILED) {
+        t->umem = NULL;
+        fprintf(stderr, "%s: could not allocate UMEM for thread %d\n", strerror(errno), t->tnum);
+        return -1;
+    }
+
+    struct xdp_umem_reg umem_reg;
+    memset(&umem_reg, 0, sizeof(umem_reg));
+    umem_reg.addr = (uint64_t)(uintptr_t)t->umem;
+    umem_reg.len = umem_len;
+    umem_reg.chunk_size = XSK_FRAME_SIZE;
+    umem_reg.headroom = 0;
+    if (setsockopt(t->sockfd, SOL_XDP, XDP_UMEM_REG, &umem_reg, sizeof(umem_reg)) != 0) {
+        fprintf(stderr, "%s: could not register UMEM for thread %d\n", strerror(errno), t->tnum);
+        return -1;
+    }
+
+    uint32_t ring_size = t->num_frames;
+    uint32_t comp_ring_size = XSK_COMP_RING_SIZE;
+    if (setsockopt(t->sockfd, SOL_XDP, XDP_UMEM_FILL_RING, &ring_size, sizeof(ring_size)) != 0 ||
+        setsockopt(t->sockfd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &comp_ring_size, sizeof(comp_ring_size)) != 0 ||
+        setsockopt(t->sockfd, SOL_XDP, XDP_RX_RING, &ring_size, sizeof(ring_size)) != 0) {
+        fprintf(stderr, "%s: could not set up AF_XDP rings for thread %d\n", strerror(errno), t->tnum);
+        return -1;
+    }
+
+    struct xdp_mmap_offsets off;
+    socklen_t optlen = sizeof(off);
+    if (getsockopt(t->sockfd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) != 0) {
+        fprintf(stderr, "%s: could not get AF_XDP ring offsets for thread %d\n", strerror(errno), t->tnum);
+        return -1;
+    }
+    if (xsk_ring_map(&t->fill, t->sockfd, &off.fr, ring_size, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) != 0 ||
+        xsk_ring_map(&t->comp, t->sockfd, &off.cr, comp_ring_size, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING) != 0 ||
+        xsk_ring_map(&t->rx, t->sockfd, &off.rx, ring_size, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) != 0) {
+        fprintf(stderr, "%s: mmap of AF_XDP rings failed for thread %d\n", strerror(errno), t->tnum);
+        return -1;
+    }
+
+    /* give every frame to the kernel */
+    uint64_t *fill_desc = (uint64_t *)t->fill.desc;
+    for (uint32_t i = 0; i < t->num_frames; i++) {
+        fill_desc[i] = (uint64_t)i * XSK_FRAME_SIZE;
+    }
+    __atomic_store_n(t->fill.producer, t->num_frames, __ATOMIC_RELEASE);
+
+    struct sockaddr_xdp addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sxdp_family = AF_XDP;
+    addr.sxdp_ifindex = ifindex;
+    addr.sxdp_queue_id = t->tnum;
+    addr.sxdp_flags = XDP_ZEROCOPY | XDP_USE_NEED_WAKEUP;
+    t->zero_copy = true;
+    if (bind(t->sockfd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        addr.sxdp_flags = XDP_COPY | XDP_USE_NEED_WAKEUP;
+        t->zero_copy = false;
+        if (bind(t->sockfd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            fprintf(stderr, "%s: could not bind AF_XDP socket to queue %d of interface %s\n", strerror(errno), t->tnum, if_name);
+            return -1;
+        }
+    }
+    fprintf(stderr, "Bound AF_XDP socket to queue %d of interface %s in %s mode\n", t->tnum, if_name, t->zero_copy ? "zero-copy" : "copy");
+
+    return 0;
+}
+
+static void xsk_socket_destroy(struct xsk_thread_storage *t) {
+    xsk_ring_unmap(&t->rx);
+    xsk_ring_unmap(&t->fill);
+    xsk_ring_unmap(&t->comp);
+    if (t->sockfd != -1) {
+        close(t->sockfd);
+    }
+    if (t->umem) {
+        munmap(t->umem, (size_t)t->num_frames * XSK_FRAME_SIZE);
+    }
+}
+
+static void xsk_socket_stats(struct xsk_thread_storage *t, struct xsk_stats_tracking *statst) {
+    struct xdp_statistics stats;
+    memset(&stats, 0, sizeof(stats));
+    socklen_t optlen = sizeof(stats);
+    if (getsockopt(t->sockfd, SOL_XDP, XDP_STATISTICS, &stats, &optlen) != 0) {
+        perror("error: could not get AF_XDP statistics for the given socket");
+        return;
+    }
+
+    /* these counters are not reset when they are read */
+    if (statst != NULL) {
+        statst->socket_drops += (stats.rx_dropped - t->last_stats.rx_dropped) + (stats.rx_ring_full - t->last_stats.rx_ring_full);
+        statst->fill_ring_empty += stats.rx_fill_ring_empty_descs - t->last_stats.rx_fill_ring_empty_descs;
+    }
+    t->last_stats = stats;
+}
+
+/*
+ * xsk_interface_queues() returns the number of receive queues of
+ * the interface, or 0 if the driver does not report it
+ */
+static unsigned int xsk_interface_queues(const char *if_name) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd == -1) {
+        return 0;
+    }
+    struct ethtool_channels channels;
+    memset(&channels, 0, sizeof(channels));
+    channels.cmd = ETHTOOL_GCHANNELS;
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, if_name, IF_NAMESIZE - 1);
+    ifr.ifr_data = (char *)&channels;
+    int err = ioctl(fd, SIOCETHTOOL, &ifr);
+    close(fd);
+    if (err != 0) {
+        return 0;
+    }
+    return channels.combined_count + channels.rx_count;
+}
+
+
+/*
+ * == Threads ==
+ */
+
+static void *xsk_stats_thread_func(void *statst_arg) {
+    struct xsk_stats_tracking *statst = (struct xsk_stats_tracking *)statst_arg;
+
+    /* wait for the other threads to get started */
+    int err = pthread_mutex_lock(statst->t_start_m);
+    if (err != 0) {
+        fprintf(stderr, "%s: error locking clean start mutex for stats thread\n", strerror(err));
+        exit(255);
+    }
+    while (*(statst->t_start_p) != 1) {
+        err = pthread_cond_wait(statst->t_start_c, statst->t_start_m);
+        if (err != 0) {
+            fprintf(stderr, "%s: error waiting on clean start condition for stats thread\n", strerror(err));
+            exit(255);
+        }
+    }
+    err = pthread_mutex_unlock(statst->t_start_m);
+    if (err != 0) {
+        fprintf(stderr, "%s: error unlocking clean start mutex for stats thread\n", strerror(err));
+        exit(255);
+    }
+
+    char space[2] = " ";
+    struct output_queue_stats *oq_prev = (struct output_queue_stats *)calloc(statst->qs->qnum, sizeof(struct output_queue_stats));
+    struct output_queue_stats *oq_curr = (struct output_queue_stats *)calloc(statst->qs->qnum, sizeof(struct output_queue_stats));
+    if (oq_prev == NULL || oq_curr == NULL) {
+        fprintf(stderr, "error: could not allocate memory for output queue stats\n");
+        exit(255);
+    }
+    output_queue_stats_snapshot(statst->qs, oq_prev, false);
+
+    /* enable all signals so that this thread shuts down first */
+    enable_all_signals();
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    while (sig_close_flag == 0) {
+        reload_resources_if_requested(statst->mc);
+
+        uint64_t packets_before = statst->received_packets;
+        uint64_t bytes_before = statst->received_bytes;
+        uint64_t socket_drops_before = statst->socket_drops;
+        uint64_t fill_ring_empty_before = statst->fill_ring_empty;
+        double time_before = ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+
+        sleep(1);
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        double time_d = (ts.tv_sec + (ts.tv_nsec / 1000000000.0)) - time_before;
+        if ((time_d < 0.9) || (time_d > 1.1)) {
+            fprintf(stderr, "Unable to compute statistics because sleep / clock strayed too far from 1 second: %f seconds\n", time_d);
+            continue;
+        }
+
+        for (int thread = 0; thread < statst->num_threads; thread++) {
+            xsk_socket_stats(&statst->tstor[thread], statst);
+        }
+
+        double pps = (statst->received_packets - packets_before) / time_d;
+        double byps = (statst->received_bytes - bytes_before) / time_d;
+        uint64_t sdps = statst->socket_drops - socket_drops_before;
+        uint64_t fres = statst->fill_ring_empty - fill_ring_empty_before;
+
+        output_queue_stats_snapshot(statst->qs, oq_curr, false);
+        uint64_t odps = 0;               /* output drops */
+        uint64_t oblocked = 0;           /* time producers spent blocked on output (nanoseconds) */
+        uint64_t worst_in_use = 0;       /* worst output queue usage (bytes) */
+        for (int q = 0; q < statst->qs->qnum; q++) {
+            odps += oq_curr[q].drops - oq_prev[q].drops;
+            oblocked += oq_curr[q].blocked_nsec - oq_prev[q].blocked_nsec;
+            if (oq_curr[q].in_use > worst_in_use) {
+                worst_in_use = oq_curr[q].in_use;
+            }
+        }
+        statst->output_drops += odps;
+
+        /* the estimated Ethernet rate includes the interpacket gap, preamble, start of frame delimiter, and FCS */
+        double ebips = (byps + (pps * (12 + 7 + 1 + 4))) * 8;
+
+        double r_pps;
+        char *r_pps_s;
+        get_readable_number_float(1000, pps, &r_pps, &r_pps_s);
+        if (r_pps_s[0] == '\0') {
+            r_pps_s = &(space[0]);
+        }
+        double r_byps;
+        char *r_byps_s;
+        get_readable_number_float(1000, byps, &r_byps, &r_byps_s);
+        if (r_byps_s[0] == '\0') {
+            r_byps_s = &(space[0]);
+        }
+        double r_ebips;
+        char *r_ebips_s;
+        get_readable_number_float(1000, ebips, &r_ebips, &r_ebips_s);
+        if (r_ebips_s[0] == '\0') {
+            r_ebips_s = &(space[0]);
+        }
+
+        if (statst->verbosity) {
+            fprintf(stderr,
+                    "Stats: "
+                    "Time %10.03f ; "
+                    "%7.03f%s Packets/s; Data Rate %7.03f%s bytes/s; "
+                    "Ethernet Rate (est.) %7.03f%s bits/s; "
+                    "Socket Drops %" PRIu64 " (packets); Fill Ring Empty %" PRIu64 "; "
+                    "Output Drops %" PRIu64 "; Output Blocked %.1f ms; Worst output queue %4.1f%%\n",
+                    (ts.tv_sec + (ts.tv_nsec / 1000000000.0)),
+                    r_pps, r_pps_s, r_byps, r_byps_s,
+                    r_ebips, r_ebips_s,
+                    sdps, fres,
+                    odps, oblocked / 1000000.0, (worst_in_use * 100.0) / LLQ_BUF_SIZE);
+        }
+
+        struct output_queue_stats *oq_tmp = oq_prev;
+        oq_prev = oq_curr;
+        oq_curr = oq_tmp;
+    }
+
+    free(oq_prev);
+    free(oq_curr);
+
+    return NULL;
+}
+
+/*
+ * xsk_capture() reads packets from the RX ring of a thread's socket
+ * and hands them to its packet processor, then returns their frames
+ * to the kernel through the fill ring.  Every frame is either on the
+ * fill ring, on the RX ring, or being processed, so there is always
+ * room on the fill ring for the frames that are returned.
+ *
+ * AF_XDP does not timestamp packets, so each packet is given the time
+ * at which it was taken from the RX ring.
+ */
+static void xsk_capture(struct xsk_thread_storage *t) {
+
+    /* wait for all of the other threads to be ready */
+    int err = pthread_mutex_lock(t->t_start_m);
+    if (err != 0) {
+        fprintf(stderr, "%s: error locking clean start mutex for thread %lu\n", strerror(err), t->tid);
+        exit(255);
+    }
+    while (*(t->t_start_p) != 1) {
+        err = pthread_cond_wait(t->t_start_c, t->t_start_m);
+        if (err != 0) {
+            fprintf(stderr, "%s: error waiting on clean start condition for thread %lu\n", strerror(err), t->tid);
+            exit(255);
+        }
+    }
+    err = pthread_mutex_unlock(t->t_start_m);
+    if (err != 0) {
+        fprintf(stderr, "%s: error unlocking clean start mutex for thread %lu\n", strerror(err), t->tid);
+        exit(255);
+    }
+
+    struct pkt_proc *pkt_processor = t->pkt_processor;
+    struct xsk_stats_tracking *statst = t->statst;
+    const struct xdp_desc *rx_desc = (const struct xdp_desc *)t->rx.desc;
+    uint64_t *fill_desc = (uint64_t *)t->fill.desc;
+    const uint32_t rx_mask = t->rx.size - 1;
+    const uint32_t fill_mask = t->fill.size - 1;
+    uint32_t rx_cons = *t->rx.consumer;
+    uint32_t fill_prod = *t->fill.producer;
+
+    xsk_socket_stats(t, NULL); // Discard bogus stats
+
+    fprintf(stderr, "Thread %d with thread id %lu started...\n", t->tnum, t->tid);
+
+    struct pollfd psockfd;
+    memset(&psockfd, 0, sizeof(psockfd));
+    psockfd.fd = t->sockfd;
+    psockfd.events = POLLIN;
+
+    struct packet_info pi[PROCESS_BATCH_SIZE];
+    uint8_t *eth[PROCESS_BATCH_SIZE];
+    int haveflushed = 0;  /* Tracks whether we've opportunistically flushed yet or not */
+    while (sig_close_workers == 0) {
+
+        uint32_t avail = __atomic_load_n(t->rx.producer, __ATOMIC_ACQUIRE) - rx_cons;
+        if (avail == 0) {
+            /* flush once before waiting, as in af_packet_v3.c */
+            if (haveflushed == 0) {
+                pkt_processor->flush();
+                haveflushed = 1;
+                continue;
+            }
+            if (poll(&psockfd, 1, 1000) < 0 && errno != EINTR) {
+                perror("poll returned error");
+            }
+            continue;
+        }
+        haveflushed = 0;
+
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        uint64_t byte_count = 0;
+        size_t n = 0;
+        for (uint32_t i = 0; i < avail; i++) {
+            const struct xdp_desc *desc = &rx_desc[(rx_cons + i) & rx_mask];
+            pi[n].ts = ts;
+            pi[n].caplen = desc->len;
+            pi[n].len = desc->len;
+            eth[n] = t->umem + desc->addr;
+            byte_count += desc->len;
+            if (++n == PROCESS_BATCH_SIZE) {
+                pkt_processor->apply_batch(pi, eth, n);
+                n = 0;
+            }
+        }
+        if (n > 0) {
+            pkt_processor->apply_batch(pi, eth, n);
+        }
+
+        /* return the frames to the kernel */
+        for (uint32_t i = 0; i < avail; i++) {
+            fill_desc[(fill_prod + i) & fill_mask] = rx_desc[(rx_cons + i) & rx_mask].addr & ~(uint64_t)(XSK_FRAME_SIZE - 1);
+        }
+        rx_cons += avail;
+        fill_prod += avail;
+        __atomic_store_n(t->rx.consumer, rx_cons, __ATOMIC_RELEASE);
+        __atomic_store_n(t->fill.producer, fill_prod, __ATOMIC_RELEASE);
+        if (__atomic_load_n(t->fill.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP) {
+            recvfrom(t->sockfd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+        }
+
+        __sync_add_and_fetch(&(statst->received_packets), avail);
+        __sync_add_and_fetch(&(statst->received_bytes), byte_count);
+    }
+
+    fprintf(stderr, "Thread %d with thread id %lu exiting...\n", t->tnum, t->tid);
+}
+
+static void *xsk_capture_thread_func(void *arg) {
+    struct xsk_thread_storage *t = (struct xsk_thread_storage *)arg;
+
+    /* disable all signals so that this worker thread is not disturbed in the middle of packet processing */
+    disable_all_signals();
+
+    xsk_capture(t);
+    return NULL;
+}
+
+/*
+ * xsk_frames_per_thread() returns the number of UMEM frames for each
+ * thread, which is the power of two that fits into that thread's
+ * share of the buffer fraction of physical memory, within limits
+ */
+static uint32_t xsk_frames_per_thread(float frac, int num_threads) {
+    if (frac < 0.0 || frac > 1.0) {
+        frac = 0.01;   /* as in ring_limits_init() */
+    }
+    uint64_t desired_memory = (uint64_t)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE) * frac;
+    uint64_t frames = desired_memory / num_threads / XSK_FRAME_SIZE;
+    uint32_t num_frames = XSK_MIN_FRAMES;
+    while (num_frames < XSK_MAX_FRAMES && (uint64_t)num_frames * 2 <= frames) {
+        num_frames *= 2;
+    }
+    return num_frames;
+}
+
+enum status af_xdp_bind_and_dispatch(struct mercury_config *cfg,
+                                     mercury_context mc,
+                                     struct output_file *out_ctx) {
+    int err;
+    int num_threads = cfg->num_threads;
+    const char *if_name = cfg->capture_interface;
+
+    int ifindex = if_nametoindex(if_name);
+    if (ifindex == 0) {
+        fprintf(stderr, "%s: could not get interface number of %s\n", strerror(errno), if_name);
+        return status_err;
+    }
+    unsigned int num_queues = xsk_interface_queues(if_name);
+    if (num_queues != 0) {
+        if ((unsigned int)num_threads > num_queues) {
+            fprintf(stderr, "error: interface %s has %u receive queue(s), and af_xdp needs a queue for each thread; use %u or fewer threads\n",
+                    if_name, num_queues, num_queues);
+            return status_err;
+        }
+        if ((unsigned int)num_threads < num_queues) {
+            fprintf(stderr, "warning: interface %s has %u receive queues, but only queues 0 through %d will be captured\n",
+                    if_name, num_queues, num_threads - 1);
+        }
+    }
+
+    /* see the comment in bind_and_dispatch() about the clean start */
+    int t_start_p = 0;
+    pthread_cond_t t_start_c  = PTHREAD_COND_INITIALIZER;
+    pthread_mutex_t t_start_m = PTHREAD_MUTEX_INITIALIZER;
+
+    struct xsk_stats_tracking statst;
+    memset(&statst, 0, sizeof(statst));
+    statst.num_threads = num_threads;
+    statst.qs = &out_ctx->qs;
+    statst.t_start_p = &t_start_p;
+    statst.t_start_c = &t_start_c;
+    statst.t_start_m = &t_start_m;
+    statst.verbosity = cfg->verbosity;
+    statst.mc = mc;
+
+    struct xsk_thread_storage *tstor = (struct xsk_thread_storage *)calloc(num_threads, sizeof(struct xsk_thread_storage));
+    if (tstor == NULL) {
+        fprintf(stderr, "error: could not allocate memory for AF_XDP thread storage\n");
+        return status_err;
+    }
+    statst.tstor = tstor;
+
+    /* create the sockets and the map through which the XDP program finds them */
+    int xsks_map_fd = bpf_map_create(BPF_MAP_TYPE_XSKMAP, sizeof(uint32_t), sizeof(uint32_t), num_threads, "mercury_xsks");
+    if (xsks_map_fd < 0) {
+        fprintf(stderr, "%s: could not create XSKMAP\n", strerror(errno));
+        return status_err;
+    }
+    uint32_t num_frames = xsk_frames_per_thread(cfg->buffer_fraction, num_threads);
+    for (int thread = 0; thread < num_threads; thread++) {
+        tstor[thread].tnum = thread;
+        tstor[thread].sockfd = -1;
+        tstor[thread].num_frames = num_frames;
+        tstor[thread].statst = &statst;
+        tstor[thread].t_start_p = &t_start_p;
+        tstor[thread].t_start_c = &t_start_c;
+        tstor[thread].t_start_m = &t_start_m;
+
+        if (xsk_socket_create(&tstor[thread], ifindex, if_name) != 0) {
+            fprintf(stderr, "error creating AF_XDP socket for thread %d\n", thread);
+            exit(255);
+        }
+        uint32_t queue = thread;
+        uint32_t sockfd = tstor[thread].sockfd;
+        if (bpf_map_update(xsks_map_fd, &queue, &sockfd) != 0) {
+            fprintf(stderr, "%s: could not add AF_XDP socket for thread %d to XSKMAP\n", strerror(errno), thread);
+            exit(255);
+        }
+    }
+
+    int flows_map_fd = -1;
+    if (cfg->xdp_filter) {
+        flows_map_fd = bpf_map_create(BPF_MAP_TYPE_LRU_HASH, 12, sizeof(uint32_t), XDP_FILTER_FLOWS, "mercury_flows");
+        if (flows_map_fd < 0) {
+            fprintf(stderr, "%s: could not create XDP flow table\n", strerror(errno));
+            return status_err;
+        }
+    }
+    int prog_fd = xdp_program_load(xsks_map_fd, flows_map_fd);
+    if (prog_fd < 0) {
+        return status_err;
+    }
+    int link_fd = xdp_program_attach(prog_fd, ifindex, if_name, cfg->verbosity);
+    if (link_fd < 0) {
+        return status_err;
+    }
+
+    /* drop privileges from root to normal user */
+    if (drop_root_privileges(cfg->user, cfg->working_dir) != status_ok) {
+        return status_err;
+    }
+    if (cfg->user) {
+        fprintf(stderr, "running as user %s\n", cfg->user);
+    } else {
+        fprintf(stderr, "dropped root privileges\n");
+    }
+
+    for (int thread = 0; thread < num_threads; thread++) {
+        tstor[thread].pkt_processor = pkt_proc_new_from_config(cfg, mc, thread, &out_ctx->qs.queue[thread]);
+        if (tstor[thread].pkt_processor == NULL) {
+            printf("error: could not initialize frame handler\n");
+            return status_err;
+        }
+    }
+
+    pthread_t stats_thread;
+    err = pthread_create(&stats_thread, NULL, xsk_stats_thread_func, &statst);
+    if (err != 0) {
+        perror("error creating stats thread");
+    }
+    for (int thread = 0; thread < num_threads; thread++) {
+        err = pthread_create(&(tstor[thread].tid), NULL, xsk_capture_thread_func, &(tstor[thread]));
+        if (err) {
+            fprintf(stderr, "%s: error creating af_xdp capture thread %d\n", strerror(err), thread);
+            exit(255);
+        }
+    }
+
+    /* wake up the output thread, then the stats and capture threads */
+    out_ctx->t_output_p = 1;
+    err = pthread_cond_broadcast(&(out_ctx->t_output_c));
+    if (err != 0) {
+        printf("%s: error broadcasting all clear on output start condition\n", strerror(err));
+        exit(255);
+    }
+    t_start_p = 1;
+    err = pthread_cond_broadcast(&t_start_c);
+    if (err != 0) {
+        printf("%s: error broadcasting all clear on clean start condition\n", strerror(err));
+        exit(255);
+    }
+
+    /* the stats thread exits on sigint/sigterm, and then the capture threads are stopped */
+    pthread_join(stats_thread, NULL);
+    sig_close_workers = 1;
+    for (int thread = 0; thread < num_threads; thread++) {
+        pthread_join(tstor[thread].tid, NULL);
+    }
+
+    close(link_fd);   /* detaches the XDP program */
+    close(prog_fd);
+    if (flows_map_fd != -1) {
+        close(flows_map_fd);
+    }
+    close(xsks_map_fd);
+    for (int thread = 0; thread < num_threads; thread++) {
+        xsk_socket_destroy(&tstor[thread]);
+        delete tstor[thread].pkt_processor;
+    }
+    free(tstor);
+
+    fprintf(stderr, "--\n"
+            "%" PRIu64 " packets captured\n"
+            "%" PRIu64 " bytes captured\n"
+            "%" PRIu64 " packets dropped\n"
+            "%" PRIu64 " fill ring empty events\n"
+            "%" PRIu64 " records dropped by output queues\n",
+            statst.received_packets, statst.received_bytes, statst.socket_drops, statst.fill_ring_empty,
+            statst.output_drops);
+
+    return status_ok;
+}
@@ -0,0 +1,24 @@
+/*
+ * af_xdp.h
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.
+ * License at https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#ifndef AF_XDP_H
+#define AF_XDP_H
+
+#include "mercury.h"
+#include "output.h"
+
+/*
+ * af_xdp_bind_and_dispatch() captures packets from the interface
+ * cfg->capture_interface with an AF_XDP socket for each worker
+ * thread; thread N reads receive queue N of the interface.  It
+ * returns when the capture is stopped by a signal.
+ */
+enum status af_xdp_bind_and_dispatch(struct mercury_config *cfg,
+                                     mercury_context mc,
+                                     struct output_file *out_ctx);
+
+#endif /* AF_XDP_H */
@@ -8,6 +8,7 @@
 #include <unistd.h>
 #include <filesystem>
 #include "libmerc/archive.h"
+#include "libmerc/resource_snapshot.h"
 #include "options.h"
 
 // hex_to_raw() reads a string in hexadecimal, and writes the raw
@@ -53,6 +54,7 @@ int main(int argc, char *argv[]) {
         { argument::required,   "--directory", "set the directory to <arg>" },
         { argument::required,   "--decrypt",   "decrypt using key from file <arg>" },
         { argument::none,       "--extract",   "extract archive" },
+        { argument::required,   "--snapshot",  "write resource snapshot of unencrypted archive to file <arg>" },
         { argument::none,       "--list",      "list archive entries" },
         { argument::none,       "--dump",      "dump archive entries" },
         { argument::none,       "--help",      "print out help message" }
@@ -65,6 +67,7 @@ int main(int argc, char *argv[]) {
     auto [ archive_is_set, archive ] = opt.get_value("--archive");
     auto [ dir_is_set, directory ] = opt.get_value("--directory");
     auto [ key_is_set, key_str ] = opt.get_value("--decrypt");
+    auto [ snapshot_is_set, snapshot ] = opt.get_value("--snapshot");
     bool list       = opt.is_set("--list");
     bool dump       = opt.is_set("--dump");
     bool extract    = opt.is_set("--extract");
@@ -76,7 +79,7 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    if (!list && !dump && !extract && !print_help) {
+    if (!list && !dump && !extract && !snapshot_is_set && !print_help) {
         fprintf(stderr, "warning: no actions specified on command line\n");
     }
 
@@ -119,6 +122,27 @@ int main(int argc, char *argv[]) {
     }
 
     const char *archive_file_name = archive.c_str();
+
+    if (snapshot_is_set) {
+        if (key_is_set) {
+            fprintf(stderr, "error: a snapshot is not encrypted, so it cannot be written from an encrypted archive\n");
+            return EXIT_FAILURE;
+        }
+        class encrypted_compressed_archive tar{archive_file_name, k};
+        FILE *snapshot_file = fopen(snapshot.c_str(), "w");
+        if (snapshot_file == nullptr) {
+            fprintf(stderr, "error: could not create snapshot file %s\n", snapshot.c_str());
+            return EXIT_FAILURE;
+        }
+        bool ok = resource_snapshot::write(tar, snapshot_file);
+        if (fclose(snapshot_file) != 0 || !ok) {
+            fprintf(stderr, "error: could not write snapshot of archive file %s\n", archive_file_name);
+            remove(snapshot.c_str());
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
     class encrypted_compressed_archive tar{archive_file_name, k};
     const class archive_node *entry = tar.get_next_entry();
     if (entry == nullptr) {
@@ -141,6 +141,27 @@ static enum status mercury_config_parse_line(struct mercury_config *cfg,
     } else if ((arg = command_get_argument("output-time=", line)) != NULL) {
         return argument_parse_as_uint64(arg, &cfg->out_rotation_duration);
 
+    } else if ((arg = command_get_argument("output-io=", line)) != NULL) {
+        cfg->output_io = strdup(arg);
+        return status_ok;
+
+    } else if ((arg = command_get_argument("compress=", line)) != NULL) {
+        cfg->compression = strdup(arg);
+        return status_ok;
+
+    } else if ((arg = command_get_argument("compress-threads=", line)) != NULL) {
+        return argument_parse_as_int(arg, &cfg->compression_threads);
+
+    } else if ((arg = command_get_argument("capture-backend=", line)) != NULL) {
+        cfg->capture_backend = strdup(arg);
+        return status_ok;
+
+    } else if ((arg = command_get_argument("xdp-filter=", line)) != NULL) {
+        return argument_parse_as_boolean(arg, &cfg->xdp_filter);
+
+    } else if ((arg = command_get_argument("socket-filter=", line)) != NULL) {
+        return argument_parse_as_boolean(arg, &cfg->socket_filter);
+
     } else if ((arg = command_get_argument("user=", line)) != NULL) {
         cfg->user = strdup(arg);
         return status_ok;
@@ -180,6 +201,12 @@ static enum status mercury_config_parse_line(struct mercury_config *cfg,
         global_vars.output_udp_initial_data = true;
         return status_ok;
 
+    } else if ((arg = command_get_argument("tcp-reassembly-budget=", line)) != NULL) {
+        additional_args = str_append(additional_args, "tcp-reassembly-budget=");
+        additional_args = str_append(additional_args, arg);
+        additional_args = str_append(additional_args, ";");
+        return status_ok;
+
     } else if ((arg = command_get_argument("tcp-reassembly", line)) != NULL) {
         additional_args = str_append(additional_args, "tcp-reassembly;");
         return status_ok;
@@ -10,6 +10,7 @@
 #include <string>
 #include <atomic>
 #include <stdexcept>
+#include <vector>
 #include "rotator.h"
 #include "output.h"
 #include "libmerc/libmerc.h"
@@ -67,6 +68,16 @@ public:
         stop();
     }
 
+    // set_output_queues(qs) has the output queue counters of qs
+    // appended to each stats file, as an output_queue_stats record;
+    // the queues must outlive the controller
+    //
+    void set_output_queues(struct thread_queues *qs) {
+        oq_prev.assign(qs->qnum, output_queue_stats{});
+        output_queue_stats_snapshot(qs, oq_prev.data(), true);
+        queues.store(qs);
+    }
+
 private:
 
     mercury_context mc;
@@ -79,6 +90,24 @@ private:
     bool has_run_at_least_once;
     struct output_file* out_file = nullptr;
     bool stats_dump = false;
+    std::atomic<struct thread_queues *> queues{nullptr};
+    std::vector<struct output_queue_stats> oq_prev;
+
+    void write_stats(const char *fname) {
+        if (mercury_write_stats_data(mc, fname) == false) {
+            fprintf(stderr, "error: could not write stats file %s\n", fname);
+            return;
+        }
+        struct thread_queues *qs = queues.load();
+        if (qs) {
+            std::vector<struct output_queue_stats> oq_curr(qs->qnum);
+            output_queue_stats_snapshot(qs, oq_curr.data(), true);
+            if (output_queue_stats_append_gz(fname, qs, oq_curr.data(), oq_prev.data()) == false) {
+                fprintf(stderr, "error: could not write output queue stats to file %s\n", fname);
+            }
+            oq_prev.swap(oq_curr);
+        }
+    }
 
     void run_tasks() {
         while (shutdown_requested.load() == false) {
@@ -88,10 +117,7 @@ private:
                 if (count == 0) {
                     count = num_secs_between_writes;
                     has_run_at_least_once = true;
-                    const char *fname = stats_file.get_next_name();
-                    if (mercury_write_stats_data(mc, fname) == false) {
-                        fprintf(stderr, "error: could not write stats file %s\n", fname);
-                    }
+                    write_stats(stats_file.get_next_name());
                 }
                 --count;
             }
@@ -129,10 +155,7 @@ private:
             controller_thread.join();
         }
         if (stats_dump) {
-            const char *fname = has_run_at_least_once ? stats_file.get_next_name() : stats_file.get_current_name();
-            if (mercury_write_stats_data(mc, fname) == false) {
-                fprintf(stderr, "error: could not write stats file %s\n", fname);
-            }
+            write_stats(has_run_at_least_once ? stats_file.get_next_name() : stats_file.get_current_name());
         }
     }
 
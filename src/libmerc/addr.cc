@@ -10,6 +10,8 @@
 #include <string.h>
 #include <locale.h>
 #include <string>
+#include <vector>
+#include <future>
 #include "addr.h"
 #include "archive.h"
 #include "datum.h"  // for ntoh()
@@ -81,6 +83,55 @@ int subnet_data::process_line(std::string &line_str) {
     return 0;       // success
 }
 
+// parse_subnet_lines(data) returns the subnets parsed from the lines
+// in data, in order, skipping (and reporting) any line that cannot be
+// parsed
+//
+static std::vector<lct_subnet_t> parse_subnet_lines(std::string_view data) {
+    std::vector<lct_subnet_t> subnets;
+    std::string line;
+    while (!data.empty()) {
+        size_t eol = data.find('\n');
+        line.assign(data.substr(0, eol));
+        data.remove_prefix(eol == std::string_view::npos ? data.length() : eol + 1);
+
+        lct_subnet_t subnet{};
+        if (lct_subnet_set_from_string(&subnet, line.c_str()) != 0) {
+            printf_err(log_err, "could not parse subnet string '%s'\n", line.c_str());
+            continue;
+        }
+        subnets.push_back(subnet);
+    }
+    return subnets;
+}
+
+void subnet_data::process_lines(std::string_view data, unsigned int threads) {
+
+    // split data into chunks that end at line boundaries, and parse
+    // each chunk on its own thread
+    //
+    std::vector<std::future<std::vector<lct_subnet_t>>> chunks;
+    size_t chunk_length = data.length() / (threads ? threads : 1) + 1;
+    while (!data.empty()) {
+        size_t eol = data.find('\n', chunk_length);
+        std::string_view chunk = data.substr(0, eol == std::string_view::npos ? data.length() : eol + 1);
+        data.remove_prefix(chunk.length());
+        chunks.push_back(std::async(std::launch::async, parse_subnet_lines, chunk));
+    }
+
+    // append the subnets of each chunk, in order, so that the result
+    // is the same as that of calling process_line() on each line
+    //
+    for (auto &c : chunks) {
+        std::vector<lct_subnet_t> subnets = c.get();
+        if (subnets.size() > (size_t)(BGP_MAX_ENTRIES - num)) {
+            throw std::runtime_error("error: too many subnets in resource file");
+        }
+        memcpy(&prefix[num], subnets.data(), subnets.size() * sizeof(lct_subnet_t));
+        num += subnets.size();
+    }
+}
+
 void subnet_data::process_final() {
 
     // validate subnet prefixes against their netmasks
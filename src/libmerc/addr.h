@@ -12,6 +12,7 @@
 #define ADDR_H
 
 #include <string>
+#include <string_view>
 #include <stdexcept>
 #include "archive.h"
 
@@ -66,6 +67,12 @@ public:
     uint32_t get_asn_info(const char* dst_ip) const;
 
     int process_line(std::string &line);
+
+    // process_lines(data, threads) processes each newline-terminated
+    // line in data as though it were passed to process_line(), using
+    // up to threads threads to parse them
+    //
+    void process_lines(std::string_view data, unsigned int threads);
 };
 
 #endif // ADDR_H
@@ -43,6 +43,14 @@ classifier *analysis_init_from_archive(int, //verbosity
         archive_name = DEFAULT_RESOURCE_FILE;
     }
 
+    if (resource_snapshot::is_snapshot(archive_name)) {
+        if (enc_key != NULL || key_type != enc_key_type_none) {
+            printf_err(log_err, "resource snapshot %s cannot be used with a decryption key, since it is not encrypted\n", archive_name);
+            throw std::runtime_error("resource snapshot cannot be used with a decryption key");
+        }
+        resource_snapshot snapshot{archive_name};
+        return new classifier(snapshot, fp_proc_threshold, proc_dst_threshold, report_os);
+    }
     encrypted_compressed_archive archive{archive_name, enc_key}; // TODO: key type
     return new classifier(archive, fp_proc_threshold, proc_dst_threshold, report_os);
 }
@@ -17,6 +17,9 @@
 #include "result.h"
 #include "dict.h"
 
+#include <atomic>
+#include <future>
+#include <thread>
 #include <mutex>
 #include <shared_mutex>
 #include <map>
@@ -25,13 +28,18 @@
 #include <unordered_set>
 #include <string>
 #include <vector>
-#include <list>
+#include <deque>
+#include <string_view>
+#include <type_traits>
 #include <zlib.h>
 #include "rapidjson/document.h"
 #include "rapidjson/stringbuffer.h"
 #include "util_obj.h"
 #include "archive.h"
+#include "resource_snapshot.h"
 #include "watchlist.hpp"
+#include "analysis_cache.h"
+#include "fingerprint_index.h"
 
 // TBD - move flow_key_sprintf_src_addr() to the right file
 //
@@ -157,6 +165,17 @@ struct common_data {
 //
 using floating_point_type = long double;
 
+// class naive_bayes is a weighted naive Bayes classifier, which is
+// compiled from the process information of a fingerprint.  The
+// updates that each feature value makes to the prior probabilities of
+// the processes are stored in two flat arrays, update_index and
+// update_value; the updates for a value are a contiguous range of
+// those arrays, and the ranges for each feature are contiguous, so
+// that all of the updates of one feature can be reweighted at once.
+// The updates are found through hash tables whose string keys are
+// views of strings owned by the classifier, so that classify() can
+// look them up without creating any strings.
+//
 class naive_bayes {
 
     // an instance of class update represents an update to a prior
@@ -169,6 +188,15 @@ class naive_bayes {
         floating_point_type value;   // value of update
     };
 
+    // an update_range is a range of update_index and update_value
+    //
+    struct update_range {
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    enum feature { as_feature, domain_feature, port_feature, ip_feature, sni_feature, ua_feature, num_features };
+
     uint64_t total_count = 0;
     ptr_dict &os_dict;
     floating_point_type base_prior = 0;
@@ -176,12 +204,18 @@ class naive_bayes {
     std::vector<floating_point_type> process_prob;
     std::vector<bool>        malware;
     std::vector<attribute_result::bitset> attr;
-    std::unordered_map<uint32_t, std::vector<class update>> as_number_updates;
-    std::unordered_map<uint16_t, std::vector<class update>> port_updates;
-    std::unordered_map<std::string, std::vector<class update>> hostname_domain_updates;
-    std::unordered_map<std::string, std::vector<class update>> ip_ip_updates;
-    std::unordered_map<std::string, std::vector<class update>> hostname_sni_updates;
-    std::unordered_map<std::string, std::vector<class update>> user_agent_updates;
+
+    std::vector<uint32_t> update_index;
+    std::vector<floating_point_type> update_value;
+    uint32_t feature_begin[num_features + 1];    // the updates of feature f are [feature_begin[f], feature_begin[f+1])
+
+    std::deque<std::string> keys;                // owns the strings viewed by the tables below
+    std::unordered_map<uint32_t, update_range> as_number_updates;
+    std::unordered_map<uint16_t, update_range> port_updates;
+    std::unordered_map<std::string_view, update_range> hostname_domain_updates;
+    std::unordered_map<std::string_view, update_range> ip_ip_updates;
+    std::unordered_map<std::string_view, update_range> hostname_sni_updates;
+    std::unordered_map<std::string_view, update_range> user_agent_updates;
 
     floating_point_type as_weight;
     floating_point_type domain_weight;
@@ -189,6 +223,48 @@ class naive_bayes {
     floating_point_type ip_weight;
     floating_point_type sni_weight;
     floating_point_type ua_weight;
+
+    // add_updates(f, tmp, table) appends the updates in tmp to the
+    // flat arrays, as those of feature f, and enters their ranges
+    // into table
+    //
+    template <typename K, typename T>
+    void add_updates(enum feature f, const std::unordered_map<K, std::vector<class update>> &tmp, T &table) {
+        feature_begin[f] = update_index.size();
+        table.reserve(tmp.size());
+        for (const auto &key_and_updates : tmp) {
+            update_range r{(uint32_t)update_index.size(), 0};
+            for (const auto &u : key_and_updates.second) {
+                update_index.push_back(u.index);
+                update_value.push_back(u.value);
+            }
+            r.end = update_index.size();
+            if constexpr (std::is_same_v<K, std::string>) {
+                keys.push_back(key_and_updates.first);
+                table.emplace(keys.back(), r);
+            } else {
+                table.emplace(key_and_updates.first, r);
+            }
+        }
+        feature_begin[f + 1] = update_index.size();
+    }
+
+    template <typename T, typename K>
+    void apply_updates(std::vector<floating_point_type> &process_score, const T &table, const K &key) const {
+        auto x = table.find(key);
+        if (x != table.end()) {
+            for (uint32_t i = x->second.begin; i < x->second.end; i++) {
+                process_score[update_index[i]] += update_value[i];
+            }
+        }
+    }
+
+    void reweight(enum feature f, floating_point_type new_weight, floating_point_type old_weight) {
+        for (uint32_t i = feature_begin[f]; i < feature_begin[f + 1]; i++) {
+            update_value[i] = update_value[i] * new_weight/old_weight;
+        }
+    }
+
 public:
 
     //    naive_bayes() { }
@@ -218,6 +294,13 @@ public:
         //
         process_prob.reserve(processes.size());
 
+        std::unordered_map<uint32_t, std::vector<class update>> as_number_tmp;
+        std::unordered_map<uint16_t, std::vector<class update>> port_tmp;
+        std::unordered_map<std::string, std::vector<class update>> hostname_domain_tmp;
+        std::unordered_map<std::string, std::vector<class update>> ip_ip_tmp;
+        std::unordered_map<std::string, std::vector<class update>> hostname_sni_tmp;
+        std::unordered_map<std::string, std::vector<class update>> user_agent_tmp;
+
         base_prior = log(0.1 / total_count);
         size_t index = 0;
         for (const auto &p : processes) {
@@ -230,63 +313,40 @@ public:
             process_prob.push_back(fmax(score, proc_prior) + base_prior * (as_weight + domain_weight + port_weight + ip_weight + sni_weight + ua_weight));
 
             for (const auto &as_and_count : p.ip_as) {
-                const auto x = as_number_updates.find(as_and_count.first);
                 class update u{ index, (log((floating_point_type)as_and_count.second / total_count) - base_prior ) * as_weight };
-                if (x != as_number_updates.end()) {
-                    x->second.push_back(u);
-                } else {
-                    as_number_updates[as_and_count.first] = { u };
-                }
+                as_number_tmp[as_and_count.first].push_back(u);
             }
             for (const auto &domains_and_count : p.hostname_domains) {
-                const auto x = hostname_domain_updates.find(domains_and_count.first);
                 class update u{ index, (log((floating_point_type)domains_and_count.second / total_count) - base_prior) * domain_weight };
-                if (x != hostname_domain_updates.end()) {
-                    x->second.push_back(u);
-                } else {
-                    hostname_domain_updates[domains_and_count.first] = { u };
-                }
+                hostname_domain_tmp[domains_and_count.first].push_back(u);
             }
             for (const auto &port_and_count : p.portname_applications) {
-                const auto x = port_updates.find(port_and_count.first);
                 class update u{ index, (log((floating_point_type)port_and_count.second / total_count) - base_prior) * port_weight };
-                if (x != port_updates.end()) {
-                    x->second.push_back(u);
-                } else {
-                    port_updates[port_and_count.first] = { u };
-                }
+                port_tmp[port_and_count.first].push_back(u);
             }
             for (const auto &ip_and_count : p.ip_ip) {
-                const auto x = ip_ip_updates.find(ip_and_count.first);
                 class update u{ index, (log((floating_point_type)ip_and_count.second / total_count) - base_prior) * ip_weight };
-                if (x != ip_ip_updates.end()) {
-                    x->second.push_back(u);
-                } else {
-                    ip_ip_updates[ip_and_count.first] = { u };
-                }
+                ip_ip_tmp[ip_and_count.first].push_back(u);
             }
             for (const auto &sni_and_count : p.hostname_sni) {
-                const auto x = hostname_sni_updates.find(sni_and_count.first);
                 class update u{ index, (log((floating_point_type)sni_and_count.second / total_count) - base_prior) * sni_weight };
-                if (x != hostname_sni_updates.end()) {
-                    x->second.push_back(u);
-                } else {
-                    hostname_sni_updates[sni_and_count.first] = { u };
-                }
+                hostname_sni_tmp[sni_and_count.first].push_back(u);
             }
             for (const auto &ua_and_count : p.user_agent) {
-                const auto x = user_agent_updates.find(ua_and_count.first);
                 class update u{ index, (log((floating_point_type)ua_and_count.second / total_count) - base_prior) * ua_weight };
-                if (x != user_agent_updates.end()) {
-                    x->second.push_back(u);
-                } else {
-                    user_agent_updates[ua_and_count.first] = { u };
-                }
+                user_agent_tmp[ua_and_count.first].push_back(u);
             }
 
             ++index;
         }
 
+        add_updates(as_feature, as_number_tmp, as_number_updates);
+        add_updates(domain_feature, hostname_domain_tmp, hostname_domain_updates);
+        add_updates(port_feature, port_tmp, port_updates);
+        add_updates(ip_feature, ip_ip_tmp, ip_ip_updates);
+        add_updates(sni_feature, hostname_sni_tmp, hostname_sni_updates);
+        add_updates(ua_feature, user_agent_tmp, user_agent_updates);
+
         // process_prob should have the same number of elements as the
         // input vector processes
         //
@@ -294,56 +354,34 @@ public:
 
     }
 
-    std::vector<floating_point_type> classify(uint32_t asn_int,
-                                              uint16_t port_app,
-                                              const std::string &domain,
-                                              const std::string &server_name_str,
-                                              const std::string &dst_ip_str,
-                                              const char *user_agent) const {
-
-        std::vector<floating_point_type> process_score = process_prob;  // working copy of probability vector
+    // the hash tables hold views of the strings in keys, which stay
+    // valid when a naive_bayes is moved, but not when it is copied
+    //
+    naive_bayes(const naive_bayes &) = delete;
+    naive_bayes(naive_bayes &&) = default;
 
-        auto asn_update = as_number_updates.find(asn_int);
-        if (asn_update != as_number_updates.end()) {
-            for (const auto &x : asn_update->second) {
-                process_score[x.index] += x.value;
-            }
-        }
-        auto port_update = port_updates.find(port_app);
-        if (port_update != port_updates.end()) {
-            for (const auto &x : port_update->second) {
-                process_score[x.index] += x.value;
-            }
-        }
-        auto hostname_domain_update = hostname_domain_updates.find(domain);
-        if (hostname_domain_update != hostname_domain_updates.end()) {
-            for (const auto &x : hostname_domain_update->second) {
-                process_score[x.index] += x.value;
-            }
-        }
-        auto ip_ip_update = ip_ip_updates.find(dst_ip_str);
-        if (ip_ip_update != ip_ip_updates.end()) {
-            for (const auto &x : ip_ip_update->second) {
-                process_score[x.index] += x.value;
-            }
-        }
-        auto hostname_sni_update = hostname_sni_updates.find(server_name_str);
-        if (hostname_sni_update != hostname_sni_updates.end()) {
-            for (const auto &x : hostname_sni_update->second) {
-                process_score[x.index] += x.value;
-            }
-        }
+    // classify(process_score, ...) sets process_score to the score of
+    // each process for the given features; process_score can be
+    // reused across calls, so that it does not need to be reallocated
+    //
+    void classify(std::vector<floating_point_type> &process_score,
+                  uint32_t asn_int,
+                  uint16_t port_app,
+                  std::string_view domain,
+                  std::string_view server_name,
+                  std::string_view dst_ip,
+                  const char *user_agent) const {
+
+        process_score.assign(process_prob.begin(), process_prob.end());  // working copy of probability vector
+
+        apply_updates(process_score, as_number_updates, asn_int);
+        apply_updates(process_score, port_updates, port_app);
+        apply_updates(process_score, hostname_domain_updates, domain);
+        apply_updates(process_score, ip_ip_updates, dst_ip);
+        apply_updates(process_score, hostname_sni_updates, server_name);
         if (user_agent != nullptr) {
-            std::string user_agent_str(user_agent);
-            auto user_agent_update = user_agent_updates.find(user_agent_str);
-            if (user_agent_update != user_agent_updates.end()) {
-                for (const auto &x : user_agent_update->second) {
-                    process_score[x.index] += x.value;
-                }
-            }
+            apply_updates(process_score, user_agent_updates, std::string_view{user_agent});
         }
-
-        return process_score;
     }
 
     bool is_recomputation_required(floating_point_type new_as_weight, floating_point_type new_domain_weight,
@@ -386,41 +424,12 @@ public:
          * Update value is originally calculated as
          * update.value  = log((floating_point_type)as_and_count.second / total_count) - base_prior ) * as_weight
          */
-        for (auto &v : as_number_updates) {
-            for (auto &update : v.second) {
-                update.value = update.value * new_as_weight/as_weight;
-            }
-        }
-
-        for (auto &v: hostname_domain_updates) {
-            for (auto &update : v.second) {
-                update.value = update.value * new_domain_weight/domain_weight;
-            }
-        }
-
-        for (auto &v: port_updates) {
-            for (auto &update : v.second) {
-                update.value = update.value * new_port_weight/port_weight;
-            }
-        }
-
-        for (auto &v: ip_ip_updates) {
-            for (auto &update : v.second) {
-                update.value = update.value * new_ip_weight/ip_weight;
-            }
-        }
-
-        for (auto &v: hostname_sni_updates) {
-            for (auto &update : v.second) {
-                update.value = update.value * new_sni_weight/sni_weight;
-            }
-        }
- 
-        for (auto &v: user_agent_updates) {
-            for (auto &update : v.second) {
-                update.value = update.value * new_ua_weight/ua_weight;
-            }
-        }
+        reweight(as_feature, new_as_weight, as_weight);
+        reweight(domain_feature, new_domain_weight, domain_weight);
+        reweight(port_feature, new_port_weight, port_weight);
+        reweight(ip_feature, new_ip_weight, ip_weight);
+        reweight(sni_feature, new_sni_weight, sni_weight);
+        reweight(ua_feature, new_ua_weight, ua_weight);
 
         as_weight = new_as_weight;
         domain_weight = new_domain_weight;
@@ -501,6 +510,8 @@ public:
 
     }
 
+    fingerprint_data(fingerprint_data &&) = default;
+
     ~fingerprint_data() {
     }
 
@@ -543,9 +554,9 @@ public:
     // get_tld_domain_name() returns the string containing the top two
     // domains of the input string; that is, given "s3.amazonaws.com",
     // it returns "amazonaws.com".  If there is only one name, it is
-    // returned.
+    // returned.  The string returned is a view of server_name.
     //
-    std::string get_tld_domain_name(const char* server_name) {
+    static std::string_view get_tld_domain_name(const char* server_name) {
 
         const char *separator = NULL;
         const char *previous_separator = NULL;
@@ -571,16 +582,26 @@ public:
 
         uint32_t asn_int = subnet_data_ptr->get_asn_info(dst_ip);
         uint16_t port_app = remap_port(dst_port);
-        std::string domain = get_tld_domain_name(server_name);
-        std::string server_name_str(server_name);
-        std::string dst_ip_str(dst_ip);
+        std::string_view domain = get_tld_domain_name(server_name);
 
-        std::vector<floating_point_type> process_score = classifier.classify(asn_int, port_app, domain, server_name_str, dst_ip_str, user_agent);
+        // the score buffer of each thread is reused from one call to
+        // the next, so that it is only reallocated when it grows
+        //
+        static thread_local std::vector<floating_point_type> process_score;
+        classifier.classify(process_score, asn_int, port_app, domain, server_name, dst_ip, user_agent);
 
+        // find the two highest scores, and exponentiate the scores
+        // and add them up, in a single pass
+        //
         floating_point_type max_score = std::numeric_limits<floating_point_type>::lowest();
         floating_point_type sec_score = std::numeric_limits<floating_point_type>::lowest();
         uint64_t index_max = 0;
         uint64_t index_sec = 0;
+        floating_point_type score_sum = 0.0;
+        floating_point_type malware_prob = 0.0;
+
+        std::array<floating_point_type, attribute_result::MAX_TAGS> attr_prob;
+        attr_prob.fill(0.0);
         for (uint64_t i=0; i < process_score.size(); i++) {
             if (process_score[i] > max_score) {
                 sec_score = max_score;
@@ -591,23 +612,13 @@ public:
                 sec_score = process_score[i];
                 index_sec = i;
             }
-        }
-
-        floating_point_type score_sum = 0.0;
-        floating_point_type malware_prob = 0.0;
-
-        std::array<floating_point_type, attribute_result::MAX_TAGS> attr_prob;
-        attr_prob.fill(0.0);
-        for (uint64_t i=0; i < process_score.size(); i++) {
             process_score[i] = exp((float)process_score[i]);
             score_sum += process_score[i];
             if (malware[i]) {
                 malware_prob += process_score[i];
             }
-            for (int j = 0; j < attribute_result::MAX_TAGS; j++) {
-                if (attr[i][j]) {
-                    attr_prob[j] += process_score[i];
-                }
+            for (unsigned long tags = attr[i].to_ulong(); tags != 0; tags &= tags - 1) {
+                attr_prob[__builtin_ctzl(tags)] += process_score[i];
             }
         }
 
@@ -665,37 +676,32 @@ public:
     }
 
     static uint16_t remap_port(uint16_t dst_port) {
-        std::unordered_map<uint16_t, uint16_t> port_remapping =
-            {
-             { 443, 443 },   // https
-             { 448, 448 },   // database
-             { 465, 465 },   // email
-             { 563, 563 },   // nntp
-             { 585, 465 },   // email
-             { 614, 614 },   // shell
-             { 636, 636 },   // ldap
-             { 989, 989 },   // ftp
-             { 990, 989 },   // ftp
-             { 991, 991 },   // nas
-             { 992, 992 },   // telnet
-             { 993, 465 },   // email
-             { 994, 994 },   // irc
-             { 995, 465 },   // email
-             { 1443, 1443 }, // alt-https
-             { 2376, 2376 }, // docker
-             { 8001, 8001 }, // tor
-             { 8443, 1443 }, // alt-https
-             { 9000, 8001 }, // tor
-             { 9001, 8001 }, // tor
-             { 9002, 8001 }, // tor
-             { 9101, 8001 }, // tor
-            };
-
-        const auto port_it = port_remapping.find(dst_port);
-        if (port_it != port_remapping.end()) {
-            return port_it->second;
+        switch (dst_port) {
+        case 443:  return 443;    // https
+        case 448:  return 448;    // database
+        case 465:  return 465;    // email
+        case 563:  return 563;    // nntp
+        case 585:  return 465;    // email
+        case 614:  return 614;    // shell
+        case 636:  return 636;    // ldap
+        case 989:  return 989;    // ftp
+        case 990:  return 989;    // ftp
+        case 991:  return 991;    // nas
+        case 992:  return 992;    // telnet
+        case 993:  return 465;    // email
+        case 994:  return 994;    // irc
+        case 995:  return 465;    // email
+        case 1443: return 1443;   // alt-https
+        case 2376: return 2376;   // docker
+        case 8001: return 8001;   // tor
+        case 8443: return 1443;   // alt-https
+        case 9000: return 8001;   // tor
+        case 9001: return 8001;   // tor
+        case 9002: return 8001;   // tor
+        case 9101: return 8001;   // tor
+        default:
+            return 0;  // unknown
         }
-        return 0;  // unknown
     }
 
 
@@ -710,7 +716,7 @@ public:
     fingerprint_prevalence(uint32_t max_cache_size) : mutex_{}, list_{}, set_{}, known_set_{}, max_cache_size_{max_cache_size} {}
 
     // first check if known fingerprints contains fingerprint, then check adaptive set
-    bool contains(std::string fp_str) const {
+    bool contains(const std::string &fp_str) const {
         if (known_set_.find(fp_str) != known_set_.end()) {
             return true;
         }
@@ -776,6 +782,7 @@ class classifier {
     subnet_data subnets;     // holds ASN/subnet information
 
     std::unordered_map<std::string, class fingerprint_data> fpdb;
+    fingerprint_index<class fingerprint_data> fpdb_index;   // built from fpdb, which must not change afterwards
     fingerprint_prevalence fp_prevalence{100000};
 
     std::string resource_version;  // as reported by VERSION file in resource archive
@@ -790,6 +797,15 @@ class classifier {
     //
     common_data common;
 
+    // id distinguishes this classifier from every other one created
+    // by this process, so that cached results can be tied to it
+    //
+    static uint64_t new_id() {
+        static std::atomic<uint64_t> next_id{1};
+        return next_id.fetch_add(1);
+    }
+    const uint64_t id = new_id();
+
 public:
 
     static fingerprint_type get_fingerprint_type(const std::string &s) {
@@ -862,9 +878,61 @@ public:
     }
 
     void process_fp_db_line(std::string &line_str, float fp_proc_threshold, float proc_dst_threshold, bool report_os) {
-
         rapidjson::Document fp;
         fp.Parse(line_str.c_str());
+        process_fp_db_entry(fp, fp_proc_threshold, proc_dst_threshold, report_os);
+    }
+
+    // process_fp_db(data, threads, ...) processes each line of the
+    // fingerprint database data as though it were passed to
+    // process_fp_db_line().  The lines are parsed in batches, each
+    // split across up to threads threads, and each batch is then
+    // added to the database in order, on the calling thread, since
+    // the order in which entries are added determines the attribute
+    // and OS dictionaries and which of any duplicates is kept.  The
+    // lines are parsed in place, so data is overwritten.
+    //
+    void process_fp_db(std::string &data, unsigned int threads, float fp_proc_threshold, float proc_dst_threshold, bool report_os) {
+        constexpr size_t batch_size = 4096;
+
+        std::vector<char *> lines;
+        for (size_t pos = 0; pos < data.length(); ) {
+            size_t eol = data.find('\n', pos);
+            if (eol == std::string::npos) {
+                eol = data.length();
+            }
+            data[eol] = '\0';     // data[data.length()] is always '\0'
+            lines.push_back(&data[pos]);
+            pos = eol + 1;
+        }
+        if (threads == 0) {
+            threads = 1;
+        }
+
+        for (size_t first = 0; first < lines.size(); first += batch_size) {
+            size_t count = std::min(batch_size, lines.size() - first);
+            std::vector<rapidjson::Document> docs(count);
+            auto parse = [&](size_t t) {
+                for (size_t i = t; i < count; i += threads) {
+                    docs[i].ParseInsitu(lines[first + i]);
+                }
+            };
+            std::vector<std::future<void>> parsers;
+            for (size_t t = 1; t < threads && t < count; t++) {
+                parsers.push_back(std::async(std::launch::async, parse, t));
+            }
+            parse(0);
+            for (auto &p : parsers) {
+                p.get();
+            }
+            for (auto &fp : docs) {
+                process_fp_db_entry(fp, fp_proc_threshold, proc_dst_threshold, report_os);
+            }
+        }
+    }
+
+    void process_fp_db_entry(rapidjson::Document &fp, float fp_proc_threshold, float proc_dst_threshold, bool report_os) {
+
         if(!fp.IsObject()) {
             printf_err(log_warning, "invalid JSON line in resource file\n");
             return;
@@ -1104,11 +1172,54 @@ public:
                 printf_err(log_warning, "fingerprint database has duplicate entry for fingerprint %s\n", fp_string.c_str());
             }
             // fpdb[fp_string] = fp_data;
-            fpdb.emplace(fp_string, fp_data); // TODO: ???
+            fpdb.emplace(fp_string, std::move(fp_data));
         }
     }
 
-    classifier(class encrypted_compressed_archive &archive,
+    // read_entry(archive, entry, contents) sets contents to the data of
+    // the current entry of archive, up to its first empty line, which
+    // ends an entry when it is read with getline()
+    //
+    template <typename ARCHIVE, typename ENTRY>
+    static void read_entry(ARCHIVE &archive, const ENTRY &entry, std::string &contents) {
+        contents.resize(entry.get_size());
+        if (archive.read((uint8_t *)contents.data(), contents.length()) != (ssize_t)contents.length()) {
+            throw std::runtime_error("error: could not read entry from resource archive file");
+        }
+        size_t empty_line = (contents.compare(0, 1, "\n") == 0) ? 0 : contents.find("\n\n");
+        if (empty_line != std::string::npos) {
+            contents.resize(empty_line == 0 ? 0 : empty_line + 1);
+        }
+    }
+
+    // for_each_line(data, f) calls f on each line of data, without its
+    // terminating newline
+    //
+    template <typename F>
+    static void for_each_line(const std::string &data, F f) {
+        std::string line_str;
+        for (size_t pos = 0; pos < data.length(); ) {
+            size_t eol = data.find('\n', pos);
+            if (eol == std::string::npos) {
+                eol = data.length();
+            }
+            line_str.assign(data, pos, eol - pos);
+            f(line_str);
+            pos = eol + 1;
+        }
+    }
+
+    // the archive is an encrypted_compressed_archive or a
+    // resource_snapshot
+    //
+    // The entries are read into memory first, since the archive can
+    // only be read sequentially, and then parsed in parallel: the
+    // subnets and their LC-trie, and the fingerprint prevalence set,
+    // are built on threads of their own while the fingerprint
+    // database is parsed, which also uses multiple threads.
+    //
+    template <typename ARCHIVE>
+    classifier(ARCHIVE &archive,
                float fp_proc_threshold,
                float proc_dst_threshold,
                bool report_os) : os_dictionary{}, subnets{}, fpdb{}, resource_version{} {
@@ -1125,44 +1236,36 @@ public:
         bool got_fp_db = false;
         bool got_version = false;
         bool got_doh_watchlist = false;
-        //        class compressed_archive archive{resource_archive_file};
-        const class archive_node *entry = archive.get_next_entry();
+        std::string fp_prevalence_data;
+        std::string fp_db_data;
+        std::string version_data;
+        std::string pyasn_data;
+        std::string doh_watchlist_data;
+        const auto *entry = archive.get_next_entry();
         if (entry == nullptr) {
             throw std::runtime_error("error: could not read any entries from resource archive file");
         }
         while (entry != nullptr) {
             if (entry->is_regular_file()) {
-                std::string line_str;
-
                 std::string name = entry->get_name();
                 if (name == "fp_prevalence_tls.txt") {
-                    while (archive.getline(line_str)) {
-                        process_fp_prevalence_line(line_str);
-                    }
+                    read_entry(archive, *entry, fp_prevalence_data);
                     got_fp_prevalence = true;
 
                 } else if (name == "fingerprint_db.json") {
-                    while (archive.getline(line_str)) {
-                        process_fp_db_line(line_str, fp_proc_threshold, proc_dst_threshold, report_os);
-                    }
+                    read_entry(archive, *entry, fp_db_data);
                     got_fp_db = true;
 
                 } else if (name == "VERSION") {
-                    while (archive.getline(line_str)) {
-                        resource_version += line_str;
-                    }
+                    read_entry(archive, *entry, version_data);
                     got_version = true;
 
                 } else if (name == "pyasn.db") {
-                    while (archive.getline(line_str)) {
-                        subnets.process_line(line_str);
-                    }
+                    read_entry(archive, *entry, pyasn_data);
                     got_version = true;
 
                 } else if (name == "doh-watchlist.txt") {
-                    while (archive.getline(line_str)) {
-                        common.doh_watchlist.process_line(line_str);
-                    }
+                    read_entry(archive, *entry, doh_watchlist_data);
                     got_doh_watchlist = true;
                 }
             }
@@ -1172,7 +1275,25 @@ public:
             entry = archive.get_next_entry();
         }
 
-        subnets.process_final();
+        unsigned int threads = std::thread::hardware_concurrency();
+        if (threads == 0) {
+            threads = 1;
+        }
+        auto subnets_built = std::async(std::launch::async, [&]() {
+            subnets.process_lines(pyasn_data, threads);
+            subnets.process_final();
+        });
+        auto fp_prevalence_built = std::async(std::launch::async, [&]() {
+            for_each_line(fp_prevalence_data, [this](std::string &line_str) { process_fp_prevalence_line(line_str); });
+        });
+
+        for_each_line(version_data, [this](std::string &line_str) { resource_version += line_str; });
+        for_each_line(doh_watchlist_data, [this](std::string &line_str) { common.doh_watchlist.process_line(line_str); });
+        process_fp_db(fp_db_data, threads, fp_proc_threshold, proc_dst_threshold, report_os);
+        fpdb_index.build(fpdb);
+
+        subnets_built.get();
+        fp_prevalence_built.get();
     }
 
 #if 0
@@ -1224,40 +1345,26 @@ public:
 
     struct analysis_result perform_analysis(const char *fp_str, const char *server_name, const char *dst_ip,
                                             uint16_t dst_port, const char *user_agent) {
+        size_t fp_len = strlen(fp_str);
+        return perform_analysis(fp_str, fp_len, fingerprint::hash(fp_str, fp_len), server_name, dst_ip, dst_port, user_agent);
+    }
+
+    // perform_analysis(fp_str, fp_len, fp_hash, ...) analyzes the
+    // fingerprint string fp_str, of length fp_len, whose
+    // fingerprint::hash() is fp_hash
+    //
+    struct analysis_result perform_analysis(const char *fp_str, size_t fp_len, uint64_t fp_hash,
+                                            const char *server_name, const char *dst_ip,
+                                            uint16_t dst_port, const char *user_agent) {
 
         // fp_stats.observe(fp_str, server_name, dst_ip, dst_port); // TBD - decide where this call should go
 
-        const auto fpdb_entry = fpdb.find(fp_str);
-        if (fpdb_entry == fpdb.end()) {
-            if (fp_prevalence.contains(fp_str)) {
-                fp_prevalence.update(fp_str);
-                return analysis_result(fingerprint_status_unlabled);
-            } else {
-                fp_prevalence.update(fp_str);
-                /*
-                 * Resource file has info about randomized fingerprints in the format
-                 * protocol/format/randomized
-                 * Eg: tls/1/randomized
-                 */
-                std::string randomized_str;
-                const char *c = &fp_str[0];
-                while (*c != '\0' && *c != '(') {
-                    randomized_str.append(c, 1);
-                    c++;
-                }
-                randomized_str.append("randomized");
- 
-                const auto fpdb_entry_randomized = fpdb.find(randomized_str);
-                if (fpdb_entry_randomized == fpdb.end()) {
-                    return analysis_result(fingerprint_status_randomized);  // TODO: does this actually happen?
-                }
-                class fingerprint_data &fp_data = fpdb_entry_randomized->second;
-                return fp_data.perform_analysis(server_name, dst_ip, dst_port, user_agent, fingerprint_status_randomized);
-            }
+        enum fingerprint_status status;
+        class fingerprint_data *fp_data = find_fingerprint_data(fp_str, fp_len, fp_hash, status);
+        if (fp_data == nullptr) {
+            return analysis_result(status);
         }
-        class fingerprint_data &fp_data = fpdb_entry->second;
-
-        return fp_data.perform_analysis(server_name, dst_ip, dst_port, user_agent, fingerprint_status_labeled);
+        return fp_data->perform_analysis(server_name, dst_ip, dst_port, user_agent, status);
     }
 
     /*
@@ -1276,44 +1383,61 @@ public:
 
         // fp_stats.observe(fp_str, server_name, dst_ip, dst_port); // TBD - decide where this call should go
 
-        const auto fpdb_entry = fpdb.find(fp_str);
-        if (fpdb_entry == fpdb.end()) {
-            if (fp_prevalence.contains(fp_str)) {
-                fp_prevalence.update(fp_str);
-                return analysis_result(fingerprint_status_unlabled);
-            } else {
-                fp_prevalence.update(fp_str);
-                /*
-                 * Resource file has info about randomized fingerprints in the format
-                 * protocol/format/randomized
-                 * Eg: tls/1/randomized
-                 */
-                std::string randomized_str;
-                const char *c = &fp_str[0];
-                while (*c != '\0' && *c != '(') {
-                    randomized_str.append(c, 1);
-                    c++;
-                }
-                randomized_str.append("randomized");
+        size_t fp_len = strlen(fp_str);
+        enum fingerprint_status status;
+        class fingerprint_data *fp_data = find_fingerprint_data(fp_str, fp_len, fingerprint::hash(fp_str, fp_len), status);
+        if (fp_data == nullptr) {
+            return analysis_result(status);
+        }
+        fp_data->recompute_probabilities(new_as_weight, new_domain_weight, new_port_weight, new_ip_weight, new_sni_weight, new_ua_weight);
+        return fp_data->perform_analysis(server_name, dst_ip, dst_port, user_agent, status);
+    }
 
-                const auto fpdb_entry_randomized = fpdb.find(randomized_str);
-                if (fpdb_entry_randomized == fpdb.end()) {
-                    return analysis_result(fingerprint_status_randomized);  // TODO: does this actually happen?
-                }
-                class fingerprint_data &fp_data = fpdb_entry_randomized->second;
-                fp_data.recompute_probabilities(new_as_weight, new_domain_weight, new_port_weight, new_ip_weight, new_sni_weight, new_ua_weight);
-                return fp_data.perform_analysis(server_name, dst_ip, dst_port, user_agent, fingerprint_status_randomized);
-            }
+    // find_fingerprint_data(fp_str, fp_len, fp_hash, status) returns
+    // the data used to analyze the fingerprint string fp_str, of
+    // length fp_len and fingerprint::hash() fp_hash, and sets status:
+    // fingerprint_status_labeled if it is in the database; otherwise
+    // fingerprint_status_unlabled (with no data) if it is in the
+    // prevalence set, or else fingerprint_status_randomized, with the
+    // data of the randomized entry for its protocol and format, if
+    // there is one.  The prevalence set is updated with any
+    // fingerprint that is not in the database.
+    //
+    class fingerprint_data *find_fingerprint_data(const char *fp_str, size_t fp_len, uint64_t fp_hash,
+                                                  enum fingerprint_status &status) {
+        class fingerprint_data *fp_data = fpdb_index.find(fp_str, fp_len, fp_hash);
+        if (fp_data != nullptr) {
+            status = fingerprint_status_labeled;
+            return fp_data;
+        }
+        std::string fp{fp_str, fp_len};
+        if (fp_prevalence.contains(fp)) {
+            fp_prevalence.update(fp);
+            status = fingerprint_status_unlabled;
+            return nullptr;
         }
-        class fingerprint_data &fp_data = fpdb_entry->second;
+        fp_prevalence.update(fp);
 
-        fp_data.recompute_probabilities(new_as_weight, new_domain_weight, new_port_weight, new_ip_weight, new_sni_weight, new_ua_weight);
-        return fp_data.perform_analysis(server_name, dst_ip, dst_port, user_agent, fingerprint_status_labeled);
+        /*
+         * Resource file has info about randomized fingerprints in the format
+         * protocol/format/randomized
+         * Eg: tls/1/randomized
+         */
+        status = fingerprint_status_randomized;
+        return fpdb_index.find_randomized(fp_str, fp_len);  // TODO: can this actually be missing?
     }
 
+    // analyze_fingerprint_and_destination_context(fp, dc, result,
+    // cache) sets result to the analysis of fp and dc; if cache is not
+    // nullptr, then the result is taken from it if possible, and
+    // otherwise added to it if the fingerprint is labeled.  Other
+    // results are not cached, since they depend on the fingerprints
+    // that have been seen before.
+    //
     bool analyze_fingerprint_and_destination_context(const fingerprint &fp,
                                                      const destination_context &dc,
-                                                     analysis_result &result
+                                                     analysis_result &result,
+                                                     analysis_cache *cache=nullptr
                                                      ) {
 
         if (fp.is_null()) {
@@ -1323,7 +1447,20 @@ public:
             result = analysis_result(fingerprint_status_unanalyzed);
             return true;  // not configured to analyze fingerprints of this type
         }
-        result = this->perform_analysis(fp.string(), dc.sn_str, dc.dst_ip_str, dc.dst_port, dc.ua_str);
+        if (cache && cache->is_enabled()) {
+            uint64_t k = cache->key(fp.string(), dc);
+            const analysis_result *cached = cache->find(k, id);
+            if (cached) {
+                result = *cached;
+                return true;
+            }
+            result = this->perform_analysis(fp.string(), fp.length(), fp.get_hash(), dc.sn_str, dc.dst_ip_str, dc.dst_port, dc.ua_str);
+            if (result.status == fingerprint_status_labeled) {
+                cache->insert(k, result);
+            }
+            return true;
+        }
+        result = this->perform_analysis(fp.string(), fp.length(), fp.get_hash(), dc.sn_str, dc.dst_ip_str, dc.dst_port, dc.ua_str);
         return true;
     }
 
@@ -0,0 +1,193 @@
+// analysis_cache.h
+//
+// a bounded cache of the analysis results of a packet processor
+//
+// Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.
+// License at https://github.com/cisco/mercury/blob/master/LICENSE
+
+#ifndef ANALYSIS_CACHE_H
+#define ANALYSIS_CACHE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "result.h"
+
+// struct analysis_cache_stats counts the lookups in an analysis_cache
+// and their outcomes; they are reported through
+// mercury_packet_processor_get_stats()
+//
+struct analysis_cache_stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;        // entries replaced to make room for new ones
+    uint64_t invalidations = 0;    // times the cache was emptied because the classifier changed
+};
+
+// class analysis_cache holds the analysis results for the most
+// recently analyzed (fingerprint, server name, destination address,
+// destination port, user agent) tuples of a single packet processor,
+// so that it needs no locks.  A tuple is identified by a 64-bit
+// keyed hash, which is computed with a random seed that is chosen
+// when the cache is created.
+//
+// The cache is set associative: a key can only be held in one set of
+// ways entries, so a lookup is a single probe of ways tags that share
+// a cache line.  Each set is managed with the CLOCK algorithm: an
+// entry has a reference bit that is set when it is found, and when a
+// new entry is needed in a full set, the hand of the set sweeps over
+// its entries, clearing reference bits, until it finds one that is
+// clear, which is replaced.
+//
+// The results in the cache refer to the data of the classifier that
+// computed them, so each lookup names its classifier, and the cache
+// is emptied when that changes.
+//
+class analysis_cache {
+public:
+
+    static constexpr size_t ways = 8;
+    static constexpr size_t default_entries = 1024;
+
+    // analysis_cache(entries) creates a cache that holds at least
+    // entries results (rounded up to a power of two number of sets);
+    // if entries is zero, then the cache is disabled
+    //
+    explicit analysis_cache(size_t entries=default_entries) {
+        if (entries == 0) {
+            return;
+        }
+        num_sets = 1;
+        while (num_sets * ways < entries) {
+            num_sets *= 2;
+        }
+        tags.assign(num_sets * ways, 0);
+        referenced.assign(num_sets * ways, 0);
+        hands.assign(num_sets, 0);
+        results.resize(num_sets * ways);
+        std::random_device rd;
+        seed = ((uint64_t)rd() << 32) | rd();
+    }
+
+    analysis_cache(const analysis_cache &) = delete;
+    analysis_cache &operator=(const analysis_cache &) = delete;
+
+    bool is_enabled() const { return num_sets != 0; }
+
+    // capacity() returns the number of results that the cache can
+    // hold, which is zero if it is disabled
+    //
+    size_t capacity() const { return num_sets * ways; }
+
+    // key(fp, dc) returns the hash of the fingerprint string fp and
+    // the destination context dc, which is never zero
+    //
+    uint64_t key(const char *fp, const struct destination_context &dc) const {
+        uint64_t h = seed;
+        h = hash(h, fp);
+        h = hash(h, dc.sn_str);
+        h = hash(h, dc.dst_ip_str);
+        h = (h ^ dc.dst_port) * multiplier;
+        h = hash(h, dc.ua_str);
+        h ^= h >> 29;
+        return h ? h : 1;
+    }
+
+    // find(k, owner) returns the result cached for the key k by the
+    // classifier identified by owner, or nullptr if there is none
+    //
+    const struct analysis_result *find(uint64_t k, uint64_t owner) {
+        if (owner != classifier_id) {
+            if (classifier_id != 0) {
+                clear();
+                stats.invalidations++;
+            }
+            classifier_id = owner;
+        }
+        size_t base = set_of(k) * ways;
+        for (size_t w = 0; w < ways; w++) {
+            if (tags[base + w] == k) {
+                referenced[base + w] = 1;
+                stats.hits++;
+                return &results[base + w];
+            }
+        }
+        stats.misses++;
+        return nullptr;
+    }
+
+    // insert(k, r) caches the result r for the key k, which find()
+    // has just failed to find
+    //
+    void insert(uint64_t k, const struct analysis_result &r) {
+        size_t set = set_of(k);
+        size_t base = set * ways;
+        size_t slot = ways;
+        for (size_t w = 0; w < ways; w++) {
+            if (tags[base + w] == 0) {
+                slot = w;
+                break;
+            }
+        }
+        if (slot == ways) {
+            uint8_t &hand = hands[set];
+            while (referenced[base + hand]) {
+                referenced[base + hand] = 0;
+                hand = (hand + 1) % ways;
+            }
+            slot = hand;
+            hand = (hand + 1) % ways;
+            stats.evictions++;
+        }
+        tags[base + slot] = k;
+        referenced[base + slot] = 0;
+        results[base + slot] = r;
+    }
+
+    void clear() {
+        std::fill(tags.begin(), tags.end(), 0);
+        std::fill(referenced.begin(), referenced.end(), 0);
+    }
+
+    struct analysis_cache_stats stats;
+
+private:
+    size_t num_sets = 0;                        // a power of two, or zero if disabled
+    std::vector<uint64_t> tags;                 // keys, ways per set; zero marks an empty entry
+    std::vector<uint8_t> referenced;            // CLOCK reference bits
+    std::vector<uint8_t> hands;                 // CLOCK hand of each set
+    std::vector<struct analysis_result> results;
+    uint64_t classifier_id = 0;                 // the classifier whose results are cached
+    uint64_t seed = 0;
+
+    static constexpr uint64_t multiplier = 2862933555777941757;
+
+    size_t set_of(uint64_t k) const {
+        return (k ^ (k >> 32)) & (num_sets - 1);
+    }
+
+    // hash(h, s) mixes the null-terminated string s, and its length,
+    // into the hash value h, eight bytes at a time
+    //
+    static uint64_t hash(uint64_t h, const char *s) {
+        size_t len = strlen(s);
+        h = (h ^ len) * multiplier;
+        while (len >= sizeof(uint64_t)) {
+            uint64_t w;
+            memcpy(&w, s, sizeof(w));
+            h = (h ^ w) * multiplier;
+            h ^= h >> 32;
+            s += sizeof(uint64_t);
+            len -= sizeof(uint64_t);
+        }
+        uint64_t w = 0;
+        memcpy(&w, s, len);
+        h = (h ^ w) * multiplier;
+        return h ^ (h >> 32);
+    }
+};
+
+#endif // ANALYSIS_CACHE_H
@@ -634,6 +634,21 @@ public:
         return entry;
     }
 
+    // read(buffer, len) reads up to len bytes of the current entry,
+    // and returns the number of bytes read; it should not be mixed
+    // with getline() on the same entry
+    //
+    ssize_t read(uint8_t *buffer, size_t len) {
+        ssize_t remaining = end_of_file - gz.tell();
+        if (remaining <= 0) {
+            return 0;
+        }
+        if (len > (size_t)remaining) {
+            len = remaining;
+        }
+        return gz.read(buffer, len);
+    }
+
     ssize_t getline(std::string &s) {
         //fprintf(stderr, "encrypted_compressed_archive::%s\n", __func__);
 
@@ -36,9 +36,12 @@ static std::vector<libmerc_option> config_mapper = {
     {"nonselected-tcp-data", "", "", SETTER_FUNCTION(){ c.output_tcp_initial_data = s.empty() ? true : s.compare("1") == 0; }},
     {"nonselected-udp-data", "", "", SETTER_FUNCTION(){ c.output_udp_initial_data = s.empty() ? true : s.compare("1") == 0; }},
     {"tcp-reassembly", "", "",       SETTER_FUNCTION(){ c.tcp_reassembly = s.empty() ? true : s.compare("1") == 0;}},
+    {"tcp-reassembly-budget", "", "", SETTER_FUNCTION(){ c.tcp_reassembly_budget = std::stoul(s); }},
     {"fp_proc_threshold", "", "",    SETTER_FUNCTION(){ c.fp_proc_threshold = std::stof(s); }},
     {"proc_dst_threshold", "", "",   SETTER_FUNCTION(){ c.proc_dst_threshold = std::stof(s); }},
-    {"max_stats_entries", "", "",    SETTER_FUNCTION(){ c.max_stats_entries = std::stoull(s); }}
+    {"max_stats_entries", "", "",    SETTER_FUNCTION(){ c.max_stats_entries = std::stoull(s); }},
+    {"stats-sketch", "", "",         SETTER_FUNCTION(){ c.stats_sketch_counters = std::stoull(s); }},
+    {"analysis-cache-size", "", "",  SETTER_FUNCTION(){ c.analysis_cache_size = std::stoull(s); }}
 };
 
 struct config_token
@@ -30,45 +30,72 @@
 // Do *not* call compress() after calling compute_inverse() or
 // get_inverse(); doing so may get you garbage results.
 //
+// A dict is generational: each entry records the epoch in which it
+// was last used, and end_epoch() evicts the entries that were not used
+// in the epoch that it ends, so that the memory used by a long-lived
+// dict is bounded by the number of strings used per epoch.  The
+// value of a string stays the same for as long as it is used in
+// every epoch; values are never reused, so a string that is evicted
+// and then seen again gets a new value.
+//
 class dict {
 public:
-    std::unordered_map<std::string, uint32_t> d;
+    struct entry {
+        uint32_t value;
+        uint32_t epoch;     // the epoch in which the entry was last used
+    };
+    std::unordered_map<std::string, entry> d;
     unsigned int count;
+    uint32_t epoch;
     std::vector<const char *> inverse;
     unsigned int inverse_size;
 
-    dict() : d{}, count{0}, inverse{}, inverse_size{0} { }
+    dict() : d{}, count{0}, epoch{0}, inverse{}, inverse_size{0} { }
 
     unsigned int get(const std::string &value) {
         auto x = d.find(value);
         if (x == d.end()) {
-            d.emplace(value, count);
+            d.emplace(value, entry{count, epoch});
             return count++;
         }
-        return x->second;
+        x->second.epoch = epoch;
+        return x->second.value;
     }
 
     void compress(const std::string &value,
                   char fp_index_string[9]) {
-        auto x = d.find(value);
-        if (x == d.end()) {
-            d.emplace(value, count);
-            sprintf(fp_index_string, "%x", count);
-            count++;
-            return;
+        sprintf(fp_index_string, "%x", get(value));
+    }
+
+    // end_epoch() evicts the entries that were not used in the
+    // current epoch, and starts a new one.  The buckets of the map
+    // are kept, so that it does not need to be rehashed as it fills
+    // up again, unless most of them have become empty.
+    //
+    void end_epoch() {
+        for (auto x = d.begin(); x != d.end(); ) {
+            if (x->second.epoch != epoch) {
+                x = d.erase(x);
+            } else {
+                ++x;
+            }
         }
-        sprintf(fp_index_string, "%x", x->second);
+        if (d.size() * 8 < d.bucket_count()) {
+            d.rehash(0);
+        }
+        epoch++;
     }
 
+    size_t size() const { return d.size(); }
+
     bool compute_inverse_map() {
 
         try {
-            inverse.clear();
-            inverse.reserve(d.size());
+            inverse.assign(count, nullptr);
             for (const auto &x : d) {
-                inverse[x.second] = x.first.c_str();
+                inverse[x.second.value] = x.first.c_str();
             }
-            inverse_size = inverse.capacity();
+            inverse_size = inverse.size();
             return true;
         }
         catch (...) {
@@ -77,7 +104,7 @@ public:
     }
 
     const char *get_inverse(unsigned int index) const {
-        if (index < inverse_size) {
+        if (index < inverse_size && inverse[index] != nullptr) {
             return inverse[index];
         }
         return unknown_fp_string;
@@ -94,15 +121,15 @@ public:
         // sanity check: output forward and reverse mappings, to enable comparison
         bool passed = true;
         for (const auto &a : d) {
-            if (a.first.compare(get_inverse(a.second)) != 0) {
+            if (a.first.compare(get_inverse(a.second.value)) != 0) {
                 if (f) {
-                    fprintf(f, "dict unit test error: mismatch at dict table entry (%s: %u)\n", a.first.c_str(), a.second);
+                    fprintf(f, "dict unit test error: mismatch at dict table entry (%s: %u)\n", a.first.c_str(), a.second.value);
                 }
                 passed = false;
             }
         }
         for (unsigned int i = 0; i < inverse_size; i++) {
-            if (get(inverse[i]) != i) {
+            if (inverse[i] != nullptr && get(inverse[i]) != i) {
                 if (f) {
                     fprintf(f, "dict unit test error: mismatch at inverse table entry (%s: %u)\n", inverse[i], i);
                 }
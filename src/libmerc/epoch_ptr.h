@@ -0,0 +1,178 @@
+// epoch_ptr.h
+//
+// a pointer that is replaced while it is being read, with epoch-based
+// reclamation of the objects that it pointed to
+//
+// Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.
+// License at https://github.com/cisco/mercury/blob/master/LICENSE
+
+#ifndef EPOCH_PTR_H
+#define EPOCH_PTR_H
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+// class epoch_ptr<T> owns an object of type T that is used by any
+// number of reader threads, and that can be replaced by another
+// object at any time, by any thread, without the readers taking a
+// lock.
+//
+// Each object is published with an epoch number, which increases by
+// one each time that the object is replaced.  Each reader thread has a
+// reader, which holds the object that the reader is using; the reader
+// calls refresh() at points where it holds no references into that
+// object (for instance, between packets), which picks up the newest
+// object, and records its epoch.  An object that has been replaced is
+// deleted once every reader has recorded a later epoch, by whichever
+// thread notices that first: either a reader, as it picks up a new
+// object, or a thread that replaces the object.  A reader that stops
+// calling refresh() (for instance, because no packets arrive) keeps
+// the object that it holds alive, until it calls refresh() again or
+// is destroyed.
+//
+template <typename T>
+class epoch_ptr {
+public:
+
+    class reader {
+        epoch_ptr &owner;
+        std::atomic<uint64_t> epoch;    // the epoch of ptr, read by reclaim()
+        T *ptr;
+
+        friend class epoch_ptr;
+
+    public:
+
+        explicit reader(epoch_ptr &p) : owner{p} {
+            std::lock_guard<std::mutex> lock{owner.mutex};
+            epoch.store(owner.current_epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            ptr = owner.current.load(std::memory_order_relaxed);
+            owner.readers.push_back(this);
+        }
+
+        ~reader() {
+            {
+                std::lock_guard<std::mutex> lock{owner.mutex};
+                owner.readers.erase(std::find(owner.readers.begin(), owner.readers.end(), this));
+            }
+            owner.reclaim();
+        }
+
+        reader(const reader &) = delete;
+        reader &operator=(const reader &) = delete;
+
+        // refresh() returns the newest object, and releases the one
+        // previously returned, which must no longer be used; if the
+        // object has not been replaced, it costs a single atomic load
+        //
+        T *refresh() {
+            uint64_t e = owner.current_epoch.load(std::memory_order_acquire);
+            if (e != epoch.load(std::memory_order_relaxed)) {
+
+                // the object is loaded after its epoch, and replace()
+                // stores them in the opposite order, so ptr is at least
+                // as new as epoch e
+                //
+                ptr = owner.current.load(std::memory_order_acquire);
+                epoch.store(e, std::memory_order_release);
+                owner.try_reclaim();
+            }
+            return ptr;
+        }
+
+        T *get() const { return ptr; }
+    };
+
+    explicit epoch_ptr(T *p=nullptr) : current{p} { }
+
+    ~epoch_ptr() {
+        delete current.load();
+        for (const auto &r : retired) {
+            delete r.ptr;
+        }
+    }
+
+    epoch_ptr(const epoch_ptr &) = delete;
+    epoch_ptr &operator=(const epoch_ptr &) = delete;
+
+    // get() returns the newest object; it is only safe to use it in a
+    // thread that is not a reader if no other thread can replace it
+    //
+    T *get() const { return current.load(std::memory_order_acquire); }
+
+    uint64_t get_epoch() const { return current_epoch.load(std::memory_order_acquire); }
+
+    // replace(p) makes p the newest object, of which this epoch_ptr
+    // takes ownership, and returns its epoch; the object that it
+    // replaces is deleted once no reader can be using it
+    //
+    uint64_t replace(T *p) {
+        uint64_t e;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            T *prev = current.load(std::memory_order_relaxed);
+            e = current_epoch.load(std::memory_order_relaxed) + 1;
+            current.store(p, std::memory_order_release);
+            current_epoch.store(e, std::memory_order_seq_cst);
+            if (prev != nullptr) {
+                retired.push_back({prev, e});
+            }
+        }
+        reclaim();
+        return e;
+    }
+
+    // reclaim() deletes each replaced object that no reader can still
+    // be using, and returns the number of replaced objects that remain
+    //
+    size_t reclaim() {
+        std::lock_guard<std::mutex> lock{mutex};
+        return reclaim_locked();
+    }
+
+private:
+
+    struct retired_ptr {
+        T *ptr;
+        uint64_t epoch;   // the epoch that replaced ptr
+    };
+
+    std::atomic<T *> current;
+    std::atomic<uint64_t> current_epoch{0};
+    std::mutex mutex;                    // guards readers and retired
+    std::vector<reader *> readers;
+    std::vector<retired_ptr> retired;
+
+    // try_reclaim() is called by readers, which must not wait for a
+    // thread that is replacing the object, or for another reader
+    //
+    void try_reclaim() {
+        std::unique_lock<std::mutex> lock{mutex, std::try_to_lock};
+        if (lock.owns_lock()) {
+            reclaim_locked();
+        }
+    }
+
+    size_t reclaim_locked() {
+        if (retired.empty()) {
+            return 0;
+        }
+        uint64_t oldest = current_epoch.load(std::memory_order_seq_cst);
+        for (const reader *r : readers) {
+            oldest = std::min(oldest, r->epoch.load(std::memory_order_acquire));
+        }
+        auto unused = std::partition(retired.begin(), retired.end(),
+                                     [oldest](const retired_ptr &r) { return r.epoch > oldest; });
+        for (auto it = unused; it != retired.end(); ++it) {
+            delete it->ptr;
+        }
+        retired.erase(unused, retired.end());
+        return retired.size();
+    }
+
+};
+
+#endif // EPOCH_PTR_H
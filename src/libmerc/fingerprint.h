@@ -4,6 +4,8 @@
 #ifndef FINGERPRINT_H
 #define FINGERPRINT_H
 
+#include <stdint.h>
+#include <string.h>
 #include <cctype>
 #include <cassert>
 #include <vector>
@@ -14,6 +16,8 @@ class fingerprint {
     static const size_t MAX_FP_STR_LEN = 4096;
     char fp_str[MAX_FP_STR_LEN];
     struct buffer_stream fp_buf;
+    size_t fp_len = 0;           // set by final()
+    uint64_t fp_hash = 0;        // hash(fp_str, fp_len), set by final()
 
 public:
 
@@ -24,12 +28,22 @@ public:
         type = fingerprint_type_unknown;
         fp_str[0] = '\0';
         fp_buf = buffer_stream{fp_str, MAX_FP_STR_LEN};
+        fp_len = 0;
+        fp_hash = hash(fp_str, 0);
     }
 
     const char *string() const {
         return fp_str;
     }
 
+    size_t length() const { return fp_len; }
+
+    // get_hash() returns the hash of the fingerprint string, which is
+    // computed once by final(), so that the fingerprint database can
+    // be searched without hashing the string again
+    //
+    uint64_t get_hash() const { return fp_hash; }
+
     // to create a fingerprint, call these member functions in this
     // order:
     //
@@ -126,6 +140,12 @@ public:
     void final() {
         fp_buf.write_char('\0'); // null-terminate
         assert(fingerprint_is_well_formed());
+        if (fp_buf.trunc) {
+            fp_len = strnlen(fp_str, MAX_FP_STR_LEN);
+        } else {
+            fp_len = fp_buf.length() - 1;
+        }
+        fp_hash = hash(fp_str, fp_len);
     }
 
     bool is_null() const {
@@ -170,6 +190,28 @@ public:
     }
 
     static size_t max_length() { return MAX_FP_STR_LEN; }
+
+    // hash(s, len) returns a 64-bit hash of the len bytes at s, eight
+    // bytes at a time; it is not keyed, so it must only be used where
+    // a match of hashes is confirmed by comparing the strings
+    //
+    static uint64_t hash(const char *s, size_t len) {
+        constexpr uint64_t multiplier = 0x9e3779b97f4a7c15;
+        uint64_t h = len * multiplier;
+        while (len >= sizeof(uint64_t)) {
+            uint64_t w;
+            memcpy(&w, s, sizeof(w));
+            h = (h ^ w) * multiplier;
+            h ^= h >> 32;
+            s += sizeof(uint64_t);
+            len -= sizeof(uint64_t);
+        }
+        uint64_t w = 0;
+        memcpy(&w, s, len);
+        h = (h ^ w) * multiplier;
+        h ^= h >> 29;
+        return h;
+    }
 };
 
 #endif // FINGERPRINT_H
@@ -0,0 +1,134 @@
+// fingerprint_index.h
+//
+// a compact, read-only hash index over the fingerprint database
+//
+// Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.
+// License at https://github.com/cisco/mercury/blob/master/LICENSE
+
+#ifndef FINGERPRINT_INDEX_H
+#define FINGERPRINT_INDEX_H
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "fingerprint.h"
+
+// class fingerprint_index<T> finds the value of type T that a map
+// from fingerprint strings to T holds for a fingerprint, given its
+// string, length, and fingerprint::hash(), without constructing a
+// std::string or hashing the string again.  It is built once, after
+// the map is complete, and refers to the keys and values of the map,
+// which must not be changed or moved while the index is in use (the
+// values themselves may be modified).
+//
+// The index is open addressed, with linear probing and a load factor
+// of at most one half.  Each slot holds the full 64-bit hash of its
+// fingerprint and the position of its entry, so a probe only touches
+// the slot array until the hashes match, and then a single string
+// comparison confirms the match.
+//
+// The fingerprints of the form "<prefix>randomized" (for instance,
+// "tls/1/randomized"), which hold the data that is used for
+// fingerprints that are neither in the database nor in the prevalence
+// set, are resolved when the index is built, so that the randomized
+// entry for a fingerprint can be found from the part of its string
+// before the first '(' without building the name of that entry.
+//
+template <typename T>
+class fingerprint_index {
+
+    struct slot {
+        uint64_t hash;
+        uint32_t entry;          // position in entries, or empty
+    };
+
+    struct entry {
+        const char *key;
+        size_t length;
+        T *value;
+    };
+
+    static constexpr uint32_t empty = UINT32_MAX;
+    static constexpr char randomized_suffix[] = "randomized";
+
+    std::vector<struct slot> slots;          // a power of two in number
+    std::vector<struct entry> entries;
+    std::vector<struct entry> randomized;   // key and length are those of the prefix
+
+public:
+
+    // build(map) indexes the entries of map, which is a map from
+    // std::string to T, replacing anything previously indexed
+    //
+    template <typename MAP>
+    void build(MAP &map) {
+        entries.clear();
+        randomized.clear();
+        size_t num_slots = 1;
+        while (num_slots < 2 * map.size()) {
+            num_slots *= 2;
+        }
+        slots.assign(num_slots, { 0, empty });
+        entries.reserve(map.size());
+
+        constexpr size_t suffix_length = sizeof(randomized_suffix) - 1;
+        for (auto &kv : map) {
+            const std::string &key = kv.first;
+            entries.push_back({ key.data(), key.length(), &kv.second });
+            uint64_t h = fingerprint::hash(key.data(), key.length());
+            size_t i = h & (slots.size() - 1);
+            while (slots[i].entry != empty) {
+                i = (i + 1) & (slots.size() - 1);
+            }
+            slots[i] = { h, (uint32_t)(entries.size() - 1) };
+
+            if (key.length() >= suffix_length
+                && key.compare(key.length() - suffix_length, suffix_length, randomized_suffix) == 0) {
+                randomized.push_back({ key.data(), key.length() - suffix_length, &kv.second });
+            }
+        }
+    }
+
+    // find(fp_str, length, h) returns the value for the fingerprint
+    // string fp_str, which has length bytes and the fingerprint::hash()
+    // h, or nullptr if there is none
+    //
+    T *find(const char *fp_str, size_t length, uint64_t h) const {
+        if (slots.empty()) {
+            return nullptr;
+        }
+        for (size_t i = h & (slots.size() - 1); slots[i].entry != empty; i = (i + 1) & (slots.size() - 1)) {
+            if (slots[i].hash == h) {
+                const struct entry &e = entries[slots[i].entry];
+                if (e.length == length && memcmp(e.key, fp_str, length) == 0) {
+                    return e.value;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    // find_randomized(fp_str, length) returns the value for the
+    // randomized entry of the fingerprint string fp_str, which has
+    // length bytes, or nullptr if there is none; that entry is the
+    // part of fp_str before its first '(', followed by "randomized"
+    //
+    T *find_randomized(const char *fp_str, size_t length) const {
+        const char *paren = (const char *)memchr(fp_str, '(', length);
+        if (paren != nullptr) {
+            length = paren - fp_str;
+        }
+        for (const auto &e : randomized) {
+            if (e.length == length && memcmp(e.key, fp_str, length) == 0) {
+                return e.value;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t size() const { return entries.size(); }
+};
+
+#endif // FINGERPRINT_INDEX_H
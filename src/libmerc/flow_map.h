@@ -0,0 +1,380 @@
+// flow_map.h
+//
+// a fixed-capacity, open-addressing hash table for flow keys
+//
+// Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.
+// License at https://github.com/cisco/mercury/blob/master/LICENSE
+
+#ifndef FLOW_MAP_H
+#define FLOW_MAP_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+#include <utility>
+#include <functional>
+#include <type_traits>
+#include <stdexcept>
+
+#include "timer_wheel.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// struct flow_map_no_value is the value type of a flow_map that only
+// records whether, and when, a flow was seen
+//
+struct flow_map_no_value { };
+
+// class flow_map<T, K, H> maps flow keys of type K to values of type
+// T, with a capacity that is fixed when it is constructed, so that
+// its memory use is bounded no matter how many flows are observed.
+//
+// The slots are divided into groups of sixteen.  Each slot has a
+// control byte, which is empty, deleted, or holds a seven-bit tag
+// taken from the hash of its key; the sixteen control bytes of a
+// group are compared to the tag of a key at once (with SSE2, where
+// available), so a lookup usually touches one cache line of control
+// bytes and one entry.  A key is probed for in at most
+// max_probe_groups consecutive groups, starting at the group
+// selected by its hash.
+//
+// Each entry records the time (in seconds) at which it was inserted
+// or last touched.  When a new key is inserted, a slot whose entry is
+// older than the timeout of the map is reused as though it were
+// free, and if there is no free slot in the probe sequence, then the
+// oldest entry in it is evicted.  If the map is given a timer_wheel,
+// then each slot has a timer that is scheduled when an entry is put
+// in it, and an entry that has not been touched for timeout seconds
+// when its timer fires is removed; since touching an entry only
+// updates its time, the timer is rescheduled when it fires, if
+// needed.  Without a timer_wheel, entries are only expired by being
+// reused.  In either case, the owner of a flow_map is responsible for
+// checking the age of the entries that it finds.
+//
+// A value is destroyed when its entry is erased, expired, reused, or
+// evicted, and when the map is cleared or destroyed.  A map whose
+// values must not vanish implicitly, because something else refers to
+// them, should add entries with try_emplace(), which never reuses or
+// evicts an entry, and should be given no timer_wheel; its entries
+// never move, so pointers to them stay valid until they are erased.
+//
+template <typename T, typename K = struct key, typename H = std::hash<K>>
+class flow_map : public timer_client {
+public:
+
+    struct entry {
+        K key;
+        unsigned int sec;    // time of insertion or last touch
+        T value;
+    };
+
+    static constexpr size_t group_size = 16;
+    static constexpr size_t max_probe_groups = 8;
+
+    // flow_map(entries, timeout) creates a map that can hold at least
+    // entries entries, in which entries older than timeout seconds
+    // can be reused; if wheel is not nullptr, then the entries are
+    // removed through it once they are older than timeout seconds
+    //
+    flow_map(size_t entries, unsigned int timeout, timer_wheel *wheel=nullptr) : expiry{timeout}, timers{wheel} {
+        size_t min_groups = (entries + entries / 7 + group_size - 1) / group_size;  // maximum load factor 7/8
+        num_groups = 1;
+        while (num_groups < min_groups) {
+            num_groups *= 2;
+        }
+        probe_groups = num_groups < max_probe_groups ? num_groups : max_probe_groups;
+
+        // the allocations are zeroized, which marks every slot as
+        // empty, and leaves pages non-resident until they are used
+        //
+        ctrl = (uint8_t *)calloc(num_groups, group_size);
+        entries_ = (entry *)calloc(num_groups * group_size, sizeof(entry));
+        if (ctrl == nullptr || entries_ == nullptr) {
+            free(ctrl);
+            free(entries_);
+            throw std::bad_alloc{};
+        }
+        if (timers) {
+            slot_timers = (struct wheel_timer *)calloc(num_groups * group_size, sizeof(struct wheel_timer));
+            if (slot_timers == nullptr) {
+                free(ctrl);
+                free(entries_);
+                throw std::bad_alloc{};
+            }
+        }
+    }
+
+    ~flow_map() {
+        cancel_timers();
+        destroy_all();
+        free(ctrl);
+        free(entries_);
+        free(slot_timers);
+    }
+
+    flow_map(const flow_map &) = delete;
+    flow_map &operator=(const flow_map &) = delete;
+
+    // find(k) returns the entry for the key k, or nullptr if there is
+    // none
+    //
+    entry *find(const K &k) {
+        uint64_t h = hasher(k);
+        uint8_t tag = tag_of(h);
+        size_t g = group_of(h);
+        for (size_t i = 0; i < probe_groups; i++, g = (g + 1) & (num_groups - 1)) {
+            const uint8_t *c = &ctrl[g * group_size];
+            for (uint32_t m = match(c, tag); m != 0; m &= m - 1) {
+                entry *e = &entries_[g * group_size + __builtin_ctz(m)];
+                if (e->key == k) {
+                    return e;
+                }
+            }
+            if (match(c, empty) != 0) {
+                return nullptr;        // k would have been placed in this group
+            }
+        }
+        return nullptr;
+    }
+
+    // insert(k, sec, args...) returns the entry for the key k, after
+    // setting its time to sec and constructing its value from args;
+    // if there was no entry for k, then one is created, possibly by
+    // reusing an expired entry or evicting the oldest one
+    //
+    template <typename... Args>
+    entry *insert(const K &k, unsigned int sec, Args&&... args) {
+        entry *e = find(k);
+        if (e == nullptr) {
+            e = new_entry(k, sec);
+        } else {
+            e->value.~T();
+        }
+        e->sec = sec;
+        new (&e->value) T{std::forward<Args>(args)...};
+        return e;
+    }
+
+    // try_emplace(k, sec, args...) returns the entry for the key k
+    // and true, if it constructed a new entry from sec and args in a
+    // free slot, or the existing entry for k and false; if there is no
+    // entry for k and no free slot in its probe sequence, it returns
+    // nullptr and false, since it never reuses or evicts an entry
+    //
+    template <typename... Args>
+    std::pair<entry *, bool> try_emplace(const K &k, unsigned int sec, Args&&... args) {
+        entry *e = find(k);
+        if (e != nullptr) {
+            return { e, false };
+        }
+        uint64_t h = hasher(k);
+        size_t g = group_of(h);
+        for (size_t i = 0; i < probe_groups; i++, g = (g + 1) & (num_groups - 1)) {
+            const uint8_t *c = &ctrl[g * group_size];
+            uint32_t free_slots = match(c, empty) | match(c, deleted);
+            if (free_slots != 0) {
+                size_t slot = g * group_size + __builtin_ctz(free_slots);
+                ctrl[slot] = tag_of(h);
+                count++;
+                e = claim(slot, k, sec);
+                e->sec = sec;
+                new (&e->value) T{std::forward<Args>(args)...};
+                return { e, true };
+            }
+        }
+        return { nullptr, false };
+    }
+
+    // erase(e) removes the entry e, which must have been returned by
+    // find() or insert()
+    //
+    void erase(entry *e) {
+        size_t slot = e - entries_;
+        if (slot_timers) {
+            timers->cancel(&slot_timers[slot]);
+        }
+        free_slot(slot);
+    }
+
+    bool erase(const K &k) {
+        entry *e = find(k);
+        if (e == nullptr) {
+            return false;
+        }
+        erase(e);
+        return true;
+    }
+
+    void clear() {
+        cancel_timers();
+        destroy_all();
+        for (size_t i = 0; i < num_groups * group_size; i++) {
+            ctrl[i] = empty;
+        }
+        count = 0;
+    }
+
+    // for_each(f) calls f(e) for each entry e in the map, in no
+    // particular order; f must not insert or erase entries
+    //
+    template <typename F>
+    void for_each(F f) {
+        for (size_t i = 0; i < num_groups * group_size; i++) {
+            if (is_live(ctrl[i])) {
+                f(entries_[i]);
+            }
+        }
+    }
+
+    size_t size() const { return count; }
+
+    size_t capacity() const { return num_groups * group_size; }
+
+    uint64_t evictions() const { return evicted; }
+
+    // expire(t, now) is called by the timer wheel when the timer t of
+    // a slot fires
+    //
+    void expire(struct wheel_timer *t, unsigned int now) override {
+        size_t slot = t - slot_timers;
+        if (ctrl[slot] == empty || ctrl[slot] == deleted) {
+            return;
+        }
+        if (is_expired(entries_[slot], now)) {
+            free_slot(slot);
+        } else {
+            timers->schedule(t, this, entries_[slot].sec + expiry);
+        }
+    }
+
+private:
+    uint8_t *ctrl;            // control bytes, group_size per group
+    entry *entries_;
+    size_t num_groups;        // a power of two
+    size_t probe_groups;
+    size_t count = 0;
+    uint64_t evicted = 0;     // live entries evicted to make room
+    unsigned int expiry;      // seconds after which an entry can be reused
+    timer_wheel *timers;      // may be nullptr
+    struct wheel_timer *slot_timers = nullptr;   // one per slot, if timers is not nullptr
+    H hasher;
+
+    static constexpr uint8_t empty   = 0x00;
+    static constexpr uint8_t deleted = 0x01;   // tags always have the high bit set
+
+    static bool is_live(uint8_t c) { return c & 0x80; }
+
+    static uint8_t tag_of(uint64_t h) {
+        return 0x80 | (h >> 57);
+    }
+
+    size_t group_of(uint64_t h) const {
+        return (h ^ (h >> 29)) & (num_groups - 1);
+    }
+
+    // match(c, b) returns a bitmask with bit i set if c[i] == b, for
+    // the group_size control bytes starting at c
+    //
+    static uint32_t match(const uint8_t *c, uint8_t b) {
+#if defined(__SSE2__)
+        __m128i group = _mm_loadu_si128((const __m128i *)c);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(b)));
+#else
+        uint32_t m = 0;
+        for (size_t i = 0; i < group_size; i++) {
+            m |= (uint32_t)(c[i] == b) << i;
+        }
+        return m;
+#endif
+    }
+
+    // age(e, sec) is the age of the entry e at time sec, which is
+    // negative if e was touched by a packet with a later timestamp
+    //
+    static int age(const entry &e, unsigned int sec) {
+        return (int)(sec - e.sec);
+    }
+
+    bool is_expired(const entry &e, unsigned int sec) const {
+        return age(e, sec) >= (int)expiry;
+    }
+
+    // new_entry(k, sec) claims a slot for the key k, which is not in
+    // the map: the first free or expired slot in the probe sequence of
+    // k, or else the slot holding its oldest entry
+    //
+    entry *new_entry(const K &k, unsigned int sec) {
+        uint64_t h = hasher(k);
+        uint8_t tag = tag_of(h);
+        size_t g = group_of(h);
+        size_t victim = SIZE_MAX;
+        for (size_t i = 0; i < probe_groups; i++, g = (g + 1) & (num_groups - 1)) {
+            const uint8_t *c = &ctrl[g * group_size];
+            uint32_t free_slots = match(c, empty) | match(c, deleted);
+            if (free_slots != 0) {
+                size_t slot = g * group_size + __builtin_ctz(free_slots);
+                ctrl[slot] = tag;
+                count++;
+                return claim(slot, k, sec);
+            }
+            for (size_t j = 0; j < group_size; j++) {
+                size_t slot = g * group_size + j;
+                if (is_expired(entries_[slot], sec)) {
+                    ctrl[slot] = tag;
+                    entries_[slot].value.~T();
+                    return claim(slot, k, sec);
+                }
+                if (victim == SIZE_MAX || age(entries_[slot], sec) > age(entries_[victim], sec)) {
+                    victim = slot;   // oldest so far
+                }
+            }
+        }
+        evicted++;
+        ctrl[victim] = tag;
+        entries_[victim].value.~T();
+        return claim(victim, k, sec);
+    }
+
+    // claim(slot, k, sec) puts the key k in slot; if the timer of the
+    // slot is still scheduled for an entry that it held before, it is
+    // left alone, since it is rescheduled when it fires
+    //
+    entry *claim(size_t slot, const K &k, unsigned int sec) {
+        entry *e = &entries_[slot];
+        e->key = k;
+        if (slot_timers && !slot_timers[slot].is_scheduled()) {
+            timers->schedule(&slot_timers[slot], this, sec + expiry);
+        }
+        return e;
+    }
+
+    void free_slot(size_t slot) {
+        uint8_t *c = &ctrl[slot & ~(group_size - 1)];
+
+        // if the group has an empty slot, no probe sequence continues
+        // past it, so the slot can be marked empty rather than deleted
+        //
+        ctrl[slot] = (match(c, empty) != 0) ? empty : deleted;
+        count--;
+        entries_[slot].value.~T();
+    }
+
+    void destroy_all() {
+        if (!std::is_trivially_destructible<T>::value) {
+            for_each([](entry &e) { e.value.~T(); });
+        }
+    }
+
+    void cancel_timers() {
+        if (slot_timers) {
+            for (size_t i = 0; i < num_groups * group_size; i++) {
+                timers->cancel(&slot_timers[i]);
+            }
+        }
+    }
+
+};
+
+#endif // FLOW_MAP_H
@@ -39,6 +39,9 @@ public:
     // extended configs
     std::string temp_proto_str;
     bool tcp_reassembly = false;          /* reassemble tcp segments      */
+    uint32_t tcp_reassembly_budget = 0;   /* max bytes reassembled per message (0 = default) */
+    size_t stats_sketch_counters = 0;     /* events tracked per stats shard (0 = exact stats) */
+    size_t analysis_cache_size = 1024;    /* analysis results cached per thread (0 = none) */
     size_t tls_fingerprint_format = 0;    // default fingerprint format
 
     void set_tls_fingerprint_format(size_t format) { tls_fingerprint_format = format; }
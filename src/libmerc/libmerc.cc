@@ -58,12 +58,27 @@ uint32_t mercury_get_version_number() {
 }
 
 const char *mercury_get_resource_version(struct mercury *mc) {
-    if (mc && mc->c) {
-        return mc->c->get_resource_version();
+    if (mc) {
+        return mc->get_resource_version();
     }
     return nullptr;
 }
 
+int mercury_reload_resources(mercury_context mc, const char *resources) {
+    if (mc == nullptr) {
+        return -1;    // error
+    }
+    try {
+        if (mc->reload_resources(resources)) {
+            return 0; // success
+        }
+    }
+    catch (std::exception &e) {
+        printf_err(log_err, "%s\n", e.what());
+    }
+    return -1;        // error
+}
+
 mercury_context mercury_init(const struct libmerc_config *vars, int verbosity) {
 
     mercury *m = nullptr;
@@ -298,6 +313,7 @@ bool mercury_write_stats_data(mercury_context mc, const char *stats_data_file_pa
         printf_err(log_err, "could not open file '%s' for writing mercury stats data\n", stats_data_file_path);
         return false;
     }
+    gzbuffer(stats_data_file, 128 * 1024);   // the stats are written in large blocks
     mc->aggregator->gzprint(stats_data_file,
                            git_commit_id,
                            git_count,
@@ -453,3 +469,26 @@ size_t get_stats_aggregator_num_entries(mercury_context mc)
 
     return mc->aggregator->get_num_entries();
 }
+
+bool mercury_packet_processor_get_stats(mercury_packet_processor processor,
+                                        struct mercury_packet_processor_stats *stats) {
+    if (processor == NULL || stats == NULL) {
+        return false;
+    }
+    const struct tcp_reassembly_stats &r = processor->reassembler.stats;
+    stats->tcp_reassembly_started = r.started;
+    stats->tcp_reassembly_completed = r.completed;
+    stats->tcp_reassembly_extended = r.extended;
+    stats->tcp_reassembly_budget_exceeded = r.budget_exceeded;
+    stats->tcp_reassembly_incomplete = r.incomplete;
+    stats->tcp_reassembly_refused = r.refused;
+    stats->tcp_reassembly_duplicates = r.duplicates;
+    stats->tcp_reassembly_in_progress = processor->reassembler.segment_table.size();
+    const struct analysis_cache_stats &a = processor->analysis_results.stats;
+    stats->analysis_cache_size = processor->analysis_results.capacity();
+    stats->analysis_cache_hits = a.hits;
+    stats->analysis_cache_misses = a.misses;
+    stats->analysis_cache_evictions = a.evictions;
+    stats->analysis_cache_invalidations = a.invalidations;
+    return true;
+}
@@ -614,6 +614,37 @@ extern "C" LIBMERC_DLL_EXPORTED
 #endif
 const char *mercury_get_resource_version(mercury_context mc);
 
+/**
+ * @brief reloads the resource archive of a mercury context
+ *
+ * Loads the resource archive (or snapshot) named by resources, or the
+ * one that the context was initialized with if resources is NULL,
+ * and then replaces the classifier of the context with the one just
+ * loaded, without interrupting the packet processors that use it.
+ * Each packet processor switches to the new classifier at the start
+ * of the next packet that it processes, and keeps all of its flow
+ * and reassembly state; the old classifier is freed once none of
+ * them is using it.  The resource version reported by
+ * mercury_get_resource_version() changes to that of the new archive.
+ *
+ * This function can be called from any thread, but not from a
+ * signal handler, and takes as long as mercury_init() takes to load
+ * the archive; if it fails (for instance, because the archive cannot
+ * be read, or uses a different tls fingerprint format), then the
+ * context keeps its current classifier.  If the context was
+ * initialized with a decryption key, the same key is used.
+ *
+ * @param mc (input) is a mercury context initialized with do_analysis
+ * @param resources (input) is the resource file to load, or NULL
+ *
+ * @return 0 on success, and -1 on failure
+ *
+ */
+#ifdef __cplusplus
+extern "C" LIBMERC_DLL_EXPORTED
+#endif
+int mercury_reload_resources(mercury_context mc, const char *resources);
+
 //
 // start of libmerc version 3 API
 //
@@ -757,4 +788,53 @@ extern "C" LIBMERC_DLL_EXPORTED
 #endif
 const struct attribute_context *mercury_packet_processor_get_attributes(mercury_packet_processor processor);
 
+
+//
+// start of libmerc version 7 API
+//
+
+/**
+ * @brief struct mercury_packet_processor_stats holds the counters of
+ * a packet processor, which count events since it was constructed.
+ *
+ * The tcp_reassembly counters describe the reassembly of messages
+ * that span several TCP segments, and are zero if reassembly is not
+ * enabled.  The analysis_cache counters describe the lookups in the
+ * cache of analysis results of the processor, and are zero if
+ * analysis or the cache is not enabled.
+ */
+struct mercury_packet_processor_stats {
+    uint64_t tcp_reassembly_started;          /* reassemblies started                                  */
+    uint64_t tcp_reassembly_completed;        /* messages reassembled and reported                     */
+    uint64_t tcp_reassembly_extended;         /* reassembled messages found incomplete, and extended   */
+    uint64_t tcp_reassembly_budget_exceeded;  /* messages reported only up to the reassembly budget    */
+    uint64_t tcp_reassembly_incomplete;       /* reassemblies that expired or were discarded           */
+    uint64_t tcp_reassembly_refused;          /* reassemblies not started, for lack of room            */
+    uint64_t tcp_reassembly_duplicates;       /* retransmitted segments of reported messages skipped  */
+    uint64_t tcp_reassembly_in_progress;      /* reassemblies not yet completed or discarded           */
+    uint64_t analysis_cache_size;             /* results that the analysis cache can hold              */
+    uint64_t analysis_cache_hits;             /* analysis results found in the cache                   */
+    uint64_t analysis_cache_misses;           /* analysis results not found in the cache               */
+    uint64_t analysis_cache_evictions;        /* cached results replaced to make room for new ones     */
+    uint64_t analysis_cache_invalidations;    /* times the cache was emptied after a classifier change */
+};
+
+/**
+ * mercury_packet_processor_get_stats() copies the counters of a
+ * packet processor into the structure pointed to by stats.  It must
+ * not be called while another thread is using the processor, and is
+ * typically called by the thread that owns the processor, just
+ * before it is destructed.
+ *
+ * @param processor (input) is a packet processor context
+ * @param stats (output) is the location to which the counters are written
+ *
+ * @return true on success, and false if either argument is NULL
+ */
+#ifdef __cplusplus
+extern "C" LIBMERC_DLL_EXPORTED
+#endif
+bool mercury_packet_processor_get_stats(mercury_packet_processor processor,
+                                        struct mercury_packet_processor_stats *stats);
+
 #endif /* LIBMERC_H */
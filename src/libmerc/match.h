@@ -52,6 +52,10 @@ public:
 
     constexpr size_t length() const { return N; }
 
+    const uint8_t *get_mask() const { return mask; }
+
+    const uint8_t *get_value() const { return value; }
+
     static unsigned int u32_compare_masked_data_to_value(const void *data_in,
                                                          const void *mask_in,
                                                          const void *value_in) {
@@ -107,6 +111,8 @@ public:
         return mask_and_value<N>::matches(data+offset);
     }
 
+    size_t get_offset() const { return offset; }
+
 };
 
 #endif /* MATCH_H */
@@ -106,67 +106,43 @@ struct do_crypto_assessment {
 
 };
 
-class event_string
-{
-    const struct key &k;
-    const struct analysis_context &analysis;
-    std::string dest_context;
-    event_msg event;
-
-public:
-    event_string(const struct key &k, const struct analysis_context &analysis) :
-        k{k}, analysis{analysis} {  }
-
-    event_msg construct_event_string() {
-        char src_ip_str[MAX_ADDR_STR_LEN];
-        k.sprint_src_addr(src_ip_str);
-        char dst_port_str[MAX_PORT_STR_LEN];
-        k.sprint_dst_port(dst_port_str);
-
-        dest_context.append("(");
-        dest_context.append(analysis.destination.sn_str).append(")(");
-        dest_context.append(analysis.destination.dst_ip_str).append(")(");
-        dest_context.append(dst_port_str).append(")");
-
-        event = std::make_tuple(src_ip_str, analysis.fp.string(), analysis.destination.ua_str, dest_context);
-        return event;
-    }
-};
-
 struct do_observation {
     const struct key &k_;
     struct analysis_context &analysis_;
-    class message_queue *mq_;
+    class stats_shard *shard_;
 
     do_observation(const struct key &k,
                    struct analysis_context &analysis,
-                   class message_queue *mq) :
+                   class stats_shard *shard) :
         k_{k},
         analysis_{analysis},
-        mq_{mq}
+        shard_{shard}
     {}
 
     void operator()(tls_client_hello &) {
-        event_string ev_str{k_, analysis_};
-        mq_->push(ev_str.construct_event_string());
+        // count event in the stats shard of this processor
+        observe();
     }
 
     void operator()(quic_init &) {
-        // create event and send it to the data/stats aggregator
-        event_string ev_str{k_, analysis_};
-        mq_->push(ev_str.construct_event_string());
+        // count event in the stats shard of this processor
+        observe();
     }
 
     void operator()(http_request &) {
-        // create event and send it to the data/stats aggregator
-        event_string ev_str{k_, analysis_};
-        mq_->push(ev_str.construct_event_string());
+        // count event in the stats shard of this processor
+        observe();
         analysis_.reset_user_agent();
     }
 
     template <typename T>
     void operator()(T &) { }
 
+private:
+    void observe() {
+        shard_->observe(k_, analysis_.fp.string(), analysis_.destination.ua_str, analysis_.destination.sn_str);
+    }
+
 };
 
 // set_tcp_protocol() sets the protocol variant record to the data
@@ -210,7 +186,7 @@ void stateful_pkt_proc::set_tcp_protocol(protocol &x,
         }
     case tcp_msg_type_tls_server_hello:
     case tcp_msg_type_tls_certificate:
-        x.emplace<tls_server_hello_and_certificate>(pkt, tcp_pkt);
+        x.emplace<tls_server_hello_and_certificate>(pkt, tcp_pkt, tls_stream);
         break;
     case tcp_msg_type_ssh:
         x.emplace<ssh_init_packet>(pkt);
@@ -441,6 +417,14 @@ bool stateful_pkt_proc::process_tcp_data (protocol &x,
         }
     }
     else {
+        // skip retransmissions of messages that have already been
+        // reassembled and reported
+        //
+        if (reassembler->is_duplicate(k, ts->tv_sec, seg_context.seq)) {
+            reassembler->dump_pkt = false;
+            return false;
+        }
+
         // check in reassembly_table
         //if initial segment, update additional bytes needed
         //
@@ -485,9 +469,21 @@ bool stateful_pkt_proc::process_tcp_data (protocol &x,
                 reassembler->dump_pkt = true;
             }
             
-            if(seg->done) {
+            while (seg->done) {
                 struct datum reassembled_data = seg->get_reassembled_segment();
+                tcp_pkt.additional_bytes_needed = 0;
                 set_tcp_protocol(x, reassembled_data, true, &tcp_pkt);
+                if (tcp_pkt.additional_bytes_needed && reassembler->extend(*seg, tcp_pkt.additional_bytes_needed)) {
+                    // the reassembled message is incomplete, as happens when
+                    // it spans records whose headers were not seen before;
+                    // the extension may already have been received
+                    //
+                    x = std::monostate{};
+                    tcp_pkt.additional_bytes_needed = 0;
+                    continue;
+                }
+                tcp_pkt.additional_bytes_needed = 0;
+                reassembler->complete(k, ts->tv_sec, *seg);
                 reassembler->dump_pkt = false;
                 reassembler->curr_reassembly_consumed = true;
                 reassembler->curr_reassembly_state = reassembly_done;
@@ -523,6 +519,9 @@ size_t stateful_pkt_proc::ip_write_json(void *buffer,
                                         struct timespec *ts,
                                         struct tcp_reassembler *reassembler) {
 
+    timers.advance(ts->tv_sec);   // expire flows and segments in packet time
+    refresh_classifier();        // pick up a reloaded classifier, if any
+
     struct buffer_stream buf{(char *)buffer, buffer_size};
     struct key k;
     struct datum pkt{ip_packet, ip_packet+length};
@@ -639,8 +638,8 @@ size_t stateful_pkt_proc::ip_write_json(void *buffer,
 
             // analysis_.destination
             //
-            if (mq) {
-                std::visit(do_observation{k, analysis, mq}, x);
+            if (shard) {
+                std::visit(do_observation{k, analysis, shard}, x);
             }
         }
 
@@ -667,7 +666,7 @@ size_t stateful_pkt_proc::ip_write_json(void *buffer,
         else if (reassembler && reassembler->curr_reassembly_state != reassembly_status::reassembly_none) {
             reassembler->write_flags(record, "reassembly_properties");
             if (reassembler->curr_reassembly_consumed == true) {
-                reassembler->remove_segment(reassembler->reap_it);
+                reassembler->remove_segment(k);
                 reassembler->curr_reassembly_consumed = false;
             }
         }
@@ -794,6 +793,8 @@ bool stateful_pkt_proc::analyze_ip_packet(const uint8_t *packet,
                                               struct timespec *ts,
                                           struct tcp_reassembler *reassembler) {
 
+    timers.advance(ts->tv_sec);   // expire flows and segments in packet time
+    refresh_classifier();        // pick up a reloaded classifier, if any
 
     struct datum pkt{packet, packet+length};
     struct key k;
@@ -862,13 +863,13 @@ bool stateful_pkt_proc::analyze_ip_packet(const uint8_t *packet,
             // configured, because we rely on do_analysis to set the
             // analysis_.destination
             //
-            if (mq) {
-                std::visit(do_observation{k, analysis, mq}, x);
+            if (shard) {
+                std::visit(do_observation{k, analysis, shard}, x);
             }
 
             if (reassembler) {
                 if (reassembler->curr_reassembly_consumed == true) {
-                    reassembler->remove_segment(reassembler->reap_it);
+                    reassembler->remove_segment(reassembler->curr_entry);
                     reassembler->curr_reassembly_consumed = false;
                     analysis.flow_state_pkts_needed = false;
                 }
@@ -880,7 +881,7 @@ bool stateful_pkt_proc::analyze_ip_packet(const uint8_t *packet,
 
     if (reassembler) {
         if (reassembler->curr_reassembly_consumed == true) {
-            reassembler->remove_segment(reassembler->reap_it);
+            reassembler->remove_segment(reassembler->curr_entry);
             reassembler->curr_reassembly_consumed = false;
             analysis.flow_state_pkts_needed = false;
         }
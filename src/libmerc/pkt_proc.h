@@ -13,6 +13,10 @@
 #include <sys/time.h>
 #include <stdexcept>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <list>
+#include <string>
 #include "tcp.h"
 #include "flow_key.h"
 #include "analysis.h"
@@ -24,6 +28,7 @@
 #include "perfect_hash.h"
 #include "crypto_assess.h"
 #include "pkt_proc_util.h"
+#include "epoch_ptr.h"
 
 /**
  * enum linktype is a 16-bit enumeration that identifies a protocol
@@ -44,67 +49,152 @@ enum linktype : uint16_t {
  * struct mercury holds state that is used by one or more
  * mercury_packet_processor
  *
+ * The classifier can be replaced while packets are being processed,
+ * by reload_resources(); each packet processor picks up the newest
+ * classifier at the start of each packet, through its
+ * epoch_ptr<classifier>::reader, and a classifier that has been
+ * replaced is deleted once no packet processor is using it.
+ *
  */
 struct mercury {
     struct global_config global_vars;
     std::unique_ptr<data_aggregator> aggregator{nullptr};
-    classifier *c;
+    epoch_ptr<classifier> c;
     class traffic_selector selector;
+    int verbosity;
 
-    mercury(const struct libmerc_config *vars, int verbosity) : global_vars{*vars}, aggregator{ global_vars.do_stats? (std::make_unique<data_aggregator>(global_vars.max_stats_entries)) : nullptr}, c{nullptr}, selector{global_vars.protocols} {
+    mercury(const struct libmerc_config *vars, int verbosity) : global_vars{*vars}, aggregator{ global_vars.do_stats? (std::make_unique<data_aggregator>(global_vars.max_stats_entries, global_vars.stats_sketch_counters)) : nullptr}, c{nullptr}, selector{global_vars.protocols}, verbosity{verbosity} {
         if (global_vars.do_analysis) {
-            c = analysis_init_from_archive(verbosity, global_vars.get_resource_file(),
-                                           vars->enc_key, vars->key_type,
-                                           global_vars.fp_proc_threshold,
-                                           global_vars.proc_dst_threshold,
-                                           global_vars.report_os);
-            if (c == nullptr) {
+
+            // keep a copy of the decryption key, if any, for use by
+            // reload_resources()
+            //
+            if (global_vars.enc_key != nullptr) {
+                memcpy(enc_key, global_vars.enc_key, global_vars.key_type == enc_key_type_aes_256 ? sizeof(enc_key) : 16);
+                global_vars.enc_key = enc_key;
+            }
+
+            classifier *tmp = load_classifier(global_vars.get_resource_file());
+            if (tmp == nullptr) {
                 throw std::runtime_error("error: analysis_init_from_archive() failed"); // failure
             }
+            c.replace(tmp);
 
             // set fingerprint formats to match those in the resource file
             //
-            size_t resources_tls_format = c->get_tls_fingerprint_format();
+            size_t resources_tls_format = tmp->get_tls_fingerprint_format();
             global_vars.set_tls_fingerprint_format(resources_tls_format);
             printf_err(log_info, "setting tls fingerprint format to match resource file (format: %zu)\n", resources_tls_format);
+            add_resource_version(tmp->get_resource_version());
         }
     }
 
+    // reload_resources(resource_file) replaces the classifier with one
+    // loaded from resource_file, or from the resource file that this
+    // context was initialized with if resource_file is nullptr, and
+    // returns true on success.  The new resources must use the same
+    // tls fingerprint format as the old ones, since the packet
+    // processors compute fingerprints in that format.
+    //
+    bool reload_resources(const char *resource_file) {
+        if (!global_vars.do_analysis) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock{reload_mutex};
+        if (resource_file == nullptr) {
+            resource_file = global_vars.get_resource_file();
+        }
+        classifier *tmp = load_classifier(resource_file);
+        if (tmp == nullptr) {
+            return false;
+        }
+        if (tmp->get_tls_fingerprint_format() != global_vars.tls_fingerprint_format) {
+            printf_err(log_err, "resource file %s has tls fingerprint format %zu, but format %zu is in use; not reloading\n",
+                       resource_file, tmp->get_tls_fingerprint_format(), global_vars.tls_fingerprint_format);
+            analysis_finalize(tmp);
+            return false;
+        }
+        const char *prev_version = get_resource_version();
+        add_resource_version(tmp->get_resource_version());
+        c.replace(tmp);
+        printf_err(log_notice, "reloaded resource file %s; resource version changed from '%s' to '%s'\n",
+                   resource_file, prev_version, get_resource_version());
+        return true;
+    }
+
+    // get_resource_version() returns the VERSION of the newest
+    // resources; it can be called while they are being reloaded, and
+    // the string that it returns lasts as long as this context
+    //
+    const char *get_resource_version() const {
+        return resource_version.load(std::memory_order_acquire);
+    }
+
     ~mercury() {
-        analysis_finalize(c);
+        volatile uint8_t *p = enc_key;
+        for (size_t i = 0; i < sizeof(enc_key); i++) {
+            p[i] = 0;
+        }
+    }
+
+private:
+    uint8_t enc_key[32] = { 0, };
+    std::mutex reload_mutex;                    // serializes reload_resources()
+    std::list<std::string> resource_versions;   // each version loaded, which never move
+    std::atomic<const char *> resource_version{nullptr};
+
+    classifier *load_classifier(const char *resource_file) {
+        return analysis_init_from_archive(verbosity, resource_file,
+                                          global_vars.enc_key, global_vars.key_type,
+                                          global_vars.fp_proc_threshold,
+                                          global_vars.proc_dst_threshold,
+                                          global_vars.report_os);
+    }
+
+    void add_resource_version(const char *version) {
+        resource_versions.emplace_back(version);
+        resource_version.store(resource_versions.back().c_str(), std::memory_order_release);
     }
 };
 
 struct stateful_pkt_proc {
+    timer_wheel timers;   // expires the entries of the tables below; constructed first
     struct flow_table ip_flow_table;
     struct flow_table_tcp tcp_flow_table;
     struct tcp_reassembler reassembler;
     struct tcp_reassembler *reassembler_ptr;
     struct tcp_initial_message_filter tcp_init_msg_filter;
     struct analysis_context analysis;
-    class message_queue *mq;
+    class stats_shard *shard;
     mercury_context m;
-    classifier *c;        // TODO: change to reference
+    epoch_ptr<classifier>::reader classifier_reader;
+    classifier *c;        // the newest classifier, as of the current packet
     data_aggregator *ag;
     global_config global_vars;
     class traffic_selector &selector;
     quic_crypto_engine quic_crypto;
+    tls_handshake_stream tls_stream;
+    class analysis_cache analysis_results;
     crypto_policy::assessor *crypto_policy = nullptr;
 
     explicit stateful_pkt_proc(mercury_context mc, size_t prealloc_size=0) :
-        ip_flow_table{prealloc_size},
-        tcp_flow_table{prealloc_size},
-        reassembler{prealloc_size},
+        timers{},
+        ip_flow_table{prealloc_size, timers},
+        tcp_flow_table{prealloc_size, timers},
+        reassembler{prealloc_size, timers},
         reassembler_ptr{&reassembler},
-        tcp_init_msg_filter{},
+        tcp_init_msg_filter{prealloc_size, timers},
         analysis{},
-        mq{nullptr},
+        shard{nullptr},
         m{mc},
-        c{nullptr},
+        classifier_reader{mc->c},
+        c{classifier_reader.get()},
         ag{nullptr},
         global_vars{mc->global_vars},
         selector{mc->selector},
-        quic_crypto{}
+        quic_crypto{},
+        tls_stream{},
+        analysis_results{mc->global_vars.do_analysis ? mc->global_vars.analysis_cache_size : 0}
     {
 
         constexpr bool DO_CRYPTO_ASSESSMENT = false;
@@ -115,26 +205,24 @@ struct stateful_pkt_proc {
 
         // set config and classifier to (refer to) context m
         //
-        if (m->c == nullptr && m->global_vars.do_analysis) {
+        if (c == nullptr && m->global_vars.do_analysis) {
             throw std::runtime_error("error: classifier pointer is null");
         }
-        this->c = m->c;
         this->global_vars = m->global_vars;
-
-        //fprintf(stderr, "note: setting classifier to %p, setting global_vars to %p\n", (void *)m->c, (void *)&m->global_vars));
-        // }
+        analysis.cache = &analysis_results;
 
         if (global_vars.do_stats) {
             ag = m->aggregator.get();
-            mq = ag->add_producer();
-            if (mq == nullptr) {
-                throw std::runtime_error("error: could not initialize event queue");
+            shard = ag->add_producer();
+            if (shard == nullptr) {
+                throw std::runtime_error("error: could not initialize stats shard");
             }
         }
 
         if (!global_vars.tcp_reassembly) {
             reassembler_ptr = nullptr;
         }
+        reassembler.set_budget(global_vars.tcp_reassembly_budget);
 
 //#ifndef USE_TCP_REASSEMBLY
 // #pragma message "omitting tcp reassembly; 'make clean' and recompile with OPTFLAGS=-DUSE_TCP_REASSEMBLY to use that option"
@@ -147,7 +235,17 @@ struct stateful_pkt_proc {
 
     ~stateful_pkt_proc() {
         delete crypto_policy;
-        // we could call ag->remote_procuder(mq), but for now we do not
+        if (ag) {
+            ag->remove_producer(shard);   // its events are written by the next stats dump
+        }
+    }
+
+    // refresh_classifier() is called at the start of each packet,
+    // when nothing refers to the classifier used for the previous
+    // one, to pick up the newest classifier
+    //
+    void refresh_classifier() {
+        c = classifier_reader.refresh();
     }
 
     // TODO: the count_all() functions should probably be removed
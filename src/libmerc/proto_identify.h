@@ -114,6 +114,10 @@ public:
         matchers_and_offset.push_back(new_proto);
     }
 
+    const std::vector<matcher_and_type<N>> &get_matchers() const { return matchers; }
+
+    const std::vector<matcher_type_and_offset<N>> &get_matchers_and_offset() const { return matchers_and_offset; }
+
     void compile() {
         // this function is a placeholder for now, but in the future,
         // it may compile a jump table, reorder matchers, etc.
@@ -232,6 +236,17 @@ public:
 
     bool openvpn_tcp() const { return select_openvpn_tcp; }
 
+    // the protocol identifiers are exposed so that the selection can
+    // be compiled into a socket filter (see socket_filter.h)
+    //
+    const protocol_identifier<4> &tcp4_identifier() const { return tcp4; }
+
+    const protocol_identifier<8> &tcp_identifier() const { return tcp; }
+
+    const protocol_identifier<8> &udp_identifier() const { return udp; }
+
+    const protocol_identifier<16> &udp16_identifier() const { return udp16; }
+
     traffic_selector(std::map<std::string, bool> protocols) :
             tcp{},
             udp{},
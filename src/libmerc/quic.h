@@ -1416,7 +1416,7 @@ public:
 
         analysis_.destination.init(sn, user_agent, alpn, k_);
 
-        return c_->analyze_fingerprint_and_destination_context(analysis_.fp, analysis_.destination, analysis_.result);
+        return c_->analyze_fingerprint_and_destination_context(analysis_.fp, analysis_.destination, analysis_.result, analysis_.cache);
     }
 };
 
@@ -1557,7 +1557,7 @@ public:
 
         analysis_.destination.init(sn, user_agent, alpn, k_);
 
-        return c_->analyze_fingerprint_and_destination_context(analysis_.fp, analysis_.destination, analysis_.result);
+        return c_->analyze_fingerprint_and_destination_context(analysis_.fp, analysis_.destination, analysis_.result, analysis_.cache);
     }
 };
 
@@ -0,0 +1,301 @@
+// resource_snapshot.h
+//
+// precompiled, memory-mapped snapshots of resource archives
+//
+// Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.
+// License at https://github.com/cisco/mercury/blob/master/LICENSE
+
+#ifndef RESOURCE_SNAPSHOT_H
+#define RESOURCE_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "archive.h"
+
+// A resource snapshot holds the regular files of a resource archive,
+// decrypted and decompressed, in a flat image that can be mapped into
+// memory read-only, so that loading resources does not decrypt or
+// inflate anything, and the processes that map the same snapshot
+// share its pages.  A snapshot is written with `archive_reader
+// --snapshot`, and analysis_init_from_archive() reads one in place of
+// an archive whenever the resource file starts with the snapshot
+// magic.
+//
+// A snapshot is neither encrypted nor authenticated; the checksum
+// only detects corruption.  So a snapshot is only written from an
+// archive that is not encrypted, and it is rejected when a decryption
+// key is configured, since that key signals that the resources must
+// not be stored or accepted in the clear.
+//
+// The image is laid out as
+//
+//    snapshot_header
+//    snapshot_entry[num_entries]
+//    contents of the entries
+//
+// where each entry gives the offset (from the start of the image) and
+// length of its contents; the checksum is the CRC-32 of everything
+// after the header.  A snapshot is written in the byte order of the
+// host that writes it, which the byte_order field identifies.
+//
+struct snapshot_header {
+    char magic[8];
+    uint32_t byte_order;        // snapshot_header::byte_order_mark, as written
+    uint32_t format_version;
+    uint32_t num_entries;
+    uint32_t checksum;
+    uint64_t image_length;      // total length, including this header
+
+    static constexpr char magic_value[8] = { 'M', 'E', 'R', 'C', 'S', 'N', 'A', 'P' };
+    static constexpr uint32_t byte_order_mark = 0x01020304;
+    static constexpr uint32_t current_format_version = 1;
+
+    bool has_magic() const {
+        return memcmp(magic, magic_value, sizeof(magic)) == 0;
+    }
+};
+
+// struct snapshot_entry provides the subset of the archive_node
+// interface that the classifier uses to walk an archive
+//
+struct snapshot_entry {
+    char name[112];             // null terminated; longer than any tar name
+    uint64_t offset;
+    uint64_t length;
+
+    const char *get_name() const { return name; }
+
+    size_t get_size() const { return length; }
+
+    bool is_regular_file() const { return true; }  // only regular files are kept
+
+    bool is_directory() const { return false; }
+};
+
+static_assert(sizeof(snapshot_header) == 32, "unexpected snapshot_header size");
+static_assert(sizeof(snapshot_entry) == 128, "unexpected snapshot_entry size");
+
+// class resource_snapshot reads a snapshot through the same
+// get_next_entry(), getline(), and read() interface as
+// encrypted_compressed_archive
+//
+class resource_snapshot {
+    const uint8_t *image = nullptr;
+    size_t image_length = 0;
+    const struct snapshot_entry *entries = nullptr;
+    uint32_t num_entries = 0;
+    uint32_t next = 0;
+    const char *line = nullptr;       // the unread part of the current entry
+    const char *line_end = nullptr;
+
+public:
+
+    // resource_snapshot(filename) maps the snapshot in filename; if
+    // it is missing, truncated, or does not match its checksum, then
+    // std::runtime_error is thrown
+    //
+    explicit resource_snapshot(const char *filename) {
+        int fd = open(filename, O_RDONLY);
+        if (fd < 0) {
+            printf_err(log_err, "could not open resource snapshot %s\n", filename);
+            throw std::runtime_error("could not open resource snapshot");
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct snapshot_header)) {
+            close(fd);
+            printf_err(log_err, "resource snapshot %s is truncated\n", filename);
+            throw std::runtime_error("resource snapshot is truncated");
+        }
+        image_length = st.st_size;
+        void *m = mmap(nullptr, image_length, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (m == MAP_FAILED) {
+            printf_err(log_err, "could not map resource snapshot %s\n", filename);
+            throw std::runtime_error("could not map resource snapshot");
+        }
+        image = (const uint8_t *)m;
+
+        const char *error = validate();
+        if (error) {
+            munmap((void *)image, image_length);
+            printf_err(log_err, "resource snapshot %s %s\n", filename, error);
+            throw std::runtime_error("invalid resource snapshot");
+        }
+        madvise((void *)image, image_length, MADV_SEQUENTIAL);
+    }
+
+    ~resource_snapshot() {
+        munmap((void *)image, image_length);
+    }
+
+    resource_snapshot(const resource_snapshot &) = delete;
+    resource_snapshot &operator=(const resource_snapshot &) = delete;
+
+    const struct snapshot_header &header() const {
+        return *(const struct snapshot_header *)image;
+    }
+
+    const struct snapshot_entry *get_next_entry() {
+        if (next == num_entries) {
+            return nullptr;
+        }
+        const struct snapshot_entry *e = &entries[next++];
+        line = (const char *)image + e->offset;
+        line_end = line + e->length;
+        return e;
+    }
+
+    // getline(s) sets s to the next line of the current entry, without
+    // its terminating newline, and returns its length, which is zero
+    // at the end of the entry
+    //
+    ssize_t getline(std::string &s) {
+        if (line == line_end) {
+            s.clear();
+            return 0;
+        }
+        const char *nl = (const char *)memchr(line, '\n', line_end - line);
+        const char *end = nl ? nl : line_end;
+        s.assign(line, end - line);
+        line = nl ? nl + 1 : line_end;
+        return s.length();
+    }
+
+    // read(buffer, len) reads up to len bytes of the current entry,
+    // and returns the number of bytes read
+    //
+    ssize_t read(uint8_t *buffer, size_t len) {
+        if (len > (size_t)(line_end - line)) {
+            len = line_end - line;
+        }
+        memcpy(buffer, line, len);
+        line += len;
+        return len;
+    }
+
+    // is_snapshot(filename) returns true if filename starts with the
+    // snapshot magic, so that it should be read as a snapshot rather
+    // than as an archive
+    //
+    static bool is_snapshot(const char *filename) {
+        char magic[sizeof(snapshot_header::magic)];
+        FILE *f = fopen(filename, "r");
+        if (f == nullptr) {
+            return false;
+        }
+        size_t n = fread(magic, 1, sizeof(magic), f);
+        fclose(f);
+        return n == sizeof(magic) && memcmp(magic, snapshot_header::magic_value, sizeof(magic)) == 0;
+    }
+
+    // write(archive, f) writes a snapshot of the regular files in
+    // archive to the file f, and returns true on success
+    //
+    static bool write(class encrypted_compressed_archive &archive, FILE *f) {
+        std::vector<struct snapshot_entry> table;
+        std::string contents;
+        for (const class archive_node *e = archive.get_next_entry(); e != nullptr; e = archive.get_next_entry()) {
+            if (!e->is_regular_file()) {
+                continue;
+            }
+            struct snapshot_entry entry{};
+            const char *name = e->get_name();
+            memcpy(entry.name, name, strnlen(name, archive_name_length));  // tar names need not be null terminated
+            entry.offset = contents.length();
+            entry.length = e->get_size();
+            contents.resize(entry.offset + entry.length);
+            if (archive.read((uint8_t *)&contents[entry.offset], entry.length) != (ssize_t)entry.length) {
+                printf_err(log_err, "could not read archive entry %s\n", entry.name);
+                return false;
+            }
+            table.push_back(entry);
+        }
+        if (table.empty()) {
+            return false;
+        }
+
+        uint64_t contents_offset = sizeof(struct snapshot_header) + table.size() * sizeof(struct snapshot_entry);
+        for (auto &entry : table) {
+            entry.offset += contents_offset;
+        }
+        struct snapshot_header hdr{};
+        memcpy(hdr.magic, snapshot_header::magic_value, sizeof(hdr.magic));
+        hdr.byte_order = snapshot_header::byte_order_mark;
+        hdr.format_version = snapshot_header::current_format_version;
+        hdr.num_entries = table.size();
+        hdr.image_length = contents_offset + contents.length();
+        uLong crc = crc32(0, (const Bytef *)table.data(), table.size() * sizeof(struct snapshot_entry));
+        hdr.checksum = checksum(crc, (const uint8_t *)contents.data(), contents.length());
+
+        return fwrite(&hdr, sizeof(hdr), 1, f) == 1
+            && fwrite(table.data(), sizeof(struct snapshot_entry), table.size(), f) == table.size()
+            && fwrite(contents.data(), 1, contents.length(), f) == contents.length();
+    }
+
+private:
+
+    static constexpr size_t archive_name_length = 100;
+
+    // checksum(crc, data, length) continues the CRC-32 crc over data,
+    // which may be longer than zlib's uInt
+    //
+    static uint32_t checksum(uLong crc, const uint8_t *data, size_t length) {
+        constexpr size_t chunk = 1 << 30;
+        while (length > 0) {
+            size_t n = length < chunk ? length : chunk;
+            crc = crc32(crc, data, n);
+            data += n;
+            length -= n;
+        }
+        return crc;
+    }
+
+    // validate() returns nullptr if the image is a well-formed snapshot
+    // that matches its checksum, and a description of the problem
+    // otherwise
+    //
+    const char *validate() {
+        const struct snapshot_header &hdr = header();
+        if (!hdr.has_magic()) {
+            return "has no snapshot magic";
+        }
+        if (hdr.byte_order != snapshot_header::byte_order_mark) {
+            return "was written on a host with a different byte order";
+        }
+        if (hdr.format_version != snapshot_header::current_format_version) {
+            return "has an unsupported format version";
+        }
+        size_t table_end = sizeof(struct snapshot_header) + (size_t)hdr.num_entries * sizeof(struct snapshot_entry);
+        if (hdr.image_length != image_length || table_end > image_length) {
+            return "is truncated";
+        }
+        if (checksum(0, image + sizeof(struct snapshot_header), image_length - sizeof(struct snapshot_header)) != hdr.checksum) {
+            return "does not match its checksum";
+        }
+        entries = (const struct snapshot_entry *)(image + sizeof(struct snapshot_header));
+        num_entries = hdr.num_entries;
+        for (uint32_t i = 0; i < num_entries; i++) {
+            const struct snapshot_entry &e = entries[i];
+            if (e.offset < table_end || e.offset > image_length || e.length > image_length - e.offset
+                || memchr(e.name, '\0', sizeof(e.name)) == nullptr) {
+                return "has a malformed entry";
+            }
+        }
+        return nullptr;
+    }
+
+};
+
+#endif // RESOURCE_SNAPSHOT_H
@@ -297,13 +297,16 @@ struct destination_context {
 
 };
 
+class analysis_cache;
+
 struct analysis_context {
     fingerprint fp;
     struct destination_context destination;
     struct analysis_result result;
     bool flow_state_pkts_needed;
+    class analysis_cache *cache;    // results of earlier analyses, if not nullptr
 
-    analysis_context() : fp{}, destination{}, result{}, flow_state_pkts_needed{false} {}
+    analysis_context() : fp{}, destination{}, result{}, flow_state_pkts_needed{false}, cache{nullptr} {}
     // could add structs needed for 'scratchwork'
 
     const char *get_server_name() const {
@@ -0,0 +1,362 @@
+/*
+ * socket_filter.h
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+/**
+ * \file socket_filter.h
+ *
+ * \brief Compilation of a traffic_selector into a socket filter
+ */
+
+#ifndef SOCKET_FILTER_H
+#define SOCKET_FILTER_H
+
+#include <stdint.h>
+#include <linux/filter.h>
+
+#include <vector>
+#include <stdexcept>
+#include "eth.h"
+#include "ip.h"
+#include "proto_identify.h"
+#include "global_config.h"
+
+// class socket_filter compiles the protocol selection of a
+// traffic_selector into a classic BPF program that can be attached
+// to an AF_PACKET socket with SO_ATTACH_FILTER, so that packets that
+// mercury would ignore are dropped in the kernel, before they are
+// copied into the ring.
+//
+// The filter is conservative: it only drops IPv4 and IPv6 TCP and UDP
+// packets that could not produce any output, and passes everything
+// else (non-IP frames, fragments, IPv6 extension headers, and other
+// transport protocols, including tunnels).  TCP packets with the SYN,
+// FIN, or RST flag are always passed, because they update the flow
+// tables, and TCP acknowledgements without data are always dropped.
+// A TCP or UDP data field is passed if it matches one of the
+// selector's mask_and_value matchers, or if the packet has one of the
+// ports that the selector recognizes.
+//
+// TCP reassembly and --nonselected-tcp-data need data segments that
+// cannot be recognized without per-flow state, so in those cases all
+// TCP data is passed; likewise for UDP with --nonselected-udp-data.
+// A classic BPF program has no per-flow state, so these modes are not
+// restricted further; passes_all_tcp_data() and passes_all_udp_data()
+// report them, so that the caller can tell the user.  The unit test
+// socket_filter_test.cc checks that the filter passes every packet
+// that libmerc writes a record for.
+//
+class socket_filter {
+    std::vector<struct sock_filter> insns;
+    std::vector<size_t> labels;
+
+    enum class field { jt, jf, ja };
+    struct fixup {
+        size_t insn;
+        int label;
+        field f;
+    };
+    std::vector<fixup> fixups;
+
+    bool all_tcp_data;
+    bool all_udp_data;
+
+    static constexpr uint32_t accept = 0xffffffff;  // pass the entire packet
+    static constexpr uint32_t drop = 0;
+
+    static constexpr int next = -1;                 // jump target: the following instruction
+
+    // scratch memory locations
+    //
+    enum scratch : uint32_t {
+        l4_offset   = 0,    // offset of the TCP or UDP header
+        l4_length   = 1,    // length of the TCP or UDP header and data
+        data_offset = 2,    // offset of the TCP or UDP data field
+        data_length = 3,    // length of the TCP or UDP data field
+        protocol    = 4,    // IP protocol number or IPv6 next header
+        tmp         = 5,
+    };
+
+    void emit(uint16_t code, uint32_t k) {
+        struct sock_filter insn = BPF_STMT(code, k);
+        insns.push_back(insn);
+    }
+
+    int new_label() {
+        labels.push_back(0);
+        return labels.size() - 1;
+    }
+
+    void bind(int label) { labels[label] = insns.size(); }
+
+    // jump() emits a conditional jump that compares the accumulator
+    // to k; either target can be a label or next
+    //
+    void jump(uint16_t op, uint32_t k, int jt, int jf) {
+        struct sock_filter insn = BPF_JUMP(BPF_JMP | op | BPF_K, k, 0, 0);
+        insns.push_back(insn);
+        if (jt != next) {
+            fixups.push_back({insns.size() - 1, jt, field::jt});
+        }
+        if (jf != next) {
+            fixups.push_back({insns.size() - 1, jf, field::jf});
+        }
+    }
+
+    void jump_always(int label) {
+        struct sock_filter insn = BPF_JUMP(BPF_JMP | BPF_JA, 0, 0, 0);
+        insns.push_back(insn);
+        fixups.push_back({insns.size() - 1, label, field::ja});
+    }
+
+    // return_if() emits instructions that return ret if the
+    // comparison of the accumulator to k holds
+    //
+    void return_if(uint16_t op, uint32_t k, uint32_t ret) {
+        struct sock_filter insn = BPF_JUMP(BPF_JMP | op | BPF_K, k, 0, 1);
+        insns.push_back(insn);
+        emit(BPF_RET | BPF_K, ret);
+    }
+
+    void accept_if(uint16_t op, uint32_t k) { return_if(op, k, accept); }
+
+    // accept_if_port() emits instructions that pass the packet if its
+    // source or destination port is port
+    //
+    void accept_if_port(uint16_t port) {
+        emit(BPF_LDX | BPF_W | BPF_MEM, l4_offset);
+        emit(BPF_LD | BPF_H | BPF_IND, 0);
+        accept_if(BPF_JEQ, port);
+        emit(BPF_LD | BPF_H | BPF_IND, 2);
+        accept_if(BPF_JEQ, port);
+    }
+
+    static uint32_t read_u32(const uint8_t *p) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    // accept_if_match() emits instructions that pass the packet if
+    // its data field matches mv at the given offset, one 32-bit word
+    // at a time
+    //
+    template <size_t N>
+    void accept_if_match(const mask_and_value<N> &mv, size_t offset=0) {
+        static_assert(N % 4 == 0, "matcher length must be a multiple of four");
+        uint32_t mask[N/4];
+        uint32_t value[N/4];
+        for (size_t i = 0; i < N/4; i++) {
+            mask[i] = read_u32(mv.get_mask() + 4*i);
+            value[i] = read_u32(mv.get_value() + 4*i);
+            if (value[i] & ~mask[i]) {
+                return;    // matcher can never match
+            }
+        }
+
+        int no_match = new_label();
+        emit(BPF_LD | BPF_W | BPF_MEM, data_length);
+        jump(BPF_JGE, offset + N, next, no_match);
+        emit(BPF_LDX | BPF_W | BPF_MEM, data_offset);
+        for (size_t i = 0; i < N/4; i++) {
+            if (mask[i] == 0) {
+                continue;
+            }
+            emit(BPF_LD | BPF_W | BPF_IND, offset + 4*i);
+            if (mask[i] != 0xffffffff) {
+                emit(BPF_ALU | BPF_AND | BPF_K, mask[i]);
+            }
+            jump(BPF_JEQ, value[i], next, no_match);
+        }
+        emit(BPF_RET | BPF_K, accept);
+        bind(no_match);
+    }
+
+    template <size_t N>
+    void accept_if_match(const protocol_identifier<N> &identifier) {
+        for (const auto &m : identifier.get_matchers()) {
+            accept_if_match(m.mv);
+        }
+        for (const auto &m : identifier.get_matchers_and_offset()) {
+            accept_if_match(m.mv, m.mv.get_offset());
+        }
+    }
+
+    // set_data_field() computes the offset and length of the TCP or
+    // UDP data field from the header length in the accumulator
+    //
+    void set_data_field() {
+        emit(BPF_ST, tmp);
+        emit(BPF_LDX | BPF_W | BPF_MEM, l4_offset);
+        emit(BPF_ALU | BPF_ADD | BPF_X, 0);
+        emit(BPF_ST, data_offset);
+        emit(BPF_LD | BPF_W | BPF_MEM, l4_length);
+        emit(BPF_LDX | BPF_W | BPF_MEM, tmp);
+        emit(BPF_ALU | BPF_SUB | BPF_X, 0);
+        emit(BPF_ST, data_length);
+    }
+
+    void resolve_jumps() {
+        for (const auto &f : fixups) {
+            size_t offset = labels[f.label] - (f.insn + 1);
+            switch(f.f) {
+            case field::jt:
+            case field::jf:
+                if (offset > UINT8_MAX) {
+                    throw std::runtime_error("socket filter jump out of range");
+                }
+                if (f.f == field::jt) {
+                    insns[f.insn].jt = offset;
+                } else {
+                    insns[f.insn].jf = offset;
+                }
+                break;
+            case field::ja:
+                insns[f.insn].k = offset;
+                break;
+            }
+        }
+        if (insns.size() > BPF_MAXINSNS) {
+            throw std::runtime_error("socket filter too long");
+        }
+    }
+
+public:
+
+    socket_filter(const traffic_selector &selector, const global_config &config) :
+        all_tcp_data{config.tcp_reassembly || config.output_tcp_initial_data},
+        all_udp_data{config.output_udp_initial_data}
+    {
+        int vlan = new_label();
+        int network = new_label();
+        int ipv4 = new_label();
+        int ipv6 = new_label();
+        int transport = new_label();
+        int tcp = new_label();
+        int udp = new_label();
+
+        // ethernet, with an optional VLAN tag; the accumulator holds
+        // the ethertype and the index register holds the offset of the
+        // network header
+        //
+        emit(BPF_LD | BPF_H | BPF_ABS, 12);
+        jump(BPF_JEQ, ETH_TYPE_VLAN, vlan, next);
+        jump(BPF_JEQ, ETH_TYPE_1AD, vlan, next);
+        emit(BPF_LDX | BPF_IMM, 14);
+        jump_always(network);
+        bind(vlan);
+        emit(BPF_LD | BPF_H | BPF_ABS, 16);
+        emit(BPF_LDX | BPF_IMM, 18);
+        bind(network);
+        jump(BPF_JEQ, ETH_TYPE_IP, ipv4, next);
+        jump(BPF_JEQ, ETH_TYPE_IPV6, ipv6, next);
+        emit(BPF_RET | BPF_K, accept);
+
+        // ipv4: fragments are passed, because only the first one has a
+        // transport header
+        //
+        bind(ipv4);
+        emit(BPF_LD | BPF_H | BPF_IND, 6);
+        accept_if(BPF_JSET, 0x3fff);
+        emit(BPF_LD | BPF_B | BPF_IND, 9);
+        emit(BPF_ST, protocol);
+        emit(BPF_LD | BPF_B | BPF_IND, 0);
+        emit(BPF_ALU | BPF_AND | BPF_K, 0x0f);
+        emit(BPF_ALU | BPF_LSH | BPF_K, 2);
+        emit(BPF_ST, tmp);
+        emit(BPF_ALU | BPF_ADD | BPF_X, 0);
+        emit(BPF_ST, l4_offset);
+        emit(BPF_LD | BPF_H | BPF_IND, 2);
+        emit(BPF_LDX | BPF_W | BPF_MEM, tmp);
+        emit(BPF_ALU | BPF_SUB | BPF_X, 0);
+        emit(BPF_ST, l4_length);
+        jump_always(transport);
+
+        // ipv6: packets with extension headers are passed
+        //
+        bind(ipv6);
+        emit(BPF_LD | BPF_B | BPF_IND, 6);
+        emit(BPF_ST, protocol);
+        emit(BPF_LD | BPF_H | BPF_IND, 4);
+        emit(BPF_ST, l4_length);
+        emit(BPF_MISC | BPF_TXA, 0);
+        emit(BPF_ALU | BPF_ADD | BPF_K, 40);
+        emit(BPF_ST, l4_offset);
+
+        bind(transport);
+        emit(BPF_LD | BPF_W | BPF_MEM, protocol);
+        jump(BPF_JEQ, ip::protocol::tcp, tcp, next);
+        jump(BPF_JEQ, ip::protocol::udp, udp, next);
+        emit(BPF_RET | BPF_K, accept);
+
+        // tcp
+        //
+        bind(tcp);
+        emit(BPF_LDX | BPF_W | BPF_MEM, l4_offset);
+        emit(BPF_LD | BPF_B | BPF_IND, 13);
+        accept_if(BPF_JSET, 0x07);                  // FIN, SYN, or RST
+        emit(BPF_LD | BPF_B | BPF_IND, 12);
+        emit(BPF_ALU | BPF_RSH | BPF_K, 4);
+        emit(BPF_ALU | BPF_LSH | BPF_K, 2);
+        set_data_field();
+        return_if(BPF_JEQ, 0, drop);                // no data
+        if (all_tcp_data) {
+            emit(BPF_RET | BPF_K, accept);
+        } else {
+            if (selector.nbss()) {
+                accept_if_port(139);
+            }
+            if (selector.openvpn_tcp()) {
+                accept_if_port(1194);
+            }
+            accept_if_match(selector.tcp_identifier());
+            accept_if_match(selector.tcp4_identifier());
+            emit(BPF_RET | BPF_K, drop);
+        }
+
+        // udp
+        //
+        bind(udp);
+        if (all_udp_data) {
+            emit(BPF_RET | BPF_K, accept);
+        } else {
+            emit(BPF_LDX | BPF_W | BPF_MEM, l4_offset);
+            emit(BPF_LD | BPF_H | BPF_IND, 2);
+            accept_if(BPF_JEQ, 4789);                   // vxlan
+            if (selector.nbds()) {
+                accept_if_port(138);
+            }
+            emit(BPF_LD | BPF_IMM, 8);
+            set_data_field();
+            accept_if_match(selector.udp_identifier());
+            accept_if_match(selector.udp16_identifier());
+            emit(BPF_RET | BPF_K, drop);
+        }
+
+        resolve_jumps();
+    }
+
+    size_t size() const { return insns.size(); }
+
+    // passes_all_tcp_data() and passes_all_udp_data() report whether
+    // the configuration forced the filter to pass every TCP or UDP
+    // data field, so that it drops little more than acknowledgements
+    //
+    bool passes_all_tcp_data() const { return all_tcp_data; }
+
+    bool passes_all_udp_data() const { return all_udp_data; }
+
+    // program() returns a sock_fprog for use with setsockopt(); it
+    // refers to this object, which must outlive it
+    //
+    struct sock_fprog program() {
+        struct sock_fprog fprog;
+        fprog.len = insns.size();
+        fprog.filter = insns.data();
+        return fprog;
+    }
+
+};
+
+#endif /* SOCKET_FILTER_H */
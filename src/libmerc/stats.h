@@ -10,6 +10,7 @@
 
 #include <unistd.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <string>
 #include <unordered_map>
@@ -18,344 +19,729 @@
 #include <atomic>
 #include <zlib.h>
 #include <functional>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <string_view>
+#include <vector>
 
 #include "dict.h"
-#include "queue.h"
+#include "util_obj.h"
+#include "result.h"
 
-// class event_processor_gz coverts a sequence of sorted event
-// strings into an alternative JSON representation
+// struct event_count is the count of an event, and an upper bound on
+// how much that count overestimates the number of times that the
+// event was observed; the error is always zero for an exact table
+//
+struct event_count {
+    uint64_t count;
+    uint64_t error;
+
+    event_count &operator+=(const event_count &rhs) {
+        count += rhs.count;
+        error += rhs.error;
+        return *this;
+    }
+};
+
+// class event_processor_gz writes a sequence of sorted events as
+// JSON, with one record per source address, in which the events are
+// nested by fingerprint, user agent, and destination.  The level of
+// an event is the first level (source, fingerprint, user agent, or
+// destination) at which it differs from the previous one.  The output
+// is formatted into a buffer, which is passed to the gzFile whenever
+// it grows past flush_size bytes; if with_error is true, then each
+// count is followed by its count_error.
 //
 class event_processor_gz {
-    std::vector<std::string> prev;
-    bool first_loop;
     gzFile gzf;
-    std::array<std::string, 4> v;
+    bool first_loop;
+    bool with_error;
+    std::string buf;
+    std::string header;   // the part of a source record after its address
 
-public:
-    event_processor_gz(gzFile gzfile) : prev{"", "", "", ""}, first_loop{true}, gzf{gzfile} {}
+    static constexpr size_t flush_size = 64 * 1024;
 
-    void process_init() {
-        first_loop = true;
-        prev = { "", "", "", "" };
-    }
+public:
 
-    void process_update(const event_msg &event, uint32_t count, const char *version,
-                    const char *git_commit_id, uint32_t git_count, const char *init_time) {
+    enum level { src_level, fp_level, ua_level, dst_level };
 
-        std::tie(v[0], v[1], v[2], v[3]) = event;
+    event_processor_gz(gzFile gzfile, bool error=false) : gzf{gzfile}, first_loop{true}, with_error{error} {}
 
-        // find number of elements that match previous vector
-        size_t num_matching = 0;
-        for (num_matching=0; num_matching<3; num_matching++) {
-            if (prev[num_matching].compare(v[num_matching]) != 0) {
-                break;
-            }
-        }
-        // set mismatched previous values
-        for (size_t i=num_matching; i<3; i++) {
-            prev[i] = v[i];
-        }
+    void process_init(const char *version, const char *git_commit_id, uint32_t git_count, const char *init_time) {
+        first_loop = true;
+        buf.clear();
+        buf.reserve(flush_size + MAX_USER_AGENT_LEN * 4);
+        header.assign("\", \"libmerc_init_time\" : \"").append(init_time);
+        header.append("\",\"libmerc_version\": \"").append(version);
+        header.append("\", \"build_number\" : \"").append(std::to_string(git_count));
+        header.append("\", \"git_commit_id\": \"").append(git_commit_id);
+        header.append("\", \"fingerprints\":[");
+    }
 
-        //Format the optional parameter user-agent only if it is present
-        //Extra 15 bytes is to account for additional data required for json
-        char user_agent[MAX_USER_AGENT_LEN + 15]{"\0"};
-        if(v[2][0] != '\0') {
-            snprintf(user_agent, MAX_USER_AGENT_LEN - 1, "\"user_agent\":\"%s\", ", v[2].c_str());
-        }
+    void process_update(enum level l, const char *src, std::string_view fp, std::string_view ua,
+                        const std::string &dst, const struct event_count &c) {
 
-        // output unique elements
-        int gz_ret = 1;
-        switch(num_matching) {
-        case 0:
+        switch(l) {
+        case src_level:
             if (!first_loop) {
-                gz_ret = gzprintf(gzf, "}]}]}]}\n");
+                buf.append("}]}]}]}\n");
             }
-            if (gz_ret <= 0)
-                throw std::runtime_error("error in gzprintf");
-            gz_ret = gzprintf(gzf, "{\"src_ip\":\"%s\", \"libmerc_init_time\" : \"%s\",\"libmerc_version\": \"%s\","
-                                   " \"build_number\" : \"%u\", \"git_commit_id\": \"%s\", \"fingerprints\":"
-                                   "[{\"str_repr\":\"%s\", \"sessions\": [{%s\"dest_info\":[{\"dst\":\"%s\",\"count\":%u", 
-                v[0].c_str(), init_time, version, git_count, git_commit_id, v[1].c_str(), user_agent, v[3].c_str(), count);
-            break;
-        case 1:
-            gz_ret = gzprintf(gzf, "}]}]},{\"str_repr\":\"%s\", \"sessions\": [{%s\"dest_info\":[{\"dst\":\"%s\",\"count\":%u", v[1].c_str(), user_agent, v[3].c_str(), count);
-            break;
-        case 2:
-            gzprintf(gzf, "}]},{%s\"dest_info\":[{\"dst\":\"%s\",\"count\":%u", user_agent, v[3].c_str(), count);
+            buf.append("{\"src_ip\":\"").append(src).append(header);
+            [[fallthrough]];
+        case fp_level:
+            if (l == fp_level) {
+                buf.append("}]}]},");
+            }
+            buf.append("{\"str_repr\":\"").append(fp).append("\", \"sessions\": [");
+            [[fallthrough]];
+        case ua_level:
+            if (l == ua_level) {
+                buf.append("}]},");
+            }
+            buf.append("{");
+            if (ua.length()) {
+                buf.append("\"user_agent\":\"").append(ua).append("\", ");  // optional
+            }
+            buf.append("\"dest_info\":[");
             break;
-        case 3:
-            gz_ret = gzprintf(gzf, "},{\"dst\":\"%s\",\"count\":%u", v[3].c_str(), count);
+        case dst_level:
+            buf.append("},");
             break;
-        default:
-            ;
+        }
+        buf.append("{\"dst\":\"").append(dst).append("\",\"count\":");
+        append_number(c.count);
+        if (with_error) {
+            buf.append(",\"count_error\":");
+            append_number(c.error);
         }
         first_loop = false;
-        if (gz_ret <= 0)
-            throw std::runtime_error("error in gzprintf");
+        if (buf.length() >= flush_size) {
+            flush();
+        }
     }
 
     void process_final() {
-        int gz_ret = gzprintf(gzf, "}]}]}]}\n");
-        if (gz_ret <= 0)
-            throw std::runtime_error("error in gzprintf");
+        if (!first_loop) {
+            buf.append("}]}]}]}\n");
+        }
+        flush();
+    }
+
+private:
+
+    void append_number(uint64_t x) {
+        char tmp[24];
+        int len = snprintf(tmp, sizeof(tmp), "%" PRIu64, x);
+        buf.append(tmp, len);
+    }
+
+    void flush() {
+        if (buf.length() && gzwrite(gzf, buf.data(), buf.length()) <= 0) {
+            throw std::runtime_error("error in gzwrite");
+        }
+        buf.clear();
     }
 
 };
 
-#define ANON_SRC_IP
+// struct stats_key identifies an event in a stats_table: its flow
+// key, without the source port and protocol, which are not reported,
+// and the identifiers of its fingerprint, user agent, and server
+// name strings in the string table of the stats_table
+//
+struct stats_key {
+    uint32_t fp_id;
+    uint32_t ua_id;
+    uint32_t sn_id;
+    struct key k;
+
+    stats_key(const struct key &flow_key, uint32_t fp, uint32_t ua, uint32_t sn) : fp_id{fp}, ua_id{ua}, sn_id{sn}, k{flow_key} {
+        k.src_port = 0;
+        k.protocol = 0;
+    }
 
-// class event_encoder provides methods to compress/decompress event string.
-// Its member functions are not const because they may update the dict
-// member.
+    bool operator==(const stats_key &rhs) const {
+        return fp_id == rhs.fp_id && ua_id == rhs.ua_id && sn_id == rhs.sn_id && k == rhs.k;
+    }
+};
 
-class event_encoder {
-    dict fp_dict;
-    dict ua_dict;
+struct stats_key_hash {
+    size_t operator()(const stats_key &x) const {
+        const uint64_t multiplier = 2862933555777941757;
+        uint64_t addr[4];
+        memcpy(addr, &x.k.addr, sizeof(addr));   // the constructors of struct key zeroize unused address bytes
+        uint64_t h = ((uint64_t)x.fp_id << 32 | x.ua_id) * multiplier;
+        h = (h ^ ((uint64_t)x.sn_id << 32 | (uint64_t)x.k.dst_port << 8 | x.k.ip_vers)) * multiplier;
+        for (const auto &a : addr) {
+            h = (h ^ a) * multiplier;
+        }
+        return h ^ (h >> 29);
+    }
+};
 
-public:
+// struct stats_record is an event that is being written out, in a
+// form that can be sorted and merged without comparing strings: the
+// ids of its strings are those of a dump_strings index, which is
+// shared by all of the tables that are written together, and which
+// numbers the strings in lexicographic order before the records are
+// sorted.  Records are ordered by source address, fingerprint, user
+// agent, server name, destination address, and destination port, so
+// a sorted sequence of records can be written as it is walked, and
+// the order of the output does not depend on the number of packet
+// processors.  Fingerprints, user agents, and server names are in
+// the string order of earlier versions of the stats output, but
+// addresses and ports are in numeric order rather than text order.
+//
+struct stats_record {
+    struct key k;
+    uint32_t fp_id;
+    uint32_t ua_id;
+    uint32_t sn_id;
+    struct event_count c;
+
+    // compare_src(r) and compare(r) return a negative, zero, or
+    // positive value as the source of this record, or the record,
+    // sorts before, with, or after that of r
+    //
+    int compare_src(const stats_record &r) const {
+        if (k.ip_vers != r.k.ip_vers) {
+            return k.ip_vers < r.k.ip_vers ? -1 : 1;
+        }
+        if (k.ip_vers == 4) {
+            return memcmp(&k.addr.ipv4.src, &r.k.addr.ipv4.src, sizeof(k.addr.ipv4.src));
+        }
+        return memcmp(&k.addr.ipv6.src, &r.k.addr.ipv6.src, sizeof(k.addr.ipv6.src));
+    }
 
-    event_encoder() : fp_dict{}, ua_dict{} {}
+    // renumber(new_id) replaces the string ids of this record with
+    // those that dump_strings::sort() assigned to them
+    //
+    void renumber(const std::vector<uint32_t> &new_id) {
+        fp_id = new_id[fp_id];
+        ua_id = new_id[ua_id];
+        sn_id = new_id[sn_id];
+    }
 
-    bool compute_inverse_map() {
-        return fp_dict.compute_inverse_map() && ua_dict.compute_inverse_map();
+    int compare(const stats_record &r) const {
+        if (int x = compare_src(r)) {
+            return x;
+        }
+        if (fp_id != r.fp_id) {
+            return fp_id < r.fp_id ? -1 : 1;
+        }
+        if (ua_id != r.ua_id) {
+            return ua_id < r.ua_id ? -1 : 1;
+        }
+        if (sn_id != r.sn_id) {
+            return sn_id < r.sn_id ? -1 : 1;
+        }
+        int x = (k.ip_vers == 4) ?
+            memcmp(&k.addr.ipv4.dst, &r.k.addr.ipv4.dst, sizeof(k.addr.ipv4.dst)) :
+            memcmp(&k.addr.ipv6.dst, &r.k.addr.ipv6.dst, sizeof(k.addr.ipv6.dst));
+        if (x) {
+            return x;
+        }
+        return (int)k.dst_port - (int)r.k.dst_port;
+    }
+
+    // level(prev) returns the level of the stats output at which this
+    // record differs from prev, which precedes it
+    //
+    enum event_processor_gz::level level(const stats_record &prev) const {
+        if (compare_src(prev) != 0) {
+            return event_processor_gz::src_level;
+        }
+        if (fp_id != prev.fp_id) {
+            return event_processor_gz::fp_level;
+        }
+        if (ua_id != prev.ua_id) {
+            return event_processor_gz::ua_level;
+        }
+        return event_processor_gz::dst_level;
     }
+};
 
-    void get_inverse(event_msg &event) {
-        const std::string &fngr = std::get<1>(event);
-        const std::string &ua   = std::get<2>(event);
+// class dump_strings gives each distinct string of the tables that
+// are written out together a single id
+//
+class dump_strings {
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::vector<std::string_view> strings;
 
-        size_t compressed_fp_num = strtol(fngr.c_str(), NULL, 16);
-        size_t compressed_ua_num = strtol(ua.c_str(), NULL, 16);
+public:
 
-        std::get<1>(event) = fp_dict.get_inverse(compressed_fp_num);
-        std::get<2>(event) = ua_dict.get_inverse(compressed_ua_num);
+    uint32_t get_id(std::string_view s) {
+        auto it = ids.emplace(s, strings.size());
+        if (it.second) {
+            strings.push_back(s);
+        }
+        return it.first->second;
     }
 
-    void compress_event_string(event_msg& event, dict& addr_dict) {
+    std::string_view operator[](uint32_t id) const { return strings[id]; }
 
-        const std::string &addr = std::get<0>(event);
-        const std::string &fngr = std::get<1>(event);
-        const std::string &ua   = std::get<2>(event);
+    // sort() renumbers the strings in lexicographic order, so that
+    // their ids compare as the strings do, and returns the new id of
+    // each old one; get_id() must not be called afterwards
+    //
+    std::vector<uint32_t> sort() {
+        std::vector<uint32_t> order(strings.size());
+        for (uint32_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [this](uint32_t l, uint32_t r) { return strings[l] < strings[r]; });
+        std::vector<uint32_t> new_id(strings.size());
+        std::vector<std::string_view> sorted(strings.size());
+        for (uint32_t i = 0; i < order.size(); i++) {
+            new_id[order[i]] = i;
+            sorted[i] = strings[order[i]];
+        }
+        strings.swap(sorted);
+        std::unordered_map<std::string_view, uint32_t>{}.swap(ids);
+        return new_id;
+    }
+};
 
-        // compress source address string, for anonymization (regardless of ANON_SRC_IP)
-        char src_addr_buf[9];
-        addr_dict.compress(addr, src_addr_buf);
+// class string_table interns the strings of the events in a
+// stats_table, and counts the references to each of them, so that a
+// string can be discarded once no event refers to it; the ids of
+// discarded strings are reused
+//
+class string_table {
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::deque<std::string> strings;      // indexed by id; a deque never moves its elements
+    std::vector<uint32_t> refs;
+    std::vector<uint32_t> free_ids;
 
-        // compress fingerprint string
-        char compressed_fp_buf[9];
-        fp_dict.compress(fngr, compressed_fp_buf);
+public:
 
-        char compressed_ua_buf[9];
-        ua_dict.compress(ua, compressed_ua_buf);
+    static constexpr uint32_t not_found = UINT32_MAX;
 
-        std::get<0>(event) = src_addr_buf;
-        std::get<1>(event) = compressed_fp_buf;
-        std::get<2>(event) = compressed_ua_buf;
+    uint32_t find(std::string_view s) const {
+        auto it = ids.find(s);
+        return it == ids.end() ? not_found : it->second;
+    }
 
+    // intern(s) returns the id of the string s, adding it to the
+    // table if needed; the reference count of a new string is zero
+    //
+    uint32_t intern(std::string_view s) {
+        auto it = ids.find(s);
+        if (it != ids.end()) {
+            return it->second;
+        }
+        uint32_t id;
+        if (free_ids.size()) {
+            id = free_ids.back();
+            free_ids.pop_back();
+            strings[id].assign(s);
+        } else {
+            id = strings.size();
+            strings.emplace_back(s);
+            refs.push_back(0);
+        }
+        ids.emplace(strings[id], id);
+        return id;
     }
 
-};
+    void acquire(uint32_t id) { refs[id]++; }
+
+    void release(uint32_t id) {
+        if (--refs[id] == 0) {
+            ids.erase(strings[id]);
+            std::string{}.swap(strings[id]);
+            free_ids.push_back(id);
+        }
+    }
 
-struct hash_tuple {
-    template <class T1, class T2, class T3, class T4>
+    const std::string &operator[](uint32_t id) const { return strings[id]; }
 
-    size_t operator()(const std::tuple<T1, T2, T3, T4>& x) const {
-        std::hash<std::string> hasher;
-        return hasher(std::get<0>(x))
-                ^ hasher(std::get<1>(x))
-                ^ hasher(std::get<2>(x))
-                ^ hasher(std::get<3>(x));
+    size_t size() const { return strings.size(); }
+
+    void clear() {
+        std::unordered_map<std::string_view, uint32_t>{}.swap(ids);
+        std::deque<std::string>{}.swap(strings);
+        std::vector<uint32_t>{}.swap(refs);
+        std::vector<uint32_t>{}.swap(free_ids);
     }
 };
 
-// class stats_aggregator manages all of the data needed to gather and
-// report aggregate statistics about (fingerprint and destination)
-// events
+// class stats_table counts the events observed by a single packet
+// processor during one stats epoch.  The strings of the events are
+// interned in the table, so once they have been seen, an observation
+// costs four hash table lookups and no allocation.
 //
-class stats_aggregator {
-    std::unordered_map<event_msg, uint64_t, hash_tuple> event_table;
-    event_encoder encoder;
-    std::string observation;  // used as preallocated temporary variable
-    size_t num_entries;
-    size_t max_entries;
-    dict &addr_dict;
-
-public:
+// An exact table counts every event, up to a limit on the number of
+// events across all tables, after which new events are discarded.  A
+// sketch table (one constructed with a nonzero capacity) instead
+// tracks the heavy hitters with the Space-Saving algorithm: it holds
+// at most capacity events, and when a new event arrives while it is
+// full, the event with the smallest count is replaced by the new one,
+// which inherits that count (plus one) as its count and as its error.
+// The count of each event in a sketch table is at least its true
+// count, and at most its true count plus its error, which is at most
+// N/capacity after N observations; every event that was observed more
+// than N/capacity times is in the table.  The memory used by a sketch
+// table is bounded by its capacity.
+//
+class stats_table {
+    struct entry {
+        stats_key key;
+        event_count c;
+        uint32_t heap_pos;      // position in heap (sketch tables only)
 
-    stats_aggregator(dict& _addr_dict, size_t size_limit) : event_table{}, encoder{}, observation{}, num_entries{0}, max_entries{size_limit}, addr_dict{_addr_dict} { }
+        entry(const stats_key &k) : key{k}, c{1, 0}, heap_pos{0} { }
+    };
 
-    ~stats_aggregator() {  }
+    string_table strings;
+    std::vector<entry> entries;
+    std::unordered_map<stats_key, uint32_t, stats_key_hash> index;   // key -> entries index
+    std::vector<uint32_t> heap;   // entries indices, in a min-heap ordered by count
+    size_t capacity;              // zero for an exact table
 
-    void observe_event_string(event_msg &obs) {
+public:
 
-        encoder.compress_event_string(obs, addr_dict);
+    stats_table(size_t sketch_capacity=0) : capacity{sketch_capacity} { }
 
-        const auto entry = event_table.find(obs);
-        if (entry != event_table.end()) {
-            entry->second = entry->second + 1;
-        } else {
-            if (max_entries && num_entries >= max_entries) {
-                return;  // don't go over the max_entries limit
+    // observe(k, fp, ua, sn, num_entries, max_entries) counts an
+    // event; if it is new, and the table is exact, it is added only
+    // if num_entries is less than max_entries (or max_entries is
+    // zero).  num_entries is incremented whenever an event is added
+    // to the table.
+    //
+    void observe(const struct key &k, const char *fp, const char *ua, const char *sn,
+                 std::atomic<size_t> &num_entries, size_t max_entries) {
+
+        std::string_view s[3] = { fp, ua, sn };
+        uint32_t id[3];
+        bool is_new = false;
+        for (size_t i = 0; i < 3; i++) {
+            id[i] = strings.find(s[i]);
+            if (id[i] == string_table::not_found) {
+                is_new = true;
             }
-            event_table.emplace(obs, 1);  // TODO: check return value for allocation failure
-            ++num_entries;
         }
+        if (!is_new) {
+            auto it = index.find(stats_key{k, id[0], id[1], id[2]});
+            if (it != index.end()) {
+                increment(it->second);
+                return;
+            }
+        }
+        if (capacity == 0 && max_entries && num_entries.load(std::memory_order_relaxed) >= max_entries) {
+            return;  // don't go over the max_entries limit
+        }
+        for (size_t i = 0; i < 3; i++) {
+            id[i] = strings.intern(s[i]);
+            strings.acquire(id[i]);
+        }
+        stats_key sk{k, id[0], id[1], id[2]};
+        if (capacity && entries.size() == capacity) {
+            replace_min(sk);
+            return;
+        }
+        uint32_t e = entries.size();
+        entries.emplace_back(sk);
+        index.emplace(sk, e);
+        if (capacity) {
+            heap.push_back(e);
+            sift_up(heap.size() - 1);
+        }
+        num_entries.fetch_add(1, std::memory_order_relaxed);
     }
 
-    bool is_empty() const { return event_table.size() == 0; }
-
-    void gzprint(gzFile f, const char *version, const char *git_commit_id,
-                 uint32_t git_count,
-                 const char *init_time,
-                 std::atomic<bool> &interrupt ) {
+    bool is_empty() const { return entries.size() == 0; }
 
-        if (event_table.size() == 0) {
-            return;  // nothing to report
+    // records(index) returns the events in the table as
+    // stats_records, with string ids taken from index
+    //
+    std::vector<stats_record> records(dump_strings &index) const {
+        std::vector<uint32_t> id(strings.size());
+        for (size_t i = 0; i < id.size(); i++) {
+            id[i] = index.get_id(strings[i]);
+        }
+        std::vector<stats_record> v;
+        v.reserve(entries.size());
+        for (const auto &entry : entries) {
+            const stats_key &sk = entry.key;
+            v.push_back({sk.k, id[sk.fp_id], id[sk.ua_id], id[sk.sn_id], entry.c});
         }
+        return v;
+    }
+
+    // clear() discards the events and strings, and releases their memory
+    //
+    void clear() {
+        std::vector<entry>{}.swap(entries);
+        std::unordered_map<stats_key, uint32_t, stats_key_hash>{}.swap(index);
+        std::vector<uint32_t>{}.swap(heap);
+        strings.clear();
+    }
 
-        // note: this function is not const because of compute_inverse_map()
+private:
 
-        // compute decoding table for elements
-        if (encoder.compute_inverse_map() == false) {
-            return;  // error; unable to compute fingerprint decompression map
+    void increment(uint32_t e) {
+        entries[e].c.count++;
+        if (capacity) {
+            sift_down(entries[e].heap_pos);
         }
+    }
 
-        std::vector<std::pair<event_msg, uint64_t>> v(event_table.begin(), event_table.end());
-        event_table.clear();
-        num_entries = 0;
-        std::sort(v.begin(), v.end(), [&interrupt](auto &l, auto &r){
-            if (interrupt.load() == true) {
-                throw std::runtime_error("error: stats dump interrupted");
-            } else {
-                return l.first < r.first;
-            } 
-        } );
+    // replace_min(sk) replaces the event with the smallest count with
+    // the event sk, whose strings have already been acquired
+    //
+    void replace_min(const stats_key &sk) {
+        uint32_t e = heap[0];
+        entry &victim = entries[e];
+        index.erase(victim.key);
+        strings.release(victim.key.fp_id);
+        strings.release(victim.key.ua_id);
+        strings.release(victim.key.sn_id);
+        victim.key = sk;
+        victim.c.error = victim.c.count;
+        victim.c.count++;
+        index.emplace(sk, e);
+        sift_down(0);
+    }
 
-        event_processor_gz ep(f);
-        ep.process_init();
-        for (auto &entry : v) {
-            if (interrupt.load() == true) {
-                ep.process_final();
-                throw std::runtime_error("error: stats dump interrupted");
+    void place(size_t pos, uint32_t e) {
+        heap[pos] = e;
+        entries[e].heap_pos = pos;
+    }
+
+    void sift_up(size_t pos) {
+        uint32_t e = heap[pos];
+        while (pos > 0) {
+            size_t parent = (pos - 1) / 2;
+            if (entries[heap[parent]].c.count <= entries[e].c.count) {
+                break;
             }
-            encoder.get_inverse(entry.first);
-            ep.process_update(entry.first, entry.second, version, git_commit_id, git_count, init_time);
+            place(pos, heap[parent]);
+            pos = parent;
         }
-        ep.process_final();
+        place(pos, e);
+    }
+
+    void sift_down(size_t pos) {
+        uint32_t e = heap[pos];
+        size_t n = heap.size();
+        while (true) {
+            size_t child = 2 * pos + 1;
+            if (child >= n) {
+                break;
+            }
+            if (child + 1 < n && entries[heap[child + 1]].c.count < entries[heap[child]].c.count) {
+                child++;
+            }
+            if (entries[heap[child]].c.count >= entries[e].c.count) {
+                break;
+            }
+            place(pos, heap[child]);
+            pos = child;
+        }
+        place(pos, e);
+    }
+};
+
+// class stats_shard holds the stats of a single packet processor,
+// which updates its active stats_table without locks.  To write the
+// stats, the data_aggregator swaps the active table with the other
+// one, which starts a new epoch, and then waits until the owner is
+// no longer using the old table, which it detects through seq: the
+// owner increments seq before and after each update, so seq is odd
+// while it might be using the table that it found in active.
+//
+class stats_shard {
+    stats_table tables[2];
+    std::atomic<stats_table *> active;
+    std::atomic<uint64_t> seq;
+    std::atomic<size_t> &num_entries;
+    size_t max_entries;
+
+public:
 
-        // if (fp_dict.unit_test(stderr)) {
-        //     fprintf(stderr, "passed fp_dict.unit_test()\n");
-        // }
+    bool retired;    // the owner has gone; guarded by the mutex of the data_aggregator
 
-        return;
+    stats_shard(std::atomic<size_t> &entries, size_t max, size_t sketch_capacity) : tables{stats_table{sketch_capacity}, stats_table{sketch_capacity}}, active{&tables[0]}, seq{0}, num_entries{entries}, max_entries{max}, retired{false} { }
+
+    stats_shard(const stats_shard &) = delete;
+    stats_shard &operator=(const stats_shard &) = delete;
+
+    // observe(k, fp, ua, sn) is called by the owner
+    //
+    void observe(const struct key &k, const char *fp, const char *ua, const char *sn) {
+        seq.fetch_add(1, std::memory_order_seq_cst);
+        active.load(std::memory_order_seq_cst)->observe(k, fp, ua, sn, num_entries, max_entries);
+        seq.fetch_add(1, std::memory_order_release);
     }
 
-    size_t get_num_entries() const
-    {
-        return num_entries;
+    // swap() makes the other table active, and returns the table that
+    // was active, once the owner can no longer be using it; it must
+    // not be called again until that table has been cleared
+    //
+    stats_table *swap() {
+        stats_table *old = active.load(std::memory_order_relaxed);
+        stats_table *next = (old == &tables[0]) ? &tables[1] : &tables[0];
+        active.store(next, std::memory_order_seq_cst);
+        uint64_t s = seq.load(std::memory_order_seq_cst);
+        if (s & 1) {
+            while (seq.load(std::memory_order_acquire) == s) {
+                std::this_thread::yield();
+            }
+        }
+        return old;
     }
 };
 
 #define MAX_VERSION_STRING 15
 
+// class data_aggregator owns a stats_shard for each packet processor
+// (or producer), and writes out their combined stats.  Each shard is
+// only updated by its owner, so producers never contend with each
+// other; when the stats are written, the shards are swapped to a new
+// epoch, the events of the old epoch are sorted in parallel, and the
+// sorted tables are merged as they are written.  The events are
+// sorted as compact records, in which each string is replaced by an
+// id that is shared by all of the tables, and the merged records are
+// walked in order, so that each level of the output (source,
+// fingerprint, user agent) is written once per group of events.  The
+// distinct strings are sorted once to number them, and no strings are
+// compared while the records are sorted and merged.
+//
+// If sketch_capacity is nonzero, then each shard tracks at most that
+// many events per epoch with sketch tables, instead of counting them
+// exactly, and each count is written with its count_error; the errors
+// of the shards add up when their counts are merged.
+//
 class data_aggregator {
-    std::vector<class message_queue *> q;
-    stats_aggregator ag1, ag2, *ag;
+    std::vector<class stats_shard *> shards;
     std::atomic<bool> shutdown_requested;
+    std::atomic<size_t> num_entries;   // entries in the current epoch, across all shards
+    size_t max_entries;
+    size_t sketch_capacity;
     dict addr_dict;
-    std::thread consumer_thread;
     std::mutex m;
     std::mutex output_mutex;
     char version[MAX_VERSION_STRING];
 
-    // stop_processing() MUST NOT be called until all writing to the
-    // message_queues has stopped
+    // a cursor in the k-way merge of the sorted tables
     //
-    void stop_processing() {
+    struct merge_cursor {
+        const std::vector<stats_record> *records;
+        size_t index;
 
-        // shut down consumer thread
-        shutdown_requested.store(true);
-        if(consumer_thread.joinable()) {
-             consumer_thread.join();
-        }
-    }
+        const stats_record &get() const { return (*records)[index]; }
+    };
 
-    void empty_event_queue(message_queue *q) {
-        //fprintf(stderr, "note: emptying message queue in %p\n", (void *)this);
-        event_msg event;
-        while (q->pop(event)) {
-            //fprintf(stderr, "note: got message\n");
-            ag->observe_event_string(event);
-        }
+    static void sort_records(std::vector<stats_record> &v, std::atomic<bool> &interrupt) {
+        std::sort(v.begin(), v.end(), [&interrupt](const stats_record &l, const stats_record &r){
+            if (interrupt.load(std::memory_order_relaxed) == true) {
+                throw std::runtime_error("error: stats dump interrupted");
+            }
+            return l.compare(r) < 0;
+        } );
     }
 
-    void process_event_queues() {
-        std::lock_guard m_guard{m};
-        //fprintf(stderr, "note: processing event queue of size %zd in %p\n", q.size(), (void *)this);
-        if (q.size()) {
-            for (auto & qr : q) {
-                //fprintf(stderr, "note: processing event queue %p in %p with size %zd\n", (void *)qr, (void *)this, qr->size());
-                empty_event_queue(qr);
+    // write_merged(f, sorted, strings, ...) writes the records in the
+    // sorted vectors sorted, adding up the counts of equal records,
+    // with each source address replaced by its index in addr_dict
+    //
+    void write_merged(gzFile f, const std::vector<std::vector<stats_record>> &sorted, const dump_strings &strings,
+                      const char *git_commit_id, uint32_t git_count, const char *init_time) {
+
+        auto greater = [](const merge_cursor &l, const merge_cursor &r) { return l.get().compare(r.get()) > 0; };
+        std::priority_queue<merge_cursor, std::vector<merge_cursor>, decltype(greater)> heap{greater};
+        for (const auto &v : sorted) {
+            if (v.size()) {
+                heap.push({&v, 0});
             }
         }
-    }
 
-    void consumer() {
-        //fprintf(stderr, "note: running consumer in %p\n", (void *)this);
-        while(shutdown_requested.load() == false) {
-            process_event_queues();
-            usleep(50); // sleep for fifty microseconds
+        event_processor_gz ep(f, sketch_capacity != 0);
+        ep.process_init(version, git_commit_id, git_count, init_time);
+        stats_record pending;
+        stats_record prev;
+        bool first = true;
+        char src_addr_buf[9];
+        std::string dest_context;
+        auto emit = [&]() {
+            enum event_processor_gz::level l = first ? event_processor_gz::src_level : pending.level(prev);
+            if (l == event_processor_gz::src_level) {
+                char src_ip_str[MAX_ADDR_STR_LEN];
+                pending.k.sprint_src_addr(src_ip_str);
+                addr_dict.compress(src_ip_str, src_addr_buf);   // anonymize source address
+            }
+            char dst_ip_str[MAX_ADDR_STR_LEN];
+            flow_key_sprintf_dst_addr(pending.k, dst_ip_str);
+            char dst_port_str[MAX_PORT_STR_LEN];
+            pending.k.sprint_dst_port(dst_port_str);
+            dest_context.assign("(");
+            dest_context.append(strings[pending.sn_id]).append(")(");
+            dest_context.append(dst_ip_str).append(")(");
+            dest_context.append(dst_port_str).append(")");
+
+            ep.process_update(l, src_addr_buf, strings[pending.fp_id], strings[pending.ua_id], dest_context, pending.c);
+            prev = pending;
+            first = false;
+        };
+        bool have_pending = false;
+        while (!heap.empty()) {
+            if (shutdown_requested.load(std::memory_order_relaxed) == true) {
+                ep.process_final();
+                throw std::runtime_error("error: stats dump interrupted");
+            }
+            merge_cursor c = heap.top();
+            heap.pop();
+            if (have_pending && c.get().compare(pending) == 0) {
+                pending.c += c.get().c;
+            } else {
+                if (have_pending) {
+                    emit();
+                }
+                pending = c.get();
+                have_pending = true;
+            }
+            if (++c.index < c.records->size()) {
+                heap.push(c);
+            }
+        }
+        if (have_pending) {
+            emit();
         }
+        ep.process_final();
     }
 
 public:
 
-    data_aggregator(size_t size_limit=0) : q{}, ag1{addr_dict, size_limit}, ag2{addr_dict, size_limit}, ag{&ag1}, shutdown_requested{false} {
+    data_aggregator(size_t size_limit=0, size_t sketch_counters=0) : shards{}, shutdown_requested{false}, num_entries{0}, max_entries{size_limit}, sketch_capacity{sketch_counters} {
         mercury_get_version_string(version, MAX_VERSION_STRING);
-        start_processing();
-        //fprintf(stderr, "note: constructing data_aggregator %p\n", (void *)this);
     }
 
     ~data_aggregator() {
-        //fprintf(stderr, "note: destructing data_aggregator %p\n", (void *)this);
-        stop_processing();
-
-        // delete message_queues, if any
-        for (auto & x : q) {
-            //fprintf(stderr, "%s: deleting message_queue %p\n", __func__, (void *)x);
+        shutdown_requested.store(true);                   // interrupt gzprint(), if it is running
+        std::lock_guard output_guard{output_mutex};
+        for (auto & x : shards) {
             delete x;
         }
     }
 
-    message_queue *add_producer() {
+    stats_shard *add_producer() {
         std::lock_guard m_guard{m};
-        //fprintf(stderr, "note: adding producer in %p\n", (void *)this);
-        q.push_back(new message_queue);
-        return q.back();
+        shards.push_back(new stats_shard{num_entries, max_entries, sketch_capacity});
+        return shards.back();
     }
 
-    void remove_producer(message_queue *p) {
+    // remove_producer(p) retires the shard p, which is deleted once
+    // its stats have been written
+    //
+    void remove_producer(stats_shard *p) {
         if (p == nullptr) {
             return;
         }
         std::lock_guard m_guard{m};
-        //fprintf(stderr, "note: removing producer in %p\n", (void *)this);
-        empty_event_queue(p);
-        for (std::vector<message_queue *>::iterator it = q.begin(); it < q.end(); it++) {
-            if (*it == p) {
-                //fprintf(stderr, "%s: deleting and erasing message_queue p=%p in %p\n", __func__, (void *)p, (void *)this);
-                delete *it;
-                q.erase(it);
-            }
-        }
-        if (q.size() == 0) {
-            shutdown_requested.store(true);  // time to close up shop
-        }
-    }
-
-    void start_processing() {
-        //fprintf(stderr, "note: starting data_aggregator\n");
-        consumer_thread = std::thread( [this](){ consumer(); } );  // lambda just calls member function
+        p->retired = true;
     }
 
     void gzprint(gzFile f,
@@ -368,32 +754,76 @@ public:
         //
         std::lock_guard output_guard{output_mutex};
 
-        // swap ag pointer, so that we can print out the previously
-        // gathered data while new events are tracked in the other
-        // stats_aggregator
+        // start a new epoch in each shard, so that the tables of the
+        // old epoch can be read while new events are counted; the other
+        // table of a shard was cleared by the previous dump, so the old
+        // table holds all of the events of a retired shard, which is
+        // deleted once they are written
         //
-        stats_aggregator *tmp;
+        std::vector<stats_table *> tables;
+        std::vector<stats_shard *> retired;
         {
             std::lock_guard m_guard{m};
-            tmp = ag;
-            if (ag == &ag1) {
-                ag = &ag2;
-            } else {
-                ag = &ag1;
+            num_entries.store(0);
+            for (auto & shard : shards) {
+                tables.push_back(shard->swap());
+                if (shard->retired) {
+                    retired.push_back(shard);
+                }
             }
         }
 
         try {
-            tmp->gzprint(f, version, git_commit_id, git_count, init_time, std::ref(shutdown_requested));
+            // convert the tables into records, number their strings
+            // in order, then sort the records in parallel, and merge
+            // them as they are written
+            //
+            dump_strings strings;
+            std::vector<std::vector<stats_record>> sorted;
+            for (auto & t : tables) {
+                if (!t->is_empty()) {
+                    sorted.push_back(t->records(strings));
+                }
+            }
+            const std::vector<uint32_t> new_id = strings.sort();
+            std::vector<std::future<void>> pending;
+            for (auto & v : sorted) {
+                pending.push_back(std::async(std::launch::async, [&v, &new_id, this]() {
+                    for (auto & r : v) {
+                        r.renumber(new_id);
+                    }
+                    sort_records(v, shutdown_requested);
+                }));
+            }
+            for (auto & p : pending) {
+                p.get();
+            }
+            write_merged(f, sorted, strings, git_commit_id, git_count, init_time);
         }
         catch (std::exception &e) {
             printf_err(log_err, "%s\n", e.what());
         }
+
+        // source addresses that were not in this dump are forgotten,
+        // and get new anonymized values if they are seen again
+        //
+        addr_dict.end_epoch();
+
+        for (auto & t : tables) {
+            t->clear();
+        }
+        if (retired.size()) {
+            std::lock_guard m_guard{m};
+            for (auto & r : retired) {
+                shards.erase(std::find(shards.begin(), shards.end(), r));
+                delete r;
+            }
+        }
     }
 
     size_t get_num_entries() const
     {
-        return ag->get_num_entries();
+        return num_entries.load(std::memory_order_relaxed);
     }
 };
 
@@ -10,10 +10,16 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <vector>
+#include <deque>
 #include <unordered_map>
 #include "datum.h"
 #include "analysis.h"
 #include "util_obj.h"
+#include "flow_map.h"
+#include "timer_wheel.h"
 
 struct tcp_header {
     uint16_t src_port;
@@ -164,10 +170,17 @@ void fprintf_tcp_hdr_info(FILE *f, const struct key *k, const struct tcp_header
 #define ACCEPT_PACKET 100
 #define DROP_PACKET     0
 
+// struct tcp_initial_message_filter keeps the state of each TCP flow
+// in a flow_map of at most max_entries entries, in which the states of
+// flows idle for more than timeout seconds are reused, and the oldest
+// states are evicted when there is no room for a new one
+//
 struct tcp_initial_message_filter {
-    std::unordered_map<struct key, struct tcp_state> tcp_flow_table;
+    flow_map<struct tcp_state> tcp_flow_table;
+    static constexpr uint32_t max_entries = 20000;
+    static const unsigned int timeout = 30;  // seconds before flow timeout
 
-    tcp_initial_message_filter(void) : tcp_flow_table{} {}
+    tcp_initial_message_filter(unsigned int size, timer_wheel &timers) : tcp_flow_table{size && size < max_entries ? size : max_entries, timeout, &timers} {}
 
     // A TCP message is defined as the set of TCP/IP packets for which
     // the ACK flag is set, the Ack value is constant, and the Seq is
@@ -184,7 +197,7 @@ struct tcp_initial_message_filter {
     // p.ack = s.ack       talking           listening               *
     // p.ack < s.ack          *                  *                   *
 
-    size_t apply(struct key &k, const struct tcp_header *tcp, size_t length) {
+    size_t apply(struct key &k, unsigned int sec, const struct tcp_header *tcp, size_t length) {
 
         size_t retval = DROP_PACKET;
 
@@ -192,8 +205,8 @@ struct tcp_initial_message_filter {
         k.dst_port = tcp->dst_port;
         size_t data_length = length - tcp_offrsv_get_header_length(tcp->offrsv);
 
-        auto it = tcp_flow_table.find(k);
-        if (it == tcp_flow_table.end()) {
+        auto *e = tcp_flow_table.find(k);
+        if (e == nullptr || sec - e->sec >= timeout) {
 
             uint32_t tmp_seq = tcp->seq;
             if (TCP_IS_SYN(tcp->flags)) {
@@ -206,14 +219,15 @@ struct tcp_initial_message_filter {
                                        tcp->ack, // .init_ack
                                        listening // .disposition
             };
-            tcp_flow_table[k] = state;
+            tcp_flow_table.insert(k, sec, state);
             retval = ACCEPT_PACKET;
 
             fprintf_tcp_hdr_info(stderr, &k, tcp, &state, length, retval);
 
         } else {
 
-            struct tcp_state state = it->second;
+            struct tcp_state &state = e->value;
+            e->sec = sec;
 
             // initialize acknowledgement number, if it has not yet been set
             if (state.ack == 0) {
@@ -243,12 +257,11 @@ struct tcp_initial_message_filter {
             if (ntoh(tcp->ack) > ntoh(state.ack)) {
                 state.ack = tcp->ack;
             }
-            tcp_flow_table[k] = state;
 
             fprintf_tcp_hdr_info(stderr, &k, tcp, &state, length, retval);
 
             if (TCP_IS_FIN(tcp->flags) || TCP_IS_RST(tcp->flags)) {
-                tcp_flow_table.erase(it);
+                tcp_flow_table.erase(e);
             }
         }
 
@@ -262,7 +275,9 @@ struct tcp_initial_message_filter {
  *
  * strategy:
  *
- *    - pre-allocated storage to hold reassembled packets
+ *    - pooled storage to hold reassembled packets, in size classes
+ *      chosen from the number of bytes needed (see
+ *      reassembly_buffer_pool)
  *
  *    - flow key maps to tcp_segment
  *
@@ -284,6 +299,184 @@ struct tcp_seg_context {
     tcp_seg_context(uint32_t len, uint32_t seq_no, uint32_t additional_bytes) : data_length{len}, seq{seq_no}, additional_bytes_needed{additional_bytes} {}
 };
 
+// class reassembly_buffer_pool provides the buffers that hold the
+// data of the segments being reassembled, in a few size classes, so
+// that a reassembly only ties up about as much memory as the message
+// that it reassembles.  Buffers are carved out of slabs of slab_size
+// bytes, each of which serves a single size class while any of its
+// buffers are in use.  A slab whose buffers have all been returned
+// goes onto a spare list, from which any size class can take it, so
+// that memory is not stranded in a class that is no longer in demand.
+// At most max_slabs slabs are allocated, after which get() fails until
+// buffers are returned; slabs are freed when the pool is destroyed.
+// A pool is not thread safe; each tcp_reassembler has its own.
+//
+class reassembly_buffer_pool {
+public:
+    static constexpr size_t num_classes = 5;
+    static constexpr size_t class_size[num_classes] = { 512, 2048, 8192, 32768, 65536 };
+    static constexpr size_t max_buffer_len = class_size[num_classes - 1];
+    static constexpr size_t slab_size = 64 * 1024;
+    static constexpr size_t max_slabs = 1280;          // 80 MB
+
+    reassembly_buffer_pool() = default;
+
+    reassembly_buffer_pool(const reassembly_buffer_pool &) = delete;
+    reassembly_buffer_pool &operator=(const reassembly_buffer_pool &) = delete;
+
+    ~reassembly_buffer_pool() {
+        for (struct slab &s : slabs) {
+            free(s.base);
+        }
+    }
+
+    // get(min_len, len) returns a buffer of at least min_len bytes,
+    // and sets len to its size, or returns nullptr if min_len is
+    // larger than max_buffer_len or no memory is available
+    //
+    uint8_t *get(size_t min_len, uint32_t &len) {
+        size_t c = 0;
+        while (class_size[c] < min_len) {
+            if (++c == num_classes) {
+                return nullptr;
+            }
+        }
+        struct slab *s = available[c];
+        if (s == nullptr && (s = take_slab(c)) == nullptr) {
+            return nullptr;
+        }
+        uint8_t *buf;
+        if (s->free_list) {
+            buf = (uint8_t *)s->free_list;
+            s->free_list = s->free_list->next;
+        } else {
+            buf = s->base + s->carved;          // not yet handed out
+            s->carved += class_size[c];
+        }
+        s->in_use++;
+        if (s->is_full()) {
+            unlink(s);
+        }
+        len = class_size[c];
+        return buf;
+    }
+
+    // put(buf, len) returns the buffer buf of size len, which must
+    // have been obtained from get(), to the pool
+    //
+    void put(uint8_t *buf, uint32_t len) {
+        struct slab *s = slab_table.at((uint8_t *)((uintptr_t)buf & ~(uintptr_t)(slab_size - 1)));
+        (void)len;
+        bool was_full = s->is_full();
+        struct free_buffer *b = (struct free_buffer *)buf;
+        b->next = s->free_list;
+        s->free_list = b;
+        s->in_use--;
+        if (s->in_use == 0) {
+            if (!was_full) {
+                unlink(s);
+            }
+            s->free_list = nullptr;
+            s->carved = 0;
+            s->next = spare;
+            spare = s;
+            spare_slabs++;
+        } else if (was_full) {
+            link(s);
+        }
+    }
+
+    // slab_count() returns the number of slabs that have been
+    // allocated, and spare_slab_count() the number of those that are
+    // not serving any size class
+    //
+    size_t slab_count() const { return slabs.size(); }
+
+    size_t spare_slab_count() const { return spare_slabs; }
+
+private:
+    struct free_buffer {
+        struct free_buffer *next;
+    };
+
+    // a slab hands out its buffers from its free list, or else from
+    // the part that has not yet been carved into buffers; a slab with
+    // a buffer to hand out is on the available list of its class
+    //
+    struct slab {
+        uint8_t *base;
+        struct free_buffer *free_list;
+        uint32_t carved;
+        uint32_t in_use;
+        size_t size_class;
+        struct slab *next;
+        struct slab *prev;
+
+        bool is_full() const { return free_list == nullptr && carved == slab_size; }
+    };
+
+    std::deque<struct slab> slabs;                     // stable addresses
+    std::unordered_map<const uint8_t *, struct slab *> slab_table;
+    struct slab *available[num_classes] = { nullptr };
+    struct slab *spare = nullptr;
+    size_t spare_slabs = 0;
+
+    void link(struct slab *s) {
+        s->prev = nullptr;
+        s->next = available[s->size_class];
+        if (s->next) {
+            s->next->prev = s;
+        }
+        available[s->size_class] = s;
+    }
+
+    void unlink(struct slab *s) {
+        if (s->prev) {
+            s->prev->next = s->next;
+        } else {
+            available[s->size_class] = s->next;
+        }
+        if (s->next) {
+            s->next->prev = s->prev;
+        }
+    }
+
+    // take_slab(c) puts a spare or newly allocated slab into service
+    // for size class c, or returns nullptr if there is none
+    //
+    struct slab *take_slab(size_t c) {
+        struct slab *s = spare;
+        if (s) {
+            spare = s->next;
+            spare_slabs--;
+        } else {
+            if (slabs.size() >= max_slabs) {
+                return nullptr;
+            }
+            uint8_t *base = (uint8_t *)aligned_alloc(slab_size, slab_size);
+            if (base == nullptr) {
+                return nullptr;
+            }
+            s = &slabs.emplace_back();
+            s->base = base;
+            s->free_list = nullptr;
+            s->carved = 0;
+            s->in_use = 0;
+            slab_table.emplace(base, s);
+        }
+        s->size_class = c;
+        link(s);
+        return s;
+    }
+};
+
+// struct tcp_segment holds a message that is being reassembled; its
+// data is kept in a buffer from a reassembly_buffer_pool, which is
+// obtained when the first segment is added, and which is moved to a
+// buffer of a larger size class if a later segment needs more room.
+// A tcp_segment is constructed in place in the segment table of a
+// tcp_reassembler, and is never copied or moved.
+//
 struct tcp_segment {
     uint32_t seq_init;
     uint32_t curr_seq;
@@ -301,15 +494,103 @@ struct tcp_segment {
 
     static const unsigned int timeout = 30;    // seconds before flow timeout
 
-    static const size_t buffer_len = 8192;
-    uint8_t data[buffer_len];
+    static const uint32_t max_buffer_len = reassembly_buffer_pool::max_buffer_len;
+
+    class reassembly_buffer_pool *pool;
+    uint8_t *data;
+    uint32_t buffer_len;       // size of data
+    uint32_t limit;            // the most bytes of a message that are reassembled
+    bool budget_exceeded;      // the message is longer than limit
 
-    static const uint32_t max_seg_count = 20;
+    static const uint32_t max_seg_count = 64;
     std::pair<uint32_t, uint32_t> seg[max_seg_count];
     //std::vector< std::pair<uint32_t,uint32_t> > seg;
 
-    tcp_segment() : seq_init{0}, curr_seq{0}, index{0}, end_index{0}, seg_len{0}, max_index{8192}, total_bytes_needed{8192},
-                        current_bytes{0}, seg_count{0}, init_time{0}, done{false}, seg_overlap{false}, max_seg_exceed{false} {}
+    struct key flow_key;         // set when the segment is added to a tcp_reassembler
+    struct wheel_timer expiry_timer;   // scheduled when the segment is added to a tcp_reassembler
+
+    tcp_segment(class reassembly_buffer_pool &buffers, uint32_t max_len) : seq_init{0}, curr_seq{0}, index{0}, end_index{0}, seg_len{0}, max_index{max_len}, total_bytes_needed{max_len},
+                        current_bytes{0}, seg_count{0}, init_time{0}, done{false}, seg_overlap{false}, max_seg_exceed{false},
+                        pool{&buffers}, data{nullptr}, buffer_len{0}, limit{max_len}, budget_exceeded{false}, flow_key{}, expiry_timer{} {}
+
+    ~tcp_segment() {
+        if (data) {
+            pool->put(data, buffer_len);
+        }
+    }
+
+    tcp_segment(const tcp_segment &) = delete;
+    tcp_segment &operator=(const tcp_segment &) = delete;
+
+    static struct tcp_segment *from_timer(struct wheel_timer *t) {
+        return (struct tcp_segment *)((uint8_t *)t - offsetof(struct tcp_segment, expiry_timer));
+    }
+
+    // reserve(len) makes sure that data holds at least len bytes,
+    // and returns false if that is not possible
+    //
+    bool reserve(uint32_t len) {
+        if (len <= buffer_len) {
+            return true;
+        }
+        uint32_t new_len;
+        uint8_t *new_data = pool->get(len, new_len);
+        if (new_data == nullptr) {
+            return false;
+        }
+        if (data) {
+            memcpy(new_data, data, buffer_len);
+            pool->put(data, buffer_len);
+        }
+        data = new_data;
+        buffer_len = new_len;
+        return true;
+    }
+
+    // copy_data(p) copies the data of the current packet into place,
+    // up to limit, and returns false if there is no buffer for it;
+    // data past the expected end of the message is kept, in case the
+    // message is extended
+    //
+    bool copy_data(const datum &p) {
+        if (index >= limit) {
+            return true;    // past the end of the message
+        }
+        // TODO: check for datum len
+        uint32_t end = end_index > limit ? limit : end_index;
+        if (!reserve(end)) {
+            return false;
+        }
+        memcpy(data+index, p.data, end - index);
+        return true;
+    }
+
+    // set_total(total) sets the length of the message, which is
+    // reassembled only up to limit bytes if it is longer
+    //
+    void set_total(uint32_t total) {
+        if (total > limit) {
+            total = limit;
+            budget_exceeded = true;
+        }
+        total_bytes_needed = total;
+        max_index = total;
+    }
+
+    // extend(n) asks for n bytes beyond the end of the message, once
+    // the reassembled data turns out to be incomplete, as happens when
+    // the length of the message was estimated before all of it was
+    // seen; it returns false if the message cannot be extended.  The
+    // segment is still done if the bytes have already been received.
+    //
+    bool extend(uint32_t n) {
+        if (max_seg_exceed || n == 0 || total_bytes_needed >= limit) {
+            return false;
+        }
+        set_total(total_bytes_needed + n);
+        done = current_bytes >= total_bytes_needed;
+        return true;
+    }
 
     bool init_from_pkt (unsigned int sec, struct tcp_seg_context &tcp_pkt, uint32_t syn_seq, datum &p) {
         seq_init = syn_seq;
@@ -320,24 +601,20 @@ struct tcp_segment {
         bool is_initial = (seq_init == curr_seq);
 
         if (is_initial) {
-            total_bytes_needed = seg_len + tcp_pkt.additional_bytes_needed;
-            max_index = total_bytes_needed;
+            set_total(seg_len + tcp_pkt.additional_bytes_needed);
         }
 
         index = curr_seq - seq_init;
         end_index = index + seg_len;
         seg[0].first = index;
         seg[0].second = end_index;
-        if (max_index > buffer_len) {
-            return false;   // cannot accommodate reassembled data
-        }
-        if (index >= buffer_len) {
+        if (index >= limit) {
             return true;    // ignore this seg
         }
 
-        // TODO: check for datum len
-        uint32_t len = end_index > buffer_len ? (buffer_len-index):seg_len;
-        memcpy(data+index, p.data, len);
+        if (!copy_data(p)) {
+            return false;
+        }
         current_bytes += seg_len;
         return true;
     }
@@ -372,8 +649,7 @@ struct tcp_segment {
         bool is_initial = (seq_init == curr_seq);
 
         if (is_initial) {
-            total_bytes_needed = seg_len + tcp_pkt.additional_bytes_needed;
-            max_index = total_bytes_needed;
+            set_total(seg_len + tcp_pkt.additional_bytes_needed);
         }
 
         index = curr_seq - seq_init;
@@ -391,16 +667,13 @@ struct tcp_segment {
             seg_overlap = true;
         }
 
-        if (max_index > buffer_len) {
-            return nullptr;   // cannot accommodate reassembled data
-        }
-        if (index >= buffer_len) {
+        if (index >= limit) {
             return this;    // ignore this seg
         }
 
-        // TODO: check for datum len
-        uint32_t len = end_index > buffer_len ? (buffer_len-index):seg_len;
-        memcpy(data+index, p.data, len);
+        if (!copy_data(p)) {
+            return nullptr;
+        }
         current_bytes += seg_len;
 
         if (current_bytes >= total_bytes_needed) {
@@ -411,7 +684,8 @@ struct tcp_segment {
     }
 
     struct datum get_reassembled_segment() {
-        struct datum reassembled_tcp_data{data, data + total_bytes_needed};
+        uint32_t len = total_bytes_needed < buffer_len ? total_bytes_needed : buffer_len;
+        struct datum reassembled_tcp_data{data, data + len};
         return reassembled_tcp_data;
     }
 
@@ -561,94 +835,207 @@ enum reassembly_status {
     truncated = 3   // truncated but cant reassemble as sync seq not known TODO: Try reassmbling wihtout syn seq
 };
 
-struct tcp_reassembler {
+// struct tcp_reassembly_stats counts the outcomes of the reassemblies
+// of a tcp_reassembler; they are reported through
+// mercury_packet_processor_get_stats()
+//
+struct tcp_reassembly_stats {
+    uint64_t started = 0;          // reassemblies started
+    uint64_t completed = 0;        // messages reassembled and reported
+    uint64_t extended = 0;         // reassembled messages found incomplete, and extended
+    uint64_t budget_exceeded = 0;  // messages reported only up to the budget
+    uint64_t incomplete = 0;       // reassemblies that expired or were discarded before completion
+    uint64_t refused = 0;          // reassemblies not started, for lack of room
+    uint64_t duplicates = 0;       // retransmitted segments of completed messages that were skipped
+};
+
+// struct tcp_reassembled_range records the sequence numbers of a
+// message that has been reassembled and reported
+//
+struct tcp_reassembled_range {
+    uint32_t seq_begin;
+    uint32_t seq_end;
+};
+
+// struct tcp_reassembler holds the segments being reassembled, each
+// of which is registered with a timer wheel, which removes it when it
+// expires.  The segments are kept in a flow_map of at most
+// max_map_entries entries, which are only added with try_emplace(),
+// so that reassemblies in progress are never evicted: when the table
+// (or the probe sequence of a flow) is full, no new reassembly is
+// started until a segment is done or expires.
+//
+// At most budget bytes of each message are reassembled; the rest of
+// a longer message is ignored.  Once a message has been reassembled
+// and reported, its range of sequence numbers is remembered for
+// tcp_segment::timeout seconds, so that retransmissions of its
+// segments can be skipped rather than parsed and reported again.
+//
+struct tcp_reassembler : public timer_client {
     bool dump_pkt;          // current pkt involved in reassembly, dump pkt regardless of json
     bool curr_reassembly_consumed;
     enum reassembly_status curr_reassembly_state;
 
     static const uint32_t max_map_entries = 10000;  // Hard limit to map entries
+    static const uint32_t default_budget = 32768;
+    static const uint32_t completed_entries = 4096;
+
+    using segment_map = flow_map<struct tcp_segment>;
+
+    reassembly_buffer_pool buffers;   // must outlive segment_table
+    segment_map segment_table;
+    segment_map::entry *curr_entry;   // segment of the current packet, or nullptr
+    timer_wheel &timers;
+    flow_map<struct tcp_reassembled_range> completed;
+    uint32_t budget;
+    struct tcp_reassembly_stats stats;
+
+    tcp_reassembler(unsigned int size, timer_wheel &wheel) : dump_pkt{false}, curr_reassembly_consumed{false}, curr_reassembly_state{reassembly_none}, buffers{},
+                                                             segment_table{size && size < max_map_entries ? size : max_map_entries, tcp_segment::timeout},
+                                                             curr_entry{nullptr}, timers{wheel},
+                                                             completed{completed_entries, tcp_segment::timeout, &wheel}, budget{default_budget}, stats{} { }
+
+    // set_budget(bytes) sets the most bytes of a message that are
+    // reassembled; zero selects the default
+    //
+    void set_budget(uint32_t bytes) {
+        if (bytes == 0) {
+            bytes = default_budget;
+        }
+        if (bytes < reassembly_buffer_pool::class_size[0]) {
+            bytes = reassembly_buffer_pool::class_size[0];
+        }
+        if (bytes > tcp_segment::max_buffer_len) {
+            bytes = tcp_segment::max_buffer_len;
+        }
+        budget = bytes;
+    }
 
-    std::unordered_map<struct key, struct tcp_segment> segment_table;
-    std::unordered_map<struct key, struct tcp_segment>::iterator reap_it;
-
-    tcp_reassembler(unsigned int size) : dump_pkt{false}, curr_reassembly_consumed{false}, curr_reassembly_state{reassembly_none}, segment_table{}, reap_it{segment_table.end()} {
-        segment_table.reserve(size);
-        reap_it = segment_table.end();
+    ~tcp_reassembler() {
+        count_all();
     }
 
     bool init_segment(const struct key &k, unsigned int sec, struct tcp_seg_context &tcp_pkt, uint32_t syn_seq, datum &p) {
+        curr_entry = nullptr;
         if (segment_table.size() >= max_map_entries) {
-            // aggressive : remove two entries
-            increment_reap_iterator();
-            if (reap_it != segment_table.end()) {
-                reap_it = segment_table.erase(reap_it);
-            }
-            increment_reap_iterator();
-            if (reap_it != segment_table.end()) {
-                reap_it = segment_table.erase(reap_it);
-            }
-        }
-        else {
-            reap(sec);  // passive: try cleaning expired entries
+            stats.refused++;
+            return false;
         }
 
-        tcp_segment segment;
-        if (segment.init_from_pkt(sec, tcp_pkt, syn_seq, p)) {
-            reap_it = segment_table.emplace(k, segment).first; 
-            //++reap_it;
+        // the segment is constructed in place, since it is never copied
+        //
+        auto [e, inserted] = segment_table.try_emplace(k, sec, buffers, budget);
+        if (e == nullptr) {
+            stats.refused++;          // no free slot for this flow
+            return false;
+        }
+        if (!inserted) {
+            curr_entry = e;           // already being reassembled
             return true;
         }
-        return false;
+        if (!e->value.init_from_pkt(sec, tcp_pkt, syn_seq, p)) {
+            segment_table.erase(e);
+            stats.refused++;
+            return false;
+        }
+        stats.started++;
+        curr_entry = e;
+        e->value.flow_key = k;
+        timers.schedule(&e->value.expiry_timer, this, sec + tcp_segment::timeout + 1);
+        return true;
     }
 
     bool is_init_seg (const struct key&k, uint32_t seq) {
-        auto it = segment_table.find(k);
-        if (it != segment_table.end()) {
-            return (it->second.seq_init == seq);
+        segment_map::entry *e = segment_table.find(k);
+        if (e != nullptr) {
+            return (e->value.seq_init == seq);
         }
         return false;
     }
 
     struct tcp_segment *check_packet(const struct key &k, unsigned int sec, struct tcp_seg_context &tcp_pkt, datum &p, bool &reassembly_consumed) {
 
-        reap(sec);    // passive cleaning
-        auto it = segment_table.find(k);
-        if (it != segment_table.end()) {
-            if (it->second.expired(sec)) {
-                remove_segment(it);
+        segment_map::entry *e = segment_table.find(k);
+        if (e != nullptr) {
+            if (e->value.expired(sec)) {
+                remove_segment(e);
                 return nullptr;
             }
             // Before adding more data, check if reassembly already done
-            if (it->second.done) {
+            if (e->value.done) {
                 reassembly_consumed = true;
-                return &it->second;
+                return &e->value;
             }
-            reap_it = it;
-            return it->second.check_packet(tcp_pkt, p);
+            curr_entry = e;
+            return e->value.check_packet(tcp_pkt, p);
         }
         return nullptr;
     }
 
-    void remove_segment(key &k) {
-        auto it = segment_table.find(k);
-        if (it != segment_table.end()) {
-            reap_it = segment_table.erase(it);
+    // extend(seg, n) asks for n more bytes of the message in seg, and
+    // returns false if it cannot be extended
+    //
+    bool extend(struct tcp_segment &seg, uint32_t n) {
+        if (seg.extend(n)) {
+            stats.extended++;
+            return true;
         }
+        return false;
     }
 
-    void remove_segment(std::unordered_map<struct key, struct tcp_segment>::iterator it) {
-        if (it != segment_table.end()) {
-            reap_it = segment_table.erase(it);
+    // complete(k, sec, seg) records that the message in seg, of the
+    // flow k, has been reassembled and reported
+    //
+    void complete(const struct key &k, unsigned int sec, const struct tcp_segment &seg) {
+        stats.completed++;
+        if (seg.budget_exceeded) {
+            stats.budget_exceeded++;
         }
+        completed.insert(k, sec, tcp_reassembled_range{seg.seq_init, seg.seq_init + seg.total_bytes_needed});
     }
 
-    void count_all() {
-        auto it = segment_table.begin();
-        while (it != segment_table.end()) {
-            it = segment_table.erase(it);
+    // is_duplicate(k, sec, seq) returns true if the segment of the
+    // flow k with sequence number seq belongs to a message that has
+    // already been reassembled and reported
+    //
+    bool is_duplicate(const struct key &k, unsigned int sec, uint32_t seq) {
+        auto *e = completed.find(k);
+        if (e == nullptr || sec - e->sec >= tcp_segment::timeout) {
+            return false;
+        }
+        if (seq - e->value.seq_begin < e->value.seq_end - e->value.seq_begin) {
+            stats.duplicates++;
+            return true;
+        }
+        return false;
+    }
+
+    void remove_segment(key &k) {
+        remove_segment(segment_table.find(k));
+    }
+
+    void remove_segment(segment_map::entry *e) {
+        if (e != nullptr) {
+            if (e == curr_entry) {
+                curr_entry = nullptr;
+            }
+            timers.cancel(&e->value.expiry_timer);
+            segment_table.erase(e);
         }
     }
 
+    void count_all() {
+        segment_table.for_each([this](segment_map::entry &e) {
+            timers.cancel(&e.value.expiry_timer);
+            if (!e.value.done) {
+                stats.incomplete++;
+            }
+        });
+        completed.clear();
+        segment_table.clear();
+        curr_entry = nullptr;
+    }
+
     void write_flags(struct json_object &record, const char *key) {
         if (curr_reassembly_state == truncated) {
             // truncated but not in reassembly
@@ -658,17 +1045,20 @@ struct tcp_reassembler {
             return;
         }
 
-        if (reap_it == segment_table.end()) {
+        if (curr_entry == nullptr) {
             return;
         }
-        if (reap_it->second.done) {
+        if (curr_entry->value.done) {
             struct json_object flags{record, key};
             flags.print_key_bool("reassembled", true);
-            if (reap_it->second.seg_overlap) {
-                flags.print_key_bool("segment_overlap", reap_it->second.seg_overlap);
+            if (curr_entry->value.seg_overlap) {
+                flags.print_key_bool("segment_overlap", curr_entry->value.seg_overlap);
+            }
+            if (curr_entry->value.max_seg_exceed) {
+                flags.print_key_bool("segment_count_exceed", curr_entry->value.max_seg_exceed);
             }
-            if (reap_it->second.max_seg_exceed) {
-                flags.print_key_bool("segment_count_exceed", reap_it->second.max_seg_exceed);
+            if (curr_entry->value.budget_exceeded) {
+                flags.print_key_bool("budget_exceeded", true);
             }
             flags.close();
         }
@@ -677,70 +1067,60 @@ struct tcp_reassembler {
             flags.print_key_bool("truncated", true);
             flags.close();
         }
-        reap_it = segment_table.end();
+        curr_entry = nullptr;
         return;
     }
 
-    void reap(unsigned int sec) {
-
-        // check for expired flows
-        increment_reap_iterator();
-        if (reap_it != segment_table.end() && reap_it->second.expired(sec)) {
-            reap_it = segment_table.erase(reap_it);
-        }
-        increment_reap_iterator();
-        if (reap_it != segment_table.end() && reap_it->second.expired(sec)) {
-            reap_it = segment_table.erase(reap_it);
+    // expire(t, now) is called by the timer wheel when the segment
+    // whose timer is t has expired
+    //
+    void expire(struct wheel_timer *t, unsigned int now) override {
+        struct tcp_segment *seg = tcp_segment::from_timer(t);
+        if (!seg->expired(now)) {
+            timers.schedule(t, this, seg->init_time + tcp_segment::timeout + 1);
+            return;
         }
-    }
-
-    void increment_reap_iterator() {
-        if (reap_it != segment_table.end()) {
-            ++reap_it;
-        } else {
-            reap_it = segment_table.begin();
+        segment_map::entry *e = segment_table.find(seg->flow_key);
+        if (e != nullptr) {
+            if (e == curr_entry) {
+                curr_entry = nullptr;
+            }
+            if (!e->value.done) {
+                stats.incomplete++;
+            }
+            segment_table.erase(e);
         }
     }
 };
 
+// struct flow_table
+//
+// goal: identify the first packet of each flow, where a flow that has
+// been idle for more than timeout seconds starts anew.
+//
+// approach: map each flow key to the time at which the flow was last
+// seen, in a flow_map of fixed capacity; when the map is full, the
+// least recently seen flows are forgotten first.
+
 struct flow_table {
-    std::unordered_map<struct key, unsigned int> table;
-    std::unordered_map<struct key, unsigned int>::iterator reap_it;
+    flow_map<flow_map_no_value> table;
+    static constexpr size_t default_size = 65536;
 
-    flow_table(unsigned int size) : table{}, reap_it{table.end()} {
-        table.reserve(size);
-        reap_it = table.end();
-    }
+    flow_table(unsigned int size, timer_wheel &timers) : table{size ? size : default_size, flow_table::timeout, &timers} { }
 
     bool flow_is_new(const struct key &k, unsigned int sec) {
 
-        auto it = table.find(k);
-        if (it != table.end() && (sec - it->second < flow_table::timeout)) {
-            it->second = sec;
-            reap(sec);
+        auto *e = table.find(k);
+        if (e != nullptr && (sec - e->sec < flow_table::timeout)) {
+            e->sec = sec;
             //printf_err(log_debug, "FLOW OLD\n");
             return false;
         }
-        auto tmp = table.insert({k, sec}).first;
-        update_reap_iterator(tmp);
+        table.insert(k, sec);
         //printf_err(log_debug, "FLOW NEW\n");
         return true;
     }
 
-    void reap(unsigned int sec) {
-
-        // check for expired flows
-        if (reap_it != table.end() && (sec - reap_it->second > flow_table::timeout)) {
-            reap_it = table.erase(reap_it);
-        }
-    }
-
-    void update_reap_iterator(std::unordered_map<struct key, unsigned int>::iterator x) {
-        if (x != table.end()) {
-            reap_it = x++;
-        }
-    }
-
     static const unsigned int timeout = 60 * 60; // seconds before flow timeout
 
 };
@@ -752,17 +1132,16 @@ struct flow_table {
 // false positives.
 //
 // approach: create a tcp_context when a SYN packet is observed, and
-// when the first data packet is observed, delete the context;
-// randomly traverse the table of tcp_contexts and check for expired
-// elements.
+// when the first data packet is observed, delete the context; the
+// tcp_contexts are kept in a flow_map of at most max_entries entries,
+// in which expired contexts are reused, and the oldest contexts are
+// evicted when there is no room for a new one.
 
 
 struct tcp_context {
 public:
     tcp_context(unsigned int seconds, uint32_t sequence_number) : sec{seconds}, seq{sequence_number+1} {}
 
-    ~tcp_context() {}
-
     bool is_expired(unsigned int current_time) {
         return (current_time - sec) >= timeout;
     }
@@ -776,65 +1155,42 @@ public:
         return seq;
     }
 
+    static const unsigned int timeout = 30; // seconds before flow timeout
+
 private:
     unsigned int sec;
     uint32_t seq;
-
-    static const unsigned int timeout = 30; // seconds before flow timeout
 };
 
 struct flow_table_tcp {
-    std::unordered_map<struct key, struct tcp_context> table;
-    std::unordered_map<struct key, struct tcp_context>::iterator reap_it;
+    flow_map<struct tcp_context> table;
     static constexpr uint32_t max_entries = 20000;
 
-    flow_table_tcp(unsigned int size) : table{}, reap_it{table.end()} {
-        table.reserve(size);
-        reap_it = table.end();
-    }
+    flow_table_tcp(unsigned int size, timer_wheel &timers) : table{size && size < max_entries ? size : max_entries, tcp_context::timeout, &timers} { }
 
     void syn_packet(const struct key &k, unsigned int sec, uint32_t seq) {
-        if (table.size() >= max_entries) {
-            // aggressive : try to remove two entries
-            increment_reap_iterator();
-            if (reap_it != table.end()) {
-                reap_it = table.erase(reap_it);
-            }
-            increment_reap_iterator();
-            if (reap_it != table.end()) {
-                reap_it = table.erase(reap_it);
-            }
-        }
-        else {
-            reap(sec);  // passive: try clean expired entries
-        }
-        auto it = table.find(k);
-        if (it == table.end()) {
-            table.insert({k, {sec, seq}});
+        if (table.find(k) == nullptr) {
+            table.insert(k, sec, sec, seq);
             // printf_err(log_debug, "tcp_flow_table size: %zu\n", table.size());
         }
     }
 
     void find_and_erase(const struct key &k) {
-        auto it = table.find(k);
-        if (it != table.end()) {
-            reap_it = table.erase(it);
-        }
+        table.erase(k);
     }
 
     bool is_first_data_packet(const struct key &k, unsigned int sec, uint32_t seq) {
-        auto it = table.find(k);
-        if (it != table.end()) {
-            if (it->second.is_expired(sec)) {
-                reap_it = table.erase(it);
+        auto *e = table.find(k);
+        if (e != nullptr) {
+            if (e->value.is_expired(sec)) {
+                table.erase(e);
                 return true;
             }
-            if (it->second.seq_is_equal_to(seq)) {
-                reap_it = table.erase(it);
+            if (e->value.seq_is_equal_to(seq)) {
+                table.erase(e);
                 return true;
             }
         }
-        reap(sec);
         return false;
     }
 
@@ -842,59 +1198,32 @@ struct flow_table_tcp {
     //
     uint32_t check_flow(const struct key &k, unsigned int sec, uint32_t seq, bool &initial_seq, bool &expired) {
         uint32_t syn_seq;
-        auto it = table.find(k);
-        if (it != table.end()) {
-            if (it->second.is_expired(sec)) {
-                syn_seq = it->second.get_seq();
-                reap_it = table.erase(it);
+        auto *e = table.find(k);
+        if (e != nullptr) {
+            if (e->value.is_expired(sec)) {
+                syn_seq = e->value.get_seq();
+                table.erase(e);
                 expired = true;
                 return syn_seq;
             }
-            if (it->second.seq_is_equal_to(seq)) {
-                reap_it = table.erase(it);
+            if (e->value.seq_is_equal_to(seq)) {
+                table.erase(e);
                 initial_seq = true;
                 return seq;
             }
-            else if (it->second.seq_is_greater(seq)) {
-                syn_seq = it->second.get_seq();
-                reap_it = table.erase(it);
+            else if (e->value.seq_is_greater(seq)) {
+                syn_seq = e->value.get_seq();
+                table.erase(e);
                 return syn_seq;       
             }
         }
-        reap(sec);
         return 0;    
     }
 
-    void reap(unsigned int sec) {
-
-        // check for expired flows
-        increment_reap_iterator();
-        if (reap_it != table.end() && reap_it->second.is_expired(sec)) {
-            reap_it = table.erase(reap_it);
-        }
-        increment_reap_iterator();
-        if (reap_it != table.end() && reap_it->second.is_expired(sec)) {
-            reap_it = table.erase(reap_it);
-        }
-    }
-
-    void increment_reap_iterator() {
-        if (reap_it != table.end()) {
-            ++reap_it;
-        } else {
-            reap_it = table.begin();
-        }
-    }
-
     void count_all() {
-        auto it = table.begin();
-        while (it != table.end()) {
-            it = table.erase(it);
-        }
+        table.clear();
     }
 
-    static const unsigned int timeout = 1; // seconds before flow timeout
-
 };
 
 #endif /* MERC_TCP_H */
@@ -0,0 +1,241 @@
+// timer_wheel.h
+//
+// a hierarchical timer wheel, driven by packet timestamps
+//
+// Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.
+// License at https://github.com/cisco/mercury/blob/master/LICENSE
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+class timer_client;
+
+// struct wheel_timer is an intrusive link, which is embedded in (or kept
+// alongside) an object that expires; a timer whose prev pointer is
+// null is not scheduled.  A zeroized timer is a valid, unscheduled
+// timer.
+//
+struct wheel_timer {
+    struct wheel_timer *next;
+    struct wheel_timer *prev;
+    class timer_client *client;
+    unsigned int expires;          // time (in seconds) at which the timer fires
+
+    bool is_scheduled() const { return prev != nullptr; }
+};
+
+// class timer_client is the interface through which a timer_wheel
+// tells the owner of a timer that it has fired.  When expire(t, now)
+// is called, t has already been unscheduled, and the client can
+// either discard the object that t belongs to, or schedule t again
+// (for instance, if the object was touched after t was scheduled).
+//
+class timer_client {
+public:
+    virtual void expire(struct wheel_timer *t, unsigned int now) = 0;
+    virtual ~timer_client() { }
+};
+
+// class timer_wheel fires each timer at the first tick of the wheel
+// at or after its expiry time, in O(1) time per timer.  The wheel
+// ticks once per second, and its time is advanced by advance(sec),
+// which a packet processor calls with the timestamp of each packet,
+// so that expiry is driven by packet time rather than by wall-clock
+// time, and is the same whether packets are captured or read from a
+// file.  Timestamps that are earlier than the current time of the
+// wheel do not move it backwards.
+//
+// There are levels levels of slots slots each; a timer that expires
+// within slots seconds is kept in level 0, one that expires within
+// slots^2 seconds in level 1, and so on, and a timer is moved down a
+// level when the wheel reaches its slot.  A timer further out than the
+// range of the wheel is kept at the end of the range, until it comes
+// within it.
+//
+class timer_wheel {
+public:
+    static constexpr unsigned int level_bits = 6;
+    static constexpr unsigned int slots = 1 << level_bits;
+    static constexpr unsigned int levels = 4;
+    static constexpr unsigned int range = 1 << (level_bits * levels);   // about 194 days
+
+    timer_wheel() {
+        for (unsigned int l = 0; l < levels; l++) {
+            for (unsigned int s = 0; s < slots; s++) {
+                list_init(&wheel[l][s]);
+            }
+        }
+    }
+
+    timer_wheel(const timer_wheel &) = delete;
+    timer_wheel &operator=(const timer_wheel &) = delete;
+
+    // schedule(t, c, expires) schedules the timer t to fire at time
+    // expires, and to be reported to the client c; if t is already
+    // scheduled, it is rescheduled.  A timer that expires at or before
+    // the current time fires at the next tick.
+    //
+    void schedule(struct wheel_timer *t, timer_client *c, unsigned int expires) {
+        if (t->is_scheduled()) {
+            unlink(t);
+        } else {
+            count++;
+        }
+        t->client = c;
+        t->expires = expires;
+        place(t, 1);
+    }
+
+    void cancel(struct wheel_timer *t) {
+        if (t->is_scheduled()) {
+            unlink(t);
+            count--;
+        }
+    }
+
+    // advance(sec) moves the time of the wheel forward to sec, firing
+    // every timer that expires at or before sec
+    //
+    void advance(unsigned int sec) {
+        if (!started) {
+            current = sec;
+            started = true;
+            return;
+        }
+        if ((int)(sec - current) <= 0) {
+            return;
+        }
+        if (count == 0) {
+            current = sec;         // nothing to fire, so there is no need to tick
+            return;
+        }
+        if (sec - current >= range) {
+            expire_all(sec);       // every timer is due, so there is no need to tick
+            return;
+        }
+        while (current != sec) {
+            tick();
+        }
+    }
+
+    unsigned int now() const { return current; }
+
+    size_t size() const { return count; }
+
+private:
+    struct wheel_timer wheel[levels][slots];   // list heads
+    unsigned int current = 0;            // the time of the last tick
+    bool started = false;
+    size_t count = 0;                    // number of scheduled timers
+
+    static void list_init(struct wheel_timer *head) {
+        head->next = head;
+        head->prev = head;
+    }
+
+    static void unlink(struct wheel_timer *t) {
+        t->prev->next = t->next;
+        t->next->prev = t->prev;
+        t->next = nullptr;
+        t->prev = nullptr;
+    }
+
+    static void link(struct wheel_timer *head, struct wheel_timer *t) {
+        t->next = head;
+        t->prev = head->prev;
+        head->prev->next = t;
+        head->prev = t;
+    }
+
+    // place(t, min_delta) puts t in the slot for its expiry time,
+    // relative to the current time of the wheel, but at least
+    // min_delta seconds ahead; min_delta is zero only while the
+    // current tick is moving timers down, before its level 0 slot is
+    // fired
+    //
+    void place(struct wheel_timer *t, unsigned int min_delta) {
+        unsigned int delta = t->expires - current;
+        if ((int)delta < (int)min_delta) {
+            delta = min_delta;
+        } else if (delta >= range) {
+            delta = range - 1;
+        }
+        unsigned int when = current + delta;
+        unsigned int level = 0;
+        while (level < levels - 1 && delta >= (1u << (level_bits * (level + 1)))) {
+            level++;
+        }
+        link(&wheel[level][(when >> (level_bits * level)) & (slots - 1)], t);
+    }
+
+    void tick() {
+        current++;
+
+        // when the wheel reaches a slot of a higher level, the timers
+        // in that slot are moved down to the lower levels
+        //
+        for (unsigned int level = 1; level < levels; level++) {
+            if ((current & ((1u << (level_bits * level)) - 1)) != 0) {
+                break;
+            }
+            struct wheel_timer pending;
+            take(&wheel[level][(current >> (level_bits * level)) & (slots - 1)], &pending);
+            while (pending.next != &pending) {
+                struct wheel_timer *t = pending.next;
+                unlink(t);
+                place(t, 0);
+            }
+        }
+
+        struct wheel_timer expired;
+        take(&wheel[0][current & (slots - 1)], &expired);
+        while (expired.next != &expired) {
+            struct wheel_timer *t = expired.next;
+            unlink(t);
+            count--;
+            t->client->expire(t, current);
+        }
+    }
+
+    void expire_all(unsigned int sec) {
+        current = sec;
+        struct wheel_timer expired;
+        list_init(&expired);
+        for (unsigned int l = 0; l < levels; l++) {
+            for (unsigned int s = 0; s < slots; s++) {
+                struct wheel_timer slot;
+                take(&wheel[l][s], &slot);
+                while (slot.next != &slot) {
+                    struct wheel_timer *t = slot.next;
+                    unlink(t);
+                    link(&expired, t);
+                }
+            }
+        }
+        while (expired.next != &expired) {
+            struct wheel_timer *t = expired.next;
+            unlink(t);
+            count--;
+            t->client->expire(t, current);
+        }
+    }
+
+    // take(head, list) moves all of the timers on head to list
+    //
+    static void take(struct wheel_timer *head, struct wheel_timer *list) {
+        if (head->next == head) {
+            list_init(list);
+            return;
+        }
+        list->next = head->next;
+        list->prev = head->prev;
+        list->next->prev = list;
+        list->prev->next = list;
+        list_init(head);
+    }
+};
+
+#endif // TIMER_WHEEL_H
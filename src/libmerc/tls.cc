@@ -801,7 +801,7 @@ bool tls_client_hello::do_analysis(const struct key &k_, struct analysis_context
 
     analysis_.destination.init(sn, ua, alpn, k_);
 
-    return c_->analyze_fingerprint_and_destination_context(analysis_.fp, analysis_.destination, analysis_.result);
+    return c_->analyze_fingerprint_and_destination_context(analysis_.fp, analysis_.destination, analysis_.result, analysis_.cache);
 }
 
 void tls_server_hello::parse(struct datum &p) {
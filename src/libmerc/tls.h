@@ -220,11 +220,11 @@ struct tls_handshake {
 
     tls_handshake() : msg_type{handshake_type::unknown}, length{0}, body{NULL, NULL}, additional_bytes_needed{0} {}
 
-    tls_handshake(struct datum &d) : msg_type{handshake_type::unknown}, length{0}, body{NULL, NULL} {
-        parse(d);
+    tls_handshake(struct datum &d, unsigned int max_len=max_handshake_len) : msg_type{handshake_type::unknown}, length{0}, body{NULL, NULL} {
+        parse(d, max_len);
     }
 
-    void parse(struct datum &d) {
+    void parse(struct datum &d, unsigned int max_len=max_handshake_len) {
         if (d.length() < (int)(4)) {
             return;
         }
@@ -232,7 +232,7 @@ struct tls_handshake {
         uint64_t tmp;
         d.read_uint(&tmp, L_HandshakeLength);
         length = tmp;
-        if (length > max_handshake_len) {
+        if (length > max_len) {
             return;
         }
         body.init_from_outer_parser(&d, length);
@@ -431,39 +431,120 @@ struct tls_server_hello : public base_protocol {
 
 };
 
+// class tls_handshake_stream collects the handshake messages carried
+// in the sequence of TLS records at the start of a TCP data field,
+// with the record headers removed, so that a message that spans
+// records, like a long certificate chain, can be parsed as a whole.
+// It also tracks where the record stream was cut off, so that the
+// number of TCP bytes needed to complete a message can be computed.
+// The data of a single record is used in place; the fragments of
+// multiple records are copied into buffer.  Each stateful_pkt_proc
+// owns one tls_handshake_stream, which is reused for each packet.
+//
+class tls_handshake_stream {
+public:
+    static constexpr size_t max_record_len = 16384;    // 2^14, from RFC 8446 Section 5.1
+    static constexpr size_t record_header_len = 5;
+    static constexpr size_t max_length = tls_server_certificate::max_length + 1024;
+
+    tls_handshake_stream() : buffer{}, handshake{nullptr, nullptr}, record_remainder{0}, header_bytes{0}, end_of_handshake{false} { }
+
+    // collect(d) reads the TLS records in d, up to the first one that
+    // is not a handshake record, and returns the concatenation of
+    // their fragments
+    //
+    datum collect(datum d) {
+        buffer.reset();
+        handshake = { nullptr, nullptr };
+        record_remainder = 0;
+        header_bytes = 0;
+        end_of_handshake = false;
+        size_t records = 0;
+        while (d.is_not_empty()) {
+            if (d.length() < (ssize_t)record_header_len) {
+                header_bytes = d.length();
+                break;
+            }
+            struct tls_record rec{d};
+            if (rec.content_type != (uint8_t)tls_content_type::handshake) {
+                end_of_handshake = true;
+                break;
+            }
+            if (++records == 1) {
+                handshake = rec.fragment;
+            } else {
+                if (records == 2) {
+                    buffer.copy(handshake.data, handshake.length());
+                }
+                buffer.copy(rec.fragment.data, rec.fragment.length());
+                handshake = buffer.contents();
+            }
+            if (rec.fragment.length() < rec.length) {
+                record_remainder = rec.length - rec.fragment.length();
+                break;
+            }
+        }
+        return handshake;
+    }
+
+    // tcp_bytes_needed(n) returns the number of bytes that must follow
+    // the data passed to collect() to provide n more bytes of
+    // handshake data; if the records after the end of that data have
+    // not been seen, then they are assumed to be as long as possible,
+    // so the result may be too small, but is never too large
+    //
+    size_t tcp_bytes_needed(size_t n) const {
+        if (end_of_handshake || handshake.is_null()) {
+            return 0;
+        }
+        if (n <= record_remainder) {
+            return n;
+        }
+        size_t rest = n - record_remainder;
+        size_t records = (rest + max_record_len - 1) / max_record_len;
+        return record_remainder + rest + records * record_header_len - header_bytes;
+    }
+
+private:
+    data_buffer<max_length> buffer;
+    datum handshake;
+    size_t record_remainder;    // bytes missing from the last record
+    size_t header_bytes;        // bytes of a record header that was cut off
+    bool end_of_handshake;      // a record that is not a handshake record was seen
+};
+
 class tls_server_hello_and_certificate : public base_protocol {
     struct tls_server_hello hello;
     struct tls_server_certificate certificate;
 
 public:
-    tls_server_hello_and_certificate(struct datum &pkt, struct tcp_packet *tcp_pkt) : hello{}, certificate{} {
-        parse(pkt, tcp_pkt);
+    tls_server_hello_and_certificate(struct datum &pkt, struct tcp_packet *tcp_pkt, tls_handshake_stream &stream) : hello{}, certificate{} {
+        parse(pkt, tcp_pkt, stream);
     }
 
-    void parse(struct datum &pkt, struct tcp_packet *tcp_pkt) {
+    // parse(pkt, tcp_pkt, stream) parses the server_hello and/or
+    // certificate in pkt, which may span several records; if the
+    // certificate is incomplete, then the number of bytes needed to
+    // complete it is passed to tcp_pkt, for reassembly
+    //
+    void parse(struct datum &pkt, struct tcp_packet *tcp_pkt, tls_handshake_stream &stream) {
 
-        // parse server_hello and/or certificate
-        //
-        struct tls_record rec{pkt};
-        struct tls_handshake handshake{rec.fragment};
+        datum messages = stream.collect(pkt);
+        struct tls_handshake handshake{messages, tls_server_certificate::max_length};
         if (handshake.msg_type == handshake_type::server_hello) {
             hello.parse(handshake.body);
-            if (rec.is_not_empty()) {
-                struct tls_handshake h;
-                h.parse(rec.fragment);
-                certificate.parse(h.body);
+            if (handshake.additional_bytes_needed == 0) {
+                handshake = tls_handshake{messages, tls_server_certificate::max_length};
             }
-
-        } else if (handshake.msg_type == handshake_type::certificate) {
-            certificate.parse(handshake.body);
-        }
-        struct tls_record rec2{pkt};
-        struct tls_handshake handshake2{rec2.fragment};
-        if (handshake2.msg_type == handshake_type::certificate) {
-            certificate.parse(handshake2.body);
         }
-        if (tcp_pkt && certificate.additional_bytes_needed) {
-            tcp_pkt->reassembly_needed(certificate.additional_bytes_needed);
+        if (handshake.msg_type == handshake_type::certificate) {
+            certificate.parse(handshake.body);
+            if (tcp_pkt && handshake.additional_bytes_needed) {
+                size_t needed = stream.tcp_bytes_needed(handshake.additional_bytes_needed);
+                if (needed) {
+                    tcp_pkt->reassembly_needed(needed);
+                }
+            }
         }
     }
 
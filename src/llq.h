@@ -9,71 +9,341 @@
 #define LLQ_H
 
 #include <unistd.h>
+#include <stdint.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <atomic>
 
-#define LLQ_MSG_SIZE 16384   /* The number of bytes allowed for each message in the lockless queue */
-#define LLQ_DEPTH    2048    /* The number of "buckets" (queue messages) allowed */
-#define LLQ_MAX_AGE  5       /* Maximum age (in seconds) messages are allowed to sit in a queue */
+#define LLQ_MSG_SIZE 131072     /* The maximum number of bytes allowed for each message in the lockless queue (room for a 64 KB certificate chain in JSON) */
+#define LLQ_BUF_SIZE (1 << 21)  /* The number of bytes in each queue's ring buffer (must be a power of two) */
+#define LLQ_MAX_AGE  5          /* Maximum age (in seconds) messages are allowed to sit in a queue */
+#define LLQ_PARK_NSEC 100000000 /* Maximum time (in nanoseconds) a thread is parked before it re-checks its queue(s) */
 
-/* The message object suitable for the std::priority_queue */
+/*
+ * struct llq_event is an "event count" built on a futex, which lets
+ * a single thread park until another thread tells it that the
+ * condition it is waiting for might have changed.  To avoid lost
+ * wake-ups, the waiter calls prepare_wait(), re-checks its condition,
+ * and then calls either cancel_wait() or wait(); a notifier changes
+ * the condition and then calls notify().  Only the first notify()
+ * after the waiter has parked makes a system call, so a notifier can
+ * call it for every change without much cost, and all of the changes
+ * made while the waiter is waking up are covered by one wake-up.
+ */
+struct llq_event {
+    std::atomic<uint32_t> seq;
+    std::atomic<uint32_t> parked;
+    std::atomic<uint64_t> parks;    /* The number of times the waiter was parked */
+    std::atomic<uint64_t> wakeups;  /* The number of wake-up calls made */
+
+    void init() {
+        seq = 0;
+        parked = 0;
+        parks = 0;
+        wakeups = 0;
+    }
+
+    uint32_t prepare_wait() {
+        parked.store(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return seq.load(std::memory_order_seq_cst);
+    }
+
+    void cancel_wait() {
+        parked.store(0, std::memory_order_relaxed);
+    }
+
+    void wait(uint32_t key, long nsec) {
+        struct timespec timeout = { nsec / 1000000000, nsec % 1000000000 };
+        parks.fetch_add(1, std::memory_order_relaxed);
+        syscall(SYS_futex, (uint32_t *)&seq, FUTEX_WAIT_PRIVATE, key, &timeout, NULL, 0);
+        parked.store(0, std::memory_order_relaxed);
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed) != 0 && parked.exchange(0) != 0) {
+            seq.fetch_add(1, std::memory_order_seq_cst);
+            wakeups.fetch_add(1, std::memory_order_relaxed);
+            syscall(SYS_futex, (uint32_t *)&seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+        }
+    }
+};
+
+/*
+ * struct llq_msg is the header of a variable-length record in the
+ * ring buffer of an ll_queue; the message body (buf) immediately
+ * follows the header.  A record whose rec_len is zero marks the point
+ * at which the writer wrapped around to the start of the ring.
+ */
 struct llq_msg {
-    volatile int used; /* The flag that says if this object is actually in use (if not, it's available) */
-    char buf[LLQ_MSG_SIZE];
-    ssize_t len;
+    size_t rec_len;     /* The (aligned) number of bytes this record occupies in the ring, including this header */
+    ssize_t len;        /* The number of bytes in buf */
     struct timespec ts;
+    char buf[];
+
+    static constexpr size_t align = alignof(struct timespec);
+
+    static size_t record_length(size_t length) {
+        return (sizeof(struct llq_msg) + length + (align - 1)) & ~(align - 1);
+    }
 
     void send(ssize_t length) {
         len = length;
-        // A full memory barrier prevents the following flag set from happening too soon
-        __sync_synchronize();
-        used = 1;
+        rec_len = record_length(length);
+    }
+};
+
+/*
+ * struct llq_stats holds the backpressure counters of an ll_queue.
+ * They are written only by the producer, and can be read by any
+ * thread; high_water is reset with exchange() by whoever reads it
+ * periodically, and raised by the producer with a compare-and-swap
+ * loop, so that a maximum is never lost to a concurrent reset.
+ */
+struct llq_stats {
+    std::atomic<uint64_t> msgs;          /* The number of messages enqueued */
+    std::atomic<uint64_t> bytes;         /* The number of message bytes enqueued */
+    std::atomic<uint64_t> drops;         /* The number of messages dropped because the queue was full */
+    std::atomic<uint64_t> blocked_nsec;  /* The time the producer spent waiting for space */
+    std::atomic<uint64_t> high_water;    /* The largest number of ring bytes in use */
+
+    void init() {
+        msgs = 0;
+        bytes = 0;
+        drops = 0;
+        blocked_nsec = 0;
+        high_water = 0;
+    }
+
+    static void increment(std::atomic<uint64_t> &counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
     }
 };
 
+static_assert((LLQ_BUF_SIZE & (LLQ_BUF_SIZE - 1)) == 0, "LLQ_BUF_SIZE must be a power of two");
+static_assert(LLQ_BUF_SIZE >= 4 * (sizeof(struct llq_msg) + LLQ_MSG_SIZE), "LLQ_BUF_SIZE is too small");
 
-/* a "lockless" queue */
+
+/*
+ * struct ll_queue is a "lockless" single-producer, single-consumer
+ * queue of variable-length messages.
+ *
+ * The producer (a packet processing thread) reserves room for a
+ * message of up to LLQ_MSG_SIZE bytes with init_msg(), writes the
+ * message body directly into the ring, then records its actual length
+ * with llq_msg::send() and publishes it with increment_widx().  Only
+ * the bytes that were actually written are consumed from the ring.
+ *
+ * The consumer (the output thread) looks at the oldest unread message
+ * with peek(), moves past it with advance_ridx(), and returns the
+ * space up to a read index that it has moved past to the producer with
+ * release().  Since space is not reclaimed until release() is called,
+ * the consumer can hand several messages to a vectored write, which
+ * may complete asynchronously, without copying them out of the ring.
+ *
+ * When the ring is full, a blocking producer parks on space_ready
+ * until release() makes room.  The consumer parks on data_ready, which
+ * is shared by all of the queues that it reads, until a producer
+ * publishes a message, or a batch of messages.
+ *
+ * widx, ridx, and rel_idx are byte offsets that increase
+ * monotonically; their position in the ring is the offset modulo
+ * LLQ_BUF_SIZE.
+ */
 struct ll_queue {
     int qnum;  /* This is the queue number and is only needed for debugging */
-    int ridx;  /* The read index */
-    int widx;  /* The write index */
-    struct llq_msg msgs[LLQ_DEPTH];
 
-    static const size_t msg_length = LLQ_DEPTH;
+    struct llq_event *data_ready;              /* Shared event on which the consumer parks */
+
+    alignas(64) std::atomic<uint64_t> widx;    /* The write index (written by producer) */
+    struct llq_msg *pending;                   /* The message reserved by init_msg() */
+    size_t pending_pad;                        /* Bytes skipped at the end of the ring to reserve pending */
+    bool in_batch;                             /* The producer is between begin_batch() and end_batch() */
+    bool notify_pending;                       /* A message was published in this batch, but the consumer was not notified */
+    struct llq_stats stats;                    /* Backpressure counters (written by producer) */
+
+    alignas(64) std::atomic<uint64_t> rel_idx; /* The released index (written by consumer) */
+    uint64_t ridx;                             /* The read index (private to consumer) */
+    struct llq_event space_ready;              /* Event on which the producer parks */
+
+    alignas(64) std::atomic<uint64_t> input_pending; /* Input batches handed to the producer but not yet processed */
+
+    alignas(64) uint8_t ring[LLQ_BUF_SIZE];
+
+    void init(int q, struct llq_event *consumer_event) {
+        qnum = q;
+        data_ready = consumer_event;
+        widx = 0;
+        pending = nullptr;
+        pending_pad = 0;
+        in_batch = false;
+        notify_pending = false;
+        rel_idx = 0;
+        ridx = 0;
+        space_ready.init();
+        stats.init();
+        input_pending = 0;
+    }
+
+    uint64_t bytes_in_use(uint64_t w) const {
+        return w - rel_idx.load(std::memory_order_acquire);
+    }
+
+    static uint64_t elapsed_nsec(const struct timespec &start) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (now.tv_sec - start.tv_sec) * 1000000000 + now.tv_nsec - start.tv_nsec;
+    }
 
     struct llq_msg *init_msg(bool blocking, unsigned int sec, unsigned int nsec) {
-        struct llq_msg *m = &msgs[widx];
-        if (blocking) {
-            while (m->used != 0) {
-                usleep(50); // sleep for fifty microseconds
+        const uint64_t w = widx.load(std::memory_order_relaxed);
+        const size_t pos = w & (LLQ_BUF_SIZE - 1);
+        const size_t max_rec = llq_msg::record_length(LLQ_MSG_SIZE);
+
+        /* A message is always contiguous, so if there is not enough
+         * room for the largest possible message between pos and the
+         * end of the ring, we skip to the start of the ring
+         */
+        size_t pad = 0;
+        if (LLQ_BUF_SIZE - pos < max_rec) {
+            pad = LLQ_BUF_SIZE - pos;
+        }
+        uint64_t in_use = bytes_in_use(w);
+        uint64_t high_water = stats.high_water.load(std::memory_order_relaxed);
+        while (in_use > high_water
+               && !stats.high_water.compare_exchange_weak(high_water, in_use, std::memory_order_relaxed)) {
+            ;   /* a concurrent reset or update reloaded high_water */
+        }
+        if (LLQ_BUF_SIZE - in_use < pad + max_rec) {
+            if (!blocking) {
+                llq_stats::increment(stats.drops, 1);
+                return nullptr;
+            }
+            notify_consumer();  /* the consumer must not wait for the end of a batch that is waiting for it */
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            while (LLQ_BUF_SIZE - bytes_in_use(w) < pad + max_rec) {
+                uint32_t key = space_ready.prepare_wait();
+                if (LLQ_BUF_SIZE - bytes_in_use(w) >= pad + max_rec) {
+                    space_ready.cancel_wait();
+                    break;
+                }
+                space_ready.wait(key, LLQ_PARK_NSEC);
             }
+            llq_stats::increment(stats.blocked_nsec, elapsed_nsec(start));
+        }
+        if (pad) {
+            ((struct llq_msg *)&ring[pos])->rec_len = 0;  /* wrap marker */
         }
-        if (m->used == 0) {
 
-            m->ts.tv_sec = sec;
-            m->ts.tv_nsec = nsec;
-            m->buf[0] = '\0';
+        struct llq_msg *m = (struct llq_msg *)&ring[(w + pad) & (LLQ_BUF_SIZE - 1)];
+        m->ts.tv_sec = sec;
+        m->ts.tv_nsec = nsec;
+        m->buf[0] = '\0';
+        pending = m;
+        pending_pad = pad;
+
+        return m;
+    }
 
-            return m;
+    void increment_widx() {
+        if (pending == nullptr) {
+            return;
+        }
+        uint64_t w = widx.load(std::memory_order_relaxed) + pending_pad + pending->rec_len;
+        llq_stats::increment(stats.msgs, 1);
+        llq_stats::increment(stats.bytes, pending->len);
+        pending = nullptr;
+        widx.store(w, std::memory_order_release);
+        if (in_batch) {
+            notify_pending = true;
+        } else {
+            data_ready->notify();
         }
-        //fprintf(stderr, "DEBUG: queue bucket used!\n");
+    }
 
-        // TODO: this is where we'd update an output drop counter
-        // but currently this spot in the code doesn't have access to
-        // any thread stats pointer or similar and I don't want
-        // to update a global variable in this location.
-        return nullptr;
+    /*
+     * Between begin_batch() and end_batch(), the producer does not
+     * notify the consumer each time that it publishes a message;
+     * instead, end_batch() notifies it once for the whole batch
+     */
+    void begin_batch() {
+        in_batch = true;
     }
-    void write_buffer_to_queue() {
+
+    void end_batch() {
+        in_batch = false;
+        notify_consumer();
     }
-    void increment_widx() {
-        widx = (widx + 1) % LLQ_DEPTH;
+
+    void notify_consumer() {
+        if (notify_pending) {
+            notify_pending = false;
+            data_ready->notify();
+        }
+    }
+
+    bool empty() const {
+        return ridx == widx.load(std::memory_order_acquire);
+    }
+
+    struct llq_msg *peek() {
+        const uint64_t w = widx.load(std::memory_order_acquire);
+        if (ridx == w) {
+            return nullptr;
+        }
+        size_t pos = ridx & (LLQ_BUF_SIZE - 1);
+        struct llq_msg *m = (struct llq_msg *)&ring[pos];
+        if (m->rec_len == 0) {
+            /* the writer wrapped around; the next message is at the start of the ring */
+            ridx += LLQ_BUF_SIZE - pos;
+            m = (struct llq_msg *)&ring[0];
+        }
+        return m;
+    }
+
+    void advance_ridx() {
+        ridx += ((struct llq_msg *)&ring[ridx & (LLQ_BUF_SIZE - 1)])->rec_len;
+    }
+
+    void release(uint64_t idx) {
+        if (rel_idx.load(std::memory_order_relaxed) != idx) {
+            rel_idx.store(idx, std::memory_order_release);
+            space_ready.notify();
+        }
     }
 };
 
 
+/*
+ * When the queues are fed from a file rather than a network
+ * interface, input_tracked is set, and the reader counts the batches
+ * of packets that it hands to the producer of each queue in
+ * input_pending.  An empty queue then only holds back the merge of
+ * the queues while input_pending is nonzero, since its producer
+ * cannot publish a message older than those already in the other
+ * queues once it has processed all of its input; and messages are
+ * never flushed out of order because of their age, since the
+ * timestamps of packets in a file have nothing to do with the time
+ * at which they are read.
+ */
 struct thread_queues {
     int qnum;             /* The number of queues that have been allocated */
     int qidx;             /* The index of the first free queue */
     struct ll_queue *queue;      /* The actual queue datastructure */
+    struct llq_event data_ready; /* The event on which the output thread parks */
+    bool input_tracked;          /* The producers are fed from a file; see input_pending */
+
+    /*
+     * may_fill(q) returns false if queue q is known to have no more
+     * messages on the way, given the input handed to its producer so
+     * far; it is checked before the queue is found to be empty
+     */
+    bool may_fill(int q) const {
+        return !input_tracked || queue[q].input_pending.load(std::memory_order_seq_cst) != 0;
+    }
 };
 
 
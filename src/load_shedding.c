@@ -0,0 +1,212 @@
+/*
+ * load_shedding.c
+ *
+ * flow-aware load shedding for the packet worker threads
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc.  All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "load_shedding.h"
+#include "libmerc/eth.h"
+#include "libmerc/ip.h"
+#include "libmerc/proto_identify.h"
+
+static const char *shed_class_names[shed_class_max] = {
+    "tcp_control",
+    "tcp_initial",
+    "udp_initial",
+    "tcp_data",
+    "udp_data",
+    "other"
+};
+
+const char *shed_class_get_name(enum shed_class c) {
+    if (c < shed_class_max) {
+        return shed_class_names[c];
+    }
+    return "unknown";
+}
+
+static inline bool shed_class_is_flow_initial(enum shed_class c) {
+    return c == shed_class_tcp_control || c == shed_class_tcp_initial || c == shed_class_udp_initial;
+}
+
+static inline uint16_t read_u16(const uint8_t *p) {
+    return (p[0] << 8) | p[1];
+}
+
+void load_shedder::init(const traffic_selector *s, bool enabled) {
+    percent_accept = enabled ? 100 : 0;
+    for (int c = 0; c < shed_class_max; c++) {
+        shed[c] = 0;
+        kept[c] = 0;
+    }
+    rng_state = ((uint64_t)(uintptr_t)this << 16) ^ (uint64_t)time(NULL) ^ 0x9e3779b97f4a7c15;
+    selector = s;
+    quiet_intervals = 0;
+}
+
+/*
+ * classify() parses just enough of the Ethernet, IP, and TCP or UDP
+ * headers to tell flow-initial packets from the rest; a data field
+ * is flow-initial if the traffic selector recognizes it, as it would
+ * in stateful_pkt_proc
+ */
+enum shed_class load_shedder::classify(const uint8_t *eth, size_t len) const {
+    size_t offset = 14;
+    if (len < offset) {
+        return shed_class_other;
+    }
+    uint16_t ethertype = read_u16(eth + 12);
+    while (ethertype == ETH_TYPE_VLAN || ethertype == ETH_TYPE_1AD) {
+        if (len < offset + 4) {
+            return shed_class_other;
+        }
+        ethertype = read_u16(eth + offset + 2);
+        offset += 4;
+    }
+
+    const uint8_t *iph = eth + offset;
+    size_t l4_offset, end;
+    uint8_t protocol;
+    if (ethertype == ETH_TYPE_IP) {
+        if (len < offset + 20) {
+            return shed_class_other;
+        }
+        if (read_u16(iph + 6) & 0x1fff) {
+            return shed_class_other;         /* not the first fragment */
+        }
+        protocol = iph[9];
+        l4_offset = offset + (iph[0] & 0x0f) * 4;
+        end = offset + read_u16(iph + 2);
+    } else if (ethertype == ETH_TYPE_IPV6) {
+        if (len < offset + 40) {
+            return shed_class_other;
+        }
+        protocol = iph[6];
+        l4_offset = offset + 40;
+        end = l4_offset + read_u16(iph + 4);
+    } else {
+        return shed_class_other;
+    }
+    if (end > len) {
+        end = len;
+    }
+
+    const uint8_t *l4 = eth + l4_offset;
+    if (protocol == ip::protocol::tcp) {
+        if (end < l4_offset + 20) {
+            return shed_class_other;
+        }
+        if (l4[13] & 0x07) {
+            return shed_class_tcp_control;   /* FIN, SYN, or RST */
+        }
+        size_t data_offset = l4_offset + (l4[12] >> 4) * 4;
+        if (selector && data_offset < end) {
+            struct datum data{eth + data_offset, eth + end};
+            if (selector->get_tcp_msg_type(data) != tcp_msg_type_unknown) {
+                return shed_class_tcp_initial;
+            }
+        }
+        return shed_class_tcp_data;
+
+    } else if (protocol == ip::protocol::udp) {
+        if (end < l4_offset + 8) {
+            return shed_class_other;
+        }
+        if (selector) {
+            struct datum data{l4 + 8, eth + end};
+            if (selector->get_udp_msg_type(data) != udp_msg_type_unknown) {
+                return shed_class_udp_initial;
+            }
+            udp::ports ports;
+            memcpy(&ports.src, l4, sizeof(ports.src));
+            memcpy(&ports.dst, l4 + 2, sizeof(ports.dst));
+            if (selector->get_udp_msg_type_from_ports(ports) != udp_msg_type_unknown) {
+                return shed_class_udp_initial;
+            }
+        }
+        return shed_class_udp_data;
+    }
+    return shed_class_other;
+}
+
+bool load_shedder::shed_packet_at(const uint8_t *eth, size_t len, int percent) {
+    enum shed_class c = classify(eth, len);
+    if (shed_class_is_flow_initial(c)) {
+        increment(kept[c]);
+        return false;
+    }
+
+    /* xorshift64 */
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    if ((int)((rng_state >> 32) % 100) < percent) {
+        increment(kept[c]);
+        return false;
+    }
+    increment(shed[c]);
+    return true;
+}
+
+bool load_shedder::adjust(uint64_t socket_drops) {
+    int percent = percent_accept.load(std::memory_order_relaxed);
+    if (percent == 0) {
+        return false;
+    }
+    int new_percent = percent;
+    if (socket_drops) {
+        quiet_intervals = 0;
+        new_percent = percent - LOAD_SHED_DECREASE;
+        if (new_percent < LOAD_SHED_MIN_PERCENT) {
+            new_percent = LOAD_SHED_MIN_PERCENT;
+        }
+    } else if (percent < 100 && ++quiet_intervals >= LOAD_SHED_QUIET_INTERVALS) {
+        quiet_intervals = 0;
+        new_percent = percent + LOAD_SHED_INCREASE;
+        if (new_percent > 100) {
+            new_percent = 100;
+        }
+    }
+    percent_accept.store(new_percent, std::memory_order_relaxed);
+    return new_percent != percent;
+}
+
+void load_shedder::snapshot(struct load_shed_stats *s) const {
+    s->percent_accept = percent_accept.load(std::memory_order_relaxed);
+    for (int c = 0; c < shed_class_max; c++) {
+        s->shed[c] = shed[c].load(std::memory_order_relaxed);
+        s->kept[c] = kept[c].load(std::memory_order_relaxed);
+    }
+}
+
+void load_shed_stats_write_json(FILE *f,
+                                int num_threads,
+                                const struct load_shed_stats *curr,
+                                const struct load_shed_stats *prev) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    fprintf(f, "{\"load_shedding_stats\":{\"time\":%.3f,\"threads\":[", ts.tv_sec + (ts.tv_nsec / 1000000000.0));
+
+    for (int t = 0; t < num_threads; t++) {
+        fprintf(f, "%s{\"thread\":%d,\"percent_accept\":%d", t ? "," : "", t, curr[t].percent_accept);
+        for (int c = 0; c < shed_class_max; c++) {
+            uint64_t shed = curr[t].shed[c];
+            uint64_t kept = curr[t].kept[c];
+            if (prev) {
+                shed -= prev[t].shed[c];
+                kept -= prev[t].kept[c];
+            }
+            fprintf(f, ",\"%s\":{\"shed\":%" PRIu64 ",\"kept\":%" PRIu64 "}", shed_class_names[c], shed, kept);
+        }
+        fprintf(f, "}");
+    }
+    fprintf(f, "]}}\n");
+}
@@ -0,0 +1,119 @@
+/*
+ * load_shedding.h
+ *
+ * flow-aware load shedding for the packet worker threads
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc.  All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#ifndef LOAD_SHEDDING_H
+#define LOAD_SHEDDING_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <atomic>
+
+class traffic_selector;  /* defined in libmerc/proto_identify.h */
+
+/*
+ * enum shed_class is the class of a packet, as far as load shedding
+ * is concerned.  Packets in the flow-initial classes carry the
+ * messages that mercury fingerprints, and are never shed; packets in
+ * the other classes are shed at the current shedding rate.
+ */
+enum shed_class {
+    shed_class_tcp_control = 0,  /* TCP SYN, SYN/ACK, FIN, or RST (never shed)         */
+    shed_class_tcp_initial,      /* TCP data recognized by the selector (never shed)   */
+    shed_class_udp_initial,      /* UDP data recognized by the selector (never shed)   */
+    shed_class_tcp_data,         /* Other TCP segments, including acknowledgements     */
+    shed_class_udp_data,         /* Other UDP datagrams                                */
+    shed_class_other,            /* Non-IP frames, fragments, and other IP protocols   */
+    shed_class_max
+};
+
+#define LOAD_SHED_MIN_PERCENT      10  /* The smallest percentage of sheddable packets accepted */
+#define LOAD_SHED_DECREASE         10  /* Percentage decrease after an interval with socket drops */
+#define LOAD_SHED_INCREASE          5  /* Percentage increase after LOAD_SHED_QUIET_INTERVALS without drops */
+#define LOAD_SHED_QUIET_INTERVALS  10
+
+/*
+ * struct load_shed_stats is a snapshot of the counters of a
+ * load_shedder.  The counters only advance while shedding is active:
+ * shed[c] counts the packets of class c that were shed, and kept[c]
+ * counts those that were passed on to the packet processor.
+ */
+struct load_shed_stats {
+    int percent_accept;
+    uint64_t shed[shed_class_max];
+    uint64_t kept[shed_class_max];
+};
+
+/*
+ * struct load_shedder sheds packets for a single packet worker
+ * thread, to reduce its load when its socket is dropping packets.
+ * Flow-initial packets are never shed; other packets are accepted
+ * with probability percent_accept / 100, which the stats thread
+ * adjusts through adjust() from the socket drops of that thread
+ * alone.  The counters are written only by the worker, and can be
+ * read by any thread.
+ */
+struct load_shedder {
+    std::atomic<int> percent_accept;           /* 0 when disabled, otherwise 10 to 100 */
+    std::atomic<uint64_t> shed[shed_class_max];
+    std::atomic<uint64_t> kept[shed_class_max];
+    uint64_t rng_state;                        /* Private to the worker */
+    const traffic_selector *selector;          /* Recognizes flow-initial data, if not NULL */
+    int quiet_intervals;                       /* Private to the stats thread */
+
+    load_shedder() { init(NULL, false); }
+
+    void init(const traffic_selector *s, bool enabled);
+
+    /*
+     * shed_packet(eth, len) returns true if the Ethernet frame eth of
+     * length len should be discarded; it is called by the worker
+     */
+    bool shed_packet(const uint8_t *eth, size_t len) {
+        int percent = percent_accept.load(std::memory_order_relaxed);
+        if (percent == 0 || percent >= 100) {
+            return false;
+        }
+        return shed_packet_at(eth, len, percent);
+    }
+
+    /*
+     * adjust(socket_drops) updates the shedding rate at the end of a
+     * stats interval, given the number of packets that the socket of
+     * this thread dropped during that interval; it returns true if
+     * the rate changed.  It is called by the stats thread.
+     */
+    bool adjust(uint64_t socket_drops);
+
+    void snapshot(struct load_shed_stats *s) const;
+
+    enum shed_class classify(const uint8_t *eth, size_t len) const;
+
+private:
+    bool shed_packet_at(const uint8_t *eth, size_t len, int percent);
+
+    static void increment(std::atomic<uint64_t> &counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+const char *shed_class_get_name(enum shed_class c);
+
+/*
+ * load_shed_stats_write_json() writes a single line JSON record of
+ * the load shedding counters of num_threads threads in the snapshot
+ * curr to the file f.  If prev is not NULL, then the counters are
+ * reported as the difference between curr and prev.
+ */
+void load_shed_stats_write_json(FILE *f,
+                                int num_threads,
+                                const struct load_shed_stats *curr,
+                                const struct load_shed_stats *prev);
+
+#endif /* LOAD_SHEDDING_H */
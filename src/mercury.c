@@ -19,11 +19,11 @@
 #include "mercury.h"
 #include "pcap_file_io.h"
 #include "af_packet_v3.h"
+#include "af_xdp.h"
 #include "pcap_reader.h"
 #include "signal_handling.h"
 #include "config.h"
 #include "output.h"
-#include "rnd_pkt_drop.h"
 #include "control.h"
 
 char mercury_help[] =
@@ -41,6 +41,10 @@ char mercury_help[] =
     "   [-t or --threads] [num_threads | cpu] # set number of threads\n"
     "   [-u or --user] u                      # set UID and GID to those of user u\n"
     "   [-d or --directory] d                 # set working directory to d\n"
+    "   --capture-backend=B                   # capture with backend B (see --help)\n"
+    "   --xdp-filter                          # drop unparsed TCP data in XDP (af_xdp)\n"
+    "   --socket-filter                       # drop unselected packets in the kernel\n"
+    "   --adaptive                            # shed mid-flow packets under overload\n"
     "GENERAL OPTIONS\n"
     "   --config c                            # read configuration from file c\n"
     "   [-a or --analysis]                    # analyze fingerprints\n"
@@ -49,12 +53,18 @@ char mercury_help[] =
     "   --stats=f                             # write stats to file f\n"
     "   --stats-time=T                        # write stats every T seconds\n"
     "   --stats-limit=L                       # limit stats to L entries\n"
+    "   --stats-sketch=K                      # approximate stats, tracking K events\n"
+    "   --analysis-cache-size=N               # cache N analysis results per thread\n"
     "   [-s or --select] filter               # select traffic by filter (see --help)\n"
     "   --nonselected-tcp-data                # tcp data for nonselected traffic\n"
     "   --nonselected-udp-data                # udp data for nonselected traffic\n"
     "   --tcp-reassembly                      # reassemble tcp data segments\n"
+    "   --tcp-reassembly-budget=B             # reassemble at most B bytes per message\n"
     "   [-l or --limit] l                     # rotate output file after l records\n"
     "   --output-time=T                       # rotate output file after T seconds\n"
+    "   --output-io=B                         # write output with backend B (see --help)\n"
+    "   --compress=C[:L]                      # compress output files with C at level L\n"
+    "   --compress-threads=N                  # use N threads for zstd compression\n"
     "   --dns-json                            # output DNS as JSON, not base64\n"
     "   --certs-json                          # output certs as JSON, not base64\n"
     "   --metadata                            # output more protocol metadata in JSON\n"
@@ -75,6 +85,33 @@ char mercury_extended_help[] =
     "   is the available memory; USE b < 0.1 EXCEPT WHEN THERE ARE GIGABYTES OF SPARE\n"
     "   RAM to avoid OS failure due to memory starvation.\n"
     "\n"
+    "   \"--capture-backend=B\" selects how packets are captured from the interface:\n"
+    "      af_packet         AF_PACKET ring buffers with fanout (default)\n"
+    "      af_xdp            AF_XDP sockets, in zero-copy mode if the driver allows\n"
+    "   With af_xdp, worker thread t reads receive queue t of the interface, so the\n"
+    "   number of threads should match the number of queues (see ethtool -l), and\n"
+    "   the buffer size b sets the size of the UMEM of each thread.  Captured packets\n"
+    "   do not reach the network stack, so af_xdp should only be used on an interface\n"
+    "   that is dedicated to capture.  \"--xdp-filter\" has the XDP program drop TCP\n"
+    "   acknowledgements without data, and all but the first 16 data segments in each\n"
+    "   direction of a TCP flow, which mercury does not need to see.\n"
+    "\n"
+    "   \"--socket-filter\" compiles the [-s or --select] protocols into a BPF filter\n"
+    "   on each AF_PACKET socket, so that packets that mercury would ignore are\n"
+    "   dropped before they reach the ring: TCP acknowledgements without data, and\n"
+    "   TCP and UDP data that does not match a selected protocol.  TCP packets with\n"
+    "   SYN, FIN, or RST, and traffic other than TCP and UDP, are always passed.  With\n"
+    "   --tcp-reassembly or --nonselected-tcp-data, all TCP data is passed, and with\n"
+    "   --nonselected-udp-data, all UDP data is passed.\n"
+    "\n"
+    "   \"--adaptive\" sheds load in each worker thread whose socket drops packets.\n"
+    "   Flow-initial packets (TCP SYN, SYN/ACK, FIN, and RST, and TCP and UDP data\n"
+    "   recognized by [-s or --select], such as TLS clientHellos and QUIC Initials)\n"
+    "   are never shed.  Other packets are accepted with a probability that drops by\n"
+    "   10% after each second with socket drops, down to 10%, and rises by 5% after\n"
+    "   10 seconds without drops.  With [-v or --verbose], the packets shed and kept\n"
+    "   by each thread are reported every second, per protocol class.\n"
+    "\n"
     "   \"[-f or --fingerprint] f\" writes a JSON record for each fingerprint observed,\n"
     "   which incorporates the flow key and the time of observation, into the file f.\n"
     "   With [-a or --analysis], fingerprints and destinations are analyzed and the\n"
@@ -84,7 +121,11 @@ char mercury_extended_help[] =
     "   option [-s or --select], packets are filtered so that only ones with\n"
     "   fingerprint metadata are written.\n"
     "\n"
-    "   \"[r or --read] r\" reads packets from the file r, in PCAP format.\n"
+    "   \"[r or --read] r\" reads packets from the file r, in PCAP format.  With\n"
+    "   [-t or --threads] t, where t > 1, the file is memory-mapped and its packets\n"
+    "   are divided between t worker threads by a hash of their flow key, so that\n"
+    "   both directions of a flow go to the same thread; the output of the threads\n"
+    "   is merged in timestamp order.\n"
     "\n"
     "   if neither -r nor -c is specified, then packets are read from standard input,\n"
     "   in PCAP format.\n"
@@ -143,6 +184,30 @@ char mercury_extended_help[] =
     "   This option allows mercury to keep track of tcp segment state and \n"
     "   and reassemble these segments based on the application in tcp payload\n"
     "\n"
+    "   --tcp-reassembly-budget=B limits the number of bytes that are reassembled\n"
+    "   for a single message to B (default 32768, maximum 65536); a message that\n"
+    "   is longer, such as a large certificate chain, is reported truncated.\n"
+    "\n"
+    "   --stats-sketch=K bounds the memory used for stats, by tracking only the\n"
+    "   K most frequent events in each stats interval, per thread, rather than\n"
+    "   counting every event.  Each count may overestimate the true count by at\n"
+    "   most its count_error, which is reported with it; any event that makes up\n"
+    "   more than 1/K of the events seen by a thread is always reported.\n"
+    "\n"
+    "   --resources=f sets the resource file to f, which is either a resource\n"
+    "   archive or a snapshot of one written with archive_reader --snapshot; a\n"
+    "   snapshot is memory mapped and needs no decryption or decompression, so\n"
+    "   it loads faster, and its pages are shared by the processes that use it.\n"
+    "   A snapshot is not encrypted, so it can only be written from an archive\n"
+    "   that is not encrypted, and it is rejected if a decryption key is set.\n"
+    "   When mercury is capturing packets with --analysis, sending it SIGHUP\n"
+    "   reloads the resource file without stopping packet processing; the\n"
+    "   new resource version is reported on stderr.\n"
+    "\n"
+    "   --analysis-cache-size=N sets the number of analysis results that each\n"
+    "   thread keeps, so that a fingerprint seen again with the same destination\n"
+    "   is not analyzed again (default 1024; 0 disables the cache).\n"
+    "\n"
     "   \"[-u or --user] u\" sets the UID and GID to those of user u, so that\n"
     "   output file(s) are owned by this user.  If this option is not set, then\n"
     "   the UID is set to SUDO_UID, so that privileges are dropped to those of\n"
@@ -167,6 +232,19 @@ char mercury_extended_help[] =
     "   \"[-l or --limit] l\" rotates output files so that each file has at most\n"
     "   l records or packets; filenames include a sequence number, date and time.\n"
     "\n"
+    "   \"--output-io=B\" selects how records are written to the output file:\n"
+    "      writev            vectored writes of record batches (default)\n"
+    "      io_uring          as above, but overlapped with record gathering\n"
+    "      direct            aligned O_DIRECT writes, bypassing the page cache\n"
+    "   If the kernel does not support the selected backend, writev is used.\n"
+    "\n"
+    "   \"--compress=C[:L]\" compresses output files with the compressor C, which is\n"
+    "   gzip (levels 1 through 9) or zstd (if mercury was built with libzstd), at the\n"
+    "   optional level L.  Each output file, including each rotated file, holds one\n"
+    "   gzip member or zstd frame, and has the suffix .gz or .zst appended to its name.\n"
+    "   \"--compress-threads=N\" has zstd compress with N worker threads, so that the\n"
+    "   output thread does not wait for the compressor.\n"
+    "\n"
     "   --dns-json writes out DNS responses as a JSON object; otherwise,\n"
     "   that data is output in base64 format, as a string with the key \"base64\".\n"
     "\n"
@@ -234,7 +312,7 @@ int main(int argc, char *argv[]) {
     std::string additional_args;
 
     while(1) {
-        enum opt { config=1, version=2, license=3, dns_json=4, certs_json=5, metadata=6, resources=7, tcp_init_data=8, udp_init_data=9, write_stats=10, stats_limit=11, stats_time=12, output_time=13, tcp_reassembly=14, format=15 };
+        enum opt { config=1, version=2, license=3, dns_json=4, certs_json=5, metadata=6, resources=7, tcp_init_data=8, udp_init_data=9, write_stats=10, stats_limit=11, stats_time=12, output_time=13, tcp_reassembly=14, format=15, output_io=16, compress=17, compress_threads=18, capture_backend=19, xdp_filter=20, socket_filter=21, tcp_reassembly_budget=22, stats_sketch=23, analysis_cache_size=24 };
         int opt_idx = 0;
         static struct option long_opts[] = {
             { "config",      required_argument, NULL, config  },
@@ -249,8 +327,17 @@ int main(int argc, char *argv[]) {
             { "nonselected-udp-data", no_argument, NULL, udp_init_data },
             { "stats-limit", required_argument, NULL, stats_limit },
             { "stats-time",  required_argument, NULL, stats_time },
+            { "stats-sketch", required_argument, NULL, stats_sketch },
+            { "analysis-cache-size", required_argument, NULL, analysis_cache_size },
             { "output-time", required_argument, NULL, output_time },
+            { "output-io",   required_argument, NULL, output_io },
+            { "compress",    required_argument, NULL, compress },
+            { "compress-threads", required_argument, NULL, compress_threads },
             { "tcp-reassembly", no_argument,    NULL, tcp_reassembly },
+            { "tcp-reassembly-budget", required_argument, NULL, tcp_reassembly_budget },
+            { "capture-backend", required_argument, NULL, capture_backend },
+            { "xdp-filter",  no_argument,       NULL, xdp_filter },
+            { "socket-filter", no_argument,     NULL, socket_filter },
             { "format",      required_argument, NULL, format },
             { "read",        required_argument, NULL, 'r' },
             { "write",       required_argument, NULL, 'w' },
@@ -346,6 +433,13 @@ int main(int argc, char *argv[]) {
                 additional_args.append("tcp-reassembly;");
             }
             break;
+        case tcp_reassembly_budget:
+            if (option_is_valid(optarg)) {
+                additional_args.append("tcp-reassembly-budget=").append(optarg).append(";");
+            } else {
+                usage(argv[0], "option tcp-reassembly-budget requires a numeric argument", extended_help_off);
+            }
+            break;
         case format:
             if (option_is_valid(optarg)) {
                 additional_args.append("format=").append(optarg).append(";");
@@ -502,6 +596,20 @@ int main(int argc, char *argv[]) {
                 usage(argv[0], "option stats-limit requires a numeric argument", extended_help_off);
             }
             break;
+        case stats_sketch:
+            if (option_is_valid(optarg)) {
+                additional_args.append("stats-sketch=").append(optarg).append(";");
+            } else {
+                usage(argv[0], "option stats-sketch requires a numeric argument", extended_help_off);
+            }
+            break;
+        case analysis_cache_size:
+            if (option_is_valid(optarg)) {
+                additional_args.append("analysis-cache-size=").append(optarg).append(";");
+            } else {
+                usage(argv[0], "option analysis-cache-size requires a numeric argument", extended_help_off);
+            }
+            break;
         case output_time:
             if (option_is_valid(optarg)) {
                 errno = 0;
@@ -513,6 +621,52 @@ int main(int argc, char *argv[]) {
                 usage(argv[0], "option output-time requires a numeric argument", extended_help_off);
             }
             break;
+        case output_io:
+            if (option_is_valid(optarg)) {
+                cfg.output_io = optarg;
+            } else {
+                usage(argv[0], "option output-io requires an argument", extended_help_off);
+            }
+            break;
+        case compress:
+            if (option_is_valid(optarg)) {
+                cfg.compression = optarg;
+            } else {
+                usage(argv[0], "option compress requires an argument", extended_help_off);
+            }
+            break;
+        case capture_backend:
+            if (option_is_valid(optarg)) {
+                cfg.capture_backend = optarg;
+            } else {
+                usage(argv[0], "option capture-backend requires an argument", extended_help_off);
+            }
+            break;
+        case xdp_filter:
+            if (optarg) {
+                usage(argv[0], "option xdp-filter does not use an argument", extended_help_off);
+            } else {
+                cfg.xdp_filter = true;
+            }
+            break;
+        case socket_filter:
+            if (optarg) {
+                usage(argv[0], "option socket-filter does not use an argument", extended_help_off);
+            } else {
+                cfg.socket_filter = true;
+            }
+            break;
+        case compress_threads:
+            if (option_is_valid(optarg)) {
+                errno = 0;
+                cfg.compression_threads = strtol(optarg, NULL, 10);
+                if (errno) {
+                    printf("%s: could not convert argument \"%s\" to a number\n", strerror(errno), optarg);
+                }
+            } else {
+                usage(argv[0], "option compress-threads requires a numeric argument", extended_help_off);
+            }
+            break;
         case 'p':
             if (option_is_valid(optarg)) {
                 errno = 0;
@@ -525,7 +679,7 @@ int main(int argc, char *argv[]) {
             }
             break;
         case 0:
-            /* The option --adaptive to adaptively accept or skip packets for PCAP file. */
+            /* The option --adaptive to shed load when capture sockets drop packets */
             if (optarg) {
                 usage(argv[0], "option --adaptive does not use an argument", extended_help_off);
             } else {
@@ -592,6 +746,33 @@ int main(int argc, char *argv[]) {
         usage(argv[0], "stats option requires --analysis", extended_help_off);
     }
 
+    enum output_io_type output_io_type;
+    if (cfg.output_io && !output_io_type_from_string(cfg.output_io, &output_io_type)) {
+        usage(argv[0], "output-io must be writev, io_uring, or direct", extended_help_off);
+    }
+    struct output_compression output_compression;
+    if (cfg.compression && !output_compression_from_string(cfg.compression, &output_compression)) {
+        usage(argv[0], "compress must be none, gzip[:1-9], or zstd[:level] (if supported by this build)", extended_help_off);
+    }
+    if (cfg.compression_threads < 0) {
+        usage(argv[0], "compress-threads must not be negative", extended_help_off);
+    }
+
+    bool use_af_xdp = false;
+    if (cfg.capture_backend) {
+        if (strcmp(cfg.capture_backend, "af_xdp") == 0) {
+            use_af_xdp = true;
+        } else if (strcmp(cfg.capture_backend, "af_packet") != 0) {
+            usage(argv[0], "capture-backend must be af_packet or af_xdp", extended_help_off);
+        }
+    }
+    if (cfg.xdp_filter && !use_af_xdp) {
+        usage(argv[0], "xdp-filter requires capture-backend af_xdp", extended_help_off);
+    }
+    if (cfg.socket_filter && use_af_xdp) {
+        usage(argv[0], "socket-filter requires capture-backend af_packet", extended_help_off);
+    }
+
     if (cfg.read_filename) {
         cfg.output_block = true;      // use blocking output, so that no packets are lost in copying
     }
@@ -622,12 +803,12 @@ int main(int argc, char *argv[]) {
         // fprintf(stderr, "notice: looping over input with loop count %d\n", cfg.loop_count);
     }
 
-    /* The option --adaptive works only with -w PCAP file option and -c capture interface */
+    /* The option --adaptive works only with the -c capture interface option */
     if (cfg.adaptive > 0) {
-        if (cfg.write_filename == NULL || cfg.capture_interface == NULL) {
-            usage(argv[0], "The option --adaptive requires options -c capture interface and -w pcap file.", extended_help_off);
-        } else {
-            set_percent_accept(30); /* set starting percentage */
+        if (cfg.capture_interface == NULL) {
+            usage(argv[0], "The option --adaptive requires option -c capture interface.", extended_help_off);
+        } else if (use_af_xdp) {
+            usage(argv[0], "The option --adaptive is not supported with capture-backend af_xdp.", extended_help_off);
         }
     }
 
@@ -665,12 +846,18 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "error: unable to initialize output thread\n");
         return EXIT_FAILURE;
     }
+    ctl->set_output_queues(&out_file.qs);
     if (cfg.capture_interface) {
 
         if (cfg.verbosity) {
             fprintf(stderr, "initializing interface %s\n", cfg.capture_interface);
         }
-        if (bind_and_dispatch(&cfg, mc, &out_file) != status_ok) {
+        if (use_af_xdp) {
+            if (af_xdp_bind_and_dispatch(&cfg, mc, &out_file) != status_ok) {
+                fprintf(stderr, "error: bind and dispatch failed\n");
+                return EXIT_FAILURE;
+            }
+        } else if (bind_and_dispatch(&cfg, mc, &out_file) != status_ok) {
             fprintf(stderr, "error: bind and dispatch failed\n");
             return EXIT_FAILURE;
         }
@@ -690,6 +877,7 @@ int main(int argc, char *argv[]) {
     if (ctl) {
         delete ctl;  // delete control thread, which will flush stats output (if any)
     }
+    thread_queues_free(&out_file.qs);
 
     mercury_finalize(mc);
 
@@ -58,13 +58,19 @@ struct mercury_config {
     int loop_count;                 /* loop count for repeat processing of read file  */
     int verbosity;                  /* 0=minimal output; 1=more detailed output       */
     int use_test_packet;            /* use test packet to write output file           */
-    int adaptive;                   /* adaptively accept/skip packets for PCAP output */
+    int adaptive;                   /* adaptively shed load in the worker threads     */
     bool output_block;              /* use blocking output                            */
     size_t stats_rotation_duration; /* number of seconds between stats file rotation  */
-    size_t out_rotation_duration;   /* number of seconds between json file rotation  */}
+    size_t out_rotation_duration;   /* number of seconds between json file rotation  */
+    char *output_io;                /* output backend: writev, io_uring, or direct    */
+    char *compression;              /* output compression: none, gzip, or zstd        */
+    int compression_threads;        /* number of zstd compression worker threads      */
+    char *capture_backend;          /* capture backend: af_packet or af_xdp           */
+    bool xdp_filter;                /* drop unparsed TCP data in the XDP program      */
+    bool socket_filter;             /* drop unselected packets in a socket filter     */}
 ;
 
-#define mercury_config_init() { NULL, NULL, NULL, NULL, NULL, NULL, O_EXCL, (char *)"w", 0, 8, 1, 0, NULL, 1, 0, 0, 0, false, 300, 0 }
+#define mercury_config_init() { NULL, NULL, NULL, NULL, NULL, NULL, O_EXCL, (char *)"w", 0, 8, 1, 0, NULL, 1, 0, 0, 0, false, 300, 0, NULL, NULL, 0, NULL, false, false }
 
 
 #endif /* MERCURY_H */
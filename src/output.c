@@ -8,8 +8,13 @@
 #include <stdlib.h>
 #include <sys/time.h>
 #include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <sys/uio.h>
+#include <string>
+#include <zlib.h>
 #include "output.h"
-#include "pcap_file_io.h"  // for write_pcap_file_header()
+#include "pcap_file_io.h"  // for write_pcap_file_header(), pcap_file_header()
 #include "libmerc/utils.h"
 
 
@@ -17,7 +22,17 @@
 
 void thread_queues_init(struct thread_queues *tqs, int n) {
     tqs->qnum = n;
-    tqs->queue = (struct ll_queue *)calloc(n, sizeof(struct ll_queue));
+    tqs->data_ready.init();
+    tqs->input_tracked = false;
+
+    /* note: the ring buffers are deliberately left uninitialized, so
+     * that their pages are only made resident as they are used
+     */
+    void *queues = nullptr;
+    if (posix_memalign(&queues, alignof(struct ll_queue), n * sizeof(struct ll_queue)) != 0) {
+        queues = nullptr;
+    }
+    tqs->queue = (struct ll_queue *)queues;
 
     if (tqs->queue == NULL) {
         fprintf(stderr, "Failed to allocate memory for thread queues\n");
@@ -25,13 +40,7 @@ void thread_queues_init(struct thread_queues *tqs, int n) {
     }
 
     for (int i = 0; i < n; i++) {
-        tqs->queue[i].qnum = i; /* only needed for debug output */
-        tqs->queue[i].ridx = 0;
-        tqs->queue[i].widx = 0;
-
-        for (int j = 0; j < LLQ_DEPTH; j++) {
-            tqs->queue[i].msgs[j].used = 0;
-        }
+        tqs->queue[i].init(i, &tqs->data_ready); /* qnum is only needed for debug output */
     }
 }
 
@@ -43,6 +52,103 @@ void thread_queues_free(struct thread_queues *tqs) {
 }
 
 
+/*
+ * output_queue_stats_snapshot() copies the backpressure counters of
+ * each of the queues in tqs into the array snapshot, which must have
+ * room for tqs->qnum entries.  The high water marks are reset only
+ * if reset_high_water is true, so that only one reader (the stats
+ * dump) owns them; other readers can use the current fill level
+ * in_use instead.
+ */
+void output_queue_stats_snapshot(struct thread_queues *tqs, struct output_queue_stats *snapshot, bool reset_high_water) {
+    for (int q = 0; q < tqs->qnum; q++) {
+        struct ll_queue &llq = tqs->queue[q];
+        struct llq_stats &stats = llq.stats;
+        snapshot[q].msgs = stats.msgs.load(std::memory_order_relaxed);
+        snapshot[q].bytes = stats.bytes.load(std::memory_order_relaxed);
+        snapshot[q].drops = stats.drops.load(std::memory_order_relaxed);
+        snapshot[q].blocked_nsec = stats.blocked_nsec.load(std::memory_order_relaxed);
+        if (reset_high_water) {
+            snapshot[q].high_water = stats.high_water.exchange(0, std::memory_order_relaxed);
+        } else {
+            snapshot[q].high_water = stats.high_water.load(std::memory_order_relaxed);
+        }
+        snapshot[q].in_use = llq.bytes_in_use(llq.widx.load(std::memory_order_acquire));
+    }
+}
+
+/*
+ * output_queue_stats_sprint() formats a single line JSON record of
+ * the backpressure counters in the snapshot curr into the string s.
+ * If prev is not NULL, then the counters are reported as the
+ * difference between curr and prev.
+ */
+static void output_queue_stats_sprint(std::string &s,
+                                      const struct thread_queues *tqs,
+                                      const struct output_queue_stats *curr,
+                                      const struct output_queue_stats *prev) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "{\"output_queue_stats\":{\"time\":%.3f,\"queue_size\":%u,\"queues\":[",
+             ts.tv_sec + (ts.tv_nsec / 1000000000.0), LLQ_BUF_SIZE);
+    s.assign(tmp);
+
+    for (int q = 0; q < tqs->qnum; q++) {
+        struct output_queue_stats delta = curr[q];
+        if (prev) {
+            delta.msgs -= prev[q].msgs;
+            delta.bytes -= prev[q].bytes;
+            delta.drops -= prev[q].drops;
+            delta.blocked_nsec -= prev[q].blocked_nsec;
+        }
+        snprintf(tmp, sizeof(tmp),
+                 "%s{\"queue\":%d,\"msgs\":%" PRIu64 ",\"bytes\":%" PRIu64 ",\"drops\":%" PRIu64
+                 ",\"blocked_ns\":%" PRIu64 ",\"high_water\":%" PRIu64 "}",
+                 q ? "," : "", q, delta.msgs, delta.bytes, delta.drops, delta.blocked_nsec, delta.high_water);
+        s.append(tmp);
+    }
+    s.append("]}}\n");
+}
+
+/*
+ * output_queue_stats_write_json() writes the JSON record formatted
+ * by output_queue_stats_sprint() to the file f
+ */
+void output_queue_stats_write_json(FILE *f,
+                                   const struct thread_queues *tqs,
+                                   const struct output_queue_stats *curr,
+                                   const struct output_queue_stats *prev) {
+    std::string s;
+    output_queue_stats_sprint(s, tqs, curr, prev);
+    fputs(s.c_str(), f);
+}
+
+/*
+ * output_queue_stats_append_gz() appends the JSON record formatted by
+ * output_queue_stats_sprint() to the gzip file filename, as a gzip
+ * member of its own, so that it follows the records written to that
+ * file by mercury_write_stats_data().  It returns false on error.
+ */
+bool output_queue_stats_append_gz(const char *filename,
+                                  const struct thread_queues *tqs,
+                                  const struct output_queue_stats *curr,
+                                  const struct output_queue_stats *prev) {
+    std::string s;
+    output_queue_stats_sprint(s, tqs, curr, prev);
+    gzFile f = gzopen(filename, "a");
+    if (f == NULL) {
+        return false;
+    }
+    bool ok = gzwrite(f, s.data(), s.length()) > 0;
+    if (gzclose(f) != Z_OK) {
+        ok = false;
+    }
+    return ok;
+}
+
+
 int time_less(struct timespec *tsl, struct timespec *tsr) {
 
     if ((tsl->tv_sec < tsr->tv_sec) || ((tsl->tv_sec == tsr->tv_sec) && (tsl->tv_nsec < tsr->tv_nsec))) {
@@ -59,8 +165,8 @@ int queue_less(int ql, int qr, struct tourn_tree *t_tree, const struct thread_qu
      *
      * WARNING: This function is NOT thread safe!
      *
-     * Meaning the access to the 'used' member in the queue
-     * struct happens and then later the access to the
+     * Meaning the check for a message at the head of the
+     * queue happens and then later the access to its
      * struct timespec happens.
      * This function must be called by the output thread
      * and ONLY the output thread because if
@@ -68,22 +174,24 @@ int queue_less(int ql, int qr, struct tourn_tree *t_tree, const struct thread_qu
      * shit will hit the fan!
      */
 
-    int ql_used = 0; /* The (l)eft queue in the tree */
-    int qr_used = 0; /* The (r)ight queue in the tree */
+    struct llq_msg *ql_msg = nullptr; /* The (l)eft queue in the tree */
+    struct llq_msg *qr_msg = nullptr; /* The (r)ight queue in the tree */
 
     /* check for a queue stall before we return anything otherwise
      * we could short-circuit logic before realizing one of the
      * queues was stalled
      */
     if ((ql >= 0) && (ql < tqs->qnum)) {
-        ql_used = tqs->queue[ql].msgs[tqs->queue[ql].ridx].used;
-        if (ql_used == 0) {
+        bool may_fill = tqs->may_fill(ql);
+        ql_msg = tqs->queue[ql].peek();
+        if (ql_msg == nullptr && may_fill) {
             t_tree->stalled = 1;
         }
     }
     if ((qr >= 0) && (qr < tqs->qnum)) {
-        qr_used = tqs->queue[qr].msgs[tqs->queue[qr].ridx].used;
-        if (qr_used == 0) {
+        bool may_fill = tqs->may_fill(qr);
+        qr_msg = tqs->queue[qr].peek();
+        if (qr_msg == nullptr && may_fill) {
             t_tree->stalled = 1;
         }
     }
@@ -118,15 +226,12 @@ int queue_less(int ql, int qr, struct tourn_tree *t_tree, const struct thread_qu
     }
 
     /* This is where we do the actual less comparison */
-    if (ql_used == 0) {
+    if (ql_msg == nullptr) {
         return 0;
-    } else if (qr_used == 0) {
+    } else if (qr_msg == nullptr) {
         return 1;
     } else {
-        struct timespec *tsl = &(tqs->queue[ql].msgs[tqs->queue[ql].ridx].ts);
-        struct timespec *tsr = &(tqs->queue[qr].msgs[tqs->queue[qr].ridx].ts);
-
-        return time_less(tsl, tsr);
+        return time_less(&ql_msg->ts, &qr_msg->ts);
     }
 }
 
@@ -217,13 +322,45 @@ void debug_print_tour_tree(struct tourn_tree *t_tree, const struct thread_queues
 
     fprintf(stderr, "Ready queues:\n");
     for (int q = 0; q < t_tree->qnum; q++) {
-        if (tqs->queue[q].msgs[tqs->queue[q].ridx].used == 1) {
+        if (tqs->queue[q].peek() != nullptr) {
             fprintf(stderr, "%d ", q);
         }
     }
     fprintf(stderr, "\n");
 }
 
+/*
+ * outfile_append_suffix() appends the file name suffix for the
+ * compression type of ojf (such as .gz) to outfile, unless outfile
+ * already ends with it
+ */
+enum status outfile_append_suffix(char outfile[FILENAME_MAX], const struct output_file *ojf) {
+    const char *suffix = output_compression_suffix(ojf->compression.type);
+    size_t len = strlen(outfile);
+    size_t suffix_len = strlen(suffix);
+    if (suffix_len == 0 || (len >= suffix_len && strcmp(outfile + len - suffix_len, suffix) == 0)) {
+        return status_ok;
+    }
+    return filename_append(outfile, outfile, "", suffix);
+}
+
+/*
+ * write_outfile_header() writes the pcap file header to f, if needed;
+ * for compressed output, the header is instead written through the
+ * output thread's writer, by output_batch_start_file()
+ */
+enum status write_outfile_header(struct output_file *ojf, FILE *f) {
+    if (ojf->type != file_type_pcap || ojf->compression.type != output_compression_none) {
+        return status_ok;
+    }
+    enum status status = write_pcap_file_header(f);
+    if (status) {
+        perror("error: could not write pcap file header");
+        ojf->file_error = true;
+    }
+    return status;
+}
+
 enum status open_outfile(struct output_file *ojf, bool is_pri) {
     char outfile[FILENAME_MAX];
     char file_num[MAX_HEX];
@@ -244,6 +381,11 @@ enum status open_outfile(struct output_file *ojf, bool is_pri) {
         ojf->file_error = true;
         return status;
     }
+    status = outfile_append_suffix(outfile, ojf);
+    if (status) {
+        ojf->file_error = true;
+        return status;
+    }
 
     FILE* file = fopen(outfile, ojf->mode);
     if (file == NULL) {
@@ -275,6 +417,12 @@ enum status output_file_rotate(struct output_file *ojf) {
     if (ojf->max_records == UINT64_MAX && ojf->rotate_time == UINT64_MAX) {
         char outfile[FILENAME_MAX];
         strncpy(outfile, ojf->outfile_name, FILENAME_MAX - 1);
+        outfile[FILENAME_MAX - 1] = '\0';
+        status = outfile_append_suffix(outfile, ojf);
+        if (status) {
+            ojf->file_error = true;
+            return status_err;
+        }
         ojf->file_pri = fopen(outfile, ojf->mode);
         if (ojf->file_pri == NULL) {
             perror("error: could not open fingerprint output file");
@@ -282,13 +430,8 @@ enum status output_file_rotate(struct output_file *ojf) {
             return status_err;
         }
 
-        if (ojf->type == file_type_pcap) {
-            status = write_pcap_file_header(ojf->file_pri);
-            if (status) {
-                perror("error: could not write pcap file header");
-                ojf->file_error = true;
-                return status_err;
-            }
+        if (write_outfile_header(ojf, ojf->file_pri)) {
+            return status_err;
         }
     }
     else {
@@ -306,20 +449,8 @@ enum status output_file_rotate(struct output_file *ojf) {
                 return status_err;
             }
 
-            if (ojf->type == file_type_pcap) {
-                status = write_pcap_file_header(ojf->file_pri);
-                if (status) {
-                    perror("error: could not write pcap file header");
-                    ojf->file_error = true;
-                    return status_err;
-                }
-
-                status = write_pcap_file_header(ojf->file_sec);
-                if (status) {
-                    perror("error: could not write pcap file header");
-                    ojf->file_error = true;
-                    return status_err;
-                }
+            if (write_outfile_header(ojf, ojf->file_pri) || write_outfile_header(ojf, ojf->file_sec)) {
+                return status_err;
             }
         }
         else {
@@ -328,13 +459,8 @@ enum status output_file_rotate(struct output_file *ojf) {
                 return status_err;
             }
 
-            if (ojf->type == file_type_pcap) {
-                status = write_pcap_file_header(ojf->file_sec);
-                if (status) {
-                    perror("error: could not write pcap file header");
-                    ojf->file_error = true;
-                    return status_err;
-                }
+            if (write_outfile_header(ojf, ojf->file_sec)) {
+                return status_err;
             }
         }
     }
@@ -429,6 +555,152 @@ enum status time_rotate (output_file* out_ctx) {
     return status_ok;
 } 
 
+/*
+ * struct output_batch gathers the messages that have been taken from
+ * the lockless queues, so that they can be handed to the output_writer
+ * in a single call.  The messages are not copied; they stay in the ring
+ * buffers of their queues until the writer is done with them.
+ *
+ * Since a writer may return before its write has completed (as the
+ * io_uring writer does), there are two iovec arrays: one is filled
+ * while the other is in flight.  When a batch is submitted, the read
+ * index of each queue is saved in in_flight_ridx, and the space up to
+ * that point is released once the write has completed.
+ */
+#define OUTPUT_BATCH_SIZE 64
+
+struct output_batch {
+    struct iovec iov[2][OUTPUT_BATCH_SIZE];
+    int current = 0;                     /* the iovec array being filled */
+    int count = 0;                       /* the number of messages in that array */
+    bool in_flight = false;              /* the other iovec array has been submitted */
+    uint64_t *in_flight_ridx = nullptr;  /* the read index of each queue when it was submitted */
+    output_writer *writer = nullptr;
+    FILE *file = nullptr;                /* the file started by output_batch_start_file() */
+    struct iovec header;                 /* the pcap file header, for compressed output */
+};
+
+void output_batch_complete(struct output_file *out_ctx, struct output_batch *batch) {
+    if (batch->in_flight) {
+        batch->writer->complete();
+        for (int q = 0; q < out_ctx->qs.qnum; q++) {
+            out_ctx->qs.queue[q].release(batch->in_flight_ridx[q]);
+        }
+        batch->in_flight = false;
+    }
+}
+
+void output_batch_flush(struct output_file *out_ctx, struct output_batch *batch) {
+    if (batch->count == 0) {
+        return;
+    }
+
+    /* anything written through stdio, such as a pcap file header, must come first */
+    fflush(out_ctx->file_pri);
+
+    output_batch_complete(out_ctx, batch);
+    batch->writer->write(fileno(out_ctx->file_pri), batch->iov[batch->current], batch->count);
+    for (int q = 0; q < out_ctx->qs.qnum; q++) {
+        batch->in_flight_ridx[q] = out_ctx->qs.queue[q].ridx;
+    }
+    batch->in_flight = true;
+    batch->current ^= 1;
+    batch->count = 0;
+}
+
+/*
+ * output_batch_sync() writes out everything in the batch, releases
+ * its space to the lockless queues, and has the writer push all of
+ * its data to the primary output file; it is called before that file
+ * is rotated or closed, and before the output thread parks
+ */
+void output_batch_sync(struct output_file *out_ctx, struct output_batch *batch) {
+    output_batch_flush(out_ctx, batch);
+    output_batch_complete(out_ctx, batch);
+    batch->writer->finish();
+}
+
+/*
+ * output_batch_end_file() is like output_batch_sync(), but it also
+ * ends the compressed frame of the primary output file; it is called
+ * before that file is rotated or closed
+ */
+void output_batch_end_file(struct output_file *out_ctx, struct output_batch *batch) {
+    output_batch_flush(out_ctx, batch);
+    output_batch_complete(out_ctx, batch);
+    batch->writer->end_file();
+}
+
+/*
+ * output_batch_start_file() is called whenever the primary output
+ * file might have changed, with that file as f.  When a new file is
+ * started, the writer is told about it, so that a compressed file
+ * gets a complete frame even if nothing is written to it; for
+ * compressed pcap output, the file header is written through the
+ * writer, so that it is compressed along with the packets
+ */
+void output_batch_start_file(struct output_file *out_ctx, struct output_batch *batch, FILE *f) {
+    if (batch->file == f) {
+        return;
+    }
+    batch->file = f;
+    batch->writer->start_file(fileno(f));
+    if (out_ctx->type == file_type_pcap && out_ctx->compression.type != output_compression_none) {
+        batch->header.iov_base = (void *)pcap_file_header(&batch->header.iov_len);
+        batch->writer->write(fileno(f), &batch->header, 1);
+    }
+}
+
+enum status output_batch_add(struct output_file *out_ctx, struct output_batch *batch, int wq, struct llq_msg *wmsg) {
+
+    batch->iov[batch->current][batch->count].iov_base = wmsg->buf;
+    batch->iov[batch->current][batch->count].iov_len = wmsg->len;
+    batch->count++;
+    out_ctx->qs.queue[wq].advance_ridx();
+
+    if (batch->count == OUTPUT_BATCH_SIZE) {
+        output_batch_flush(out_ctx, batch);
+    }
+
+    /* Handle rotating file if needed; rotation always happens on a batch boundary */
+    if (output_file_needs_rotation(out_ctx)) {
+        output_batch_end_file(out_ctx, batch);
+        enum status status = limit_rotate(out_ctx);
+        if (status) {
+            return status;
+        }
+        output_batch_start_file(out_ctx, batch, out_ctx->file_pri);
+    }
+
+    if (out_ctx->time_rotation_req.load() == true) {
+        output_batch_end_file(out_ctx, batch);
+        enum status status = time_rotate(out_ctx);
+        if (status) {
+            return status;
+        }
+        output_batch_start_file(out_ctx, batch, out_ctx->file_pri);
+    }
+
+    return status_ok;
+}
+
+void output_thread_park(struct output_file *out_ctx) {
+    struct thread_queues *tqs = &out_ctx->qs;
+
+    uint32_t key = tqs->data_ready.prepare_wait();
+    for (int q = 0; q < tqs->qnum; q++) {
+        if (!tqs->queue[q].empty()) {
+            tqs->data_ready.cancel_wait();
+            return;
+        }
+    }
+    if (out_ctx->sig_stop_output != 0) {
+        tqs->data_ready.cancel_wait();
+        return;
+    }
+    tqs->data_ready.wait(key, LLQ_PARK_NSEC);
+}
+
 void *output_thread_func(void *arg) {
 
     struct output_file *out_ctx = (struct output_file *)arg;
@@ -499,6 +771,11 @@ void *output_thread_func(void *arg) {
      * does pause for more than 5 seconds only messages older than 5
      * seconds will be flushed.
      *
+     * When the queues are fed from a file, an empty queue whose
+     * producer has processed all of its input does not count as a
+     * stall, and messages are never flushed because of their age (see
+     * struct thread_queues).
+     *
      * The other big assumption is that each lockless queue is in
      * perfect order.  Testing shows that rarely, packets can be
      * out-of-order by a few microseconds in a lockless queue.  This
@@ -523,6 +800,15 @@ void *output_thread_func(void *arg) {
         t_tree.tree[i] = -1;
     }
 
+    struct output_batch batch;
+    batch.in_flight_ridx = (uint64_t *)calloc(out_ctx->qs.qnum, sizeof(uint64_t));
+    if (batch.in_flight_ridx == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the output batch\n");
+        exit(255);
+    }
+    batch.writer = output_writer::create(out_ctx->io_type, out_ctx->compression, out_ctx->verbosity);
+    output_batch_start_file(out_ctx, &batch, out_ctx->file_pri);
+
     int all_output_flushed = 0;
     enum status status = status_ok;
     while (all_output_flushed == 0) {
@@ -543,31 +829,13 @@ void *output_thread_func(void *arg) {
         while (t_tree.stalled == 0) {
             wq = t_tree.tree[0]; /* the root node is always the winning queue */
 
-            struct llq_msg *wmsg = &(out_ctx->qs.queue[wq].msgs[out_ctx->qs.queue[wq].ridx]);
-            if (wmsg->used == 1) {
-                fwrite(wmsg->buf, wmsg->len, 1, out_ctx->file_pri);
-
-                /* A full memory barrier prevents the following flag (un)set from happening too soon */
-                __sync_synchronize();
-                wmsg->used = 0;
-
-                /* Handle rotating file if needed */
-                if (output_file_needs_rotation(out_ctx)) {
-                    status = limit_rotate(out_ctx);
-                    if (status) {
-                        break;
-                    }
-                }
-
-                if (out_ctx->time_rotation_req.load() == true) {
-                    status = time_rotate(out_ctx);
-                    if (status) {
-                        break;
-                    }
+            struct llq_msg *wmsg = out_ctx->qs.queue[wq].peek();
+            if (wmsg != nullptr) {
+                status = output_batch_add(out_ctx, &batch, wq, wmsg);
+                if (status) {
+                    break;
                 }
 
-                out_ctx->qs.queue[wq].ridx = (out_ctx->qs.queue[wq].ridx + 1) % LLQ_DEPTH;
-
                 run_tourn_for_queue(&t_tree, wq, &out_ctx->qs);
             }
             else {
@@ -593,13 +861,15 @@ void *output_thread_func(void *arg) {
          */
 
         int old_done = 0;
+        int all_queues_empty = 0;
         while (old_done == 0) {
             wq = t_tree.tree[0];
 
-            struct llq_msg *wmsg = &(out_ctx->qs.queue[wq].msgs[out_ctx->qs.queue[wq].ridx]);
-            if (wmsg->used == 0) {
+            struct llq_msg *wmsg = out_ctx->qs.queue[wq].peek();
+            if (wmsg == nullptr) {
                 /* Even the top queue has nothing so we can just stop now */
                 old_done = 1;
+                all_queues_empty = 1;
 
                 /* This is how we detect no more output is coming */
                 if (out_ctx->sig_stop_output != 0) {
@@ -607,56 +877,72 @@ void *output_thread_func(void *arg) {
                 }
 
                 break;
-            } else if (time_less(&(wmsg->ts), &old_ts) == 1) {
+            } else if (!out_ctx->qs.input_tracked && time_less(&(wmsg->ts), &old_ts) == 1) {
                 //fprintf(stderr, "DEBUG: writing old message from queue %d\n", wq);
-                fwrite(wmsg->buf, wmsg->len, 1, out_ctx->file_pri);
-
-                /* A full memory barrier prevents the following flag (un)set from happening too soon */
-                __sync_synchronize();
-                wmsg->used = 0;
-
-                /* Handle rotating file if needed */
-                if (output_file_needs_rotation(out_ctx)) {
-                    status = limit_rotate(out_ctx);
-                    if (status) {
-                        break;
-                    }
-                }
-
-                if (out_ctx->time_rotation_req.load() == true) {
-                    status = time_rotate(out_ctx);
-                    if (status) {
-                        break;
-                    }
+                status = output_batch_add(out_ctx, &batch, wq, wmsg);
+                if (status) {
+                    break;
                 }
 
-                out_ctx->qs.queue[wq].ridx = (out_ctx->qs.queue[wq].ridx + 1) % LLQ_DEPTH;
-
                 run_tourn_for_queue(&t_tree, wq, &out_ctx->qs);
             } else {
                 old_done = 1;
             }
         }
 
-        /* This sleep slows us down so we don't spin the CPU.
-         * We probably could afford to call fflush() here
-         * the first time instead of sleeping and only sleep
-         * if we really aren't recieving any messages on
-         * any queues.
+        /* Write out whatever is left in the batch, and return the
+         * space it occupied to the lockless queues
          */
-        struct timespec sleep_ts;
-        sleep_ts.tv_sec = 0;
-        sleep_ts.tv_nsec = 1000000;
-        nanosleep(&sleep_ts, NULL);
+        output_batch_flush(out_ctx, &batch);
+        output_batch_complete(out_ctx, &batch);
+
+        if (all_output_flushed == 0) {
+            if (all_queues_empty) {
+                /* Nothing is waiting in any queue, so we park until a
+                 * producer publishes a message; the writer's buffered
+                 * data is pushed out first, so that it does not sit
+                 * there while the link is idle
+                 */
+                output_batch_sync(out_ctx, &batch);
+                output_thread_park(out_ctx);
+            } else {
+                /* At least one queue is empty, and the messages in
+                 * the others are too young to be flushed; this sleep
+                 * slows us down so we don't spin the CPU while we
+                 * wait for them
+                 */
+                struct timespec sleep_ts;
+                sleep_ts.tv_sec = 0;
+                sleep_ts.tv_nsec = 1000000;
+                nanosleep(&sleep_ts, NULL);
+            }
+        }
     } /* End all_output_flushed == 0 meaning we got a signal to stop */
 
     if (t_tree.tree) {
         free(t_tree.tree);
     }
-    
+
+    output_batch_end_file(out_ctx, &batch);
+
     if (out_ctx->type != file_type_stdout) {
+        /* let the control thread finish any rotation that is in
+         * progress, since it closes file_used and opens file_sec
+         */
+        while ((out_ctx->rotation_req.load() == true || out_ctx->file_used != nullptr) && out_ctx->file_error.load() == false) {
+            sleep(1);
+        }
+        /* the file opened for the next rotation is left empty, but
+         * it should still be a valid (compressed) file
+         */
+        if (out_ctx->file_sec != nullptr) {
+            output_batch_start_file(out_ctx, &batch, out_ctx->file_sec);
+            batch.writer->end_file();
+        }
         close_outfiles(out_ctx);
     }
+    delete batch.writer;
+    free(batch.in_flight_ridx);
 
     return NULL;
 }
@@ -677,6 +963,14 @@ int output_thread_init(pthread_t &output_thread, struct output_file &out_ctx, co
         return -1;
     }
     out_ctx.t_output_p = 0;
+    out_ctx.verbosity = cfg.verbosity;
+    if (cfg.output_io) {
+        output_io_type_from_string(cfg.output_io, &out_ctx.io_type);
+    }
+    if (cfg.compression) {
+        output_compression_from_string(cfg.compression, &out_ctx.compression);
+    }
+    out_ctx.compression.threads = cfg.compression_threads;
 
     //fprintf(stderr, "DEBUG: fingerprint filename: %s\n", cfg.fingerprint_filename);
     //fprintf(stderr, "DEBUG: max records: %ld\n", out_ctx.out_jf.max_records);
@@ -692,6 +986,24 @@ int output_thread_init(pthread_t &output_thread, struct output_file &out_ctx, co
 
 void output_thread_finalize(pthread_t output_thread, struct output_file *out_file) {
     out_file->sig_stop_output = 1;
+    out_file->qs.data_ready.notify();
     pthread_join(output_thread, NULL);
-    thread_queues_free(&out_file->qs);
+
+    if (out_file->verbosity) {
+        uint64_t producer_parks = 0;
+        uint64_t producer_wakeups = 0;
+        for (int q = 0; q < out_file->qs.qnum; q++) {
+            producer_parks += out_file->qs.queue[q].space_ready.parks;
+            producer_wakeups += out_file->qs.queue[q].space_ready.wakeups;
+        }
+        fprintf(stderr, "output thread parks: %" PRIu64 ", wake-ups: %" PRIu64 "; producer parks: %" PRIu64 ", wake-ups: %" PRIu64 "\n",
+                out_file->qs.data_ready.parks.load(), out_file->qs.data_ready.wakeups.load(), producer_parks, producer_wakeups);
+
+        struct output_queue_stats *snapshot = (struct output_queue_stats *)calloc(out_file->qs.qnum, sizeof(struct output_queue_stats));
+        if (snapshot) {
+            output_queue_stats_snapshot(&out_file->qs, snapshot, false);
+            output_queue_stats_write_json(stderr, &out_file->qs, snapshot, NULL);
+            free(snapshot);
+        }
+    }
 }
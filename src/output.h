@@ -13,6 +13,7 @@
 #include <pthread.h>
 #include "mercury.h"
 #include "llq.h"
+#include "output_writer.h"
 
 enum file_type {
    file_type_unknown=0,
@@ -40,14 +41,44 @@ struct output_file {
     pthread_mutex_t t_output_m;
     struct thread_queues qs;
     int sig_stop_output = 0;
+    int verbosity = 0;
+    enum output_io_type io_type = output_io_writev;
+    struct output_compression compression;
 };
 
+/*
+ * struct output_queue_stats is a snapshot of the backpressure
+ * counters of a single lockless queue; see struct llq_stats
+ */
+struct output_queue_stats {
+    uint64_t msgs;
+    uint64_t bytes;
+    uint64_t drops;
+    uint64_t blocked_nsec;
+    uint64_t high_water;
+    uint64_t in_use;      /* ring bytes in use when the snapshot was taken */
+};
+
+void output_queue_stats_snapshot(struct thread_queues *tqs, struct output_queue_stats *snapshot, bool reset_high_water);
+
+void output_queue_stats_write_json(FILE *f,
+                                   const struct thread_queues *tqs,
+                                   const struct output_queue_stats *curr,
+                                   const struct output_queue_stats *prev);
+
+bool output_queue_stats_append_gz(const char *filename,
+                                  const struct thread_queues *tqs,
+                                  const struct output_queue_stats *curr,
+                                  const struct output_queue_stats *prev);
+
 void *output_thread_func(void *arg);
 
 int output_thread_init(pthread_t &output_thread, struct output_file &out_ctx, const struct mercury_config &cfg);
 
 void output_thread_finalize(pthread_t output_thread, struct output_file *out_file);
 
+void thread_queues_free(struct thread_queues *tqs);
+
 char *stdout_string();
 
 enum status output_file_rotate(struct output_file *ojf);
@@ -0,0 +1,759 @@
+/*
+ * output_writer.c
+ *
+ * backends that write batches of output records to a file
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc.  All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE   /* for O_DIRECT */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "output_writer.h"
+
+bool output_io_type_from_string(const char *name, enum output_io_type *type) {
+    if (strcmp(name, "writev") == 0) {
+        *type = output_io_writev;
+    } else if (strcmp(name, "io_uring") == 0) {
+        *type = output_io_uring;
+    } else if (strcmp(name, "direct") == 0) {
+        *type = output_io_direct;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *output_io_type_name(enum output_io_type type) {
+    switch(type) {
+    case output_io_uring:
+        return "io_uring";
+    case output_io_direct:
+        return "direct";
+    case output_io_writev:
+    default:
+        break;
+    }
+    return "writev";
+}
+
+bool output_compression_from_string(const char *name, struct output_compression *compression) {
+    const char *level = strchr(name, ':');
+    size_t name_len = level ? (size_t)(level - name) : strlen(name);
+
+    if (name_len == 4 && strncmp(name, "none", 4) == 0 && level == nullptr) {
+        compression->type = output_compression_none;
+        compression->level = 0;
+        return true;
+    }
+    if (name_len == 4 && strncmp(name, "gzip", 4) == 0) {
+        compression->type = output_compression_gzip;
+    }
+#ifdef HAVE_ZSTD
+    else if (name_len == 4 && strncmp(name, "zstd", 4) == 0) {
+        compression->type = output_compression_zstd;
+    }
+#endif
+    else {
+        return false;
+    }
+
+    compression->level = 0;
+    if (level) {
+        char *end;
+        errno = 0;
+        long l = strtol(level + 1, &end, 10);
+        if (errno || end == level + 1 || *end != '\0') {
+            return false;
+        }
+        if (compression->type == output_compression_gzip && (l < 1 || l > 9)) {
+            return false;
+        }
+#ifdef HAVE_ZSTD
+        if (compression->type == output_compression_zstd && (l < ZSTD_minCLevel() || l > ZSTD_maxCLevel() || l == 0)) {
+            return false;
+        }
+#endif
+        compression->level = l;
+    }
+    return true;
+}
+
+const char *output_compression_suffix(enum output_compression_type type) {
+    switch(type) {
+    case output_compression_gzip:
+        return ".gz";
+    case output_compression_zstd:
+        return ".zst";
+    case output_compression_none:
+    default:
+        break;
+    }
+    return "";
+}
+
+/*
+ * writev_all() writes all of the buffers in iov to fd, except for
+ * the first skip bytes, retrying after partial writes
+ */
+static void writev_all(int fd, const struct iovec *iov, int iovcnt, size_t skip) {
+    while (iovcnt > 0) {
+        while (iovcnt > 0 && skip >= iov->iov_len) {
+            skip -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt == 0) {
+            break;
+        }
+        ssize_t written;
+        if (skip) {
+            written = ::write(fd, (const char *)iov->iov_base + skip, iov->iov_len - skip);
+        } else {
+            written = writev(fd, iov, iovcnt < IOV_MAX ? iovcnt : IOV_MAX);
+        }
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("error: could not write to output file");
+            return;
+        }
+        skip += written;
+    }
+}
+
+class writev_writer : public output_writer {
+public:
+    void write(int fd, const struct iovec *iov, int iovcnt) override {
+        writev_all(fd, iov, iovcnt, 0);
+    }
+};
+
+/*
+ * io_uring_writer submits each batch as an IORING_OP_WRITEV request
+ * and returns without waiting for it, so that the output thread can
+ * gather the next batch while the kernel writes the previous one.  At
+ * most one request is in flight, which keeps the records in order;
+ * the request writes at the current file position (offset -1), like
+ * writev() does.  The ring is set up with raw system calls, so that
+ * liburing is not needed.
+ */
+class io_uring_writer : public output_writer {
+    int ring_fd = -1;
+    void *sq_ring = MAP_FAILED;
+    void *cq_ring = MAP_FAILED;
+    size_t sq_ring_size = 0;
+    size_t cq_ring_size = 0;
+    struct io_uring_sqe *sqes = (struct io_uring_sqe *)MAP_FAILED;
+    size_t sqes_size = 0;
+
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    bool in_flight = false;
+    bool failed = false;        /* a submission failed, so writes are made with writev() */
+    int fd = -1;
+    const struct iovec *iov = nullptr;
+    int iovcnt = 0;
+
+public:
+
+    // init() sets up the ring, and returns 0 on success, or a
+    // negative errno value on failure, as io_uring_queue_init() does
+    //
+    int init() {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        ring_fd = syscall(__NR_io_uring_setup, 4, &p);
+        if (ring_fd < 0) {
+            return -errno;
+        }
+        if ((p.features & IORING_FEAT_RW_CUR_POS) == 0) {
+            return -EOPNOTSUPP;    // offset -1 is not supported for regular files
+        }
+
+        sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+            if (cq_ring_size > sq_ring_size) {
+                sq_ring_size = cq_ring_size;
+            }
+            cq_ring_size = 0;
+        }
+        sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+        if (sq_ring == MAP_FAILED) {
+            return -errno;
+        }
+        void *cq_base = sq_ring;
+        if (cq_ring_size) {
+            cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+            if (cq_ring == MAP_FAILED) {
+                return -errno;
+            }
+            cq_base = cq_ring;
+        }
+        sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = (struct io_uring_sqe *)mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return -errno;
+        }
+
+        sq_tail  = (unsigned *)((uint8_t *)sq_ring + p.sq_off.tail);
+        sq_mask  = (unsigned *)((uint8_t *)sq_ring + p.sq_off.ring_mask);
+        sq_array = (unsigned *)((uint8_t *)sq_ring + p.sq_off.array);
+        cq_head  = (unsigned *)((uint8_t *)cq_base + p.cq_off.head);
+        cq_tail  = (unsigned *)((uint8_t *)cq_base + p.cq_off.tail);
+        cq_mask  = (unsigned *)((uint8_t *)cq_base + p.cq_off.ring_mask);
+        cqes     = (struct io_uring_cqe *)((uint8_t *)cq_base + p.cq_off.cqes);
+
+        return 0;
+    }
+
+    ~io_uring_writer() {
+        complete();
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_ring != MAP_FAILED) {
+            munmap(cq_ring, cq_ring_size);
+        }
+        if (sq_ring != MAP_FAILED) {
+            munmap(sq_ring, sq_ring_size);
+        }
+        if (ring_fd >= 0) {
+            close(ring_fd);
+        }
+    }
+
+    void write(int new_fd, const struct iovec *new_iov, int new_iovcnt) override {
+        complete();
+        if (failed) {
+            writev_all(new_fd, new_iov, new_iovcnt, 0);
+            return;
+        }
+
+        unsigned tail = *sq_tail;
+        unsigned idx = tail & *sq_mask;
+        struct io_uring_sqe *sqe = &sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = new_fd;
+        sqe->addr = (uint64_t)new_iov;
+        sqe->len = new_iovcnt;
+        sqe->off = (uint64_t)-1;
+        sq_array[idx] = idx;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+        int ret;
+        do {
+            ret = syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, NULL, 0);
+        } while (ret < 0 && errno == EINTR);
+        if (ret != 1) {
+            perror("error: could not submit io_uring write");
+            // the request might still be in the submission queue, so
+            // the ring is not used again after this
+            failed = true;
+            writev_all(new_fd, new_iov, new_iovcnt, 0);
+            return;
+        }
+        in_flight = true;
+        fd = new_fd;
+        iov = new_iov;
+        iovcnt = new_iovcnt;
+    }
+
+    void complete() override {
+        if (!in_flight) {
+            return;
+        }
+        unsigned head = *cq_head;
+        while (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            int ret = syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+            if (ret < 0 && errno != EINTR) {
+                perror("error: could not wait for io_uring write");
+                break;
+            }
+        }
+        if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            return;   // the request is still in flight, so its buffers stay reserved
+        }
+        int res = cqes[head & *cq_mask].res;
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        in_flight = false;
+
+        // a failed or short write is finished off synchronously
+        //
+        size_t skip = 0;
+        if (res < 0) {
+            if (res != -EAGAIN && res != -EINTR) {
+                fprintf(stderr, "error: io_uring write to output file failed (%s)\n", strerror(-res));
+                return;
+            }
+        } else {
+            skip = res;
+        }
+        writev_all(fd, iov, iovcnt, skip);
+    }
+};
+
+/*
+ * direct_writer copies each batch into an aligned staging buffer and
+ * writes it out in whole blocks through a descriptor that has
+ * O_DIRECT set, so that output files do not fill the page cache.
+ *
+ * The file position is not always block aligned: the pcap file
+ * header is written through stdio, and a partial block is written
+ * out by finish().  The bytes needed to reach the next block
+ * boundary, and the partial block at the end, are written with
+ * O_DIRECT cleared.  If the output is not a regular file, or its
+ * filesystem does not support O_DIRECT, all writes are made through
+ * the page cache.
+ */
+class direct_writer : public output_writer {
+    static constexpr size_t block_size = 4096;
+    static constexpr size_t buffer_size = 1 << 20;
+
+    uint8_t *buffer = nullptr;
+    size_t length = 0;          /* number of bytes in buffer */
+    int fd = -1;                /* descriptor that buffer will be written to, or -1 if none */
+    off_t offset = 0;           /* file offset of buffer[0] */
+    bool direct = false;        /* O_DIRECT is set on fd */
+    bool supported = true;      /* O_DIRECT can be set on fd */
+
+    void set_direct(bool on) {
+        if (on == direct || (on && !supported)) {
+            return;
+        }
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, on ? (flags | O_DIRECT) : (flags & ~O_DIRECT)) < 0) {
+            if (on) {
+                fprintf(stderr, "warning: O_DIRECT is not supported for the output file; writing through the page cache\n");
+                supported = false;
+            }
+            return;
+        }
+        direct = on;
+    }
+
+    void write_out(size_t n) {
+        const uint8_t *p = buffer;
+        size_t remaining = n;
+        while (remaining > 0) {
+            ssize_t written = ::write(fd, p, remaining);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("error: could not write to output file");
+                break;
+            }
+            p += written;
+            remaining -= written;
+        }
+        offset += n;
+        length -= n;
+        memmove(buffer, buffer + n, length);
+    }
+
+    void write_blocks() {
+        size_t misalignment = offset & (block_size - 1);
+        if (misalignment && length > 0) {
+            size_t head = block_size - misalignment;
+            set_direct(false);
+            write_out(head < length ? head : length);
+        }
+        size_t whole_blocks = length & ~(block_size - 1);
+        if (whole_blocks && (offset & (block_size - 1)) == 0) {
+            set_direct(true);
+            write_out(whole_blocks);
+        }
+    }
+
+public:
+
+    bool init() {
+        return posix_memalign((void **)&buffer, block_size, buffer_size) == 0;
+    }
+
+    ~direct_writer() {
+        finish();
+        free(buffer);
+    }
+
+    void write(int new_fd, const struct iovec *iov, int iovcnt) override {
+        if (fd != new_fd) {
+            finish();
+            fd = new_fd;
+            offset = lseek(fd, 0, SEEK_CUR);
+            if (offset < 0) {
+                offset = 0;
+            }
+            int flags = fcntl(fd, F_GETFL);
+            direct = flags >= 0 && (flags & O_DIRECT);
+            struct stat st;
+            supported = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);  // on a pipe, O_DIRECT means packet mode
+        }
+        for (int i = 0; i < iovcnt; i++) {
+            const uint8_t *data = (const uint8_t *)iov[i].iov_base;
+            size_t data_len = iov[i].iov_len;
+            while (data_len > 0) {
+                size_t n = buffer_size - length;
+                if (n > data_len) {
+                    n = data_len;
+                }
+                memcpy(buffer + length, data, n);
+                length += n;
+                data += n;
+                data_len -= n;
+                if (length == buffer_size) {
+                    write_blocks();
+                }
+            }
+        }
+        write_blocks();
+    }
+
+    void finish() override {
+        if (fd < 0) {
+            return;
+        }
+        write_blocks();
+        if (length > 0) {
+            set_direct(false);
+            write_out(length);
+        }
+        fd = -1;
+    }
+};
+
+/*
+ * compressing_writer compresses the data passed to it, and hands the
+ * compressed data to another writer.  Each output file holds a single
+ * gzip member or zstd frame, which is ended by end_file(); finish()
+ * flushes the compressor, so that everything written so far can be
+ * decompressed while the file is still open.
+ *
+ * There are two output buffers, so that one can be filled while the
+ * next writer is still writing the other; the next writer completes
+ * its previous write before it starts a new one.
+ */
+class compressing_writer : public output_writer {
+    static constexpr size_t buffer_size = 1 << 18;
+
+    output_writer *next;
+    uint8_t *buffer[2] = { nullptr, nullptr };
+    struct iovec iov[2];
+    int current = 0;            /* the buffer being filled */
+    size_t length = 0;          /* the number of bytes in that buffer */
+    int fd = -1;                /* the descriptor being written, or -1 if no frame is open */
+    bool flushed = true;        /* nothing has been compressed since the last flush */
+
+protected:
+
+    enum directive {
+        compress_continue,      /* compress data, emitting output as it becomes available */
+        compress_flush,         /* emit all of the data compressed so far */
+        compress_end            /* emit all of the data and end the frame */
+    };
+
+    /*
+     * compress() feeds data to the compressor, which writes its output
+     * into out, starting at out_pos and continuing up to out_len.  It
+     * sets consumed and out_pos to reflect what it did, and returns
+     * true when the directive has been carried out for all of the
+     * data, or false if it needs more room in out
+     */
+    virtual bool compress(const uint8_t *data, size_t data_len, size_t *consumed,
+                          uint8_t *out, size_t out_len, size_t *out_pos, enum directive directive) = 0;
+
+    virtual void reset() = 0;
+
+    virtual bool init() {
+        for (uint8_t *&b : buffer) {
+            b = (uint8_t *)malloc(buffer_size);
+            if (b == nullptr) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+public:
+
+    compressing_writer(output_writer *w) : next{w} { }
+
+    ~compressing_writer() {
+        delete next;
+        free(buffer[0]);
+        free(buffer[1]);
+    }
+
+    void emit() {
+        if (length > 0) {
+            iov[current].iov_base = buffer[current];
+            iov[current].iov_len = length;
+            next->write(fd, &iov[current], 1);
+            current ^= 1;
+            length = 0;
+        }
+    }
+
+    void run(const uint8_t *data, size_t data_len, enum directive directive) {
+        while (true) {
+            size_t consumed = 0;
+            bool done = compress(data, data_len, &consumed, buffer[current], buffer_size, &length, directive);
+            data += consumed;
+            data_len -= consumed;
+            if (length == buffer_size) {
+                emit();
+            }
+            if (done) {
+                break;
+            }
+        }
+    }
+
+    void start_file(int new_fd) override {
+        fd = new_fd;
+        next->start_file(new_fd);
+    }
+
+    void write(int new_fd, const struct iovec *in_iov, int iovcnt) override {
+        fd = new_fd;
+        for (int i = 0; i < iovcnt; i++) {
+            run((const uint8_t *)in_iov[i].iov_base, in_iov[i].iov_len, compress_continue);
+        }
+        flushed = false;
+    }
+
+    void complete() override {
+        next->complete();
+    }
+
+    void finish() override {
+        if (fd >= 0 && !flushed) {
+            run(nullptr, 0, compress_flush);
+            emit();
+            flushed = true;
+        }
+        next->finish();
+    }
+
+    void end_file() override {
+        if (fd >= 0) {
+            run(nullptr, 0, compress_end);
+            emit();
+            reset();
+            fd = -1;
+            flushed = true;
+        }
+        next->end_file();
+    }
+};
+
+class gzip_writer : public compressing_writer {
+    z_stream strm;
+    bool initialized = false;
+
+    bool compress(const uint8_t *data, size_t data_len, size_t *consumed,
+                  uint8_t *out, size_t out_len, size_t *out_pos, enum directive directive) override {
+        strm.next_in = (Bytef *)data;
+        strm.avail_in = data_len;
+        strm.next_out = out + *out_pos;
+        strm.avail_out = out_len - *out_pos;
+        int flush = Z_NO_FLUSH;
+        if (directive == compress_flush) {
+            flush = Z_SYNC_FLUSH;
+        } else if (directive == compress_end) {
+            flush = Z_FINISH;
+        }
+        int ret = deflate(&strm, flush);
+        *consumed = data_len - strm.avail_in;
+        *out_pos = out_len - strm.avail_out;
+        if (ret == Z_STREAM_ERROR) {
+            fprintf(stderr, "error: gzip compression failed\n");
+            return true;
+        }
+        if (directive == compress_end) {
+            return ret == Z_STREAM_END;
+        }
+        return strm.avail_in == 0 && strm.avail_out != 0;
+    }
+
+    void reset() override {
+        deflateReset(&strm);
+    }
+
+public:
+
+    gzip_writer(output_writer *w) : compressing_writer{w} { }
+
+    ~gzip_writer() {
+        if (initialized) {
+            deflateEnd(&strm);
+        }
+    }
+
+    bool init(int level) {
+        memset(&strm, 0, sizeof(strm));
+        if (level == 0) {
+            level = Z_DEFAULT_COMPRESSION;
+        }
+        // windowBits of 15 + 16 selects a gzip header and trailer
+        if (deflateInit2(&strm, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return false;
+        }
+        initialized = true;
+        return compressing_writer::init();
+    }
+};
+
+#ifdef HAVE_ZSTD
+
+class zstd_writer : public compressing_writer {
+    ZSTD_CCtx *cctx = nullptr;
+
+    bool compress(const uint8_t *data, size_t data_len, size_t *consumed,
+                  uint8_t *out, size_t out_len, size_t *out_pos, enum directive directive) override {
+        ZSTD_inBuffer in = { data, data_len, 0 };
+        ZSTD_outBuffer output = { out, out_len, *out_pos };
+        ZSTD_EndDirective end = ZSTD_e_continue;
+        if (directive == compress_flush) {
+            end = ZSTD_e_flush;
+        } else if (directive == compress_end) {
+            end = ZSTD_e_end;
+        }
+        size_t remaining = ZSTD_compressStream2(cctx, &output, &in, end);
+        *consumed = in.pos;
+        *out_pos = output.pos;
+        if (ZSTD_isError(remaining)) {
+            fprintf(stderr, "error: zstd compression failed (%s)\n", ZSTD_getErrorName(remaining));
+            return true;
+        }
+        if (directive == compress_continue) {
+            return in.pos == in.size;
+        }
+        return remaining == 0;
+    }
+
+    void reset() override {
+        ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+    }
+
+public:
+
+    zstd_writer(output_writer *w) : compressing_writer{w} { }
+
+    ~zstd_writer() {
+        ZSTD_freeCCtx(cctx);
+    }
+
+    bool init(int level, int threads) {
+        cctx = ZSTD_createCCtx();
+        if (cctx == nullptr) {
+            return false;
+        }
+        if (level != 0 && ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level))) {
+            return false;
+        }
+        if (threads > 0 && ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, threads))) {
+            fprintf(stderr, "warning: zstd library does not support worker threads; compressing in the output thread\n");
+        }
+        return compressing_writer::init();
+    }
+};
+
+#endif // HAVE_ZSTD
+
+output_writer *output_writer::create(enum output_io_type type, const struct output_compression &compression, int verbosity) {
+    output_writer *writer = nullptr;
+
+    switch(type) {
+    case output_io_uring:
+        {
+            io_uring_writer *w = new io_uring_writer;
+            int ret = w->init();
+            if (ret == 0) {
+                writer = w;
+            } else {
+                fprintf(stderr, "warning: io_uring is not available (%s); using writev output\n", strerror(-ret));
+                delete w;
+            }
+        }
+        break;
+    case output_io_direct:
+        {
+            direct_writer *w = new direct_writer;
+            if (w->init()) {
+                writer = w;
+            } else {
+                fprintf(stderr, "warning: could not allocate O_DIRECT buffer; using writev output\n");
+                delete w;
+            }
+        }
+        break;
+    case output_io_writev:
+    default:
+        break;
+    }
+    if (writer == nullptr) {
+        writer = new writev_writer;
+        type = output_io_writev;
+    }
+    if (verbosity) {
+        fprintf(stderr, "output backend: %s\n", output_io_type_name(type));
+    }
+
+    switch(compression.type) {
+    case output_compression_gzip:
+        {
+            gzip_writer *w = new gzip_writer(writer);
+            if (!w->init(compression.level)) {
+                fprintf(stderr, "error: could not initialize gzip compression\n");
+                exit(EXIT_FAILURE);
+            }
+            writer = w;
+        }
+        break;
+#ifdef HAVE_ZSTD
+    case output_compression_zstd:
+        {
+            zstd_writer *w = new zstd_writer(writer);
+            if (!w->init(compression.level, compression.threads)) {
+                fprintf(stderr, "error: could not initialize zstd compression\n");
+                exit(EXIT_FAILURE);
+            }
+            writer = w;
+        }
+        break;
+#endif
+    case output_compression_none:
+    default:
+        break;
+    }
+    return writer;
+}
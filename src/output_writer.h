@@ -0,0 +1,91 @@
+/*
+ * output_writer.h
+ *
+ * backends that write batches of output records to a file
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc.  All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+#include <sys/uio.h>
+
+enum output_io_type {
+    output_io_writev = 0,   /* writev() on the file descriptor (default) */
+    output_io_uring,        /* vectored writes submitted through io_uring */
+    output_io_direct        /* aligned O_DIRECT writes, which bypass the page cache */
+};
+
+bool output_io_type_from_string(const char *name, enum output_io_type *type);
+
+const char *output_io_type_name(enum output_io_type type);
+
+enum output_compression_type {
+    output_compression_none = 0,
+    output_compression_gzip,
+    output_compression_zstd     /* only available if zstd.h was found by configure */
+};
+
+struct output_compression {
+    enum output_compression_type type = output_compression_none;
+    int level = 0;              /* compression level, or 0 for the library default */
+    int threads = 0;            /* zstd worker threads, or 0 to compress in the output thread */
+};
+
+/*
+ * output_compression_from_string() parses a compression setting of
+ * the form "none", "gzip[:level]", or "zstd[:level]"
+ */
+bool output_compression_from_string(const char *name, struct output_compression *compression);
+
+const char *output_compression_suffix(enum output_compression_type type);
+
+/*
+ * class output_writer is the interface through which the output
+ * thread writes the records that it has gathered into a batch
+ *
+ * start_file(fd) tells the writer that a new output file has been
+ * opened on fd, even if nothing is written to it.
+ *
+ * write(fd, iov, iovcnt) starts writing the buffers in iov to the
+ * file descriptor fd.  It may return before the data has been
+ * written, so neither the iovec array nor the buffers that it points
+ * to can be reused until complete() has been called.
+ *
+ * complete() waits until the writer no longer references any of the
+ * buffers passed to write().
+ *
+ * finish() waits until all of the data passed to write() has reached
+ * the file descriptor, so that it can be read while the file is still
+ * open.
+ *
+ * end_file() is like finish(), but it also ends the compressed frame,
+ * if any.  It must be called before the file is closed or rotated;
+ * the next write() can then use a different descriptor.
+ */
+class output_writer {
+public:
+    virtual ~output_writer() { }
+
+    virtual void start_file(int fd) { (void)fd; }
+
+    virtual void write(int fd, const struct iovec *iov, int iovcnt) = 0;
+
+    virtual void complete() { }
+
+    virtual void finish() { complete(); }
+
+    virtual void end_file() { finish(); }
+
+    /*
+     * create() returns a writer of the requested type, which
+     * compresses its output if compression is set; if that type is
+     * not supported by the kernel, a warning is printed and a
+     * writev() writer is used instead
+     */
+    static output_writer *create(enum output_io_type type, const struct output_compression &compression, int verbosity);
+};
+
+#endif /* OUTPUT_WRITER_H */
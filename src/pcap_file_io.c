@@ -38,29 +38,6 @@
 static uint32_t magic = 0xa1b2c3d4;
 static uint32_t cagim = 0xd4c3b2a1;
 
-/*
- * global pcap header (one per file, at beginning)
- */
-struct pcap_file_hdr {
-    uint32_t magic_number;   /* magic number */
-    uint16_t version_major;  /* major version number */
-    uint16_t version_minor;  /* minor version number */
-    int32_t  thiszone;       /* GMT to local correction */
-    uint32_t sigfigs;        /* accuracy of timestamps */
-    uint32_t snaplen;        /* max length of captured packets, in octets */
-    uint32_t network;        /* data link type */
-}  __attribute__((packed));
-
-/*
- * packet header (one per packet, right before it)
- */
-struct pcap_packet_hdr {
-    uint32_t ts_sec;         /* timestamp seconds */
-    uint32_t ts_usec;        /* timestamp microseconds */
-    uint32_t incl_len;       /* number of octets of packet saved in file */
-    uint32_t orig_len;       /* actual length of packet */
-} __attribute__((packed));
-
 #define ONE_KB (1024)
 #define ONE_MB (1024 * ONE_KB)
 #ifndef FBUFSIZE
@@ -85,17 +62,25 @@ static inline void set_file_io_buffer(struct pcap_file *f, const char *fname) {
     }
 }
 
+const void *pcap_file_header(size_t *length) {
+    static struct pcap_file_hdr file_header = {
+        magic,
+        2,                  /* version_major */
+        4,                  /* version_minor */
+        0,                  /* no GMT correction for now */
+        0,                  /* we don't claim sigfigs for now */
+        65535,              /* snaplen */
+        LINKTYPE_ETHERNET
+    };
+    *length = sizeof(file_header);
+    return &file_header;
+}
+
 enum status write_pcap_file_header(FILE *f) {
-    struct pcap_file_hdr file_header;
-    file_header.magic_number = magic;
-    file_header.version_major = 2;
-    file_header.version_minor = 4;
-    file_header.thiszone = 0;     /* no GMT correction for now */
-    file_header.sigfigs = 0;      /* we don't claim sigfigs for now */
-    file_header.snaplen = 65535;
-    file_header.network = LINKTYPE_ETHERNET;
-
-    size_t items_written = fwrite(&file_header, sizeof(file_header), 1, f);
+    size_t length;
+    const void *file_header = pcap_file_header(&length);
+
+    size_t items_written = fwrite(file_header, length, 1, f);
     if (items_written == 0) {
         perror("error writing pcap file header");
         return status_err;
@@ -457,6 +442,40 @@ enum status pcap_file_read_packet(struct pcap_file *f,
 }
 
 
+/*
+ * pcap_file_data_is_simple() returns true if the memory-mapped file
+ * data of length data_len is a single PCAP file whose packets
+ * pcap_file_read_packet() would return unmodified: it has the PCAP
+ * magic number, it contains no packet header that could be the file
+ * header of a concatenated file, and no packet is longer than BUFLEN.
+ * Only the packet headers are read.
+ */
+bool pcap_file_data_is_simple(const uint8_t *data, size_t data_len) {
+    struct pcap_file_hdr file_header;
+    if (data_len < sizeof(file_header)) {
+        return false;
+    }
+    memcpy(&file_header, data, sizeof(file_header));
+    if (file_header.magic_number != magic && file_header.magic_number != cagim) {
+        return false;  /* pcap-ng or unknown format */
+    }
+    size_t offset = sizeof(file_header);
+    while (offset + sizeof(struct pcap_packet_hdr) <= data_len) {
+        struct pcap_packet_hdr packet_hdr;
+        memcpy(&packet_hdr, data + offset, sizeof(packet_hdr));
+        if (pcap_packet_hdr_may_be_a_file_header(&packet_hdr)) {
+            return false;
+        }
+        uint32_t caplen = file_header.magic_number == cagim ? ntohl(packet_hdr.incl_len) : packet_hdr.incl_len;
+        if (caplen > BUFLEN) {
+            return false;
+        }
+        offset += sizeof(packet_hdr) + caplen;
+    }
+    return true;
+}
+
+
 void packet_info_init_from_pkthdr(struct packet_info *pi,
 				  struct pcap_pkthdr *pkthdr) {
     pi->len = pkthdr->caplen;
@@ -546,25 +565,13 @@ void pcap_queue_write(struct ll_queue *llq,
         return;  // error
     }
 
-    if (blocking) {
-        while (llq->msgs[llq->widx].used != 0) {
-            usleep(50); // sleep for fifty microseconds
-        }
-    }
-
-    if (llq->msgs[llq->widx].used == 0) {
+    struct llq_msg *msg = llq->init_msg(blocking, sec, nsec);
+    if (msg) {
 
-        //char obuf[LLQ_MSG_SIZE];
         int olen = LLQ_MSG_SIZE;
         int ooff = 0;
         int trunc = 0;
 
-        llq->msgs[llq->widx].ts.tv_sec = sec;
-        llq->msgs[llq->widx].ts.tv_nsec = nsec;
-
-        //obuf[sizeof(struct timespec)] = '\0';
-        llq->msgs[llq->widx].buf[0] = '\0';
-
         if (packet && !length) {
             fprintf(stderr, "warning: attempt to write an empty packet\n");
         }
@@ -577,34 +584,19 @@ void pcap_queue_write(struct ll_queue *llq,
         packet_hdr.orig_len = length;
 
         // write the packet header
-        int r = append_memcpy(llq->msgs[llq->widx].buf, &ooff, olen, &trunc, &packet_hdr, sizeof(packet_hdr));
+        int r = append_memcpy(msg->buf, &ooff, olen, &trunc, &packet_hdr, sizeof(packet_hdr));
 
         // write the packet
-        r += append_memcpy(llq->msgs[llq->widx].buf, &ooff, olen, &trunc, packet, length);
+        r += append_memcpy(msg->buf, &ooff, olen, &trunc, packet, length);
 
         // f->bytes_written += length + sizeof(struct pcap_packet_hdr);
         // f->packets_written++;
 
         if ((trunc == 0) && (r > 0)) {
-
-            llq->msgs[llq->widx].len = r;
-
-            //fprintf(stderr, "DEBUG: sent a message!\n");
-            __sync_synchronize(); /* A full memory barrier prevents the following flag set from happening too soon */
-            llq->msgs[llq->widx].used = 1;
-
-            //llq->next_write();
-            llq->widx = (llq->widx + 1) % LLQ_DEPTH;
+            msg->send(r);
+            llq->increment_widx();
         }
     }
-    else {
-        //fprintf(stderr, "DEBUG: queue bucket used!\n");
-
-        // TODO: this is where we'd update an output drop counter
-        // but currently this spot in the code doesn't have access to
-        // any thread stats pointer or similar and I don't want
-        // to update a global variable in this location.
-    }
-
+    // note: if the queue was full, init_msg() has counted the drop
 }
 
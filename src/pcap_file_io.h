@@ -24,6 +24,29 @@ enum io_direction {
     io_direction_writer = 2
 };
 
+/*
+ * global pcap header (one per file, at beginning)
+ */
+struct pcap_file_hdr {
+    uint32_t magic_number;   /* magic number */
+    uint16_t version_major;  /* major version number */
+    uint16_t version_minor;  /* minor version number */
+    int32_t  thiszone;       /* GMT to local correction */
+    uint32_t sigfigs;        /* accuracy of timestamps */
+    uint32_t snaplen;        /* max length of captured packets, in octets */
+    uint32_t network;        /* data link type */
+}  __attribute__((packed));
+
+/*
+ * packet header (one per packet, right before it)
+ */
+struct pcap_packet_hdr {
+    uint32_t ts_sec;         /* timestamp seconds */
+    uint32_t ts_usec;        /* timestamp microseconds */
+    uint32_t incl_len;       /* number of octets of packet saved in file */
+    uint32_t orig_len;       /* actual length of packet */
+} __attribute__((packed));
+
 enum status pcap_file_open(struct pcap_file *f,
                            const char *fname,
                            enum io_direction dir,
@@ -34,6 +57,8 @@ enum status pcap_file_read_packet(struct pcap_file *f,
 				  void *packet_data           /* output */
 				  );
 
+bool pcap_file_data_is_simple(const uint8_t *data, size_t data_len);
+
 struct pcap_file {
     FILE *file_ptr = nullptr;
     int fd = 0;                      // file descriptor returned by fileno()
@@ -113,5 +138,11 @@ void pcap_queue_write(struct ll_queue *llq,
 
 enum status write_pcap_file_header(FILE *f);
 
+/*
+ * pcap_file_header() returns the PCAP file header written by
+ * write_pcap_file_header(), and sets length to its size
+ */
+const void *pcap_file_header(size_t *length);
+
 
 #endif /* PCAP_FILE_IO_H */
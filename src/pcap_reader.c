@@ -6,10 +6,16 @@
  */
 
 #include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <arpa/inet.h>
 #include "pcap_reader.h"
 #include "output.h"
 #include "pkt_processing.h"
 #include "libmerc/utils.h"
+#include "libmerc/eth.h"
+#include "libmerc/ppp.h"
 
 extern int sig_close_flag;  // defined in signal_handling.c
 
@@ -64,6 +70,332 @@ void *pcap_file_processing_thread_func(void *userdata) {
     return NULL;
 }
 
+static inline uint16_t read_u16(const uint8_t *p) {
+    return (p[0] << 8) | p[1];
+}
+
+static inline uint32_t read_u32(const uint8_t *p) {
+    uint32_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+/*
+ * flow_hash() returns a hash of the source and destination addresses
+ * of the packet pkt of length len, which is the same for both
+ * directions of a flow, since the addresses are combined by addition.
+ * The ports and the protocol are not hashed, because the fragments of
+ * an IP packet after the first carry no ports, and IPv6 fragments
+ * carry the fragment header instead of the transport protocol, so
+ * the addresses are the only key that a flow shares with all of its
+ * fragments.  Packets that are not IP hash to zero.
+ */
+static uint64_t flow_hash(const uint8_t *pkt, size_t len, uint16_t linktype) {
+    const uint8_t *ip = pkt;
+    const uint8_t *end = pkt + len;
+
+    if (linktype == LINKTYPE_ETHERNET) {
+        if (len < 14) {
+            return 0;
+        }
+        uint16_t ethertype = read_u16(pkt + 12);
+        ip = pkt + 14;
+        while (ethertype == ETH_TYPE_VLAN || ethertype == ETH_TYPE_1AD) {
+            if (end - ip < 4) {
+                return 0;
+            }
+            ethertype = read_u16(ip + 2);
+            ip += 4;
+        }
+        if (ethertype != ETH_TYPE_IP && ethertype != ETH_TYPE_IPV6) {
+            return 0;
+        }
+    } else if (linktype == LINKTYPE_PPP) {
+        struct datum d{pkt, end};
+        if (!ppp::is_ip(d) || d.data == nullptr) {
+            return 0;
+        }
+        ip = d.data;
+    }
+
+    uint64_t addrs = 0;
+    if (end - ip >= 20 && (ip[0] >> 4) == 4) {
+        addrs = (uint64_t)read_u32(ip + 12) + read_u32(ip + 16);
+    } else if (end - ip >= 40 && (ip[0] >> 4) == 6) {
+        for (int i = 8; i < 40; i += 4) {
+            addrs += read_u32(ip + i);
+        }
+    } else {
+        return 0;
+    }
+
+    /* the finalizer of MurmurHash3 */
+    uint64_t h = addrs;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+void *pcap_shard_worker_func(void *userdata) {
+    struct pcap_shard_worker *w = (struct pcap_shard_worker *)userdata;
+    uint64_t r = 0;
+
+    while (true) {
+        uint64_t wi = w->widx.load(std::memory_order_acquire);
+        if (r == wi) {
+            uint32_t key = w->batch_ready.prepare_wait();
+            wi = w->widx.load(std::memory_order_acquire);
+            if (r == wi) {
+                if (w->done.load(std::memory_order_acquire) && r == w->widx.load(std::memory_order_acquire)) {
+                    w->batch_ready.cancel_wait();
+                    break;
+                }
+                w->batch_ready.wait(key, LLQ_PARK_NSEC);
+                continue;
+            }
+            w->batch_ready.cancel_wait();
+        }
+        for ( ; r < wi; r++) {
+            struct pcap_shard_batch *b = &w->ring[r & (PCAP_SHARD_RING_SIZE - 1)];
+            w->pkt_processor->apply_batch(b->pi, b->eth, b->n);
+
+            /* the messages of this batch are published, so the output thread can stop waiting for them */
+            w->llq->input_pending.fetch_sub(1, std::memory_order_seq_cst);
+            w->ridx.store(r + 1, std::memory_order_release);
+            w->batch_free.notify();
+        }
+    }
+    w->pkt_processor->finalize();  // clear out buffers
+
+    return NULL;
+}
+
+/*
+ * pcap_shard_publish() hands the batch that the reader is filling for
+ * worker w over to that worker
+ */
+static void pcap_shard_publish(struct pcap_shard_worker *w) {
+    if (w->open) {
+        w->open = false;
+        w->widx.store(w->widx.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        w->batch_ready.notify();
+    }
+}
+
+static void pcap_shard_publish_all(struct pcap_shard_worker *workers, int num_workers) {
+    for (int i = 0; i < num_workers; i++) {
+        pcap_shard_publish(&workers[i]);
+    }
+}
+
+/*
+ * pcap_shard_next_batch() returns the batch that the reader is filling
+ * for worker w, starting a new one if needed.  If the ring of w is
+ * full, the partial batches of all of the workers are published
+ * before the reader parks, so that no worker waits for the reader
+ * while the reader waits for a worker.
+ */
+static struct pcap_shard_batch *pcap_shard_next_batch(struct pcap_shard_worker *w,
+                                                      struct pcap_shard_worker *workers,
+                                                      int num_workers) {
+    uint64_t wi = w->widx.load(std::memory_order_relaxed);
+    struct pcap_shard_batch *b = &w->ring[wi & (PCAP_SHARD_RING_SIZE - 1)];
+    if (w->open) {
+        return b;
+    }
+    if (wi - w->ridx.load(std::memory_order_acquire) == PCAP_SHARD_RING_SIZE) {
+        pcap_shard_publish_all(workers, num_workers);
+        while (wi - w->ridx.load(std::memory_order_acquire) == PCAP_SHARD_RING_SIZE) {
+            uint32_t key = w->batch_free.prepare_wait();
+            if (wi - w->ridx.load(std::memory_order_acquire) < PCAP_SHARD_RING_SIZE) {
+                w->batch_free.cancel_wait();
+                break;
+            }
+            w->batch_free.wait(key, LLQ_PARK_NSEC);
+        }
+    }
+    w->llq->input_pending.fetch_add(1, std::memory_order_seq_cst);
+    w->open = true;
+    b->n = 0;
+    return b;
+}
+
+/*
+ * pcap_file_shard() reads the memory-mapped PCAP file data of length
+ * data_len loop_count times, and hands each packet to one of the
+ * num_workers workers according to its flow hash.  It returns the
+ * number of packets read, and sets bytes_read to their total length,
+ * including the file header and packet headers.
+ */
+static uint64_t pcap_file_shard(const struct pcap_file *f,
+                                uint8_t *data,
+                                size_t data_len,
+                                struct pcap_shard_worker *workers,
+                                int num_workers,
+                                int loop_count,
+                                uint64_t *bytes_read) {
+    uint64_t num_packets = 0;
+    uint64_t total_length = sizeof(struct pcap_file_hdr);
+
+    for (int i = 0; i < loop_count && sig_close_flag == 0; i++) {
+        size_t offset = sizeof(struct pcap_file_hdr);
+        while (offset + sizeof(struct pcap_packet_hdr) <= data_len && sig_close_flag == 0) {
+            struct pcap_packet_hdr packet_hdr;
+            memcpy(&packet_hdr, data + offset, sizeof(packet_hdr));
+            if (f->byteswap) {
+                packet_hdr.ts_sec = ntohl(packet_hdr.ts_sec);
+                packet_hdr.ts_usec = ntohl(packet_hdr.ts_usec);
+                packet_hdr.incl_len = ntohl(packet_hdr.incl_len);
+            }
+            offset += sizeof(struct pcap_packet_hdr);
+            if (packet_hdr.incl_len > data_len - offset) {
+                fprintf(stderr, "error: could not read packet with caplen %u\n", packet_hdr.incl_len);
+                break;
+            }
+            uint8_t *pkt = data + offset;
+            offset += packet_hdr.incl_len;
+
+            struct pcap_shard_worker *w = &workers[flow_hash(pkt, packet_hdr.incl_len, f->linktype) % num_workers];
+            struct pcap_shard_batch *b = pcap_shard_next_batch(w, workers, num_workers);
+            struct packet_info *pi = &b->pi[b->n];
+            pi->ts.tv_sec = packet_hdr.ts_sec;
+            pi->ts.tv_nsec = packet_hdr.ts_usec * 1000;
+            pi->caplen = packet_hdr.incl_len;
+            pi->len = packet_hdr.incl_len;
+            pi->linktype = f->linktype;
+            b->eth[b->n] = pkt;
+            if (++b->n == PROCESS_BATCH_SIZE) {
+                pcap_shard_publish(w);
+            }
+
+            num_packets++;
+            total_length += packet_hdr.incl_len + sizeof(struct pcap_packet_hdr);
+        }
+    }
+    pcap_shard_publish_all(workers, num_workers);
+
+    *bytes_read = total_length;
+    return num_packets;
+}
+
+/*
+ * open_and_dispatch_parallel() processes the input file with
+ * cfg->num_threads worker threads, as described in pcap_reader.h;
+ * the packet and byte counts are returned through packets_read and
+ * bytes_read.  If the file is not a single PCAP file that can be
+ * sharded (see pcap_file_data_is_simple()), nothing is processed and
+ * serial is set to true, so that the caller can read the file with a
+ * single thread, which handles (or reports) those inputs.
+ */
+static enum status open_and_dispatch_parallel(struct mercury_config *cfg,
+                                              mercury_context mc,
+                                              struct output_file *of,
+                                              uint64_t *packets_read,
+                                              uint64_t *bytes_read,
+                                              bool *serial) {
+    char input_filename[FILENAME_MAX];
+    struct pcap_file rf;
+    enum status status = filename_append(input_filename, cfg->read_filename, "/", NULL);
+    if (status) {
+        return status;
+    }
+    *serial = false;
+
+    /*
+     * the mapping is private and writable, so that a packet processor
+     * can modify a packet in place, as it could in a read buffer
+     */
+    int fd = open(input_filename, O_RDONLY);
+    if (fd < 0) {
+        printf("error: could not open pcap input file %s\n", cfg->read_filename);
+        return status_err;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("could not get size of pcap input file");
+        close(fd);
+        return status_err;
+    }
+    size_t data_len = st.st_size;
+    uint8_t *data = (uint8_t *)mmap(NULL, data_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "%s: could not mmap pcap input file %s\n", strerror(errno), cfg->read_filename);
+        return status_err;
+    }
+    if (!pcap_file_data_is_simple(data, data_len)) {
+        if (cfg->verbosity) {
+            fprintf(stderr, "note: %s is not a single pcap file with packets of at most 64k bytes; reading it with one thread\n", cfg->read_filename);
+        }
+        munmap(data, data_len);
+        *serial = true;
+        return status_ok;
+    }
+    status = pcap_file_open(&rf, input_filename, io_direction_reader, cfg->flags);
+    if (status) {
+        printf("error: could not open pcap input file %s\n", cfg->read_filename);
+        munmap(data, data_len);
+        return status;
+    }
+    madvise(data, data_len, MADV_SEQUENTIAL);
+
+    int num_workers = cfg->num_threads;
+    struct pcap_shard_worker *workers = new struct pcap_shard_worker[num_workers];
+    for (int i = 0; i < num_workers; i++) {
+        struct pcap_shard_worker *w = &workers[i];
+        w->tnum = i;
+        w->llq = &of->qs.queue[i];
+        w->open = false;
+        w->widx = 0;
+        w->ridx = 0;
+        w->done = false;
+        w->batch_ready.init();
+        w->batch_free.init();
+        w->pkt_processor = pkt_proc_new_from_config(cfg, mc, i, w->llq);
+        if (w->pkt_processor == NULL) {
+            printf("error: could not initialize frame handler\n");
+            exit(255);
+        }
+    }
+    of->qs.input_tracked = true;
+
+    /* Wake up output thread so it's polling the queues waiting for data */
+    of->t_output_p = 1;
+    int err = pthread_cond_broadcast(&(of->t_output_c)); /* Wake up output */
+    if (err != 0) {
+        printf("%s: error broadcasting all clear on output start condition\n", strerror(err));
+        exit(255);
+    }
+
+    for (int i = 0; i < num_workers; i++) {
+        err = pthread_create(&workers[i].tid, NULL, pcap_shard_worker_func, &workers[i]);
+        if (err) {
+            printf("%s: error creating file processing thread\n", strerror(err));
+            exit(255);
+        }
+    }
+
+    *packets_read = pcap_file_shard(&rf, data, data_len, workers, num_workers, cfg->loop_count, bytes_read);
+
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].done.store(true, std::memory_order_release);
+        workers[i].batch_ready.notify();
+    }
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i].tid, NULL);
+        delete workers[i].pkt_processor;
+    }
+    delete[] workers;
+
+    munmap(data, data_len);
+    pcap_file_close(&rf);
+
+    return status_ok;
+}
+
 enum status open_and_dispatch(struct mercury_config *cfg, mercury_context mc, struct output_file *of) {
     enum status status;
     struct timer t;
@@ -73,6 +405,31 @@ enum status open_and_dispatch(struct mercury_config *cfg, mercury_context mc, st
 
     timer_start(&t); // get timestamp before we start processing
 
+#ifndef DONT_USE_THREADS
+    /*
+     * a file is processed by several worker threads if they were
+     * requested, except when it is read from standard input, which
+     * cannot be memory-mapped, or when it is not a single pcap file
+     */
+    bool serial = true;
+    if (cfg->num_threads > 1 && cfg->read_filename != NULL && strcmp(cfg->read_filename, "-") != 0) {
+        status = open_and_dispatch_parallel(cfg, mc, of, &packets_written, &bytes_written, &serial);
+        if (status != status_ok) {
+            return status;
+        }
+    }
+    if (!serial) {
+        nano_seconds = timer_stop(&t);
+        double byte_rate = ((double)bytes_written * BILLION) / (double)nano_seconds;
+        double packet_rate = ((double)packets_written * BILLION) / (double)nano_seconds;
+        if (cfg->verbosity) {
+            fprintf(stderr, "Packets processed: %" PRIu64 ", packets per second: %.4e, bytes processed: %" PRIu64 ", nano sec: %" PRIu64 ", bytes per second: %.4e, threads: %d\n",
+                    packets_written, packet_rate, bytes_written, nano_seconds, byte_rate, cfg->num_threads);
+        }
+        return status_ok;
+    }
+#endif
+
     struct pcap_reader_thread_context tc;
 
     status = pcap_reader_thread_context_init_from_config(&tc, cfg, mc, 0, &of->qs.queue[0]);
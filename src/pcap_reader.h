@@ -9,7 +9,9 @@
 #define PCAP_READER_H
 
 #include <pthread.h>
+#include <atomic>
 #include "pcap_file_io.h"
+#include "pkt_processing.h"
 #include "mercury.h"
 #include "llq.h"
 
@@ -27,6 +29,49 @@ struct pcap_reader_thread_context {
     int loop_count;           /* loop count */
 };
 
+/*
+ * In parallel file mode, a single reader memory-maps the input file
+ * and shards its packets across the worker threads by a symmetric
+ * hash of their addresses, so that both directions of a flow, and
+ * all of its IP fragments, are processed by the same worker.  Files
+ * that are not a single pcap file (pcap-ng, or concatenated pcap
+ * files) are read by one thread instead.  Packets are handed over in batches of up to
+ * PROCESS_BATCH_SIZE packets, which point into the mapped file,
+ * through a ring of PCAP_SHARD_RING_SIZE batches per worker.  Each
+ * worker writes to its own lockless queue, and the output thread
+ * merges the queues by timestamp.
+ */
+#define PCAP_SHARD_RING_SIZE 64  /* Batches in the ring of each worker (must be a power of two) */
+
+struct pcap_shard_batch {
+    size_t n;
+    struct packet_info pi[PROCESS_BATCH_SIZE];
+    uint8_t *eth[PROCESS_BATCH_SIZE];
+};
+
+/*
+ * struct pcap_shard_worker holds the state of a worker thread in
+ * parallel file mode.  The reader fills the batch at widx, and
+ * publishes it by advancing widx; the worker processes the batch at
+ * ridx, and frees it by advancing ridx.
+ */
+struct pcap_shard_worker {
+    struct pkt_proc *pkt_processor;
+    struct ll_queue *llq;
+    int tnum;                               /* Thread Number */
+    pthread_t tid;                          /* Thread ID */
+    bool open;                              /* The reader is filling the batch at widx (private to reader) */
+
+    alignas(64) std::atomic<uint64_t> widx; /* Batches published (written by reader) */
+    std::atomic<bool> done;                 /* No more batches will be published */
+    struct llq_event batch_ready;           /* Event on which the worker parks */
+
+    alignas(64) std::atomic<uint64_t> ridx; /* Batches processed (written by worker) */
+    struct llq_event batch_free;            /* Event on which the reader parks */
+
+    struct pcap_shard_batch ring[PCAP_SHARD_RING_SIZE];
+};
+
 enum status pcap_reader_thread_context_init_from_config(struct pcap_reader_thread_context *tc,
                                                         struct mercury_config *cfg,
                                                         mercury_context mc,
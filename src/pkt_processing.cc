@@ -6,9 +6,9 @@
  */
 
 #include <string.h>
+#include <inttypes.h>
 #include <stdexcept>
 #include "pcap_file_io.h"
-#include "rnd_pkt_drop.h"
 #include "pkt_processing.h"
 #include "libmerc/utils.h"
 
@@ -19,6 +19,7 @@ struct pkt_proc *pkt_proc_new_from_config(struct mercury_config *cfg,
 
     try {
 
+        struct pkt_proc *p;
         enum status status;
         char outfile[FILENAME_MAX];
         pid_t pid = tnum;
@@ -36,17 +37,25 @@ struct pkt_proc *pkt_proc_new_from_config(struct mercury_config *cfg,
             /*
              * write (filtered, if configured that way) packets to capture file
              */
-            return new pkt_proc_filter_pcap_writer_llq(mc, llq, cfg->output_block);
+            p = new pkt_proc_filter_pcap_writer_llq(mc, llq, cfg->output_block);
 
         } else {
             /*
              * write fingerprints into output file
              */
 
-            return new pkt_proc_json_writer_llq(mc, llq, cfg->output_block);
+            p = new pkt_proc_json_writer_llq(mc, llq, cfg->output_block);
 
         }
 
+        /*
+         * shed load adaptively if configured, recognizing flow-initial
+         * packets with the same traffic selector as the processor
+         */
+        p->shedder.init(&mc->selector, cfg->adaptive);
+        p->verbosity = cfg->verbosity;
+        return p;
+
     }
     catch (const char *s) {
         fprintf(stdout, "error: %s\n", s);
@@ -55,4 +64,25 @@ struct pkt_proc *pkt_proc_new_from_config(struct mercury_config *cfg,
     return NULL;
 }
 
-
+void pkt_proc_stats_write_json(FILE *f, mercury_packet_processor processor) {
+    struct mercury_packet_processor_stats s;
+    if (mercury_packet_processor_get_stats(processor, &s) == false) {
+        return;
+    }
+    fprintf(f,
+            "{\"tcp_reassembly_stats\":{\"started\":%" PRIu64 ",\"completed\":%" PRIu64
+            ",\"extended\":%" PRIu64 ",\"budget_exceeded\":%" PRIu64 ",\"incomplete\":%" PRIu64
+            ",\"refused\":%" PRIu64 ",\"duplicates\":%" PRIu64 ",\"in_progress\":%" PRIu64 "}}\n",
+            s.tcp_reassembly_started, s.tcp_reassembly_completed, s.tcp_reassembly_extended,
+            s.tcp_reassembly_budget_exceeded, s.tcp_reassembly_incomplete, s.tcp_reassembly_refused,
+            s.tcp_reassembly_duplicates, s.tcp_reassembly_in_progress);
+    if (s.analysis_cache_size) {
+        uint64_t lookups = s.analysis_cache_hits + s.analysis_cache_misses;
+        fprintf(f,
+                "{\"analysis_cache_stats\":{\"hits\":%" PRIu64 ",\"misses\":%" PRIu64
+                ",\"hit_rate\":%f,\"evictions\":%" PRIu64 ",\"invalidations\":%" PRIu64 "}}\n",
+                s.analysis_cache_hits, s.analysis_cache_misses,
+                lookups ? (double)s.analysis_cache_hits / lookups : 0.0,
+                s.analysis_cache_evictions, s.analysis_cache_invalidations);
+    }
+}
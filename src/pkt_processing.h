@@ -13,13 +13,19 @@
 #include <sys/time.h>
 #include <stdexcept>
 #include "pcap_file_io.h"
-#include "rnd_pkt_drop.h"
+#include "load_shedding.h"
 #include "llq.h"
 #include "libmerc/libmerc.h"
 #include "libmerc/pkt_proc.h"
 
 constexpr static size_t PREALLOC_SIZE = 65536;
 
+/*
+ * Packet capture hands packets to a packet processor in batches of up
+ * to PROCESS_BATCH_SIZE packets
+ */
+#define PROCESS_BATCH_SIZE 32
+
 // struct packet_info contains timestamp and length information about
 // a packet
 //
@@ -34,17 +40,61 @@ struct packet_info {
  * struct pkt_proc is a packet processor; this abstract class defines
  * the interface to packet processing that can be used by packet
  * capture or packet file readers.
+ *
+ * apply_batch(pi, eth, n) processes the n packets eth[0], ...,
+ * eth[n-1], whose timestamps and lengths are pi[0], ..., pi[n-1].
+ * By default it calls apply() for each packet; a packet processor
+ * can override it to handle a whole batch with one virtual call.
+ *
+ * Each packet processor has its own load_shedder, which discards
+ * packets before they are processed when shedding is enabled.
  */
 
 struct pkt_proc {
     virtual void apply(struct packet_info *pi, uint8_t *eth) = 0;
+    virtual void apply_batch(struct packet_info *pi, uint8_t **eth, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            apply(&pi[i], eth[i]);
+        }
+    }
     virtual void flush() = 0;
     virtual void finalize() = 0;
     virtual ~pkt_proc() {};
     size_t bytes_written = 0;
     size_t packets_written = 0;
+    struct load_shedder shedder;
+    int verbosity = 0;    /* if nonzero, counters are reported on stderr */
 };
 
+/*
+ * pkt_proc_stats_write_json(f, processor) writes the counters of the
+ * libmerc packet processor as single line JSON records to the file f
+ */
+void pkt_proc_stats_write_json(FILE *f, mercury_packet_processor processor);
+
+
+/*
+ * apply_each(proc, pi, eth, n) calls proc.process() for each packet
+ * in a batch that is not shed by proc.shedder, with static rather
+ * than virtual dispatch, and prefetches the start of the next packet
+ * while the current one is processed.  The consumer of the lockless
+ * queue llq is woken up at most once per batch.
+ */
+template <typename T>
+inline void apply_each(T &proc, struct ll_queue *llq, struct packet_info *pi, uint8_t **eth, size_t n) {
+    llq->begin_batch();
+    for (size_t i = 0; i < n; i++) {
+        if (i + 1 < n) {
+            __builtin_prefetch(eth[i + 1]);
+            __builtin_prefetch(eth[i + 1] + 64);
+        }
+        if (proc.shedder.shed_packet(eth[i], pi[i].caplen)) {
+            continue;
+        }
+        proc.process(&pi[i], eth[i]);
+    }
+    llq->end_batch();
+}
 
 /*
  * struct pkt_proc_pcap_writer represents a packet processing object
@@ -59,11 +109,17 @@ struct pkt_proc_pcap_writer_llq : public pkt_proc {
     }
 
     void apply(struct packet_info *pi, uint8_t *eth) override {
-        extern int rnd_pkt_drop_percent_accept;  /* defined in rnd_pkt_drop.c */
-
-        if (rnd_pkt_drop_percent_accept && drop_this_packet()) {
-            return;  /* random packet drop configured, and this packet got selected to be discarded */
+        if (shedder.shed_packet(eth, pi->caplen)) {
+            return;
         }
+        process(pi, eth);
+    }
+
+    void apply_batch(struct packet_info *pi, uint8_t **eth, size_t n) override {
+        apply_each(*this, llq, pi, eth, n);
+    }
+
+    void process(struct packet_info *pi, uint8_t *eth) {
         pcap_queue_write(llq, eth, pi->len, pi->ts.tv_sec, pi->ts.tv_nsec / 1000, block);
     }
 
@@ -91,10 +147,8 @@ struct pkt_proc_pcap_writer : public pkt_proc {
     pkt_proc_pcap_writer(const char *outfile, int flags) : pcap_file{outfile, io_direction_writer, flags} { }
 
     void apply(struct packet_info *pi, uint8_t *eth) override {
-        extern int rnd_pkt_drop_percent_accept;  /* defined in rnd_pkt_drop.c */
-
-        if (rnd_pkt_drop_percent_accept && drop_this_packet()) {
-            return;  /* random packet drop configured, and this packet got selected to be discarded */
+        if (shedder.shed_packet(eth, pi->caplen)) {
+            return;
         }
         pcap_file_write_packet_direct(&pcap_file, eth, pi->len, pi->ts.tv_sec, pi->ts.tv_nsec / 1000);
     }
@@ -128,10 +182,8 @@ struct pkt_proc_filter_pcap_writer : public pkt_proc {
         uint8_t *packet = eth;
         unsigned int length = pi->len;
 
-        extern int rnd_pkt_drop_percent_accept;  /* defined in rnd_pkt_drop.c */
-
-        if (rnd_pkt_drop_percent_accept && drop_this_packet()) {
-            return;  /* random packet drop configured, and this packet got selected to be discarded */
+        if (shedder.shed_packet(eth, pi->caplen)) {
+            return;
         }
 
         uint8_t buf[LLQ_MSG_SIZE];
@@ -187,6 +239,17 @@ struct pkt_proc_json_writer_llq : public pkt_proc {
     }
 
     void apply(struct packet_info *pi, uint8_t *eth) override {
+        if (shedder.shed_packet(eth, pi->caplen)) {
+            return;
+        }
+        process(pi, eth);
+    }
+
+    void apply_batch(struct packet_info *pi, uint8_t **eth, size_t n) override {
+        apply_each(*this, llq, pi, eth, n);
+    }
+
+    void process(struct packet_info *pi, uint8_t *eth) {
         struct llq_msg *msg = llq->init_msg(block, pi->ts.tv_sec, pi->ts.tv_nsec);
         if (msg) {
             size_t write_len = mercury_packet_processor_write_json_linktype(processor, msg->buf, LLQ_MSG_SIZE, eth, pi->len, &(msg->ts), pi->linktype);
@@ -197,8 +260,23 @@ struct pkt_proc_json_writer_llq : public pkt_proc {
         }
     }
 
+    /*
+     * finalize() reports the counters of the libmerc packet processor,
+     * if verbose, and then destructs it; it is also called by the
+     * destructor, since live capture does not call it
+     */
     void finalize() override {
-        mercury_packet_processor_destruct(processor);
+        if (processor) {
+            if (verbosity) {
+                pkt_proc_stats_write_json(stderr, processor);
+            }
+            mercury_packet_processor_destruct(processor);
+            processor = NULL;
+        }
+    }
+
+    ~pkt_proc_json_writer_llq() {
+        finalize();
     }
 
     void flush() override {
@@ -237,6 +315,17 @@ struct pkt_proc_json_writer_llq_CPP : public pkt_proc {
     }
 
     void apply(struct packet_info *pi, uint8_t *eth) override {
+        if (shedder.shed_packet(eth, pi->caplen)) {
+            return;
+        }
+        process(pi, eth);
+    }
+
+    void apply_batch(struct packet_info *pi, uint8_t **eth, size_t n) override {
+        apply_each(*this, llq, pi, eth, n);
+    }
+
+    void process(struct packet_info *pi, uint8_t *eth) {
         struct llq_msg *msg = llq->init_msg(block, pi->ts.tv_sec, pi->ts.tv_nsec);
         if (msg) {
             size_t write_len = processor.write_json(msg->buf, LLQ_MSG_SIZE, eth, pi->len, &(msg->ts));
@@ -278,14 +367,19 @@ struct pkt_proc_filter_pcap_writer_llq : public pkt_proc {
     }
 
     void apply(struct packet_info *pi, uint8_t *eth) override {
-        uint8_t *packet = eth;
-        unsigned int length = pi->len;
+        if (shedder.shed_packet(eth, pi->caplen)) {
+            return;
+        }
+        process(pi, eth);
+    }
 
-        extern int rnd_pkt_drop_percent_accept;  /* defined in rnd_pkt_drop.c */
+    void apply_batch(struct packet_info *pi, uint8_t **eth, size_t n) override {
+        apply_each(*this, llq, pi, eth, n);
+    }
 
-        if (rnd_pkt_drop_percent_accept && drop_this_packet()) {
-            return;  /* random packet drop configured, and this packet got selected to be discarded */
-        }
+    void process(struct packet_info *pi, uint8_t *eth) {
+        uint8_t *packet = eth;
+        unsigned int length = pi->len;
 
         uint8_t buf[LLQ_MSG_SIZE];
         if (processor.write_json(buf, LLQ_MSG_SIZE, packet, length, &pi->ts) != 0 || processor.dump_pkt()) {
@@ -298,6 +392,12 @@ struct pkt_proc_filter_pcap_writer_llq : public pkt_proc {
     void flush() override {
     }
 
+    ~pkt_proc_filter_pcap_writer_llq() {
+        if (verbosity) {
+            pkt_proc_stats_write_json(stderr, &processor);
+        }
+    }
+
 };
 
 /*
@@ -14,6 +14,7 @@
 #include "signal_handling.h"
 
 int sig_close_flag = 0; /* Watched by the threads while processing packets */
+volatile sig_atomic_t sig_reload_flag = 0; /* Watched by the stats thread */
 
 /*
  * sig_close() causes a graceful shutdown of the program after recieving
@@ -25,6 +26,35 @@ void sig_close (int signal_arg) {
     fclose(stdin);      /* if are reading from stdin, stop reading */
 }
 
+/*
+ * sig_reload() requests that the resource file be reloaded; the
+ * reload takes place in reload_resources_if_requested(), since it
+ * cannot take place in a signal handler
+ */
+void sig_reload (int signal_arg) {
+    (void)signal_arg;
+    sig_reload_flag = 1;
+}
+
+/*
+ * reload_resources_if_requested() reloads the resource file of the
+ * mercury context mc, if SIGHUP has been received since it was last
+ * called; the packet worker threads keep running while the resources
+ * are loaded, and switch over to them when that is done
+ */
+void reload_resources_if_requested(mercury_context mc) {
+    if (sig_reload_flag == 0) {
+        return;
+    }
+    sig_reload_flag = 0;
+    fprintf(stderr, "reloading resources\n");
+    if (mercury_reload_resources(mc, NULL) == 0) {
+        fprintf(stderr, "resources reloaded (resource version: %s)\n", mercury_get_resource_version(mc));
+    } else {
+        fprintf(stderr, "error: could not reload resources; continuing with the current ones\n");
+    }
+}
+
 /*
  * set up signal handlers, so that output is flushed upon close
  *
@@ -40,6 +70,11 @@ enum status setup_signal_handler(void) {
         return status_err;
     }
 
+    /* kill -HUP causes the resource file to be reloaded */
+    if (signal(SIGHUP, sig_reload) == SIG_ERR) {
+        return status_err;
+    }
+
     return status_ok;
 }
 
@@ -15,8 +15,14 @@
 
 extern int sig_close_flag; /* Watched by the threads while processing packets */
 
+extern volatile sig_atomic_t sig_reload_flag; /* Set by SIGHUP, watched by the stats thread */
+
 void sig_close (int signal_arg);
 
+void sig_reload (int signal_arg);
+
+void reload_resources_if_requested(mercury_context mc);
+
 enum status setup_signal_handler(void);
 
 void enable_all_signals(void);
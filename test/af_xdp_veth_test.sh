@@ -0,0 +1,93 @@
+#!/bin/bash
+#
+# af_xdp_veth_test.sh
+#
+# tests the af_xdp capture backend on a veth pair: the packets of a
+# pcap file are sent into one end of the pair while mercury captures
+# on the other end with --capture-backend=af_xdp, and the JSON records
+# are compared with those that mercury writes when it reads the pcap
+# file, with and without --xdp-filter.  The packets are sent with
+# tcpreplay if it is available, and with a python3 raw socket
+# otherwise.  This test must be run as root.
+#
+# usage: af_xdp_veth_test.sh [mercury] [pcap file]
+
+MERCURY=${1:-../src/mercury}
+PCAP=${2:-data/top_100_fingerprints.pcap}
+VETH_CAP=merc-xdp0     # mercury captures on this end of the pair
+VETH_SEND=merc-xdp1    # the pcap is sent into this end
+TMPDIR=$(mktemp -d)
+
+if [ "$(id -u)" != "0" ]; then
+    echo "error: $0 must be run as root"
+    exit 1
+fi
+
+cleanup() {
+    ip link del $VETH_CAP 2> /dev/null
+    rm -rf $TMPDIR
+}
+trap cleanup EXIT
+
+# send_pcap(file, interface) sends the packets in the pcap file out of the interface
+#
+send_pcap() {
+    if command -v tcpreplay > /dev/null; then
+        tcpreplay -q -t -i $2 $1 > /dev/null
+    else
+        python3 - $1 $2 <<'EOF'
+import socket, struct, sys
+f = open(sys.argv[1], 'rb')
+magic = struct.unpack('<I', f.read(24)[:4])[0]
+endian = '<' if magic in (0xa1b2c3d4, 0xa1b23c4d) else '>'
+s = socket.socket(socket.AF_PACKET, socket.SOCK_RAW)
+s.bind((sys.argv[2], 0))
+while True:
+    hdr = f.read(16)
+    if len(hdr) < 16:
+        break
+    caplen = struct.unpack(endian + 'IIII', hdr)[2]
+    s.send(f.read(caplen))
+EOF
+    fi
+}
+
+# strip_time(file) writes the JSON records in file without their event_start times
+#
+strip_time() {
+    jq -c 'del(.event_start)' $1
+}
+
+ip link add $VETH_CAP type veth peer name $VETH_SEND || exit 1
+ip link set dev $VETH_CAP mtu 3000 up     # the largest test packets are longer than 1500 bytes
+ip link set dev $VETH_SEND mtu 3000 up
+sysctl -q -w net.ipv6.conf.$VETH_CAP.disable_ipv6=1     # keep the kernel's own packets off the pair
+sysctl -q -w net.ipv6.conf.$VETH_SEND.disable_ipv6=1
+sleep 1
+
+$MERCURY -r $PCAP -f $TMPDIR/expected.json || exit 1
+strip_time $TMPDIR/expected.json > $TMPDIR/expected.stripped
+
+status=0
+for filter in "" "--xdp-filter"; do
+    rm -f $TMPDIR/capture.json
+    $MERCURY -c $VETH_CAP --capture-backend=af_xdp $filter -t 1 -u root -f $TMPDIR/capture.json &
+    pid=$!
+    sleep 2
+    send_pcap $PCAP $VETH_SEND
+    sleep 2
+    while kill $pid 2> /dev/null; do
+        sleep 1
+    done
+    wait $pid
+    strip_time $TMPDIR/capture.json > $TMPDIR/capture.stripped
+    if diff -q $TMPDIR/expected.stripped $TMPDIR/capture.stripped > /dev/null; then
+        echo "passed af_xdp veth test $filter"
+    else
+        echo "error: af_xdp veth test $filter: captured records differ from those read from $PCAP"
+        diff $TMPDIR/expected.stripped $TMPDIR/capture.stripped | head -10
+        status=1
+    fi
+done
+
+exit $status
@@ -94,6 +94,8 @@ def read_merc_stats(in_file, mask_src_ip):
     total_count = 0
     for line in open(in_file):
         r = json.loads(line)
+        if 'src_ip' not in r:
+            continue    # not a source record (e.g. output_queue_stats)
         src_ip = int(r['src_ip'], 16)  # convert hex string to integer
 
         if mask_src_ip is True:
@@ -0,0 +1,55 @@
+#!/bin/bash
+#
+# parallel_pcap_test.sh
+#
+# compares the JSON records that mercury writes when it reads a pcap
+# file with one thread to those that it writes with several threads,
+# for each pcap file in a directory, with and without tcp reassembly.
+# The parallel reader shards packets across threads, so its records
+# are in timestamp order rather than file order, and the records are
+# sorted before they are compared.  A concatenated pcap file is also
+# checked, since the parallel reader must fall back to one thread to
+# read it.
+#
+# usage: parallel_pcap_test.sh [mercury] [pcap directory] [threads]
+
+MERCURY=${1:-../src/mercury}
+PCAPDIR=${2:-../unit_tests/pcaps}
+THREADS=${3:-4}
+TMPDIR=$(mktemp -d)
+
+cleanup() {
+    rm -rf $TMPDIR
+}
+trap cleanup EXIT
+
+# compare(pcap, options...) runs mercury on pcap with one thread and
+# with $THREADS threads, and reports whether the sorted records match
+#
+status=0
+compare() {
+    local pcap=$1
+    shift
+    $MERCURY -r $pcap -f $TMPDIR/serial.json "$@" || { status=1; return; }
+    $MERCURY -r $pcap -f $TMPDIR/parallel.json -t $THREADS "$@" || { status=1; return; }
+    touch $TMPDIR/serial.json $TMPDIR/parallel.json
+    if cmp -s <(sort $TMPDIR/serial.json) <(sort $TMPDIR/parallel.json); then
+        echo "passed $(basename $pcap) $@"
+    else
+        echo "error: $(basename $pcap) $@: output with $THREADS threads differs from output with one thread"
+        diff <(sort $TMPDIR/serial.json) <(sort $TMPDIR/parallel.json) | head -4
+        status=1
+    fi
+    rm -f $TMPDIR/serial.json $TMPDIR/parallel.json
+}
+
+for pcap in $PCAPDIR/*.pcap; do
+    compare $pcap
+    compare $pcap --tcp-reassembly
+done
+
+pcaps=($PCAPDIR/*.pcap)
+cat ${pcaps[0]} ${pcaps[1]} > $TMPDIR/concatenated.pcap
+compare $TMPDIR/concatenated.pcap
+
+exit $status
@@ -0,0 +1,100 @@
+tls/(0303)(c02cc02bc030c02f009f009ec024c023c028c027c00ac009c014c013009d009c003d003c0035002f000a)((0000)(000500050100000000)(000a00080006001d00170018)(000b00020100)(000d00140012040105010201040305030203020206010603)(0023)(0017)(ff01))
+tls/(0303)(0a0a130113021303c02bc02fc02cc030cca9cca8c013c014009c009d002f0035000a)((0a0a)(0000)(0017)(ff01)(000a000a00080a0a001d00170018)(000b00020100)(0023)(0010000e000c02683208687474702f312e31)(000500050100000000)(000d00140012040308040401050308050501080606010201)(0012)(0033)(002d00020101)(002b000b0a0a0a0304030303020301)(001b0003020002)(0a0a)(0015))
+tls/(0303)(c030c02cc028c024c014c00a00a500a300a1009f006b006a0069006800390038003700360088008700860085c032c02ec02ac026c00fc005009d003d00350084c02fc02bc027c023c013c00900a400a200a0009e00670040003f003e0033003200310030009a0099009800970045004400430042c031c02dc029c025c00ec004009c003c002f00960041c011c007c00cc00200050004c012c008001600130010000dc00dc003000a00ff)((0000)(000b000403000102)(000a001c001a00170019001c001b0018001a0016000e000d000b000c0009000a)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101))
+tls/(0303)(00ffc02cc02bc024c023c00ac009c008c030c02fc028c027c014c013c012009d009c003d003c0035002f000a)((0000)(000a00080006001700180019)(000b00020100)(000d0012001004010201050106010403020305030603)(000500050100000000)(0012)(0017))
+tls/(0303)(c030c02cc028c024c014c00a00a500a300a1009f006b006a0069006800390038003700360088008700860085009d003d00350084c02fc02bc027c023c013c00900a400a200a0009e00670040003f003e0033003200310030009a0099009800970045004400430042009c003c002f00960041c012c008001600130010000d000a00ff)((000b000403000102)(000a000a00080019001800170013)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101))
+tls/(0303)(c030c02cc02fc02bc028c024c027c023009d009c003c00ff)((0000)(000b000403000102)(000a000a00080019001800170013)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101))
+tls/(0303)(c030c02cc032c02ec02fc02bc031c02d00a500a300a1009f00a400a200a0009ec028c024c014c00ac02ac026c00fc005006b006a006900680039003800370036c027c023c013c009c029c025c00ec00400670040003f003e0033003200310030009d009c003d0035003c002f00ff)((0000)(000b000403000102)(000a001c001a00170019001c001b0018001a0016000e000d000b000c0009000a)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101)(0015))
+tls/(0303)(c02cc02bc030c02fc024c023c028c027c00ac009c014c013009d009c003d003c0035002f000a)((0000)(000500050100000000)(000a00080006001d00170018)(000b00020100)(000d00140012040105010201040305030203020206010603)(0023)(0010000e000c02683208687474702f312e31)(0017)(00180006001003020100)(ff01))
+tls/(0303)(c030c02cc032c02ec02fc02bc031c02d00a500a300a1009f00a400a200a0009ec028c024c02ac026006b006a00690068c027c023c029c02500670040003f003e009d009c003d003c00ff)((000b000403000102)(000a001c001a00170019001c001b0018001a0016000e000d000b000c0009000a)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101))
+tls/(0303)(130113031302c02bc02fcca9cca8c02cc030c00ac009c013c01400330039002f0035000a)((0000)(0017)(ff01)(000a000e000c001d00170018001901000101)(000b00020100)(0023)(0010000e000c02683208687474702f312e31)(000500050100000000)(0033)(002b0009080304030303020301)(000d0018001604030503060308040805080604010501060102030201)(002d00020101)(001c00024001)(0015))
+tls/(0303)(130313011302c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002fc008c012000a)((ff01)(0000)(0017)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(3374)(0012)(00100030002e0268320568322d31360568322d31350568322d313408737064792f332e3106737064792f3308687474702f312e31)(000b00020100)(0033)(002d00020101)(002b0009080304030303020301)(000a000a0008001d001700180019)(0015))
+tls/(0303)(0a0a130113021303c02bc02fc02cc030cca9cca8c013c014009c009d002f0035000a)((0a0a)(0000)(0017)(ff01)(000a000a00080a0a001d00170018)(000b00020100)(0023)(0010000e000c02683208687474702f312e31)(000500050100000000)(000d00140012040308040401050308050501080606010201)(0012)(0033)(002d00020101)(002b000b0a0a0a0304030303020301)(001b0003020002)(0a0a)(0029))
+tls/(0303)(c02fc030c02bc02ccca8cca9c013c009c014c00a009c009d002f0035c012000a)((3374)(0000)(000500050100000000)(000a000a0008001d001700180019)(000b00020100)(000d0012001004010403050105030601060302010203)(ff01)(0010000e000c02683208687474702f312e31)(0012))
+tls/(0303)(c02cc02bc030c02f009f009ec024c023c028c027c00ac009c014c013009d009c003d003c0035002f000a)((0000)(000500050100000000)(000a00080006001d00170018)(000b00020100)(000d00140012040105010201040305030203020206010603)(0023)(0010000e000c02683208687474702f312e31)(0017)(ff01))
+tls/(0303)(c030c02cc028c024c014c00a00a500a300a1009f006b006a006900680039003800370036009d003d0035c02fc02bc027c023c013c00900a400a200a0009e00670040003f003e0033003200310030009c003c002fc012c008001600130010000d000a00ff)((0000)(000b000403000102)(000a000a00080019001800170013)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(3374)(0010000b000908687474702f312e31))
+tls/(0303)(c02fc02bc030c02c009ec0270067c028006bc024c014c00a00a500a300a1009f006a006900680039003800370036c032c02ec02ac026c00fc005009d003d0035c023c013c00900a400a200a00040003f003e0033003200310030c031c02dc029c025c00ec004009c003c002f00ff)((0000)(000b000403000102)(000a000400020017)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(3374))
+tls/(0303)(c030c02cc028c024c014c00a00a500a300a1009f006b006a0069006800390038003700360088008700860085009d003d00350084c02fc02bc027c023c013c00900a400a200a0009e00670040003f003e0033003200310030009a0099009800970045004400430042009c003c002f00960041c012c008001600130010000d000a00ff)((0000)(000b000403000102)(000a000a00080019001800170013)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101)(3374)(0010000b000908687474702f312e31)(0015))
+tls/(0303)(c02fc030c02bc02ccca8cca9c013c009c014c00a009c009d002f0035c012000a)((0000)(000500050100000000)(000a000a0008001d001700180019)(000b00020100)(000d0012001004010403050105030601060302010203)(ff01)(0012))
+tls/(0303)(c02cc02bc030c02fc024c023c028c027c00ac009c014c013009d009c003d003c0035002f000a)((0000)(000500050100000000)(000a00080006001d00170018)(000b00020100)(000d00140012040105010201040305030203020206010603)(0023)(0017)(ff01))
+tls/(0303)(c02cc02bc030c02f009f009ec024c023c028c027c00ac009c014c013009d009c003d003c0035002f000a)((0000)(000a00080006001d00170018)(000b00020100)(000d00140012040105010201040305030203020206010603)(0023)(0017)(ff01))
+tls/(0303)(c030c02cc032c02ec02fc02bc031c02d00a500a300a1009f00a400a200a0009ec028c024c014c00ac02ac026c00fc005006b006a006900680039003800370036c027c023c013c009c029c025c00ec00400670040003f003e003300320031003000880087008600850045004400430042c012c008c00dc003001600130010000d009d009c003d0035003c002f00840041000a00ff)((0000)(000b000403000102)(000a001c001a00170019001c001b0018001a0016000e000d000b000c0009000a)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101)(0015))
+tls/(0303)(c030c02cc028c024c014c00a00a500a300a1009f006b006a006900680039003800370036009d003d0035c02fc02bc027c023c013c00900a400a200a0009e00670040003f003e0033003200310030009c003c002f00ff)((0000)(000b000403000102)(000a000a00080019001800170013)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203))
+tls/(0303)(0a0a130113021303c02bc02fc02cc030cca9cca8c013c014009c009d002f0035000a)((0a0a)(0000)(0017)(ff01)(000a000a00080a0a001d00170018)(000b00020100)(0023)(0010000e000c02683208687474702f312e31)(000500050100000000)(000d00140012040308040401050308050501080606010201)(0012)(0033)(002d00020101)(002b000b0a0a0a0304030303020301)(001b0003020002)(0a0a))
+tls/(0303)(130113031302c02bc02fcca9cca8c02cc030c00ac009c013c01400330039002f0035000a)((0000)(0017)(ff01)(000a000e000c001d00170018001901000101)(000b00020100)(0023)(0010000e000c02683208687474702f312e31)(000500050100000000)(0033)(002b0009080304030303020301)(000d0018001604030503060308040805080604010501060102030201)(002d00020101)(001c00024001))
+tls/(0303)(c02fc02bc030c02cc013c009c014c00a009c009d002f0035c012000a)((3374)(0000)(000500050100000000)(000a00080006001700180019)(000b00020100)(000d000e000c040104030501050302010203)(ff01)(0010000e000c02683208687474702f312e31)(0012))
+tls/(0303)(c028c027c014c013009f009e00390033009d009c003d003c0035002fc02cc02bc024c023c00ac009006a004000380032000a001300050004)((0000)(000a0006000400170018)(000b00020100)(000d00140012060106030401050102010403050302030202)(0017)(ff01))
+tls/(0303)(c030c02cc028c024c014c00a00a500a300a1009f006b006a0069006800390038003700360088008700860085c032c02ec02ac026c00fc005009d003d00350084c02fc02bc027c023c013c00900a400a200a0009e00670040003f003e0033003200310030009a0099009800970045004400430042c031c02dc029c025c00ec004009c003c002f00960041c012c008001600130010000dc00dc003000a0007c011c007c00cc0020005000400ff)((0000)(000b000403000102)(000a000a00080017001900180016)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101))
+tls/(0301)(c00ac009c014c0130035002f000a)((0000)(000a00080006001d00170018)(000b00020100)(0023)(0017)(ff01))
+tls/(0303)(c02fc02bc030c02c009ec0270067c028006b00a3009fcca9cca8ccaac0afc0adc0a3c09f00a2c0aec0acc0a2c09ec024006ac0230040c00ac01400390038c009c01300330032009dc0a1c09d009cc0a0c09c003d003c0035002f00ff)((0000)(000b000403000102)(000a000a0008001d001700190018)(0023)(0016)(0017)(000d0020001e060106020603050105020503040104020403030103020303020102020203))
+tls/(0303)(c030c02cc02fc02bcca9cca8009f009eccaac028c024c014c00a006b0039c027c023c013c00900670033009d009c003d0035003c002f00ff)((0000)(000b00020100)(000a00080006001d00170018)(0023)(000d001c001a06010603efef0501050304010403eeeeeded0301030302010203))
+tls/(0303)(130313011302c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002fc008c012000a)((ff01)(0000)(0017)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(0012)(000b00020100)(0033)(002d00020101)(002b0009080304030303020301)(000a000a0008001d001700180019)(0015))
+tls/(0303)(c02fc030c02bc02ccca8cca9c013c009c014c00a009c009d002f0035c012000a)((3374)(0000)(000500050100000000)(000a000a0008001d001700180019)(000b00020100)(000d000e000c040104030501050302010203)(ff01)(0010000e000c02683208687474702f312e31)(0012))
+tls/(0303)(130313011302c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002fc008c012000a)((ff01)(0000)(0017)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(3374)(0012)(0010001b001908737064792f332e3106737064792f3308687474702f312e31)(000b00020100)(0033)(002d00020101)(002b0009080304030303020301)(000a000a0008001d001700180019)(0015))
+tls/(0303)(0a0ac02bc02fc02cc030cca9cca8c013c014009c009d002f0035000a)((0a0a)(ff01)(0000)(0017)(0023)(000d00140012040308040401050308050501080606010201)(000500050100000000)(0012)(0010000e000c02683208687474702f312e31)(000b00020100)(000a000a00080a0a001d00170018)(0a0a))
+tls/(0303)(130113031302c02bc02fcca9cca8c02cc030c00ac009c013c01400330039002f0035000a)((0000)(0017)(ff01)(000a000e000c001d00170018001901000101)(000b00020100)(0010000e000c02683208687474702f312e31)(000500050100000000)(0033)(002b0009080304030303020301)(000d0018001604030503060308040805080604010501060102030201)(002d00020101)(001c00024001)(0029))
+tls/(0303)(c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002fc008c012000a)((ff01)(0000)(0017)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(3374)(0012)(00100030002e0268320568322d31360568322d31350568322d313408737064792f332e3106737064792f3308687474702f312e31)(000b00020100)(000a000a0008001d001700180019))
+tls/(0303)(c02cc02bc030c02f009f009ec024c023c028c027c00ac009c014c01300390033009d009c003d003c0035002f000a006a0040003800320013)((0000)(000500050100000000)(000a00080006001d00170018)(000b00020100)(000d00140012040105010201040305030203020206010603)(0023)(0017)(ff01))
+tls/(0303)(c02fc02bc030c02c009ec0270067c028006bc024c014c00a00a500a300a1009f006a006900680039003800370036c032c02ec02ac026c00fc005009d003d0035c023c013c00900a400a200a00040003f003e0033003200310030c031c02dc029c025c00ec004009c003c002f00ff)((0000)(000b000403000102)(000a001c001a00170019001c001b0018001a0016000e000d000b000c0009000a)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(3374))
+tls/(0303)(c030c02cc028c02400a500a1009f006b00690068c032c02ec02ac026009d003dc02fc02bc027c02300a400a0009e0067003f003ec031c02dc029c025009c003c00ff)((000b000403000102)(000a001c001a00170019001c001b0018001a0016000e000d000b000c0009000a)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101))
+tls/(0303)(c030c02cc032c02ec02fc02bc031c02d00a500a300a1009f00a400a200a0009ec028c024c014c00ac02ac026c00fc005006b006a006900680039003800370036c027c023c013c009c029c025c00ec00400670040003f003e0033003200310030009d009c003d0035003c002f00ff)((0000)(000b000403000102)(000a001c001a00170019001c001b0018001a0016000e000d000b000c0009000a)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101))
+tls/(0303)(0a0ac02bc02fc02cc030cca9cca8c013c014009c009d002f0035000a)((0a0a)(ff01)(0000)(0017)(0023)(000d00140012040308040401050308050501080606010201)(000500050100000000)(0012)(0010000e000c02683208687474702f312e31)(7550)(000b00020100)(000a000a00080a0a001d00170018)(0a0a)(0015))
+tls/(0303)(00ffc02cc02bc024c023c00ac009c008c030c02fc028c027c014c013c012009f009e006b0067003900330016009d009c003d003c0035002f000a)((0000)(000a00080006001700180019)(000b00020100)(000d0012001004010201050106010403020305030603)(000500050100000000)(0012)(0017))
+tls/(0303)(c024c028003dc026c02a006b006ac00ac0140035c005c00f00390038c023c027003cc025c02900670040c009c013002fc004c00e00330032c02cc02bc030009dc02ec032009f00a3c02f009cc02dc031009e00a200ff)((000a001600140017001800190009000a000b000c000d000e0016)(000b00020100)(000d001c001a0603060105030501040304010402030303010302020302010202)(0017)(0000))
+tls/(0303)(c02bc02cc086c087c009c023c00ac024c072c073c0acc0adc008c02fc030c08ac08bc013c027c014c028c076c077c012009c009dc07ac07b002f003c0035003d004100ba008400c0c09cc09d000a009e009fc07cc07d003300670039006b004500be008800c4c09ec09f0016)((0017)(0016)(000500050100000000)(0000)(ff01)(0023)(000a000c000a00170018001900150013)(000b00020100)(000d001600140401040305010503060106030301030302010203)(0010000b000908687474702f312e31))
+tls/(0303)(c030c02cc028c024c014c00a00a500a300a1009f006b006a0069006800390038003700360088008700860085009d003d00350084c02fc02bc027c023c013c00900a400a200a0009e00670040003f003e0033003200310030009a0099009800970045004400430042009c003c002f00960041c012c008001600130010000d000a00ff)((0000)(000b000403000102)(000a000a00080019001800170013)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101)(0015))
+tls/(0303)(0a0ac02bc02fc02cc030cca9cca8c013c014009c009d002f0035000a)((0a0a)(ff01)(0000)(0017)(0023)(000d00140012040308040401050308050501080606010201)(000500050100000000)(0012)(0010000e000c02683208687474702f312e31)(7550)(000b00020100)(000a000a00080a0a001d00170018)(0a0a))
+tls/(0301)(c014c013003900330035002fc00ac00900380032000a001300050004)((0000)(000a0006000400170018)(000b00020100)(0017)(ff01))
+tls/(0303)(c02cc030c02bc02fc00ac009c014c0130035002f)((0000)(000500050100000000)(000a000a0008001d001700180019)(000b00020100)(000d0012001004010403050105030601060302010203)(ff01)(0012))
+tls/(0303)(c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8)((ff01)(0000)(0017)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(3374)(0012)(00100030002e0268320568322d31360568322d31350568322d313408737064792f332e3106737064792f3308687474702f312e31)(000b00020100)(000a000a0008001d001700180019))
+tls/(0303)(c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8)((ff01)(0000)(0017)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(3374)(0012)(0010001b001908737064792f332e3106737064792f3308687474702f312e31)(000b00020100)(000a000a0008001d001700180019))
+tls/(0303)(c030c02cc028c024c014c00a00a500a300a1009f006b006a0069006800390038003700360088008700860085c032c02ec02ac026c00fc005009d003d00350084c02fc02bc027c023c013c00900a400a200a0009e00670040003f003e0033003200310030009a0099009800970045004400430042c031c02dc029c025c00ec004009c003c002f009600410007c012c008001600130010000dc00dc003000a00ff)((0000)(000b000403000102)(000a001c001a00170019001c001b0018001a0016000e000d000b000c0009000a)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101)(3374)(0010000b000908687474702f312e31)(0015))
+tls/(0303)(c02cc02bc030c02fc024c023c028c027c00ac009c014c013009d009c003d003c0035002f000a)((0000)(000500050100000000)(000a00080006001d00170018)(000b00020100)(000d00140012040105010201040305030203020206010603)(0023)(0010000e000c02683208687474702f312e31)(0017)(ff01))
+tls/(0303)(c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002f)((ff01)(0000)(0017)(000d00140012040308040401050308050501080606010201)(000500050100000000)(3374)(0012)(00100030002e0268320568322d31360568322d31350568322d313408737064792f332e3106737064792f3308687474702f312e31)(000b00020100)(000a000a0008001d001700180019))
+tls/(0303)(130113031302c02bc02fcca9cca8c02cc030c00ac009c013c01400330039002f0035000a)((0000)(0017)(ff01)(000a000e000c001d00170018001901000101)(000b00020100)(0010000e000c02683208687474702f312e31)(000500050100000000)(0033)(002b0009080304030303020301)(000d0018001604030503060308040805080604010501060102030201)(002d00020101)(001c00024001)(0015))
+tls/(0303)(c024c028003dc026c02a006b006ac00ac0140035c005c00f00390038c023c027003cc025c02900670040c009c013002fc004c00e00330032c02cc02bc030009dc02ec032009f00a3c02f009cc02dc031009e00a2c008c012000ac003c00d0016001300ff)((000a001600140017001800190009000a000b000c000d000e0016)(000b00020100)(000d001c001a0603060105030501040304010402030303010302020302010202)(0000))
+tls/(0303)(130113031302c02bc02fcca9cca8c02cc030c00ac009c013c01400330039002f0035000a)((0000)(0017)(ff01)(000a000e000c001d00170018001901000101)(000b00020100)(0010000e000c02683208687474702f312e31)(000500050100000000)(0033)(002b0009080304030303020301)(000d0018001604030503060308040805080604010501060102030201)(001c00024001)(0015))
+tls/(0303)(c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002fc008c012000a)((ff01)(0000)(0017)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(0012)(000b00020100)(000a000a0008001d001700180019))
+tls/(0303)(c030c02cc028c024c014c00a00a500a300a1009f006b006a0069006800390038003700360088008700860085c032c02ec02ac026c00fc005009d003d00350084c02fc02bc027c023c013c00900a400a200a0009e00670040003f003e0033003200310030009a0099009800970045004400430042c031c02dc029c025c00ec004009c003c002f00960041c012c008001600130010000dc00dc003000a0007c011c007c00cc0020005000400ff)((000b000403000102)(000a000a00080017001900180016)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101))
+tls/(0303)(c028c027c014c013009f009e00390033009d009c003d003c0035002fc02cc02bc024c023c00ac009006a004000380032000a0013)((0000)(000500050100000000)(000a0006000400170018)(000b00020100)(000d00140012060106030401050102010403050302030202)(0017)(ff01))
+tls/(0303)(c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002fc008c012000a)((ff01)(0000)(0017)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(3374)(0012)(00100030002e0268320568322d31360568322d31350568322d313408737064792f332e3106737064792f3308687474702f312e31)(000b00020100)(000a000a0008001d001700180019)(0015))
+tls/(0303)(c030c028c014c02fc027c013009f006b0039009e0067003300ff)((0000)(000b000403000102)(000a001c001a00170019001c001b0018001a0016000e000d000b000c0009000a)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203))
+tls/(0303)(c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002f)((ff01)(0000)(0017)(000d00140012040308040401050308050501080606010201)(000500050100000000)(3374)(0012)(00100030002e0268320568322d31360568322d31350568322d313408737064792f332e3106737064792f3308687474702f312e31)(000b00020100)(000a000a0008001d001700180019)(0015))
+tls/(0303)(c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8)((ff01)(0000)(0017)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(0012)(000b00020100)(000a000a0008001d001700180019))
+tls/(0303)(c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002f)((ff01)(0000)(0017)(000d00140012040308040401050308050501080606010201)(000500050100000000)(0012)(000b00020100)(000a000a0008001d001700180019))
+tls/(0303)(0a0a130113021303c02bc02fc02cc030cca9cca8c013c014009c009d002f0035000a)((0a0a)(0000)(0017)(ff01)(000a000a00080a0a001d00170018)(000b00020100)(0023)(0010000e000c02683208687474702f312e31)(000500050100000000)(000d00140012040308040401050308050501080606010201)(0012)(0033)(002d00020101)(002b000b0a0a0a0304030303020301)(001b0003020002)(0a0a)(0015)(0029))
+tls/(0303)(c024c028003dc026c02a006b006ac00ac0140035c005c00f00390038c023c027003cc025c02900670040c009c013002fc004c00e00330032c02cc02bc030009dc02ec032009f00a3c02f009cc02dc031009e00a2c008c012000ac003c00d0016001300ff)((000a00080006001700180019)(000b00020100)(000d001c001a0603060105030501040304010402030303010302020302010202)(0000))
+tls/(0303)(0a0a130113021303c02bc02fc02cc030cca9cca8c013c014009c009d002f0035000a)((0a0a)(0000)(0017)(ff01)(000a000a00080a0a001d00170018)(000b00020100)(0023)(000500050100000000)(000d00140012040308040401050308050501080606010201)(0012)(0033)(002d00020101)(002b000b0a0a0a0304030303020301)(001b0003020002)(0a0a)(0015))
+tls/(0303)(c02bc02ccca9c02fc030cca8c009c00ac013c014009c009d002f0035)((ff01)(0000)(0017)(0023)(000d00140012040308040401050308050501080606010201)(000500050100000000)(0010000b000908687474702f312e31)(000b00020100)(000a00080006001d00170018))
+tls/(0303)(c02cc02bc030c02fc024c023c028c027c00ac009c014c013009d009c003d003c0035002f000a)((0000)(000500050100000000)(000a00080006001d00170018)(000b00020100)(000d00140012040105010201040305030203020206010603)(0023)(0010000e000c02683208687474702f312e31)(0017)(00180006000a03020100)(ff01))
+tls/(0303)(c02bc02ccca9c02fc030cca8c009c00ac013c014009c009d002f0035)((ff01)(0000)(0017)(0023)(000d0010000e0403040105030501060306010201)(000500050100000000)(0010000b000908687474702f312e31)(000b00020100)(000a00080006001d00170018))
+tls/(0303)(130313011302c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002fc008c012000a)((ff01)(0000)(0017)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(3374)(0012)(00100030002e0268320568322d31360568322d31350568322d313408737064792f332e3106737064792f3308687474702f312e31)(000b00020100)(0033)(002d00020101)(002b0009080304030303020301)(000a000a0008001d001700180019)(0029))
+tls/(0303)(c028c027c014c013009f009e009d009cc02cc02bc024c023c00ac009003d003c0035002f006a004000380032000a001300050004)((0000)(000a00080006001700180019)(000b00020100)(000d00140012060106030401050102010403050302030202)(ff01))
+tls/(0303)(c02cc030c02bc02fc00ac009c014c0130035002f)((0000)(000500050100000000)(000a000a0008001d001700180019)(000b00020100)(000d000e000c040104030501050302010203)(ff01)(0012))
+tls/(0303)(c030c02fc028c027c014c013009f009e00390033009d009c003d003c0035002fc02cc02bc024c023c00ac009006a004000380032000a0013)((0000)(000500050100000000)(000a0006000400170018)(000b00020100)(000d00140012040105010201040305030203020206010603)(0023)(0017)(ff01))
+tls/(0303)(c02bc02fcca9cca8c02cc030c00ac009c013c01400330039002f0035000a)((0000)(0017)(ff01)(000a000a0008001d001700180019)(000b00020100)(0023)(0010000e000c02683208687474702f312e31)(000500050100000000)(000d0018001604030503060308040805080604010501060102030201))
+tls/(0303)(c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002f)((ff01)(0000)(0017)(000d00140012040308040401050308050501080606010201)(000500050100000000)(3374)(0012)(0010001b001908737064792f332e3106737064792f3308687474702f312e31)(000b00020100)(000a000a0008001d001700180019))
+tls/(0303)(00ffc02cc02bc024c023c00ac009c008c030c02fc028c027c014c013c012009d009c003d003c0035002f000a)((0000)(000a00080006001700180019)(000b00020100)(000d0012001004010201050106010403020305030603)(3374)(00100020001e1061706e732d73656375726974792d76330c61706e732d7061636b2d7631)(000500050100000000)(0012)(0017))
+tls/(0303)(130113031302c02bc02fcca9cca8c02cc030c00ac009c013c01400330039002f0035000a)((0000)(0017)(ff01)(000a000e000c001d00170018001901000101)(000b00020100)(0023)(0010000b000908687474702f312e31)(000500050100000000)(0033)(002b0009080304030303020301)(000d0018001604030503060308040805080604010501060102030201)(002d00020101)(001c00024001))
+tls/(0303)(c02cc030c02bc02fcca9cca800a3009f00a2009eccaac0afc0adc024c028c00ac014c0a3c09f006b006a00390038c0aec0acc023c027c009c013c0a2c09e0067004000330032009d009cc0a1c09dc0a0c09c003d003c0035002f00ff)((0000)(000b000403000102)(000a000a0008001d001700190018)(0023)(0016)(0017)(000d0020001e060106020603050105020503040104020403030103020303020102020203))
+tls/(0303)(c030c02cc028c024c014c00a00a500a300a1009f006b006a0069006800390038003700360088008700860085c032c02ec02ac026c00fc005009d003d00350084c02fc02bc027c023c013c00900a400a200a0009e00670040003f003e0033003200310030009a0099009800970045004400430042c031c02dc029c025c00ec004009c003c002f009600410007c011c007c00cc00200050004c012c008001600130010000dc00dc003000a00ff)((0000)(000b000403000102)(000a001c001a00170019001c001b0018001a0016000e000d000b000c0009000a)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101)(0015))
+tls/(0303)(0a0ac02bc02fc02cc030cca9cca8c013c014009c009d002f0035000a)((0a0a)(ff01)(0000)(0017)(0023)(000d00140012040308040401050308050501080606010201)(000500050100000000)(0012)(0010000e000c02683208687474702f312e31)(000b00020100)(000a000a00080a0a001d00170018)(0a0a)(0015))
+tls/(0303)(c030c02cc032c02ec02fc02bc031c02d00a500a300a1009f00a400a200a0009ec028c024c014c00ac02ac026c00fc005006b006a006900680039003800370036c027c023c013c009c029c025c00ec00400670040003f003e003300320031003000880087008600850045004400430042c012c008c00dc003001600130010000d009d009c003d0035003c002f00840041000a00ff)((0000)(000b000403000102)(000a000a00080017001900180016)(0023)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101)(0015))
+tls/(0303)(c02bc02f009e009cc00ac0140039006b00380035003dc009c013003300670032002f003c0005000400160013000a)((0000)(ff01)(000a00080006001700180019)(000b00020100)(000d001a0018040305030603020304010501060102010402050206020202))
+tls/(0303)(c024c028003dc026c02a006b006ac00ac0140035c005c00f00390038c023c027003cc025c02900670040c009c013002fc004c00e00330032c02cc02bc030009dc02ec032009f00a3c02f009cc02dc031009e00a200ff)((000a001600140017001800190009000a000b000c000d000e0016)(000b00020100)(000d001c001a0603060105030501040304010402030303010302020302010202)(0000))
+tls/(0303)(c02cc02bc030c02f009f009ec024c023c028c027c00ac009c014c013009d009c003d003c0035002f000a00050004)((0000)(000a00080006001d00170018)(000b00020100)(000d00140012040105010201040305030203020206010603)(0023)(0017)(ff01))
+tls/(0303)(00ffc02cc02bc024c023c00ac009c030c02fc028c027c014c013009d009c003d003c0035002f)((0000)(000a00080006001700180019)(000b00020100)(000d0012001004010201050106010403020305030603)(3374)(00100030002e0268320568322d31360568322d31350568322d313408737064792f332e3106737064792f3308687474702f312e31)(000500050100000000)(0012)(0017))
+tls/(0303)(c02cc00ac02bcca9c009c030c014c02fcca8c013003900330035002f000a)((0000)(0017)(ff01)(000a000a0008001d001700180019)(000b00020100)(0023)(0010000e000c02683208687474702f312e31)(000500050100000000)(000d0012001004030503060304010501060102030201))
+tls/(0303)(c030c02cc032c02ec02fc02bc031c02d00a3009f00a2009ec028c024c014c00ac02ac026c00fc005006b006a00390038c027c023c013c009c029c025c00ec0040067004000330032cca9cca8cc14cc13c012c008c00dc003ccaacc1500c400c30088008700be00bd0045004400160013009d009c003d0035003c002f00c0008400ba0041000a00ff)((0000)(000b000403000102)(000a003a0038000e000d0019001c000b000c001b00180009000a001a00160017000800060007001400150004000500120013000100020003000f00100011)(0023)(000d00260024060106020603efef050105020503040104020403eeeeeded030103020303020102020203)(0015))
+tls/(0301)(c00ac009c014c0130035002f000a00050004)((0000)(000a00080006001d00170018)(000b00020100)(0023)(0017)(ff01))
+tls/(0303)(c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8)((ff01)(0000)(0017)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(3374)(0012)(00100030002e0268320568322d31360568322d31350568322d313408737064792f332e3106737064792f3308687474702f312e31)(000b00020100)(000a000a0008001d001700180019)(0015))
+tls/(0303)(0a0ac02bc02fc02cc030cca9cca8c013c014009c009d002f0035000a)((0a0a)(ff01)(0000)(0017)(0023)(000d00140012040308040401050308050501080606010201)(000500050100000000)(0012)(0010000e000c02683208687474702f312e31)(000b00020100)(000a000a00080a0a001d00170018)(001b0003020002)(0a0a))
+tls/(0303)(130313011302c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002fc008c012000a)((ff01)(0000)(0017)(0023)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(3374)(0012)(00100030002e0268320568322d31360568322d31350568322d313408737064792f332e3106737064792f3308687474702f312e31)(000b00020100)(0033)(002d00020101)(002b0009080304030303020301)(000a000a0008001d001700180019)(0015))
+tls/(0303)(c02cc02bc030c02f009f009ec024c023c028c027c00ac009c014c01300390033009d009c003d003c0035002f000a006a0040003800320013)((0000)(000500050100000000)(000a0006000400170018)(000b00020100)(000d00140012040105010201040305030203020206010603)(0023)(0017)(ff01))
+tls/(0303)(c024c028003dc026c02a006b006ac00ac0140035c005c00f00390038c023c027003cc025c02900670040c009c013002fc004c00e00330032c02cc02bc030009dc02ec032009f00a3c02f009cc02dc031009e00a2c008c012000ac003c00d0016001300ff)((000a00080006001700180019)(000b00020100)(000d001c001a0603060105030501040304010402030303010302020302010202)(0017)(0000))
+tls/(0303)(00ffc02cc02bc024c023c00ac009c008c030c02fc028c027c014c013c012009d009c003d003c0035002f000ac007c01100050004)((0000)(000a00080006001700180019)(000b00020100)(000d000e000c050104010201050304030203)(3374)(0010001300111061706e732d73656375726974792d7632)(000500050100000000)(0012))
+tls/(0303)(00ffc02cc02bc024c023c00ac009c008c030c02fc028c027c014c013c012009f009e006b0067003900330016009d009c003d003c0035002f000ac007c01100050004)((0000)(000a00080006001700180019)(000b00020100)(000d0012001004010201050106010403020305030603)(000500050100000000)(0012)(0017))
+tls/(0303)(130313011302c02cc02bc024c023c00ac009cca9c030c02fc028c027c014c013cca8009d009c003d003c0035002fc008c012000a)((ff01)(0000)(0017)(0023)(000d0018001604030804040105030203080508050501080606010201)(000500050100000000)(0012)(000b00020100)(0033)(002d00020101)(002b0009080304030303020301)(000a000a0008001d001700180019)(0015))
+tls/(0303)(c02bc02ccca9c02fc030cca8c013c014009c009d002f0035)((ff01)(0000)(0017)(0023)(000d00140012040308040401050308050501080606010201)(000500050100000000)(0010000e000c02683208687474702f312e31)(000b00020100)(000a00080006001d00170018))
+tls/(0303)(0a0a130313011302cca9cca8c02bc02fc02cc030c013c014009c009d002f0035000a)((0a0a)(0000)(0017)(ff01)(000a000a00080a0a001d00170018)(000b00020100)(0023)(0010000e000c02683208687474702f312e31)(000500050100000000)(000d00140012040308040401050308050501080606010201)(0012)(0033)(002d00020101)(002b000b0a0a0a0304030303020301)(001b0003020002)(0a0a)(0015))
+tls/(0303)(c030c02cc028c024c014c00a00a3009f006b006a0039003800880087c032c02ec02ac026c00fc005009d003d00350084c012c00800160013c00dc003000ac02fc02bc027c023c013c00900a2009e0067004000330032009a009900450044c031c02dc029c025c00ec004009c003c002f00960041c011c007c00cc0020005000400150012000900ff)((0000)(000b000403000102)(000a00340032000e000d0019000b000c00180009000a00160017000800060007001400150004000500120013000100020003000f00100011)(000d0020001e060106020603050105020503040104020403030103020303020102020203)(000f000101))
@@ -0,0 +1,157 @@
+/*
+ * analysis_cache_test.cc
+ *
+ * unit tests for class analysis_cache, and its counters in the
+ * packet processor stats
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#include "libmerc_fixture.h"
+#include "analysis_cache.h"
+
+// context(sn, port) returns a destination_context with the server
+// name sn and the destination port port
+//
+static struct destination_context context(const char *sn, uint16_t port) {
+    struct destination_context dc;
+    strncpy(dc.sn_str, sn, sizeof(dc.sn_str) - 1);
+    strcpy(dc.dst_ip_str, "192.0.2.1");
+    strcpy(dc.ua_str, "");
+    dc.dst_port = port;
+    return dc;
+}
+
+static struct analysis_result labeled(const char *proc) {
+    return analysis_result{fingerprint_status_labeled, proc, 0.9, nullptr, 0, attribute_result{}};
+}
+
+TEST_CASE("analysis_cache size and keys") {
+    CHECK_FALSE(analysis_cache{0}.is_enabled());
+    CHECK(analysis_cache{0}.capacity() == 0);
+    CHECK(analysis_cache{1}.capacity() == analysis_cache::ways);
+    CHECK(analysis_cache{100}.capacity() == 128);
+    CHECK(analysis_cache{}.capacity() == analysis_cache::default_entries);
+
+    analysis_cache c{64};
+    uint64_t k = c.key("tls/(0303)", context("example.com", 443));
+    CHECK(k != 0);
+    CHECK(c.key("tls/(0303)", context("example.com", 443)) == k);
+    CHECK(c.key("tls/(0303)", context("example.com", 8443)) != k);
+    CHECK(c.key("tls/(0303)", context("example.org", 443)) != k);
+    CHECK(c.key("tls/(0301)", context("example.com", 443)) != k);
+
+    // the fields are delimited, so moving a byte from one string to
+    // the next changes the key
+    //
+    CHECK(c.key("tls/(0303)e", context("xample.com", 443)) != k);
+
+    analysis_cache other{64};
+    CHECK(other.key("tls/(0303)", context("example.com", 443)) != k);   // seeded per cache
+}
+
+TEST_CASE("analysis_cache find and insert") {
+    analysis_cache c{64};
+    const uint64_t owner = 1;
+    uint64_t k1 = c.key("fp1", context("a.example.com", 443));
+    uint64_t k2 = c.key("fp2", context("b.example.com", 443));
+
+    CHECK(c.find(k1, owner) == nullptr);
+    c.insert(k1, labeled("firefox"));
+    CHECK(c.find(k2, owner) == nullptr);
+    c.insert(k2, labeled("chrome"));
+
+    const struct analysis_result *r = c.find(k1, owner);
+    REQUIRE(r != nullptr);
+    CHECK(std::string{r->max_proc} == "firefox");
+    r = c.find(k2, owner);
+    REQUIRE(r != nullptr);
+    CHECK(std::string{r->max_proc} == "chrome");
+
+    CHECK(c.stats.hits == 2);
+    CHECK(c.stats.misses == 2);
+    CHECK(c.stats.evictions == 0);
+    CHECK(c.stats.invalidations == 0);
+}
+
+TEST_CASE("analysis_cache is emptied when the classifier changes") {
+    analysis_cache c{64};
+    uint64_t k = c.key("fp1", context("a.example.com", 443));
+
+    CHECK(c.find(k, 1) == nullptr);
+    c.insert(k, labeled("firefox"));
+    CHECK(c.find(k, 1) != nullptr);
+
+    CHECK(c.find(k, 2) == nullptr);      // results of classifier 1 are gone
+    CHECK(c.stats.invalidations == 1);
+    c.insert(k, labeled("chrome"));
+    REQUIRE(c.find(k, 2) != nullptr);
+    CHECK(std::string{c.find(k, 2)->max_proc} == "chrome");
+    CHECK(c.stats.invalidations == 1);
+}
+
+TEST_CASE("analysis_cache replaces the entries that were not referenced") {
+    analysis_cache c{analysis_cache::ways};    // a single set
+    const uint64_t owner = 1;
+
+    for (uint64_t k = 1; k <= analysis_cache::ways; k++) {
+        CHECK(c.find(k, owner) == nullptr);
+        c.insert(k, labeled(("p" + std::to_string(k)).c_str()));
+    }
+    CHECK(c.stats.evictions == 0);
+
+    // key 1 is referenced, so the hand passes over it and replaces key 2
+    //
+    CHECK(c.find(1, owner) != nullptr);
+    const uint64_t next = analysis_cache::ways + 1;
+    CHECK(c.find(next, owner) == nullptr);
+    c.insert(next, labeled("next"));
+    CHECK(c.stats.evictions == 1);
+    CHECK(c.find(2, owner) == nullptr);
+    CHECK(c.find(1, owner) != nullptr);
+    REQUIRE(c.find(next, owner) != nullptr);
+    CHECK(std::string{c.find(next, owner)->max_proc} == "next");
+    for (uint64_t k = 3; k <= analysis_cache::ways; k++) {
+        CHECK(c.find(k, owner) != nullptr);
+    }
+}
+
+TEST_CASE_METHOD(LibmercTestFixture, "analysis cache counters are reported by the packet processor")
+{
+    struct libmerc_config config{};
+    config.resources = default_resources_path;
+    config.do_analysis = true;
+    initialize(config);
+
+    auto process = [this]() {
+        set_pcap("top_100_fingerprints.pcap");
+        while (read_next_data_packet() == 0) {
+            mercury_packet_processor_write_json(m_mpp, m_output, sizeof(m_output),
+                                                (unsigned char *)m_data_packet.first,
+                                                m_data_packet.second - m_data_packet.first,
+                                                &m_time);
+        }
+    };
+
+    struct mercury_packet_processor_stats first;
+    process();
+    REQUIRE(mercury_packet_processor_get_stats(m_mpp, &first));
+    CHECK(first.analysis_cache_size == analysis_cache::default_entries);
+    CHECK(first.analysis_cache_misses > 0);
+    CHECK(first.analysis_cache_invalidations == 0);
+
+    // the same flows again: every result that was cached is now a hit
+    //
+    struct mercury_packet_processor_stats second;
+    process();
+    REQUIRE(mercury_packet_processor_get_stats(m_mpp, &second));
+    uint64_t lookups = first.analysis_cache_hits + first.analysis_cache_misses;
+    CHECK(second.analysis_cache_hits + second.analysis_cache_misses == 2 * lookups);
+    CHECK(second.analysis_cache_hits > first.analysis_cache_hits);
+
+    CHECK_FALSE(mercury_packet_processor_get_stats(m_mpp, nullptr));
+    CHECK_FALSE(mercury_packet_processor_get_stats(nullptr, &second));
+
+    deinitialize();
+}
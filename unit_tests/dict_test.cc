@@ -0,0 +1,99 @@
+/*
+ * dict_test.cc
+ *
+ * unit tests for class dict
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#include <string>
+#include <set>
+#include "catch.hpp"
+#include "dict.h"
+
+// compressed(d, s) returns the compressed form of s in the dict d
+//
+static std::string compressed(dict &d, const std::string &s) {
+    char buf[9];
+    d.compress(s, buf);
+    return buf;
+}
+
+TEST_CASE("dict gives each string its own value") {
+    dict d;
+    CHECK(compressed(d, "10.0.0.1") == "0");
+    CHECK(compressed(d, "10.0.0.2") == "1");
+    CHECK(compressed(d, "10.0.0.1") == "0");
+    for (int i = 0; i < 30; i++) {
+        d.get("host" + std::to_string(i));
+    }
+    CHECK(compressed(d, "new") == "20");       // values are written in hex
+    CHECK(d.size() == 33);
+}
+
+TEST_CASE("dict end_epoch evicts the strings that were not used") {
+    dict d;
+    unsigned int kept = d.get("kept");
+    unsigned int dropped = d.get("dropped");
+    d.end_epoch();
+    CHECK(d.size() == 2);                       // both were used in the first epoch
+
+    CHECK(d.get("kept") == kept);
+    d.end_epoch();
+    CHECK(d.size() == 1);
+
+    // the value of a string that is used in every epoch never
+    // changes, and an evicted string gets a new value
+    //
+    for (int epoch = 0; epoch < 10; epoch++) {
+        CHECK(d.get("kept") == kept);
+        d.end_epoch();
+    }
+    unsigned int again = d.get("dropped");
+    CHECK(again != dropped);
+    CHECK(again != kept);
+}
+
+TEST_CASE("dict memory is bounded by the strings used per epoch") {
+    dict d;
+    std::set<unsigned int> values;
+    size_t max_buckets = 0;
+    for (int epoch = 0; epoch < 50; epoch++) {
+        d.get("persistent");
+        int n = (epoch % 10 == 0) ? 20000 : 100;   // an occasional burst
+        for (int i = 0; i < n; i++) {
+            values.insert(d.get("e" + std::to_string(epoch) + "." + std::to_string(i)));
+        }
+        d.end_epoch();
+        CHECK(d.size() == (size_t)n + 1);
+        max_buckets = std::max(max_buckets, d.d.bucket_count());
+    }
+    CHECK(values.size() == 5 * 20000 + 45 * 100);   // values are never reused
+
+    // the table shrinks after a burst
+    //
+    d.get("persistent");
+    d.end_epoch();
+    d.get("persistent");
+    d.end_epoch();
+    CHECK(d.size() == 1);
+    CHECK(d.d.bucket_count() < max_buckets / 8);
+}
+
+TEST_CASE("dict inverse map skips evicted strings") {
+    dict d;
+    unsigned int a = d.get("a");
+    unsigned int b = d.get("b");
+    d.end_epoch();
+    d.get("a");
+    unsigned int c = d.get("c");
+    d.end_epoch();
+
+    REQUIRE(d.compute_inverse_map());
+    CHECK(std::string{d.get_inverse(a)} == "a");
+    CHECK(std::string{d.get_inverse(c)} == "c");
+    CHECK(std::string{d.get_inverse(b)} == dict::unknown_fp_string);
+    CHECK(std::string{d.get_inverse(1000)} == dict::unknown_fp_string);
+    CHECK(d.unit_test(nullptr));
+}
@@ -0,0 +1,198 @@
+/*
+ * flow_map_test.cc
+ *
+ * unit tests for class flow_map
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#include "catch.hpp"
+#include "flow_map.h"
+
+// same_hash puts every key in the same probe sequence, with the same tag
+//
+struct same_hash {
+    size_t operator()(uint64_t) const { return 0x1234; }
+};
+
+// struct counted keeps track of the number of its instances that are alive
+//
+struct counted {
+    int *live;
+    int value;
+    counted(int *l, int v) : live{l}, value{v} { ++*live; }
+    ~counted() { --*live; }
+};
+
+TEST_CASE("flow_map insert, find, and erase") {
+    flow_map<int, uint64_t> m{1000, 30};
+    CHECK(m.capacity() >= 1000);
+    CHECK(m.size() == 0);
+    CHECK(m.find(1) == nullptr);
+
+    for (uint64_t k = 0; k < 1000; k++) {
+        m.insert(k, 0, (int)k * 2);
+    }
+    CHECK(m.size() == 1000);
+    CHECK(m.evictions() == 0);
+    for (uint64_t k = 0; k < 1000; k++) {
+        auto *e = m.find(k);
+        REQUIRE(e != nullptr);
+        CHECK(e->value == (int)k * 2);
+    }
+
+    // insert() replaces the value of an existing key
+    //
+    m.insert(7, 5, -1);
+    CHECK(m.size() == 1000);
+    CHECK(m.find(7)->value == -1);
+    CHECK(m.find(7)->sec == 5);
+
+    CHECK(m.erase(7));
+    CHECK_FALSE(m.erase(7));
+    CHECK(m.find(7) == nullptr);
+    CHECK(m.size() == 999);
+
+    size_t visited = 0;
+    m.for_each([&](flow_map<int, uint64_t>::entry &) { visited++; });
+    CHECK(visited == 999);
+
+    m.clear();
+    CHECK(m.size() == 0);
+    CHECK(m.find(8) == nullptr);
+}
+
+TEST_CASE("flow_map memory use is bounded") {
+    flow_map<int, uint64_t> m{100, 30};
+    for (uint64_t k = 0; k < 100000; k++) {
+        m.insert(k, 0, 0);
+        REQUIRE(m.size() <= m.capacity());
+    }
+    CHECK(m.evictions() > 0);
+    CHECK(m.find(99999) != nullptr);   // the newest key is always found
+}
+
+TEST_CASE("flow_map reuses expired entries before evicting live ones") {
+    flow_map<int, uint64_t, same_hash> m{14, 10};
+    REQUIRE(m.capacity() == 16);       // a single group, so every key collides
+
+    for (uint64_t k = 0; k < 16; k++) {
+        m.insert(k, 10 + k, (int)k);   // at times 10 through 25
+    }
+    CHECK(m.size() == 16);
+    for (uint64_t k = 0; k < 16; k++) {
+        REQUIRE(m.find(k) != nullptr);
+        CHECK(m.find(k)->value == (int)k);
+    }
+
+    // at time 20, the entry inserted at time 10 is the only expired
+    // one; the entries with later times (as from packets out of order)
+    // are not expired
+    //
+    m.insert(100, 20, 100);
+    CHECK(m.evictions() == 0);
+    CHECK(m.find(0) == nullptr);
+    CHECK(m.find(100) != nullptr);
+
+    // nothing else has expired, so the oldest entry is evicted
+    //
+    m.find(1)->sec = 20;               // touched, so no longer the oldest
+    m.insert(101, 20, 101);
+    CHECK(m.evictions() == 1);
+    CHECK(m.find(1) != nullptr);
+    CHECK(m.find(2) == nullptr);
+    CHECK(m.size() == 16);
+}
+
+TEST_CASE("flow_map try_emplace never reuses or evicts") {
+    flow_map<int, uint64_t, same_hash> m{14, 10};
+    for (uint64_t k = 0; k < 16; k++) {
+        auto [e, inserted] = m.try_emplace(k, 0, (int)k);
+        REQUIRE(e != nullptr);
+        CHECK(inserted);
+    }
+
+    auto [existing, inserted] = m.try_emplace(3, 100, -3);
+    REQUIRE(existing != nullptr);
+    CHECK_FALSE(inserted);
+    CHECK(existing->value == 3);       // the existing value is left alone
+
+    // every entry has expired, but none is reused
+    //
+    auto [e, added] = m.try_emplace(16, 100, 16);
+    CHECK(e == nullptr);
+    CHECK_FALSE(added);
+    CHECK(m.evictions() == 0);
+    CHECK(m.size() == 16);
+
+    m.erase(5);
+    auto [f, added_after_erase] = m.try_emplace(16, 100, 16);
+    REQUIRE(f != nullptr);
+    CHECK(added_after_erase);
+    CHECK(m.find(16)->value == 16);
+}
+
+TEST_CASE("flow_map destroys its values") {
+    int live = 0;
+    {
+        flow_map<counted, uint64_t, same_hash> m{14, 10};
+        for (uint64_t k = 0; k < 4; k++) {
+            m.try_emplace(k, 0, &live, (int)k);
+        }
+        CHECK(live == 4);
+
+        m.erase(uint64_t{0});          // erased
+        CHECK(live == 3);
+
+        m.insert(1, 0, &live, -1);     // replaced
+        CHECK(live == 3);
+        CHECK(m.find(1)->value.value == -1);
+
+        for (uint64_t k = 4; k < 16; k++) {
+            m.insert(k, 1, &live, (int)k);
+        }
+        CHECK(live == 15);
+        m.insert(16, 1, &live, 16);
+        m.insert(17, 20, &live, 17);   // reuses an expired entry
+        CHECK(live == 16);
+        CHECK(m.evictions() == 0);
+        m.for_each([](flow_map<counted, uint64_t, same_hash>::entry &e) { e.sec = 20; });
+        m.insert(18, 20, &live, 18);   // evicts a live entry
+        CHECK(m.evictions() == 1);
+        CHECK(live == 16);
+
+        m.clear();
+        CHECK(live == 0);
+
+        for (uint64_t k = 0; k < 8; k++) {
+            m.insert(k, 0, &live, (int)k);
+        }
+        CHECK(live == 8);
+    }
+    CHECK(live == 0);                  // destroyed with the map
+}
+
+TEST_CASE("flow_map removes untouched entries through a timer_wheel") {
+    timer_wheel wheel;                 // must outlive the map
+    flow_map<int, uint64_t> m{64, 10, &wheel};
+    wheel.advance(0);
+
+    m.insert(1, 0, 1);
+    m.insert(2, 0, 2);
+    CHECK(wheel.size() == 2);
+
+    wheel.advance(5);
+    CHECK(m.size() == 2);
+    m.find(1)->sec = 5;                // touched at time 5
+
+    wheel.advance(12);                 // the timers fire at time 10
+    CHECK(m.find(1) != nullptr);       // rescheduled, since it was touched
+    CHECK(m.find(2) == nullptr);
+    CHECK(m.size() == 1);
+
+    wheel.advance(16);
+    CHECK(m.find(1) == nullptr);
+    CHECK(m.size() == 0);
+    CHECK(wheel.size() == 0);
+}
@@ -0,0 +1,159 @@
+/*
+ * reassembly_buffer_pool_test.cc
+ *
+ * unit tests for class reassembly_buffer_pool
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#include <vector>
+#include <set>
+#include "catch.hpp"
+#include "tcp.h"
+
+using pool = reassembly_buffer_pool;
+
+TEST_CASE("reassembly_buffer_pool hands out buffers of the smallest class that fits") {
+    pool p;
+    uint32_t len = 0;
+
+    for (size_t c = 0; c < pool::num_classes; c++) {
+        uint8_t *b = p.get(pool::class_size[c], len);
+        REQUIRE(b != nullptr);
+        CHECK(len == pool::class_size[c]);
+        memset(b, 0xff, len);
+        p.put(b, len);
+
+        b = p.get(pool::class_size[c] - 1, len);
+        REQUIRE(b != nullptr);
+        CHECK(len == pool::class_size[c]);
+        p.put(b, len);
+    }
+    CHECK(p.get(1, len) != nullptr);
+    CHECK(len == pool::class_size[0]);
+    CHECK(p.get(pool::max_buffer_len + 1, len) == nullptr);
+}
+
+TEST_CASE("reassembly_buffer_pool buffers do not overlap") {
+    pool p;
+    std::vector<std::pair<uint8_t *, uint32_t>> buffers;
+    for (size_t i = 0; i < 1000; i++) {
+        uint32_t len = 0;
+        uint8_t *b = p.get(pool::class_size[i % pool::num_classes], len);
+        REQUIRE(b != nullptr);
+        memset(b, (int)i, len);
+        buffers.push_back({b, len});
+    }
+    for (size_t i = 0; i < buffers.size(); i++) {
+        auto [b, len] = buffers[i];
+        CHECK(b[0] == (uint8_t)i);
+        CHECK(b[len - 1] == (uint8_t)i);
+    }
+    for (auto [b, len] : buffers) {
+        p.put(b, len);
+    }
+    CHECK(p.spare_slab_count() == p.slab_count());
+}
+
+TEST_CASE("reassembly_buffer_pool exhaustion and reuse of slabs across classes") {
+    pool p;
+    uint32_t len = 0;
+
+    // fill the pool with buffers of the largest class, one per slab
+    //
+    std::vector<uint8_t *> large;
+    while (uint8_t *b = p.get(pool::max_buffer_len, len)) {
+        large.push_back(b);
+    }
+    CHECK(large.size() == pool::max_slabs);
+    CHECK(p.slab_count() == pool::max_slabs);
+    CHECK(p.get(1, len) == nullptr);             // exhausted
+
+    // a returned buffer makes room for another
+    //
+    p.put(large.back(), pool::max_buffer_len);
+    large.pop_back();
+    uint8_t *small = p.get(1, len);
+    REQUIRE(small != nullptr);
+    CHECK(p.get(pool::max_buffer_len, len) == nullptr);
+    p.put(small, pool::class_size[0]);
+
+    // once the large buffers are returned, their slabs serve the
+    // smallest class, up to the same limit
+    //
+    for (uint8_t *b : large) {
+        p.put(b, pool::max_buffer_len);
+    }
+    CHECK(p.spare_slab_count() == pool::max_slabs);
+
+    const size_t per_slab = pool::slab_size / pool::class_size[0];
+    std::vector<uint8_t *> smalls;
+    std::set<uint8_t *> distinct;
+    while (uint8_t *b = p.get(1, len)) {
+        smalls.push_back(b);
+        distinct.insert(b);
+    }
+    CHECK(smalls.size() == pool::max_slabs * per_slab);
+    CHECK(distinct.size() == smalls.size());
+    CHECK(p.slab_count() == pool::max_slabs);
+    CHECK(p.spare_slab_count() == 0);
+    CHECK(p.get(pool::class_size[1], len) == nullptr);
+
+    // freeing every buffer of one slab lets another class take it
+    //
+    uint8_t *slab = (uint8_t *)((uintptr_t)smalls[0] & ~(uintptr_t)(pool::slab_size - 1));
+    size_t returned = 0;
+    for (uint8_t *&b : smalls) {
+        if (b >= slab && b < slab + pool::slab_size) {
+            p.put(b, pool::class_size[0]);
+            b = nullptr;
+            returned++;
+        }
+    }
+    CHECK(returned == per_slab);
+    CHECK(p.spare_slab_count() == 1);
+    uint8_t *mid = p.get(pool::class_size[2], len);
+    CHECK(mid == slab);
+    CHECK(p.get(pool::class_size[0], len) == nullptr);
+
+    p.put(mid, pool::class_size[2]);
+    for (uint8_t *b : smalls) {
+        if (b) {
+            p.put(b, pool::class_size[0]);
+        }
+    }
+    CHECK(p.spare_slab_count() == pool::max_slabs);
+}
+
+TEST_CASE("reassembly_buffer_pool keeps partly used slabs in service") {
+    pool p;
+    uint32_t len = 0;
+    const size_t per_slab = pool::slab_size / pool::class_size[1];
+
+    std::vector<uint8_t *> buffers;
+    for (size_t i = 0; i < 3 * per_slab; i++) {
+        buffers.push_back(p.get(pool::class_size[1], len));
+        REQUIRE(buffers.back() != nullptr);
+    }
+    CHECK(p.slab_count() == 3);
+
+    // return every other buffer; no slab is empty, so none is spare,
+    // and the returned buffers are handed out again before any new
+    // slab is allocated
+    //
+    for (size_t i = 0; i < buffers.size(); i += 2) {
+        p.put(buffers[i], len);
+    }
+    CHECK(p.spare_slab_count() == 0);
+    for (size_t i = 0; i < buffers.size(); i += 2) {
+        buffers[i] = p.get(pool::class_size[1], len);
+        REQUIRE(buffers[i] != nullptr);
+    }
+    CHECK(p.slab_count() == 3);
+
+    for (uint8_t *b : buffers) {
+        p.put(b, len);
+    }
+    CHECK(p.spare_slab_count() == 3);
+}
@@ -0,0 +1,243 @@
+/*
+ * resource_archive_test.cc
+ *
+ * unit tests for the parsing of resource archives and snapshots
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "libmerc_fixture.h"
+#include "analysis.h"
+#include "resource_snapshot.h"
+
+static const char *snapshot_test_file = "resource_archive_test.snap";
+static const char *bad_snapshot_test_file = "resource_archive_test_bad.snap";
+
+// struct string_entry and struct string_archive provide the subset of
+// the archive interface that is used by classifier::read_entry()
+//
+struct string_entry {
+    size_t size;
+    size_t get_size() const { return size; }
+};
+
+struct string_archive {
+    std::string data;
+    size_t pos = 0;
+
+    ssize_t read(uint8_t *buffer, size_t len) {
+        len = std::min(len, data.length() - pos);
+        memcpy(buffer, data.data() + pos, len);
+        pos += len;
+        return len;
+    }
+};
+
+// read_entry(data, size) returns the contents that read_entry() reads
+// from an entry of length size that holds data
+//
+static std::string read_entry(const std::string &data, size_t size) {
+    string_archive archive{data};
+    std::string contents;
+    classifier::read_entry(archive, string_entry{size}, contents);
+    return contents;
+}
+
+static std::vector<std::string> lines_of(const std::string &data) {
+    std::vector<std::string> lines;
+    classifier::for_each_line(data, [&lines](std::string &line) { lines.push_back(line); });
+    return lines;
+}
+
+TEST_CASE("resource archive entries end at an empty line") {
+    CHECK(read_entry("a\nb\n", 4) == "a\nb\n");
+    CHECK(read_entry("a\nb", 3) == "a\nb");
+    CHECK(read_entry("a\n\nb\n", 5) == "a\n");
+    CHECK(read_entry("\na\n", 3) == "");
+    CHECK(read_entry("", 0) == "");
+    CHECK_THROWS_AS(read_entry("a\n", 4), std::runtime_error);     // truncated entry
+}
+
+TEST_CASE("resource archive entries are split into lines") {
+    CHECK(lines_of("") == std::vector<std::string>{});
+    CHECK(lines_of("a") == std::vector<std::string>{"a"});
+    CHECK(lines_of("a\nbc\n") == std::vector<std::string>{"a", "bc"});
+    CHECK(lines_of("a\nbc") == std::vector<std::string>{"a", "bc"});
+    CHECK(lines_of("a\n\nb\n") == std::vector<std::string>{"a", "", "b"});
+}
+
+TEST_CASE("subnet_data process_lines matches process_line") {
+
+    // a pyasn.db in the format of the resource archive, with a line
+    // that cannot be parsed, and without a final newline
+    //
+    std::string pyasn;
+    std::vector<std::string> addresses;
+    for (unsigned int i = 0; i < 1000; i++) {
+        std::string net = std::to_string(11 + i / 256) + "." + std::to_string(i % 256);
+        pyasn += net + ".0.0/16\t" + std::to_string(64512 + i) + "\n";
+        addresses.push_back(net + ".1.2");
+        if (i == 500) {
+            pyasn += "not a subnet\n";
+        }
+    }
+    pyasn += "200.1.2.0/24\t65000";
+    addresses.push_back("200.1.2.3");
+    addresses.push_back("200.1.3.3");
+
+    // expected[i] is the ASN of addresses[i] when each line is
+    // processed on its own
+    //
+    std::vector<uint32_t> expected;
+    {
+        subnet_data serial;
+        for (std::string &line : lines_of(pyasn)) {
+            serial.process_line(line);
+        }
+        serial.process_final();
+        for (const auto &a : addresses) {
+            expected.push_back(serial.get_asn_info(a.c_str()));
+        }
+    }
+    CHECK(expected[0] == 64512);
+    CHECK(expected[999] == 64512 + 999);
+    CHECK(expected[1000] == 65000);
+    CHECK(expected[1001] == 0);
+
+    for (unsigned int threads : { 0, 1, 3, 8, 64 }) {
+        INFO("threads " << threads);
+        subnet_data parallel;
+        parallel.process_lines(pyasn, threads);
+        parallel.process_final();
+        for (size_t i = 0; i < addresses.size(); i++) {
+            CHECK(parallel.get_asn_info(addresses[i].c_str()) == expected[i]);
+        }
+    }
+}
+
+// write_snapshot(archive_name, snapshot_name) writes a snapshot of the
+// unencrypted archive archive_name to the file snapshot_name
+//
+static void write_snapshot(const char *archive_name, const char *snapshot_name) {
+    encrypted_compressed_archive archive{archive_name, nullptr};
+    FILE *f = fopen(snapshot_name, "w");
+    REQUIRE(f != nullptr);
+    bool ok = resource_snapshot::write(archive, f);
+    REQUIRE(fclose(f) == 0);
+    REQUIRE(ok);
+}
+
+TEST_CASE("resource snapshots hold the entries of the archive") {
+    write_snapshot(default_resources_path, snapshot_test_file);
+    REQUIRE(resource_snapshot::is_snapshot(snapshot_test_file));
+    CHECK_FALSE(resource_snapshot::is_snapshot(default_resources_path));
+
+    // the entries of the snapshot, read with read_entry(), are those
+    // of the archive
+    //
+    std::vector<std::pair<std::string, std::string>> from_archive, from_snapshot;
+    {
+        encrypted_compressed_archive archive{default_resources_path, nullptr};
+        for (const auto *e = archive.get_next_entry(); e != nullptr; e = archive.get_next_entry()) {
+            if (e->is_regular_file()) {
+                std::string contents;
+                classifier::read_entry(archive, *e, contents);
+                from_archive.push_back({e->get_name(), contents});
+            }
+        }
+    }
+    {
+        resource_snapshot snapshot{snapshot_test_file};
+        CHECK(snapshot.header().num_entries == from_archive.size());
+        for (const auto *e = snapshot.get_next_entry(); e != nullptr; e = snapshot.get_next_entry()) {
+            std::string contents;
+            classifier::read_entry(snapshot, *e, contents);
+            from_snapshot.push_back({e->get_name(), contents});
+        }
+    }
+    REQUIRE(from_archive.size() > 0);
+    CHECK(from_snapshot == from_archive);
+
+    // a snapshot that is truncated, or that does not match its
+    // checksum, is rejected
+    //
+    std::ifstream in{snapshot_test_file, std::ios::binary};
+    std::string image{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+    auto write_bad = [](const std::string &s) {
+        std::ofstream out{bad_snapshot_test_file, std::ios::binary};
+        out.write(s.data(), s.length());
+    };
+    write_bad(image.substr(0, image.length() - 1));
+    CHECK_THROWS_AS(resource_snapshot{bad_snapshot_test_file}, std::runtime_error);
+    write_bad(image.substr(0, 16));
+    CHECK_THROWS_AS(resource_snapshot{bad_snapshot_test_file}, std::runtime_error);
+    std::string corrupt = image;
+    corrupt[corrupt.length() / 2] ^= 0x01;
+    write_bad(corrupt);
+    CHECK_THROWS_AS(resource_snapshot{bad_snapshot_test_file}, std::runtime_error);
+
+    remove(bad_snapshot_test_file);
+    remove(snapshot_test_file);
+}
+
+TEST_CASE_METHOD(LibmercTestFixture, "analysis with a resource snapshot matches analysis with the archive")
+{
+    write_snapshot(default_resources_path, snapshot_test_file);
+
+    // analyze(resources) returns the records written for a pcap when
+    // resources is the resource file
+    //
+    auto analyze = [this](char *resources) {
+        struct libmerc_config config{};
+        config.resources = resources;
+        config.do_analysis = true;
+        initialize(config);
+        REQUIRE(m_mc != nullptr);
+        std::vector<std::string> records;
+        set_pcap("top_100_fingerprints.pcap");
+        while (read_next_data_packet() == 0) {
+            size_t len = mercury_packet_processor_write_json(m_mpp, m_output, sizeof(m_output),
+                                                             (unsigned char *)m_data_packet.first,
+                                                             m_data_packet.second - m_data_packet.first,
+                                                             &m_time);
+            if (len > 0) {
+                records.emplace_back(m_output, len);
+            }
+        }
+        CHECK(std::string{mercury_get_resource_version(m_mc)} != "");
+        deinitialize();
+        return records;
+    };
+
+    std::vector<std::string> from_archive = analyze(default_resources_path);
+    std::vector<std::string> from_snapshot = analyze((char *)snapshot_test_file);
+    REQUIRE(from_archive.size() > 0);
+    CHECK(from_snapshot == from_archive);
+
+    remove(snapshot_test_file);
+}
+
+TEST_CASE("resource snapshots are rejected with a decryption key") {
+    write_snapshot(default_resources_path, snapshot_test_file);
+
+    uint8_t key[16] = { 0x00, };
+    struct libmerc_config config{};
+    config.resources = (char *)snapshot_test_file;
+    config.do_analysis = true;
+    config.enc_key = key;
+    config.key_type = enc_key_type_aes_128;
+    CHECK(mercury_init(&config, 0) == nullptr);
+
+    config.enc_key = nullptr;
+    config.key_type = enc_key_type_none;
+    mercury_context mc = mercury_init(&config, 0);
+    CHECK(mc != nullptr);
+    mercury_finalize(mc);
+
+    remove(snapshot_test_file);
+}
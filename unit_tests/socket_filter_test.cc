@@ -0,0 +1,168 @@
+/*
+ * socket_filter_test.cc
+ *
+ * checks that the socket filter compiled from a protocol selection
+ * passes every packet that libmerc writes a JSON record for
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include "libmerc_fixture.h"
+#include "socket_filter.h"
+
+// class filtered_socketpair attaches a socket_filter to one end of a
+// datagram socketpair, so that the kernel runs the filter on each
+// packet sent into the other end
+//
+class filtered_socketpair {
+    int fd[2] = { -1, -1 };
+
+public:
+
+    filtered_socketpair(socket_filter &filter) {
+        REQUIRE(socketpair(AF_UNIX, SOCK_DGRAM, 0, fd) == 0);
+        struct sock_fprog prog = filter.program();
+        REQUIRE(setsockopt(fd[1], SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) == 0);
+    }
+
+    ~filtered_socketpair() {
+        close(fd[0]);
+        close(fd[1]);
+    }
+
+    // passes() returns true if the filter accepts the packet
+    //
+    bool passes(const uint8_t *pkt, size_t length) {
+        REQUIRE(send(fd[0], pkt, length, 0) == (ssize_t)length);
+        static uint8_t buf[65536];
+        return recv(fd[1], buf, sizeof(buf), MSG_DONTWAIT) == (ssize_t)length;
+    }
+};
+
+TEST_CASE_METHOD(LibmercTestFixture, "socket filter passes every packet with output")
+{
+    // all of these pcaps have ethernet framing, which the socket filter assumes
+    //
+    const char *pcaps[] = {
+        "capture2.pcap",
+        "top_100_fingerprints.pcap",
+        "dns_packet.capture2.pcap",
+        "mdns_capture.pcap",
+        "http_request.capture2.pcap",
+        "multi_packet_http_request.pcap",
+        "quic_init.capture2.pcap",
+        "quic_v2.pcap",
+        "smb.pcap",
+        "openvpn_tcp_multi.pcap",
+        "bittorrent.pcap",
+        "mysql.pcap",
+        "dnp3.pcap",
+        "iec.pcap",
+        "tls_sgt.pcap",
+    };
+    const char *selections[] = {
+        "all",
+        "tls",
+        "tls.client_hello,dns",
+        "http,quic",
+        "smb,nbss,openvpn_tcp",
+        "ssh,stun,dtls,wireguard",
+        "bittorrent,mysql,dnp3,iec",
+        "tcp,tcp.message",
+    };
+
+    for (const char *selection : selections) {
+        struct libmerc_config config{};
+        config.resources = default_resources_path;
+        config.packet_filter_cfg = (char *)selection;
+        initialize(config);
+
+        socket_filter filter{m_mc->selector, m_mc->global_vars};
+        filtered_socketpair sockets{filter};
+
+        for (const char *pcap : pcaps) {
+            set_pcap(pcap);
+            size_t records = 0;
+            size_t dropped = 0;
+            while (read_next_data_packet() == 0) {
+                size_t length = m_data_packet.second - m_data_packet.first;
+                bool passed = sockets.passes(m_data_packet.first, length);
+                if (!passed) {
+                    dropped++;
+                }
+                size_t json = mercury_packet_processor_write_json(m_mpp, m_output, sizeof(m_output),
+                                                                  (unsigned char *)m_data_packet.first,
+                                                                  length, &m_time);
+                if (json > 0) {
+                    records++;
+                    INFO("selection: " << selection << ", pcap: " << pcap << ", record: " << m_output);
+                    CHECK(passed);
+                }
+            }
+            UNSCOPED_INFO("selection " << selection << ", " << pcap << ": " << records << " records, " << dropped << " packets dropped");
+        }
+        deinitialize();
+    }
+}
+
+TEST_CASE_METHOD(LibmercTestFixture, "socket filter drops unselected data")
+{
+    // with only DNS selected, none of the TCP data in capture2.pcap
+    // is passed, but the SYN, FIN, and RST segments are
+    //
+    struct libmerc_config config{};
+    config.resources = default_resources_path;
+    config.packet_filter_cfg = (char *)"dns";
+    initialize(config);
+
+    socket_filter filter{m_mc->selector, m_mc->global_vars};
+    CHECK_FALSE(filter.passes_all_tcp_data());
+    CHECK_FALSE(filter.passes_all_udp_data());
+    filtered_socketpair sockets{filter};
+
+    set_pcap("capture2.pcap");
+    size_t dropped = 0;
+    while (read_next_data_packet() == 0) {
+        size_t length = m_data_packet.second - m_data_packet.first;
+        if (!sockets.passes(m_data_packet.first, length)) {
+            dropped++;
+        }
+    }
+    CHECK(dropped > 0);
+    deinitialize();
+}
+
+TEST_CASE_METHOD(LibmercTestFixture, "socket filter passes all data with nonselected data output")
+{
+    // --nonselected-tcp-data and --nonselected-udp-data write records
+    // for data that no selected protocol recognizes, so the filter
+    // can only drop TCP segments without data
+    //
+    struct libmerc_config config{};
+    config.resources = default_resources_path;
+    config.packet_filter_cfg = (char *)"dns";
+    config.output_tcp_initial_data = true;
+    config.output_udp_initial_data = true;
+    initialize(config);
+
+    socket_filter filter{m_mc->selector, m_mc->global_vars};
+    CHECK(filter.passes_all_tcp_data());
+    CHECK(filter.passes_all_udp_data());
+    filtered_socketpair sockets{filter};
+
+    set_pcap("capture2.pcap");
+    while (read_next_data_packet() == 0) {
+        size_t length = m_data_packet.second - m_data_packet.first;
+        bool passed = sockets.passes(m_data_packet.first, length);
+        size_t json = mercury_packet_processor_write_json(m_mpp, m_output, sizeof(m_output),
+                                                          (unsigned char *)m_data_packet.first,
+                                                          length, &m_time);
+        if (json > 0) {
+            CHECK(passed);
+        }
+    }
+    deinitialize();
+}
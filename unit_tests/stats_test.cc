@@ -0,0 +1,340 @@
+/*
+ * stats_test.cc
+ *
+ * unit tests for the stats tables and shards, and the data_aggregator
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#include <random>
+#include <regex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "libmerc_fixture.h"
+#include "stats.h"
+
+static const char *stats_test_file = "stats_test.json.gz";
+
+// read_gz(fname) returns the decompressed contents of the gzip file fname
+//
+static std::string read_gz(const char *fname) {
+    std::string s;
+    gzFile f = gzopen(fname, "r");
+    REQUIRE(f != nullptr);
+    char buf[4096];
+    int len;
+    while ((len = gzread(f, buf, sizeof(buf))) > 0) {
+        s.append(buf, len);
+    }
+    gzclose(f);
+    return s;
+}
+
+// total_count(s) returns the sum of the counts in the stats output s
+//
+static uint64_t total_count(const std::string &s) {
+    static const std::regex count_regex{"\"count\":([0-9]+)"};
+    uint64_t total = 0;
+    for (auto it = std::sregex_iterator(s.begin(), s.end(), count_regex); it != std::sregex_iterator(); ++it) {
+        total += std::stoull((*it)[1]);
+    }
+    return total;
+}
+
+// dump(ag) writes the stats of ag, and returns the sum of their counts
+//
+static uint64_t dump(data_aggregator &ag) {
+    gzFile f = gzopen(stats_test_file, "w");
+    REQUIRE(f != nullptr);
+    ag.gzprint(f, "test", 0, "2021-01-01T00:00:00Z");
+    gzclose(f);
+    uint64_t total = total_count(read_gz(stats_test_file));
+    remove(stats_test_file);
+    return total;
+}
+
+// count(t) returns the sum of the counts in the stats_table t
+//
+static uint64_t count(const stats_table &t) {
+    dump_strings strings;
+    uint64_t total = 0;
+    for (const auto &r : t.records(strings)) {
+        total += r.c.count;
+    }
+    return total;
+}
+
+static const struct key k1{49152, 443, 0x0100000a, 0x01010101, 6};
+static const struct key k2{49153, 443, 0x0200000a, 0x02020202, 6};
+
+TEST_CASE("stats_shard swap starts a new epoch") {
+    std::atomic<size_t> num_entries{0};
+    stats_shard shard{num_entries, 0, 0};
+
+    for (int i = 0; i < 3; i++) {
+        shard.observe(k1, "fp1", "", "example.com");
+    }
+    stats_table *old = shard.swap();
+    dump_strings strings;
+    std::vector<stats_record> r = old->records(strings);
+    REQUIRE(r.size() == 1);
+    CHECK(r[0].c.count == 3);
+    CHECK(strings[r[0].fp_id] == "fp1");
+    CHECK(strings[r[0].sn_id] == "example.com");
+
+    // events after the swap go into the other table
+    //
+    shard.observe(k2, "fp2", "ua", "example.org");
+    CHECK(count(*old) == 3);
+    old->clear();
+    CHECK(old->is_empty());
+
+    stats_table *next = shard.swap();
+    CHECK(next != old);
+    dump_strings next_strings;
+    r = next->records(next_strings);
+    REQUIRE(r.size() == 1);
+    CHECK(r[0].c.count == 1);
+    CHECK(next_strings[r[0].fp_id] == "fp2");
+    CHECK(next_strings[r[0].ua_id] == "ua");
+    next->clear();
+
+    CHECK(shard.swap() == old);        // the tables alternate
+}
+
+TEST_CASE("stats_shard swap does not lose events counted concurrently") {
+    std::atomic<size_t> num_entries{0};
+    stats_shard shard{num_entries, 0, 0};
+    const uint64_t observations = 200000;
+    std::atomic<bool> done{false};
+
+    std::thread owner{[&]() {
+        const char *fps[] = { "fp1", "fp2", "fp3" };
+        for (uint64_t i = 0; i < observations; i++) {
+            shard.observe(i & 1 ? k1 : k2, fps[i % 3], "", "example.com");
+        }
+        done.store(true);
+    }};
+
+    uint64_t total = 0;
+    size_t swaps = 0;
+    while (done.load() == false) {
+        stats_table *t = shard.swap();
+        total += count(*t);
+        t->clear();
+        swaps++;
+    }
+    owner.join();
+    stats_table *t = shard.swap();
+    total += count(*t);
+    t->clear();
+
+    CHECK(total == observations);
+    UNSCOPED_INFO(swaps << " swaps");
+}
+
+TEST_CASE("data_aggregator writes the events of a retired shard once") {
+    data_aggregator ag;
+    stats_shard *p1 = ag.add_producer();
+    stats_shard *p2 = ag.add_producer();
+
+    for (int i = 0; i < 5; i++) {
+        p1->observe(k1, "fp1", "", "example.com");
+    }
+    p2->observe(k2, "fp2", "", "example.org");
+    p2->observe(k1, "fp1", "", "example.com");
+    CHECK(dump(ag) == 7);
+
+    // p1 counts events in a new epoch, and then goes away
+    //
+    for (int i = 0; i < 4; i++) {
+        p1->observe(k2, "fp1", "", "example.com");
+    }
+    ag.remove_producer(p1);
+    CHECK(dump(ag) == 4);
+
+    p2->observe(k2, "fp2", "", "example.org");
+    CHECK(dump(ag) == 1);
+    CHECK(dump(ag) == 0);
+}
+
+TEST_CASE("data_aggregator writes fingerprints and server names in string order") {
+    data_aggregator ag;
+    stats_shard *p1 = ag.add_producer();
+    stats_shard *p2 = ag.add_producer();
+
+    // the strings are seen in reverse order, and split across shards
+    //
+    p2->observe(k1, "fp_c", "", "c.example.com");
+    p1->observe(k1, "fp_b", "", "b.example.com");
+    p2->observe(k1, "fp_b", "", "a.example.com");
+    p1->observe(k1, "fp_a", "", "c.example.com");
+
+    gzFile f = gzopen(stats_test_file, "w");
+    REQUIRE(f != nullptr);
+    ag.gzprint(f, "test", 0, "2021-01-01T00:00:00Z");
+    gzclose(f);
+    std::string s = read_gz(stats_test_file);
+    remove(stats_test_file);
+
+    std::vector<size_t> pos;
+    for (const char *x : { "fp_a", "fp_b", "(a.example.com)", "(b.example.com)", "fp_c" }) {
+        pos.push_back(s.find(x));
+        REQUIRE(pos.back() != std::string::npos);
+    }
+    CHECK(std::is_sorted(pos.begin(), pos.end()));
+}
+
+TEST_CASE_METHOD(LibmercTestFixture, "stats of a packet processor destroyed between dumps")
+{
+    struct libmerc_config config{};
+    config.resources = default_resources_path;
+    config.do_analysis = true;
+    config.do_stats = true;
+    initialize(config);
+
+    // process(mpp) runs capture2.pcap through the packet processor
+    // mpp, and returns the number of records written
+    //
+    auto process = [this](mercury_packet_processor mpp) {
+        size_t records = 0;
+        set_pcap("capture2.pcap");
+        while (read_next_data_packet() == 0) {
+            if (mercury_packet_processor_write_json(mpp, m_output, sizeof(m_output),
+                                                    (unsigned char *)m_data_packet.first,
+                                                    m_data_packet.second - m_data_packet.first,
+                                                    &m_time) > 0) {
+                records++;
+            }
+        }
+        return records;
+    };
+    auto stats_total = [this]() {
+        REQUIRE(mercury_write_stats_data(m_mc, stats_test_file));
+        uint64_t total = total_count(read_gz(stats_test_file));
+        remove(stats_test_file);
+        return total;
+    };
+
+    REQUIRE(process(m_mpp) > 0);
+    uint64_t per_pass = stats_total();
+    REQUIRE(per_pass > 0);
+
+    // the events of a processor that is destroyed before a dump are
+    // written by that dump, and are not written again
+    //
+    mercury_packet_processor other = mercury_packet_processor_construct(m_mc);
+    REQUIRE(other != nullptr);
+    process(other);
+    process(m_mpp);
+    mercury_packet_processor_destruct(other);
+    CHECK(stats_total() == 2 * per_pass);
+
+    process(m_mpp);
+    CHECK(stats_total() == per_pass);
+    CHECK(stats_total() == 0);
+
+    deinitialize();
+}
+
+// sketch_counts(t) returns the counts in the stats_table t, by fingerprint
+//
+static std::unordered_map<std::string, event_count> sketch_counts(const stats_table &t) {
+    dump_strings strings;
+    std::unordered_map<std::string, event_count> counts;
+    for (const auto &r : t.records(strings)) {
+        counts[std::string{strings[r.fp_id]}] = r.c;
+    }
+    return counts;
+}
+
+TEST_CASE("stats_table sketch tracks the heavy hitters") {
+    const size_t capacity = 16;
+    std::atomic<size_t> num_entries{0};
+    stats_table sketch{capacity};
+
+    // a skewed stream: event i is observed about 2000/(i+1) times,
+    // interleaved with many events that are observed once
+    //
+    std::mt19937 rng{7};
+    std::vector<std::string> fps;
+    std::unordered_map<std::string, uint64_t> truth;
+    for (size_t i = 0; i < 8; i++) {
+        for (size_t j = 0; j < 2000 / (i + 1); j++) {
+            fps.push_back("heavy" + std::to_string(i));
+        }
+    }
+    for (size_t j = 0; j < 3000; j++) {
+        fps.push_back("light" + std::to_string(j));
+    }
+    std::shuffle(fps.begin(), fps.end(), rng);
+    for (const auto &fp : fps) {
+        sketch.observe(k1, fp.c_str(), "", "example.com", num_entries, 0);
+        truth[fp]++;
+    }
+    const uint64_t n = fps.size();
+
+    auto counts = sketch_counts(sketch);
+    CHECK(counts.size() == capacity);
+    CHECK(num_entries.load() == capacity);
+    uint64_t total = 0;
+    for (const auto &[fp, c] : counts) {
+        INFO(fp);
+        CHECK(c.count >= truth[fp]);                // never an underestimate
+        CHECK(c.count - c.error <= truth[fp]);      // the error bounds the overestimate
+        CHECK(c.error <= n / capacity);
+        total += c.count;
+    }
+    CHECK(total == n);                              // each observation is counted once
+
+    // every event observed more than n/capacity times is present
+    //
+    for (const auto &[fp, t] : truth) {
+        if (t > n / capacity) {
+            INFO(fp);
+            CHECK(counts.find(fp) != counts.end());
+        }
+    }
+}
+
+TEST_CASE("stats_table sketch is exact while it has room") {
+    std::atomic<size_t> num_entries{0};
+    stats_table sketch{8};
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j <= i; j++) {
+            sketch.observe(k1, ("fp" + std::to_string(i)).c_str(), "", "example.com", num_entries, 0);
+        }
+    }
+    auto counts = sketch_counts(sketch);
+    REQUIRE(counts.size() == 8);
+    for (int i = 0; i < 8; i++) {
+        CHECK(counts["fp" + std::to_string(i)].count == (uint64_t)i + 1);
+        CHECK(counts["fp" + std::to_string(i)].error == 0);
+    }
+
+    // a new event replaces the one with the smallest count, and
+    // inherits that count as its error
+    //
+    sketch.observe(k1, "new", "", "example.com", num_entries, 0);
+    counts = sketch_counts(sketch);
+    CHECK(counts.size() == 8);
+    CHECK(counts.find("fp0") == counts.end());
+    CHECK(counts["new"].count == 2);
+    CHECK(counts["new"].error == 1);
+}
+
+TEST_CASE("event_processor_gz writes 64-bit counts") {
+    gzFile f = gzopen(stats_test_file, "w");
+    REQUIRE(f != nullptr);
+    event_processor_gz ep{f, true};
+    ep.process_init("1.0", "test", 0, "2021-01-01T00:00:00Z");
+    ep.process_update(event_processor_gz::src_level, "00", "fp", "", "(example.com)(01010101)(443)",
+                      event_count{5000000000, 4294967297});
+    ep.process_final();
+    gzclose(f);
+    std::string s = read_gz(stats_test_file);
+    remove(stats_test_file);
+    CHECK(s.find("\"count\":5000000000,\"count_error\":4294967297") != std::string::npos);
+}
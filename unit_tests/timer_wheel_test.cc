@@ -0,0 +1,201 @@
+/*
+ * timer_wheel_test.cc
+ *
+ * unit tests for class timer_wheel
+ *
+ * Copyright (c) 2021 Cisco Systems, Inc. All rights reserved.  License at
+ * https://github.com/cisco/mercury/blob/master/LICENSE
+ */
+
+#include <vector>
+#include <random>
+#include "catch.hpp"
+#include "timer_wheel.h"
+
+// struct recorder is a timer_client that records the time at which
+// each of its timers fired, and can reschedule a timer when it fires
+//
+struct recorder : public timer_client {
+    timer_wheel &wheel;
+    std::vector<std::pair<struct wheel_timer *, unsigned int>> fired;
+    unsigned int reschedule_delay = 0;
+
+    recorder(timer_wheel &w) : wheel{w} { }
+
+    void expire(struct wheel_timer *t, unsigned int now) override {
+        CHECK_FALSE(t->is_scheduled());
+        fired.push_back({t, now});
+        if (reschedule_delay) {
+            wheel.schedule(t, this, now + reschedule_delay);
+        }
+    }
+
+    unsigned int fire_time(struct wheel_timer *t) const {
+        for (const auto &f : fired) {
+            if (f.first == t) {
+                return f.second;
+            }
+        }
+        return 0;
+    }
+};
+
+TEST_CASE("timer_wheel fires timers at their expiry time on every level") {
+    timer_wheel wheel;
+    recorder r{wheel};
+    wheel.advance(1000);
+
+    // expiry times that fall in each of the levels of the wheel, and
+    // on the boundaries between them
+    //
+    std::vector<unsigned int> delays = { 1, 2, 63, 64, 65, 100, 4095, 4096, 4097, 10000, 262143, 262144, 262145, 1000000 };
+    std::mt19937 rng{1};
+    for (int i = 0; i < 200; i++) {
+        delays.push_back(1 + rng() % 2000000);
+    }
+
+    std::vector<struct wheel_timer> timers(delays.size(), wheel_timer{});
+    for (size_t i = 0; i < delays.size(); i++) {
+        wheel.schedule(&timers[i], &r, 1000 + delays[i]);
+    }
+    CHECK(wheel.size() == delays.size());
+
+    // advance in uneven steps, since a step ticks through every second
+    //
+    unsigned int now = 1000;
+    while (now < 1000 + 2000001) {
+        now += 1 + rng() % 5000;
+        wheel.advance(now);
+    }
+
+    CHECK(wheel.size() == 0);
+    REQUIRE(r.fired.size() == delays.size());
+    for (size_t i = 0; i < delays.size(); i++) {
+        INFO("delay " << delays[i]);
+        CHECK(r.fire_time(&timers[i]) == 1000 + delays[i]);
+    }
+}
+
+TEST_CASE("timer_wheel fires overdue timers at the next tick") {
+    timer_wheel wheel;
+    recorder r{wheel};
+    wheel.advance(50);
+
+    struct wheel_timer past{}, now{};
+    wheel.schedule(&past, &r, 10);
+    wheel.schedule(&now, &r, 50);
+    wheel.advance(50);                // not a tick
+    CHECK(r.fired.empty());
+    wheel.advance(51);
+    CHECK(r.fire_time(&past) == 51);
+    CHECK(r.fire_time(&now) == 51);
+}
+
+TEST_CASE("timer_wheel cancels and reschedules timers") {
+    timer_wheel wheel;
+    recorder r{wheel};
+    wheel.advance(0);
+
+    struct wheel_timer a{}, b{}, c{};
+    wheel.schedule(&a, &r, 10);
+    wheel.schedule(&b, &r, 10);
+    wheel.schedule(&c, &r, 10);
+    CHECK(wheel.size() == 3);
+
+    wheel.cancel(&a);
+    CHECK_FALSE(a.is_scheduled());
+    wheel.cancel(&a);                 // cancelling twice is harmless
+    CHECK(wheel.size() == 2);
+
+    wheel.schedule(&b, &r, 5000);     // moved to a higher level
+    CHECK(wheel.size() == 2);
+
+    wheel.advance(10);
+    REQUIRE(r.fired.size() == 1);
+    CHECK(r.fire_time(&c) == 10);
+
+    wheel.advance(6000);
+    REQUIRE(r.fired.size() == 2);
+    CHECK(r.fire_time(&b) == 5000);
+    CHECK(r.fire_time(&a) == 0);
+}
+
+TEST_CASE("timer_wheel lets a client reschedule a timer that fired") {
+    timer_wheel wheel;
+    recorder r{wheel};
+    r.reschedule_delay = 7;
+    wheel.advance(0);
+
+    struct wheel_timer t{};
+    wheel.schedule(&t, &r, 3);
+    wheel.advance(30);
+    REQUIRE(r.fired.size() == 4);     // at 3, 10, 17, and 24
+    CHECK(r.fired[3].second == 24);
+    CHECK(t.is_scheduled());
+    CHECK(wheel.size() == 1);
+
+    wheel.cancel(&t);
+    CHECK(wheel.size() == 0);
+}
+
+TEST_CASE("timer_wheel does not move backwards") {
+    timer_wheel wheel;
+    recorder r{wheel};
+    wheel.advance(100);
+
+    struct wheel_timer t{};
+    wheel.schedule(&t, &r, 105);
+    wheel.advance(90);                // out of order timestamp
+    CHECK(wheel.now() == 100);
+    wheel.advance(104);
+    CHECK(r.fired.empty());
+    wheel.advance(105);
+    CHECK(r.fire_time(&t) == 105);
+}
+
+TEST_CASE("timer_wheel fires every timer after a jump past its range") {
+    timer_wheel wheel;
+    recorder r{wheel};
+    wheel.advance(0);
+
+    std::vector<struct wheel_timer> timers(100, wheel_timer{});
+    for (size_t i = 0; i < timers.size(); i++) {
+        wheel.schedule(&timers[i], &r, 1 + i * 100000);
+    }
+    wheel.advance(timer_wheel::range + 10);
+    CHECK(wheel.size() == 0);
+    REQUIRE(r.fired.size() == timers.size());
+    for (const auto &f : r.fired) {
+        CHECK(f.second == timer_wheel::range + 10);
+    }
+}
+
+TEST_CASE("timer_wheel holds timers beyond its range") {
+    timer_wheel wheel;
+    recorder r{wheel};
+    wheel.advance(0);
+
+    struct wheel_timer t{};
+    unsigned int expires = timer_wheel::range + 5000;
+    wheel.schedule(&t, &r, expires);
+    for (unsigned int now = 0; now < expires + 10; ) {
+        now += timer_wheel::range / 16;
+        wheel.advance(now < expires + 10 ? now : expires + 10);
+    }
+    CHECK(r.fire_time(&t) == expires);
+}
+
+TEST_CASE("timer_wheel handles the wraparound of time") {
+    timer_wheel wheel;
+    recorder r{wheel};
+    wheel.advance(0xffffff00);
+
+    struct wheel_timer t{};
+    wheel.schedule(&t, &r, 0x100);    // 512 seconds later
+    wheel.advance(0xffffffff);
+    CHECK(r.fired.empty());
+    wheel.advance(0x80);
+    CHECK(r.fired.empty());
+    wheel.advance(0x200);
+    CHECK(r.fire_time(&t) == 0x100);
+}